@@ -55,12 +55,30 @@ class dynamic_2bitset {
   const uint8_t ones() { return std::numeric_limits<uint8_t>::max(); }
 };
 
-static uint32_t nextpoweroftwo(uint32_t k) {
+static inline uint32_t nextpoweroftwo(uint32_t k) {
   if (k == 0) return 1;
   k--;
   for (uint32_t i=1; i<sizeof(uint32_t)*CHAR_BIT; i<<=1) k = k | k >> i;
   return k+1;
 }
+// Maps a well mixed 32-bit hash value to [0, n) with a multiplication
+// and a shift instead of a division.
+static inline uint32_t fastrange32(uint32_t h, uint32_t n) {
+  return static_cast<uint32_t>((static_cast<uint64_t>(h) * n) >> 32);
+}
+// Number of bits set in x. Uses the popcnt instruction when the compiler
+// targets it (e.g. -mpopcnt or -march=native), a branch free count otherwise.
+static inline uint32_t popcount64(uint64_t x) {
+#if defined(__GNUC__) && (defined(__POPCNT__) || defined(__aarch64__))
+  return __builtin_popcountll(x);
+#else
+  x = x - ((x >> 1) & 0x5555555555555555ULL);
+  x = (x & 0x3333333333333333ULL) + ((x >> 2) & 0x3333333333333333ULL);
+  x = (x + (x >> 4)) & 0x0f0f0f0f0f0f0f0fULL;
+  return (x * 0x0101010101010101ULL) >> 56;
+#endif
+}
+
 // Interesting bit tricks that might end up here:
 // http://graphics.stanford.edu/~seander/bithacks.html#ZeroInWord
 // Fast a % (k*2^t)
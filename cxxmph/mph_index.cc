@@ -1,3 +1,4 @@
+#include <algorithm>
 #include <limits>
 #include <iostream>
 #include <vector>
@@ -12,26 +13,25 @@ using std::vector;
 namespace {
 
 static const uint8_t kUnassigned = 3;
-// table used for looking up the number of assigned vertices to a 8-bit integer
-static uint8_t kBdzLookupIndex[] =
-{
-4, 4, 4, 3, 4, 4, 4, 3, 4, 4, 4, 3, 3, 3, 3, 2,
-4, 4, 4, 3, 4, 4, 4, 3, 4, 4, 4, 3, 3, 3, 3, 2,
-4, 4, 4, 3, 4, 4, 4, 3, 4, 4, 4, 3, 3, 3, 3, 2,
-3, 3, 3, 2, 3, 3, 3, 2, 3, 3, 3, 2, 2, 2, 2, 1,
-4, 4, 4, 3, 4, 4, 4, 3, 4, 4, 4, 3, 3, 3, 3, 2,
-4, 4, 4, 3, 4, 4, 4, 3, 4, 4, 4, 3, 3, 3, 3, 2,
-4, 4, 4, 3, 4, 4, 4, 3, 4, 4, 4, 3, 3, 3, 3, 2,
-3, 3, 3, 2, 3, 3, 3, 2, 3, 3, 3, 2, 2, 2, 2, 1,
-4, 4, 4, 3, 4, 4, 4, 3, 4, 4, 4, 3, 3, 3, 3, 2,
-4, 4, 4, 3, 4, 4, 4, 3, 4, 4, 4, 3, 3, 3, 3, 2,
-4, 4, 4, 3, 4, 4, 4, 3, 4, 4, 4, 3, 3, 3, 3, 2,
-3, 3, 3, 2, 3, 3, 3, 2, 3, 3, 3, 2, 2, 2, 2, 1,
-3, 3, 3, 2, 3, 3, 3, 2, 3, 3, 3, 2, 2, 2, 2, 1,
-3, 3, 3, 2, 3, 3, 3, 2, 3, 3, 3, 2, 2, 2, 2, 1,
-3, 3, 3, 2, 3, 3, 3, 2, 3, 3, 3, 2, 2, 2, 2, 1,
-2, 2, 2, 1, 2, 2, 2, 1, 2, 2, 2, 1, 1, 1, 1, 0
-};
+
+// Reads the 32 2-bit values of g starting at byte i as a single word, the
+// values past the end of g read as kUnassigned.
+inline uint64_t load_values(const vector<uint8_t>& g, uint32_t i) {
+  uint64_t word = 0;
+  for (uint32_t j = 0; j < 8; ++j) {
+    uint64_t byte = i + j < g.size() ? g[i + j] : 0xff;
+    word |= byte << (j << 3);
+  }
+  return word;
+}
+
+// Number of values other than kUnassigned among the first nvalues (at most
+// 32) 2-bit values of word.
+inline uint32_t assigned_values(uint64_t word, uint32_t nvalues) {
+  uint64_t unassigned = word & (word >> 1) & 0x5555555555555555ULL;
+  if (nvalues < 32) unassigned &= (1ULL << (nvalues << 1)) - 1;
+  return nvalues - cxxmph::popcount64(unassigned);
+}
 
 }  // anonymous namespace
 
@@ -157,24 +157,16 @@ void MPHIndex::Assigning(
 }
 
 void MPHIndex::Ranking() {
-  uint32_t nbytes_total = static_cast<uint32_t>(ceil(n_ / 4.0));
-  uint32_t size = k_ >> 2U;
   uint32_t ranktable_size = static_cast<uint32_t>(
       ceil(n_ / static_cast<double>(k_)));
   vector<uint32_t> ranktable(ranktable_size);
-  uint32_t offset = 0;
   uint32_t count = 0;
-  uint32_t i = 1;
-  while (1) {
-    if (i == ranktable.size()) break;
-    uint32_t nbytes = size < nbytes_total ? size : nbytes_total;
-    for (uint32_t j = 0; j < nbytes; ++j) {
-      count += kBdzLookupIndex[g_.data()[offset + j]];
+  for (uint32_t i = 1; i < ranktable.size(); ++i) {
+    uint32_t end = i << b_;
+    for (uint32_t v = (i - 1) << b_; v < end; v += 32) {
+      count += assigned_values(load_values(g_.data(), v >> 2), std::min(32U, end - v));
     }
     ranktable[i] = count;
-    offset += nbytes;
-    nbytes_total -= size;
-    ++i;
   }
   ranktable_.swap(ranktable);
 }
@@ -184,27 +176,14 @@ uint32_t MPHIndex::Rank(uint32_t vertex) const {
   uint32_t index = vertex >> b_;
   uint32_t base_rank = ranktable_[index];
   uint32_t beg_idx_v = index << b_;
-  uint32_t beg_idx_b = beg_idx_v >> 2;
-  uint32_t end_idx_b = vertex >> 2;
-  while (beg_idx_b < end_idx_b) {
-     assert(g_.data().size() > beg_idx_b);
-     base_rank += kBdzLookupIndex[g_.data()[beg_idx_b++]];
-  }
-  beg_idx_v = beg_idx_b << 2;
-  /*
-  cerr << "beg_idx_v: " << beg_idx_v << endl;
-  cerr << "base rank: " << base_rank << endl;
-  cerr << "G: ";
-  for (unsigned int i = 0; i < n_; ++i) {
-   cerr << static_cast<uint32_t>(g_[i]) << " ";
+  // 32 values per popcount, k_/32 of them at most instead of k_/4 lookups
+  while (beg_idx_v + 32 <= vertex) {
+    base_rank += assigned_values(load_values(g_.data(), beg_idx_v >> 2), 32);
+    beg_idx_v += 32;
   }
-  cerr << endl;
-  */
-  while (beg_idx_v < vertex) {
-    if (g_[beg_idx_v] != kUnassigned) ++base_rank;
-    ++beg_idx_v;
+  if (beg_idx_v < vertex) {
+    base_rank += assigned_values(load_values(g_.data(), beg_idx_v >> 2), vertex - beg_idx_v);
   }
-  // cerr << "Base rank: " << base_rank << endl;
   return base_rank;
 }
 
@@ -222,8 +201,14 @@ void MPHIndex::swap(std::vector<uint32_t>& params, dynamic_2bitset& g, std::vect
   std::swap(params[5], hash_seed_[0]);
   std::swap(params[6], hash_seed_[1]);
   std::swap(params[7], hash_seed_[2]);
+  std::swap(params[8], version_);
   g.swap(g_);
   ranktable.swap(ranktable_);
+  // r_ is not serialized, n_ is 3*r_
+  r_ = n_ ? n_ / 3 : 1;
+  nest_displacement_[0] = 0;
+  nest_displacement_[1] = r_;
+  nest_displacement_[2] = (r_ << 1);
 }
 
 }  // namespace cxxmph
@@ -45,10 +45,12 @@ namespace cxxmph {
 class MPHIndex {
  public:
   MPHIndex(bool square = false, double c = 1.23, uint8_t b = 7) :
-      c_(c), b_(b), m_(0), n_(0), k_(0), square_(square), r_(1), g_(8, true) {
+      c_(c), b_(b), m_(0), n_(0), k_(0), square_(square),
+      version_(kFastrangeVersion), r_(1), g_(8, true) {
     nest_displacement_[0] = 0;
     nest_displacement_[1] = r_;
     nest_displacement_[2] = (r_ << 1);
+    for (uint32_t i = 0; i < sizeof(threebit_mod3); ++i) threebit_mod3[i] = i % 3;
   }
   ~MPHIndex();
 
@@ -73,9 +75,15 @@ class MPHIndex {
 
   // Experimental api to use as a serialization building block.
   // Since this signature exposes some implementation details, expect it to
-  // change.
+  // change. params[8] holds the format version, 0 in the params of the
+  // releases that reduced the hash values with a modulo (or a mask for
+  // square), which are still searched that way.
   void swap(std::vector<uint32_t>& params, dynamic_2bitset& g, std::vector<uint32_t>& ranktable);
 
+  // Format version of the functions whose hash values are reduced with
+  // fastrange32.
+  static const uint32_t kFastrangeVersion = 1;
+
  private:
   template <class SeededHashFcn, class ForwardIterator>
   bool Mapping(ForwardIterator begin, ForwardIterator end,
@@ -86,6 +94,10 @@ class MPHIndex {
                  const std::vector<uint32_t>& queue);
   void Ranking();
   uint32_t Rank(uint32_t vertex) const;
+  // Reduces a hash value to [0, r_) as the format version requires.
+  uint32_t Reduce(uint32_t h) const {
+    return version_ >= kFastrangeVersion ? fastrange32(h, r_) : h % r_;
+  }
 
   // Algorithm parameters
   // Perfect hash function density. If this was a 2graph,
@@ -99,7 +111,8 @@ class MPHIndex {
   uint32_t m_;  // edges count
   uint32_t n_;  // vertex count
   uint32_t k_;  // kth index in ranktable, $k = log_2(n=3r)\varepsilon$
-  bool square_;  // make bit vector size a power of 2
+  bool square_;  // make bit vector size a power of 2 in version 0
+  uint32_t version_;  // format version, see kFastrangeVersion
 
   // Values used during search
 
@@ -128,13 +141,12 @@ bool MPHIndex::Reset(
   m_ = size;
   r_ = static_cast<uint32_t>(ceil((c_*m_)/3));
   if ((r_ % 2) == 0) r_ += 1;
-  // This can be used to speed mods, but increases occupation too much. 
-  // Needs to try http://gmplib.org/manual/Integer-Exponentiation.html instead
-  if (square_) r_ = nextpoweroftwo(r_);
+  // Version 0 rounded r_ up to a power of two for square, to reduce the
+  // hash values with a mask. fastrange32 is as fast for any r_.
+  version_ = kFastrangeVersion;
   nest_displacement_[0] = 0;
   nest_displacement_[1] = r_;
   nest_displacement_[2] = (r_ << 1);
-  for (uint32_t i = 0; i < sizeof(threebit_mod3); ++i) threebit_mod3[i] = i % 3;
 
   n_ = 3*r_;
   k_ = 1U << b_;
@@ -166,9 +178,9 @@ bool MPHIndex::Mapping(
   for (ForwardIterator it = begin; it != end; ++it) {
     h128 h = SeededHashFcn().hash128(*it, hash_seed_[0]);
     // for (int i = 0; i < 3; ++i) h[i] = SeededHashFcn()(*it, hash_seed_[i]);
-    uint32_t v0 = h[0] % r_;
-    uint32_t v1 = h[1] % r_ + r_;
-    uint32_t v2 = h[2] % r_ + (r_ << 1);
+    uint32_t v0 = Reduce(h[0]);
+    uint32_t v1 = Reduce(h[1]) + r_;
+    uint32_t v2 = Reduce(h[2]) + (r_ << 1);
     // cerr << "Key: " << *it << " edge " <<  it - begin << " (" << v0 << "," << v1 << "," << v2 << ")" << endl;
     graph.AddEdge(TriGraph::Edge(v0, v1, v2));
   }
@@ -182,9 +194,9 @@ bool MPHIndex::Mapping(
 template <class SeededHashFcn, class Key>
 uint32_t MPHIndex::perfect_square(const Key& key) const {
   h128 h = SeededHashFcn().hash128(key, hash_seed_[0]);
-  h[0] = (h[0] & (r_-1)) + nest_displacement_[0];
-  h[1] = (h[1] & (r_-1)) + nest_displacement_[1];
-  h[2] = (h[2] & (r_-1)) + nest_displacement_[2];
+  h[0] = Reduce(h[0]) + nest_displacement_[0];
+  h[1] = Reduce(h[1]) + nest_displacement_[1];
+  h[2] = Reduce(h[2]) + nest_displacement_[2];
   assert((h[0]) < g_.size());
   assert((h[1]) < g_.size());
   assert((h[2]) < g_.size());
@@ -197,9 +209,9 @@ template <class SeededHashFcn, class Key>
 uint32_t MPHIndex::perfect_hash(const Key& key) const {
   if (!g_.size()) return 0;
   h128 h = SeededHashFcn().hash128(key, hash_seed_[0]);
-  h[0] = (h[0] % r_) + nest_displacement_[0];
-  h[1] = (h[1] % r_) + nest_displacement_[1];
-  h[2] = (h[2] % r_) + nest_displacement_[2];
+  h[0] = Reduce(h[0]) + nest_displacement_[0];
+  h[1] = Reduce(h[1]) + nest_displacement_[1];
+  h[2] = Reduce(h[2]) + nest_displacement_[2];
   assert((h[0]) < g_.size());
   assert((h[1]) < g_.size());
   assert((h[2]) < g_.size());
@@ -44,6 +44,17 @@ int main(int argc, char** argv) {
   assert(mph_index.size() == ids.size());
   for (vector<int>::size_type i = 0; i < ids.size(); ++i) assert(ids[i] == static_cast<vector<int>::value_type>(i));
 
+  // The params carry the format version, and a function swapped into
+  // another index gives the same values.
+  vector<uint32_t> values;
+  for (vector<string>::size_type i = 0; i < keys.size(); ++i) values.push_back(mph_index.index(keys[i]));
+  mph_index.swap(params, g, ranktable);
+  assert(params[8] == MPHIndex::kFastrangeVersion);
+  SimpleMPHIndex<string> loaded;
+  loaded.swap(params, g, ranktable);
+  assert(loaded.size() == keys.size());
+  for (vector<string>::size_type i = 0; i < keys.size(); ++i) assert(loaded.index(keys[i]) == values[i]);
+
   FlexibleMPHIndex<false, true, int64_t, seeded_hash<std::hash<int64_t>>::hash_function> square_empty;
   auto id = square_empty.index(1);
   FlexibleMPHIndex<false, false, int64_t, seeded_hash<std::hash<int64_t>>::hash_function> unordered_empty;
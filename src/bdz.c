@@ -3,6 +3,9 @@
 #include "bdz_structs.h"
 #include "hash.h"
 #include "bitbool.h"
+#include "prefetch.h"
+#include "fastrange.h"
+#include "thread_pool.h"
 
 #include <math.h>
 #include <stdlib.h>
@@ -16,26 +19,6 @@
 
 //cmph_uint32 ngrafos = 0;
 //cmph_uint32 ngrafos_aciclicos = 0;
-// table used for looking up the number of assigned vertices  a 8-bit integer
-const cmph_uint8 bdz_lookup_table[] =
-{
-4, 4, 4, 3, 4, 4, 4, 3, 4, 4, 4, 3, 3, 3, 3, 2,
-4, 4, 4, 3, 4, 4, 4, 3, 4, 4, 4, 3, 3, 3, 3, 2,
-4, 4, 4, 3, 4, 4, 4, 3, 4, 4, 4, 3, 3, 3, 3, 2,
-3, 3, 3, 2, 3, 3, 3, 2, 3, 3, 3, 2, 2, 2, 2, 1,
-4, 4, 4, 3, 4, 4, 4, 3, 4, 4, 4, 3, 3, 3, 3, 2,
-4, 4, 4, 3, 4, 4, 4, 3, 4, 4, 4, 3, 3, 3, 3, 2,
-4, 4, 4, 3, 4, 4, 4, 3, 4, 4, 4, 3, 3, 3, 3, 2,
-3, 3, 3, 2, 3, 3, 3, 2, 3, 3, 3, 2, 2, 2, 2, 1,
-4, 4, 4, 3, 4, 4, 4, 3, 4, 4, 4, 3, 3, 3, 3, 2,
-4, 4, 4, 3, 4, 4, 4, 3, 4, 4, 4, 3, 3, 3, 3, 2,
-4, 4, 4, 3, 4, 4, 4, 3, 4, 4, 4, 3, 3, 3, 3, 2,
-3, 3, 3, 2, 3, 3, 3, 2, 3, 3, 3, 2, 2, 2, 2, 1,
-3, 3, 3, 2, 3, 3, 3, 2, 3, 3, 3, 2, 2, 2, 2, 1,
-3, 3, 3, 2, 3, 3, 3, 2, 3, 3, 3, 2, 2, 2, 2, 1,
-3, 3, 3, 2, 3, 3, 3, 2, 3, 3, 3, 2, 2, 2, 2, 1,
-2, 2, 2, 1, 2, 2, 2, 1, 2, 2, 2, 1, 1, 1, 1, 0
-};
 
 typedef struct
 {
@@ -218,10 +201,16 @@ static int bdz_generate_queue(cmph_uint32 nedges, cmph_uint32 nvertices, bdz_que
 	return (int)(queue_head-nedges);/* returns 0 if successful otherwies return negative number*/
 };
 
+// Results of bdz_mapping. Only a cyclic graph is worth another hash function.
+#define BDZ_MAPPING_CYCLIC 0
+#define BDZ_MAPPING_OK 1
+#define BDZ_MAPPING_NO_MEMORY 2
+
 static int bdz_mapping(cmph_config_t *mph, bdz_graph3_t* graph3, bdz_queue_t queue);
+static int bdz_mapping_parallel(cmph_config_t *mph, bdz_graph3_t* graph3, bdz_queue_t queue);
 static void assigning(bdz_config_data_t *bdz, bdz_graph3_t* graph3, bdz_queue_t queue);
-static void ranking(bdz_config_data_t *bdz);
-static cmph_uint32 rank(cmph_uint32 b, cmph_uint32 * ranktable, cmph_uint8 * g, cmph_uint32 vertex);
+static cmph_uint64 *ranking(const cmph_uint8 *g, cmph_uint32 n, cmph_uint32 nthreads, void **lines_mem);
+static cmph_uint32 rank(const cmph_uint64 * lines, cmph_uint32 vertex, int popcnt);
 
 bdz_config_data_t *bdz_config_new(void)
 {
@@ -235,7 +224,8 @@ bdz_config_data_t *bdz_config_new(void)
 	bdz->k = 0; //kth index in ranktable, $k = log_2(n=3r)/\varepsilon$
 	bdz->b = 7; // number of bits of k
 	bdz->ranktablesize = 0; //number of entries in ranktable, $n/k +1$
-	bdz->ranktable = NULL; // rank table
+	bdz->lines = NULL; // g interleaved with its rank counters
+	bdz->fingerprints = NULL;
 	return bdz;
 }
 
@@ -314,15 +304,29 @@ cmph_t *bdz_new(cmph_config_t *mph, double c)
 	{
 		fprintf(stderr, "Entering mapping step for mph creation of %u keys with graph sized %u\n", bdz->m, bdz->n);
 	}
+	// retries then derive the edges from the fingerprints, without reading the keys
+	__config_phase(mph, CMPH_PHASE_HASHING);
+	if (bdz->hashfunc == CMPH_HASH_FINGERPRINT) bdz->fingerprints = __config_fingerprints(mph);
 	while(1)
 	{
-		int ok;
+		int status;
 		DEBUGP("linear hash function \n");
-		bdz->hl = hash_state_new(bdz->hashfunc, 15);
+		mph->stats.iterations++;
+		bdz->hl = __config_hash_state(mph, bdz->hashfunc, 15);
 
-		ok = bdz_mapping(mph, &graph3, edges);
-                //ok = 0;
-		if (!ok)
+		status = bdz_mapping(mph, &graph3, edges);
+		if (status == BDZ_MAPPING_NO_MEMORY)
+		{
+			hash_state_destroy(bdz->hl);
+			bdz->hl = NULL;
+			if (mph->verbosity)
+			{
+				fprintf(stderr, "Not enough memory to map the keys\n");
+			}
+			iterations = 0;
+			break;
+		}
+		if (status != BDZ_MAPPING_OK)
 		{
 			--iterations;
 			hash_state_destroy(bdz->hl);
@@ -336,6 +340,8 @@ cmph_t *bdz_new(cmph_config_t *mph, double c)
 		}
 		else break;
 	}
+	free(bdz->fingerprints);
+	bdz->fingerprints = NULL;
 
 	if (iterations == 0)
 	{
@@ -349,6 +355,7 @@ cmph_t *bdz_new(cmph_config_t *mph, double c)
 	{
 		fprintf(stderr, "Entering assigning step for mph creation of %u keys with graph sized %u\n", bdz->m, bdz->n);
 	}
+	__config_phase(mph, CMPH_PHASE_ASSIGNING);
 	assigning(bdz, &graph3, edges);
 
 	bdz_free_queue(&edges);
@@ -357,19 +364,23 @@ cmph_t *bdz_new(cmph_config_t *mph, double c)
 	{
 		fprintf(stderr, "Entering ranking step for mph creation of %u keys with graph sized %u\n", bdz->m, bdz->n);
 	}
-	ranking(bdz);
+	__config_phase(mph, CMPH_PHASE_RANKING);
+	bdz->lines = ranking(bdz->g, bdz->n, mph->nthreads, &bdz->lines_mem);
+	free(bdz->g); // g now lives in the lines
+	bdz->g = NULL;
 	#ifdef CMPH_TIMING
 	ELAPSED_TIME_IN_SECONDS(&construction_time);
 	#endif
 	mphf = (cmph_t *)malloc(sizeof(cmph_t));
 	mphf->algo = mph->algo;
+	mphf->version = CMPH_VERSION_FASTRANGE;
 	bdzf = (bdz_data_t *)malloc(sizeof(bdz_data_t));
-	bdzf->g = bdz->g;
-	bdz->g = NULL; //transfer memory ownership
+	bdzf->lines = bdz->lines;
+	bdzf->lines_mem = bdz->lines_mem;
+	bdz->lines = NULL; //transfer memory ownership
+	bdz->lines_mem = NULL;
 	bdzf->hl = bdz->hl;
 	bdz->hl = NULL; //transfer memory ownership
-	bdzf->ranktable = bdz->ranktable;
-	bdz->ranktable = NULL; //transfer memory ownership
 	bdzf->ranktablesize = bdz->ranktablesize;
 	bdzf->k = bdz->k;
 	bdzf->b = bdz->b;
@@ -403,24 +414,279 @@ static int bdz_mapping(cmph_config_t *mph, bdz_graph3_t* graph3, bdz_queue_t que
 	int cycles = 0;
 	cmph_uint32 hl[3];
 	bdz_config_data_t *bdz = (bdz_config_data_t *)mph->data;
+	__config_phase(mph, CMPH_PHASE_HASHING);
+	if (mph->nthreads > 1) return bdz_mapping_parallel(mph, graph3, queue);
 	bdz_init_graph3(graph3, bdz->m, bdz->n);
-	mph->key_source->rewind(mph->key_source->data);
+	if (bdz->fingerprints == NULL) mph->key_source->rewind(mph->key_source->data);
 	for (e = 0; e < mph->key_source->nkeys; ++e)
 	{
 		cmph_uint32 h0, h1, h2;
 		cmph_uint32 keylen;
 		char *key = NULL;
-		mph->key_source->read(mph->key_source->data, &key, &keylen);
-		hash_vector(bdz->hl, key, keylen,hl);
-		h0 = hl[0] % bdz->r;
-		h1 = hl[1] % bdz->r + bdz->r;
-		h2 = hl[2] % bdz->r + (bdz->r << 1);
-                DEBUGP("Key: %.*s (%u %u %u)\n", keylen, key, h0, h1, h2);
-		mph->key_source->dispose(mph->key_source->data, key, keylen);
+		if (bdz->fingerprints) hash_vector_fingerprint(bdz->hl, bdz->fingerprints + 2*e, hl);
+		else
+		{
+			mph->key_source->read(mph->key_source->data, &key, &keylen);
+			hash_vector(bdz->hl, key, keylen,hl);
+			__key_dispose(mph->key_source, key, keylen);
+		}
+		h0 = fastrange32(hl[0], bdz->r);
+		h1 = fastrange32(hl[1], bdz->r) + bdz->r;
+		h2 = fastrange32(hl[2], bdz->r) + (bdz->r << 1);
+                DEBUGP("Edge %u: (%u %u %u)\n", e, h0, h1, h2);
 		bdz_add_edge(graph3,h0,h1,h2);
 	}
+	__config_phase(mph, CMPH_PHASE_SEARCHING);
 	cycles = bdz_generate_queue(bdz->m, bdz->n, queue, graph3);
-	return (cycles == 0);
+	return cycles == 0 ? BDZ_MAPPING_OK : BDZ_MAPPING_CYCLIC;
+}
+
+// Parallel mapping. Fingerprinted keys are hashed by the thread pool
+// BDZ_KEYS_PER_TASK per task. Keys of adapters split into chunks are read and hashed
+// by the thread pool a chunk per task, others are still read serially,
+// BDZ_KEYS_BLOCK at a time, but hashed by the thread pool. The edges are then linked into the vertex
+// lists: tasks owning contiguous edge ranges sort the incidences of their
+// edges by vertex partition, in two passes that count and then scatter them,
+// and a task per partition links its incidences. Each vertex sees its edges
+// in increasing order, which yields exactly the lists bdz_add_edge builds, so
+// peeling and therefore the resulting function match the serial path.
+#define BDZ_KEYS_BLOCK 65536U
+#define BDZ_KEYS_PER_TASK 4096U
+#define BDZ_KEYS_PER_BATCH 256U
+
+typedef struct
+{
+	bdz_config_data_t *bdz;
+	bdz_graph3_t *graph3;
+	cmph_io_adapter_t *key_source;
+	char **keys;
+	cmph_uint32 *keylens;
+	cmph_uint32 first; // edge of keys[0]
+	cmph_uint32 nkeys;
+	cmph_uint32 ntasks;
+	cmph_uint32 nslotparts;	// partitions of the vertices of each of the 3 slots
+	cmph_uint64 *starts;	// ntasks x 3*nslotparts, counts and then scatter positions
+	cmph_uint64 *part_first;	// first incidence of each partition, 3*nslotparts + 1
+	cmph_uint32 *incidences;	// edges sorted by the partition of one of their vertices
+} bdz_mapping_job_t;
+
+static void bdz_hash_task(void *arg, cmph_uint32 task)
+{
+	bdz_mapping_job_t *job = (bdz_mapping_job_t *)arg;
+	cmph_uint32 r = job->bdz->r;
+	cmph_uint32 i = task * BDZ_KEYS_PER_TASK;
+	cmph_uint32 end = i + BDZ_KEYS_PER_TASK < job->nkeys ? i + BDZ_KEYS_PER_TASK : job->nkeys;
+	cmph_uint32 hl[3];
+	for (; i < end; ++i)
+	{
+		bdz_edge_t *edge = job->graph3->edges + job->first + i;
+		hash_vector(job->bdz->hl, job->keys[i], job->keylens[i], hl);
+		edge->vertices[0] = fastrange32(hl[0], r);
+		edge->vertices[1] = fastrange32(hl[1], r) + r;
+		edge->vertices[2] = fastrange32(hl[2], r) + (r << 1);
+	}
+}
+
+static void bdz_hash_fingerprint_task(void *arg, cmph_uint32 task)
+{
+	bdz_mapping_job_t *job = (bdz_mapping_job_t *)arg;
+	cmph_uint32 r = job->bdz->r;
+	cmph_uint32 i = task * BDZ_KEYS_PER_TASK;
+	cmph_uint32 end = i + BDZ_KEYS_PER_TASK < job->nkeys ? i + BDZ_KEYS_PER_TASK : job->nkeys;
+	cmph_uint32 hl[3];
+	for (; i < end; ++i)
+	{
+		bdz_edge_t *edge = job->graph3->edges + i;
+		hash_vector_fingerprint(job->bdz->hl, job->bdz->fingerprints + 2*i, hl);
+		edge->vertices[0] = fastrange32(hl[0], r);
+		edge->vertices[1] = fastrange32(hl[1], r) + r;
+		edge->vertices[2] = fastrange32(hl[2], r) + (r << 1);
+	}
+}
+
+static void bdz_hash_chunk_task(void *arg, cmph_uint32 chunk)
+{
+	bdz_mapping_job_t *job = (bdz_mapping_job_t *)arg;
+	cmph_io_adapter_t *key_source = job->key_source;
+	cmph_uint32 r = job->bdz->r;
+	bdz_edge_t *edge = job->graph3->edges + key_source->chunk_first[chunk];
+	char *keys[BDZ_KEYS_PER_BATCH];
+	cmph_uint32 keylens[BDZ_KEYS_PER_BATCH];
+	cmph_uint32 hl[3];
+	cmph_uint32 i, n;
+	while ((n = key_source->read_batch(key_source->data, chunk, keys, keylens, BDZ_KEYS_PER_BATCH)) > 0)
+	{
+		for (i = 0; i < n; ++i, ++edge)
+		{
+			hash_vector(job->bdz->hl, keys[i], keylens[i], hl);
+			edge->vertices[0] = fastrange32(hl[0], r);
+			edge->vertices[1] = fastrange32(hl[1], r) + r;
+			edge->vertices[2] = fastrange32(hl[2], r) + (r << 1);
+			__key_dispose(key_source, keys[i], keylens[i]);
+		}
+	}
+}
+
+// Partition of vertex v, the j-th vertex of its edge.
+static inline cmph_uint32 bdz_link_part(bdz_mapping_job_t *job, cmph_uint32 v, cmph_uint32 j)
+{
+	cmph_uint32 r = job->bdz->r;
+	return j*job->nslotparts + (cmph_uint32)(((cmph_uint64)(v - j*r)*job->nslotparts)/r);
+}
+
+static void bdz_count_task(void *arg, cmph_uint32 task)
+{
+	bdz_mapping_job_t *job = (bdz_mapping_job_t *)arg;
+	bdz_edge_t *edges = job->graph3->edges;
+	cmph_uint64 *counts = job->starts + (cmph_uint64)task*3*job->nslotparts;
+	cmph_uint32 e = (cmph_uint32)(((cmph_uint64)job->nkeys * task) / job->ntasks);
+	cmph_uint32 end = (cmph_uint32)(((cmph_uint64)job->nkeys * (task + 1)) / job->ntasks);
+	cmph_uint32 j;
+	for (; e < end; ++e)
+	{
+		for (j = 0; j < 3; ++j) counts[bdz_link_part(job, edges[e].vertices[j], j)]++;
+	}
+}
+
+static void bdz_scatter_task(void *arg, cmph_uint32 task)
+{
+	bdz_mapping_job_t *job = (bdz_mapping_job_t *)arg;
+	bdz_edge_t *edges = job->graph3->edges;
+	cmph_uint64 *starts = job->starts + (cmph_uint64)task*3*job->nslotparts;
+	cmph_uint32 e = (cmph_uint32)(((cmph_uint64)job->nkeys * task) / job->ntasks);
+	cmph_uint32 end = (cmph_uint32)(((cmph_uint64)job->nkeys * (task + 1)) / job->ntasks);
+	cmph_uint32 j;
+	for (; e < end; ++e)
+	{
+		for (j = 0; j < 3; ++j) job->incidences[starts[bdz_link_part(job, edges[e].vertices[j], j)]++] = e;
+	}
+}
+
+static void bdz_link_task(void *arg, cmph_uint32 part)
+{
+	bdz_mapping_job_t *job = (bdz_mapping_job_t *)arg;
+	bdz_graph3_t *graph3 = job->graph3;
+	cmph_uint32 j = part / job->nslotparts;
+	cmph_uint64 i;
+	cmph_uint32 e, v;
+	for (i = job->part_first[part]; i < job->part_first[part + 1]; ++i)
+	{
+		e = job->incidences[i];
+		v = graph3->edges[e].vertices[j];
+		graph3->edges[e].next_edges[j] = graph3->first_edge[v];
+		graph3->first_edge[v] = e;
+		graph3->vert_degree[v]++;
+	}
+}
+
+// Links the edges into the vertex lists with the thread pool. Returns 0 when
+// out of memory.
+static int bdz_link_parallel(cmph_config_t *mph, bdz_mapping_job_t *job)
+{
+	cmph_uint32 nparts, task, p;
+	cmph_uint64 pos = 0;
+
+	job->ntasks = mph->nthreads;
+	job->nslotparts = mph->nthreads;
+	nparts = 3*job->nslotparts;
+	job->starts = (cmph_uint64 *)calloc((size_t)job->ntasks*nparts, sizeof(cmph_uint64));
+	job->part_first = (cmph_uint64 *)malloc(sizeof(cmph_uint64)*(nparts + 1));
+	job->incidences = (cmph_uint32 *)malloc(sizeof(cmph_uint32)*3*(size_t)job->nkeys);
+	if (job->starts == NULL || job->part_first == NULL || job->incidences == NULL)
+	{
+		free(job->starts);
+		free(job->part_first);
+		free(job->incidences);
+		return 0;
+	}
+	thread_pool_run(mph->nthreads, job->ntasks, bdz_count_task, job);
+	// the incidences of a partition are ordered by task, then by edge
+	for (p = 0; p < nparts; ++p)
+	{
+		job->part_first[p] = pos;
+		for (task = 0; task < job->ntasks; ++task)
+		{
+			cmph_uint64 count = job->starts[(cmph_uint64)task*nparts + p];
+			job->starts[(cmph_uint64)task*nparts + p] = pos;
+			pos += count;
+		}
+	}
+	job->part_first[nparts] = pos;
+	thread_pool_run(mph->nthreads, job->ntasks, bdz_scatter_task, job);
+	thread_pool_run(mph->nthreads, nparts, bdz_link_task, job);
+	free(job->starts);
+	free(job->part_first);
+	free(job->incidences);
+	return 1;
+}
+
+// Reads the keys serially, BDZ_KEYS_BLOCK at a time, and hashes each block
+// on the thread pool. Returns 0 when out of memory.
+static int bdz_hash_blocks(cmph_config_t *mph, bdz_mapping_job_t *job)
+{
+	cmph_uint32 e, i;
+	cmph_uint32 nkeys = mph->key_source->nkeys;
+	cmph_uint32 block = nkeys < BDZ_KEYS_BLOCK ? nkeys : BDZ_KEYS_BLOCK;
+
+	job->keys = (char **)malloc(sizeof(char *)*block);
+	job->keylens = (cmph_uint32 *)malloc(sizeof(cmph_uint32)*block);
+	if (job->keys == NULL || job->keylens == NULL)
+	{
+		free(job->keys);
+		free(job->keylens);
+		return 0;
+	}
+	for (e = 0; e < nkeys; e += job->nkeys)
+	{
+		job->first = e;
+		job->nkeys = nkeys - e < block ? nkeys - e : block;
+		for (i = 0; i < job->nkeys; ++i)
+		{
+			mph->key_source->read(mph->key_source->data, job->keys + i, job->keylens + i);
+		}
+		thread_pool_run(mph->nthreads, (job->nkeys + BDZ_KEYS_PER_TASK - 1)/BDZ_KEYS_PER_TASK, bdz_hash_task, job);
+		for (i = 0; i < job->nkeys; ++i)
+		{
+			__key_dispose(mph->key_source, job->keys[i], job->keylens[i]);
+		}
+	}
+	free(job->keys);
+	free(job->keylens);
+	return 1;
+}
+
+static int bdz_mapping_parallel(cmph_config_t *mph, bdz_graph3_t* graph3, bdz_queue_t queue)
+{
+	bdz_mapping_job_t job;
+	bdz_config_data_t *bdz = (bdz_config_data_t *)mph->data;
+	cmph_uint32 nkeys = mph->key_source->nkeys;
+
+	bdz_init_graph3(graph3, bdz->m, bdz->n);
+	job.bdz = bdz;
+	job.graph3 = graph3;
+	job.key_source = mph->key_source;
+	if (bdz->fingerprints)
+	{
+		job.nkeys = nkeys;
+		thread_pool_run(mph->nthreads, (nkeys + BDZ_KEYS_PER_TASK - 1)/BDZ_KEYS_PER_TASK, bdz_hash_fingerprint_task, &job);
+	}
+	else
+	{
+		mph->key_source->rewind(mph->key_source->data);
+		if (mph->key_source->read_batch != NULL)
+		{
+			thread_pool_run(mph->nthreads, mph->key_source->nchunks, bdz_hash_chunk_task, &job);
+		}
+		else if (!bdz_hash_blocks(mph, &job)) return BDZ_MAPPING_NO_MEMORY;
+	}
+
+	__config_phase(mph, CMPH_PHASE_MAPPING);
+	job.nkeys = nkeys;
+	if (!bdz_link_parallel(mph, &job)) return BDZ_MAPPING_NO_MEMORY;
+	graph3->nedges = nkeys;
+
+	__config_phase(mph, CMPH_PHASE_SEARCHING);
+	return bdz_generate_queue(bdz->m, bdz->n, queue, graph3) == 0 ? BDZ_MAPPING_OK : BDZ_MAPPING_CYCLIC;
 }
 
 static void assigning(bdz_config_data_t *bdz, bdz_graph3_t* graph3, bdz_queue_t queue)
@@ -472,28 +738,99 @@ static void assigning(bdz_config_data_t *bdz, bdz_graph3_t* graph3, bdz_queue_t
 }
 
 
-static void ranking(bdz_config_data_t *bdz)
+#define BDZ_LINES_PER_TASK 16384U
+#define BDZ_LINE_BYTES (BDZ_LINE_VERTICES >> 2)
+
+// one bit set in each 2-bit value of word that is UNASSIGNED
+#define UNASSIGNED_VALUES(word) ((word) & ((word) >> 1) & 0x5555555555555555ULL)
+
+static inline cmph_uint32 bdz_nlines(cmph_uint32 n)
 {
-	cmph_uint32 i, j, offset = 0U, count = 0U, size = (bdz->k >> 2U), nbytes_total = (cmph_uint32)ceil(bdz->n/4.0), nbytes;
-	bdz->ranktable = (cmph_uint32 *)calloc((size_t)bdz->ranktablesize, sizeof(cmph_uint32));
-	// ranktable computation
-	bdz->ranktable[0] = 0;	
-	i = 1;
-	while(1)
+	return (n + BDZ_LINE_VERTICES - 1) / BDZ_LINE_VERTICES;
+}
+
+static inline cmph_uint8 bdz_get_value(const cmph_uint64 * lines, cmph_uint32 vertex)
+{
+	register const cmph_uint64 *line = lines + (vertex / BDZ_LINE_VERTICES) * BDZ_LINE_WORDS;
+	register cmph_uint32 offset = vertex % BDZ_LINE_VERTICES;
+	return (cmph_uint8)((line[1 + (offset >> 5)] >> ((offset & 31U) << 1)) & 3U);
+}
+
+typedef struct
+{
+	const cmph_uint8 *g;
+	cmph_uint32 sizeg;
+	cmph_uint32 nlines;
+	cmph_uint64 *lines;
+} bdz_ranking_job_t;
+
+// Fills lines with g and the in-line counters, and leaves in the low half of
+// each header the number of assigned vertices of its own line only: ranking()
+// turns them into prefix sums afterwards.
+static void ranking_task(void *arg, cmph_uint32 task)
+{
+	bdz_ranking_job_t *job = (bdz_ranking_job_t *)arg;
+	cmph_uint32 l = task * BDZ_LINES_PER_TASK;
+	cmph_uint32 end = l + BDZ_LINES_PER_TASK < job->nlines ? l + BDZ_LINES_PER_TASK : job->nlines;
+	cmph_uint32 w, j, idx, count;
+	for (; l < end; l++)
 	{
-		if(i == bdz->ranktablesize) break;
-		nbytes = size < nbytes_total? size : nbytes_total;
-		for(j = 0; j < nbytes; j++)
+		cmph_uint64 *line = job->lines + (size_t)l * BDZ_LINE_WORDS;
+		cmph_uint64 header = 0, word;
+		count = 0;
+		for (w = 0; w < BDZ_LINE_WORDS - 1; w++)
 		{
-			count += bdz_lookup_table[*(bdz->g + offset + j)];
+			if ((w & 1U) == 0) header |= (cmph_uint64)count << (32 + (w << 2));
+			word = 0;
+			for (j = 0; j < 8; j++)
+			{
+				idx = l * BDZ_LINE_BYTES + (w << 3) + j;
+				// vertices past the end are left UNASSIGNED
+				word |= (cmph_uint64)(idx < job->sizeg ? job->g[idx] : 0xff) << (j << 3);
+			}
+			line[1 + w] = word;
+			count += 32 - popcount64(UNASSIGNED_VALUES(word));
 		}
-		bdz->ranktable[i] = count;
-		offset += nbytes;
-		nbytes_total -= size;
-		i++;
+		line[0] = header | count;
 	}
 }
 
+static cmph_uint64 *ranking(const cmph_uint8 *g, cmph_uint32 n, cmph_uint32 nthreads, void **lines_mem)
+{
+	bdz_ranking_job_t job;
+	cmph_uint32 i, count, base = 0;
+	job.g = g;
+	job.sizeg = (cmph_uint32)ceil(n/4.0);
+	job.nlines = bdz_nlines(n);
+	// lines are aligned so that none of them straddles two cache lines
+	*lines_mem = malloc((size_t)job.nlines * BDZ_LINE_WORDS * sizeof(cmph_uint64) + 63);
+	if (!*lines_mem) return NULL;
+	job.lines = (cmph_uint64 *)(((size_t)*lines_mem + 63) & ~(size_t)63);
+	thread_pool_run(nthreads, (job.nlines + BDZ_LINES_PER_TASK - 1)/BDZ_LINES_PER_TASK, ranking_task, &job);
+	for(i = 0; i < job.nlines; i++)
+	{
+		cmph_uint64 *header = job.lines + (size_t)i * BDZ_LINE_WORDS;
+		count = (cmph_uint32)*header;
+		*header = (*header & 0xffffffff00000000ULL) | base;
+		base += count;
+	}
+	return job.lines;
+}
+
+// Extracts g, as dumped, from the lines.
+static cmph_uint8 *bdz_lines_to_g(const cmph_uint64 * lines, cmph_uint32 n)
+{
+	cmph_uint32 i, sizeg = (cmph_uint32)ceil(n/4.0);
+	cmph_uint8 *g = (cmph_uint8 *)malloc((size_t)sizeg);
+	for (i = 0; i < sizeg; i++)
+	{
+		const cmph_uint64 *line = lines + (size_t)(i / BDZ_LINE_BYTES) * BDZ_LINE_WORDS;
+		cmph_uint32 offset = i % BDZ_LINE_BYTES;
+		g[i] = (cmph_uint8)(line[1 + (offset >> 3)] >> ((offset & 7U) << 3));
+	}
+	return g;
+}
+
 
 int bdz_dump(cmph_t *mphf, FILE *fd)
 {
@@ -513,27 +850,36 @@ int bdz_dump(cmph_t *mphf, FILE *fd)
 	nbytes = fwrite(&(data->m), sizeof(cmph_uint32), (size_t)1, fd);
 	nbytes = fwrite(&(data->r), sizeof(cmph_uint32), (size_t)1, fd);
 
-	cmph_uint32 sizeg = (cmph_uint32)ceil(data->n/4.0);
-	nbytes = fwrite(data->g, sizeof(cmph_uint8)*sizeg, (size_t)1, fd);
+	cmph_uint32 i, sizeg = (cmph_uint32)ceil(data->n/4.0);
+	cmph_uint8 *g = bdz_lines_to_g(data->lines, data->n);
+	nbytes = fwrite(g, sizeof(cmph_uint8)*sizeg, (size_t)1, fd);
+	free(g);
 
 	nbytes = fwrite(&(data->k), sizeof(cmph_uint32), (size_t)1, fd);
 	nbytes = fwrite(&(data->b), sizeof(cmph_uint8), (size_t)1, fd);
 	nbytes = fwrite(&(data->ranktablesize), sizeof(cmph_uint32), (size_t)1, fd);
 
-	nbytes = fwrite(data->ranktable, sizeof(cmph_uint32)*(data->ranktablesize), (size_t)1, fd);
+	// the ranktable of the dump format, rebuilt from the line counters
+	cmph_uint32 *ranktable = (cmph_uint32 *)malloc(sizeof(cmph_uint32)*(data->ranktablesize));
+	for (i = 0; i < data->ranktablesize; ++i) ranktable[i] = rank(data->lines, i << data->b, 0);
+	nbytes = fwrite(ranktable, sizeof(cmph_uint32)*(data->ranktablesize), (size_t)1, fd);
+	free(ranktable);
 	#ifdef DEBUG
-	cmph_uint32 i;
 	fprintf(stderr, "G: ");
-	for (i = 0; i < data->n; ++i) fprintf(stderr, "%u ", GETVALUE(data->g, i));
+	for (i = 0; i < data->n; ++i) fprintf(stderr, "%u ", bdz_get_value(data->lines, i));
 	fprintf(stderr, "\n");
 	#endif
 	return 1;
 }
 
+#define BDZ_SKIP_WORDS 256U // ranktable words dropped per fread in bdz_load
+
 void bdz_load(FILE *f, cmph_t *mphf)
 {
 	char *buf = NULL;
-	cmph_uint32 buflen, sizeg;
+	cmph_uint8 *g = NULL;
+	cmph_uint32 buflen, sizeg, left;
+	cmph_uint32 skip[BDZ_SKIP_WORDS];
 	register size_t nbytes;
 	bdz_data_t *bdz = (bdz_data_t *)malloc(sizeof(bdz_data_t));
 
@@ -553,75 +899,176 @@ void bdz_load(FILE *f, cmph_t *mphf)
 	nbytes = fread(&(bdz->m), sizeof(cmph_uint32), (size_t)1, f);
 	nbytes = fread(&(bdz->r), sizeof(cmph_uint32), (size_t)1, f);
 	sizeg = (cmph_uint32)ceil(bdz->n/4.0);
-	bdz->g = (cmph_uint8 *)calloc((size_t)(sizeg), sizeof(cmph_uint8));
-	nbytes = fread(bdz->g, sizeg*sizeof(cmph_uint8), (size_t)1, f);
+	g = (cmph_uint8 *)calloc((size_t)(sizeg), sizeof(cmph_uint8));
+	nbytes = fread(g, sizeg*sizeof(cmph_uint8), (size_t)1, f);
 
 	nbytes = fread(&(bdz->k), sizeof(cmph_uint32), (size_t)1, f);
 	nbytes = fread(&(bdz->b), sizeof(cmph_uint8), (size_t)1, f);
 	nbytes = fread(&(bdz->ranktablesize), sizeof(cmph_uint32), (size_t)1, f);
 
-	bdz->ranktable = (cmph_uint32 *)calloc((size_t)bdz->ranktablesize, sizeof(cmph_uint32));
-	nbytes = fread(bdz->ranktable, sizeof(cmph_uint32)*(bdz->ranktablesize), (size_t)1, f);
+	// the ranktable is recomputed into the lines along with g. It is read
+	// and dropped rather than skipped with fseek, which fails on pipes.
+	left = bdz->ranktablesize;
+	while (left > 0)
+	{
+		cmph_uint32 chunk = left < BDZ_SKIP_WORDS ? left : BDZ_SKIP_WORDS;
+		if (fread(skip, sizeof(cmph_uint32), (size_t)chunk, f) != chunk) break;
+		left -= chunk;
+	}
+	bdz->lines = ranking(g, bdz->n, 1, &bdz->lines_mem);
+	free(g);
 
 	#ifdef DEBUG
 	cmph_uint32  i = 0;
 	fprintf(stderr, "G: ");
-	for (i = 0; i < bdz->n; ++i) fprintf(stderr, "%u ", GETVALUE(bdz->g,i));
+	for (i = 0; i < bdz->n; ++i) fprintf(stderr, "%u ", bdz_get_value(bdz->lines, i));
 	fprintf(stderr, "\n");
 	#endif
 	return;
 }
 
 
-static inline cmph_uint32 rank(cmph_uint32 b, cmph_uint32 * ranktable, cmph_uint8 * g, cmph_uint32 vertex)
+// Number of assigned vertices before vertex: the line header gives it up
+// to an even word of the line, at most two popcounts finish the count.
+// popcnt is set by the callers compiled for the popcnt instruction.
+CMPH_POPCNT_INLINE cmph_uint32 rank(const cmph_uint64 * lines, cmph_uint32 vertex, int popcnt)
 {
-	register cmph_uint32 index = vertex >> b;
-	register cmph_uint32 base_rank = ranktable[index];
-	register cmph_uint32 beg_idx_v = index << b;
-	register cmph_uint32 beg_idx_b = beg_idx_v >> 2;
-	register cmph_uint32 end_idx_b = vertex >> 2;
-	while(beg_idx_b < end_idx_b)
-	{
-		base_rank += bdz_lookup_table[*(g + beg_idx_b++)];
+	register const cmph_uint64 *line = lines + (vertex / BDZ_LINE_VERTICES) * BDZ_LINE_WORDS;
+	register cmph_uint32 offset = vertex % BDZ_LINE_VERTICES;
+	register cmph_uint32 w = offset >> 5; // word of the line holding vertex
+	register cmph_uint32 pos = offset & 31U; // values before vertex in that word
+	register cmph_uint64 header = line[0];
+	register cmph_uint32 base_rank = (cmph_uint32)header + (cmph_uint32)((header >> (32 + ((w >> 1) << 3))) & 0xff);
+	// an odd word also counts the whole word before it, line[w] (masked out for even words)
+	register cmph_uint64 odd = (cmph_uint64)0 - (w & 1U);
+	base_rank += ((w & 1U) << 5) - popcount64_hw(UNASSIGNED_VALUES(line[w]) & odd, popcnt);
+	base_rank += pos - popcount64_hw(UNASSIGNED_VALUES(line[1 + w]) & ((((cmph_uint64)1) << (pos << 1)) - 1), popcnt);
+	DEBUGP("base rank %u\n", base_rank);
+	return base_rank;
+}
 
-	}
-        DEBUGP("base rank %u\n", base_rank);
-	beg_idx_v = beg_idx_b << 2;
-        DEBUGP("beg_idx_v %u\n", beg_idx_v);
-	while(beg_idx_v < vertex)
-	{
-		if(GETVALUE(g, beg_idx_v) != UNASSIGNED) base_rank++;
-		beg_idx_v++;
-	}
+// Gives the value of a key from its hash values.
+CMPH_POPCNT_INLINE cmph_uint32 bdz_search_hashed_with(cmph_uint32 r, cmph_uint32 fastrange, const cmph_uint64 * lines, cmph_uint32 * hl, int popcnt)
+{
+	register cmph_uint32 vertex;
+	hl[0] = RANGE(hl[0], r, fastrange);
+	hl[1] = RANGE(hl[1], r, fastrange) + r;
+	hl[2] = RANGE(hl[2], r, fastrange) + (r << 1);
+	vertex = hl[(bdz_get_value(lines, hl[0]) + bdz_get_value(lines, hl[1]) + bdz_get_value(lines, hl[2])) % 3];
+        DEBUGP("Search found vertex %u\n", vertex);
+	return rank(lines, vertex, popcnt);
+}
 
-	return base_rank;
+#ifdef CMPH_POPCNT_DISPATCH
+__attribute__((target("popcnt")))
+static cmph_uint32 bdz_search_hashed_popcnt(cmph_uint32 r, cmph_uint32 fastrange, const cmph_uint64 * lines, cmph_uint32 * hl)
+{
+	return bdz_search_hashed_with(r, fastrange, lines, hl, 1);
+}
+#endif
+
+static inline cmph_uint32 bdz_search_hashed(cmph_uint32 r, cmph_uint32 fastrange, const cmph_uint64 * lines, cmph_uint32 * hl)
+{
+#ifdef CMPH_POPCNT_DISPATCH
+	if (__builtin_cpu_supports("popcnt")) return bdz_search_hashed_popcnt(r, fastrange, lines, hl);
+#endif
+	return bdz_search_hashed_with(r, fastrange, lines, hl, 0);
 }
 
 cmph_uint32 bdz_search(cmph_t *mphf, const char *key, cmph_uint32 keylen)
 {
-	register cmph_uint32 vertex;
 	register bdz_data_t *bdz = (bdz_data_t *)mphf->data;
 	cmph_uint32 hl[3];
 	hash_vector(bdz->hl, key, keylen, hl);
-	hl[0] = hl[0] % bdz->r;
-	hl[1] = hl[1] % bdz->r + bdz->r;
-	hl[2] = hl[2] % bdz->r + (bdz->r << 1);
-	vertex = hl[(GETVALUE(bdz->g, hl[0]) + GETVALUE(bdz->g, hl[1]) + GETVALUE(bdz->g, hl[2])) % 3];
-        DEBUGP("Search found vertex %u\n", vertex);
-	return rank(bdz->b, bdz->ranktable, bdz->g, vertex);
+	return bdz_search_hashed(bdz->r, mphf->version, bdz->lines, hl);
+}
+
+cmph_uint32 bdz_search_integer(cmph_t *mphf, cmph_uint64 key, cmph_uint32 keylen)
+{
+	register bdz_data_t *bdz = (bdz_data_t *)mphf->data;
+	cmph_uint32 hl[3];
+	hash_vector_integer(bdz->hl, key, keylen, hl);
+	return bdz_search_hashed(bdz->r, mphf->version, bdz->lines, hl);
+}
+
+// Resolves a group of already hashed keys in two passes so that the misses
+// on the lines of every key in the group overlap instead of being taken one
+// after the other. The rank of a key reads one of the lines it was mapped to.
+CMPH_POPCNT_INLINE void bdz_search_group_with(cmph_uint32 r, cmph_uint32 fastrange, const cmph_uint64 * lines,
+                                              cmph_uint32 hl[][3], cmph_uint32 count, cmph_uint32 *out, int popcnt)
+{
+	register cmph_uint32 i, vertex;
+	for(i = 0; i < count; i++)
+	{
+		hl[i][0] = RANGE(hl[i][0], r, fastrange);
+		hl[i][1] = RANGE(hl[i][1], r, fastrange) + r;
+		hl[i][2] = RANGE(hl[i][2], r, fastrange) + (r << 1);
+		PREFETCH(lines + (hl[i][0] / BDZ_LINE_VERTICES) * BDZ_LINE_WORDS);
+		PREFETCH(lines + (hl[i][1] / BDZ_LINE_VERTICES) * BDZ_LINE_WORDS);
+		PREFETCH(lines + (hl[i][2] / BDZ_LINE_VERTICES) * BDZ_LINE_WORDS);
+	}
+	for(i = 0; i < count; i++)
+	{
+		vertex = hl[i][(bdz_get_value(lines, hl[i][0]) + bdz_get_value(lines, hl[i][1]) + bdz_get_value(lines, hl[i][2])) % 3];
+		out[i] = rank(lines, vertex, popcnt);
+	}
+}
+
+#ifdef CMPH_POPCNT_DISPATCH
+__attribute__((target("popcnt")))
+static void bdz_search_group_popcnt(cmph_uint32 r, cmph_uint32 fastrange, const cmph_uint64 * lines,
+                                    cmph_uint32 hl[][3], cmph_uint32 count, cmph_uint32 *out)
+{
+	bdz_search_group_with(r, fastrange, lines, hl, count, out, 1);
+}
+#endif
+
+static inline void bdz_search_group(cmph_uint32 r, cmph_uint32 fastrange, const cmph_uint64 * lines,
+                                    cmph_uint32 hl[][3], cmph_uint32 count, cmph_uint32 *out)
+{
+#ifdef CMPH_POPCNT_DISPATCH
+	if (__builtin_cpu_supports("popcnt"))
+	{
+		bdz_search_group_popcnt(r, fastrange, lines, hl, count, out);
+		return;
+	}
+#endif
+	bdz_search_group_with(r, fastrange, lines, hl, count, out, 0);
+}
+
+void bdz_search_batch(cmph_t *mphf, const char **keys, const cmph_uint32 *keylens, cmph_uint32 n, cmph_uint32 *out)
+{
+	register bdz_data_t *bdz = (bdz_data_t *)mphf->data;
+	cmph_uint32 hl[CMPH_SEARCH_BATCH_SIZE][3];
+	cmph_uint32 i, count;
+	for(i = 0; i < n; i += count)
+	{
+		count = n - i < CMPH_SEARCH_BATCH_SIZE ? n - i : CMPH_SEARCH_BATCH_SIZE;
+		hash_vector_batch(bdz->hl, keys + i, keylens + i, count, hl);
+		bdz_search_group(bdz->r, mphf->version, bdz->lines, hl, count, out + i);
+	}
 }
 
 
 void bdz_destroy(cmph_t *mphf)
 {
 	bdz_data_t *data = (bdz_data_t *)mphf->data;
-	free(data->g);
+	free(data->lines_mem);
 	hash_state_destroy(data->hl);
-	free(data->ranktable);
 	free(data);
 	free(mphf);
 }
 
+// Offset of the lines from packed_mphf. packed_mphf follows the 4-byte
+// algorithm id written by cmph_pack, the lines are padded to start 64 bytes
+// into the packed function so that they are cache line aligned whenever the
+// packed function is, as in cmph_mmap_load.
+static inline cmph_uint32 bdz_packed_lines_offset(CMPH_HASH hl_type)
+{
+	cmph_uint32 offset = (cmph_uint32)(sizeof(CMPH_ALGO) + 2*sizeof(cmph_uint32)) + hash_state_packed_size(hl_type);
+	return ((offset + 63U) & ~63U) - (cmph_uint32)sizeof(CMPH_ALGO);
+}
+
 /** \fn void bdz_pack(cmph_t *mphf, void *packed_mphf);
  *  \brief Support the ability to pack a perfect hash function into a preallocated contiguous memory space pointed by packed_mphf.
  *  \param mphf pointer to the resulting mphf
@@ -634,7 +1081,7 @@ void bdz_pack(cmph_t *mphf, void *packed_mphf)
 
 	// packing hl type
 	CMPH_HASH hl_type = hash_get_type(data->hl);
-	*((cmph_uint32 *) ptr) = hl_type;
+	*((cmph_uint32 *) ptr) = hl_type | CMPH_PACKED_BDZ_LINES | (mphf->version ? CMPH_PACKED_FASTRANGE : 0);
 	ptr += sizeof(cmph_uint32);
 
 	// packing hl
@@ -645,20 +1092,10 @@ void bdz_pack(cmph_t *mphf, void *packed_mphf)
 	*((cmph_uint32 *) ptr) = data->r;
 	ptr += sizeof(data->r);
 
-	// packing ranktablesize
-	*((cmph_uint32 *) ptr) = data->ranktablesize;
-	ptr += sizeof(data->ranktablesize);
-
-	// packing ranktable
-	memcpy(ptr, data->ranktable, sizeof(cmph_uint32)*(data->ranktablesize));
-	ptr += sizeof(cmph_uint32)*(data->ranktablesize);
-
-	// packing b
-	*ptr++ = data->b;
-
-	// packing g
-	cmph_uint32 sizeg = (cmph_uint32)ceil(data->n/4.0);
-	memcpy(ptr, data->g,  sizeof(cmph_uint8)*sizeg);
+	// packing the lines after the padding
+	cmph_uint8 *lines = (cmph_uint8 *)packed_mphf + bdz_packed_lines_offset(hl_type);
+	memset(ptr, 0, (size_t)(lines - ptr));
+	memcpy(lines, data->lines, sizeof(cmph_uint64)*BDZ_LINE_WORDS*bdz_nlines(data->n));
 }
 
 /** \fn cmph_uint32 bdz_packed_size(cmph_t *mphf);
@@ -672,7 +1109,41 @@ cmph_uint32 bdz_packed_size(cmph_t *mphf)
 
 	CMPH_HASH hl_type = hash_get_type(data->hl);
 
-	return (cmph_uint32)(sizeof(CMPH_ALGO) + hash_state_packed_size(hl_type) + 3*sizeof(cmph_uint32) + sizeof(cmph_uint32)*(data->ranktablesize) + sizeof(cmph_uint8) + sizeof(cmph_uint8)* (cmph_uint32)(ceil(data->n/4.0)));
+	return (cmph_uint32)(sizeof(CMPH_ALGO) + bdz_packed_lines_offset(hl_type) + sizeof(cmph_uint64)*BDZ_LINE_WORDS*bdz_nlines(data->n));
+}
+
+// Gives the value of a key from its hash values in a function packed
+// without CMPH_PACKED_BDZ_LINES: the hash function, r, the size of the rank
+// table, the rank table, the shift b of its blocks and the values of g.
+// Those functions reduce with the modulo operator.
+static cmph_uint32 bdz_search_packed_legacy(void *packed_mphf, cmph_uint32 * hl)
+{
+	register CMPH_HASH hl_type = (CMPH_HASH)(*(cmph_uint32 *)packed_mphf);
+	register cmph_uint32 *ranktable = (cmph_uint32 *)((cmph_uint8 *)packed_mphf + 4 + hash_state_packed_size(hl_type));
+	register cmph_uint32 r = *ranktable++;
+	register cmph_uint32 ranktablesize = *ranktable++;
+	register cmph_uint8 *g = (cmph_uint8 *)(ranktable + ranktablesize);
+	register cmph_uint8 b = *g++;
+	register cmph_uint32 vertex, index, base_rank, beg_idx_b, end_idx_b, beg_idx_v;
+
+	hl[0] = hl[0] % r;
+	hl[1] = hl[1] % r + r;
+	hl[2] = hl[2] % r + (r << 1);
+	vertex = hl[(GETVALUE(g, hl[0]) + GETVALUE(g, hl[1]) + GETVALUE(g, hl[2])) % 3];
+
+	index = vertex >> b;
+	base_rank = ranktable[index];
+	beg_idx_b = (index << b) >> 2;
+	end_idx_b = vertex >> 2;
+	for(; beg_idx_b < end_idx_b; beg_idx_b++)
+	{
+		base_rank += 4 - popcount64(UNASSIGNED_VALUES((cmph_uint64)g[beg_idx_b]));
+	}
+	for(beg_idx_v = beg_idx_b << 2; beg_idx_v < vertex; beg_idx_v++)
+	{
+		if(GETVALUE(g, beg_idx_v) != UNASSIGNED) base_rank++;
+	}
+	return base_rank;
 }
 
 /** cmph_uint32 bdz_search(void *packed_mphf, const char *key, cmph_uint32 keylen);
@@ -685,22 +1156,54 @@ cmph_uint32 bdz_packed_size(cmph_t *mphf)
 cmph_uint32 bdz_search_packed(void *packed_mphf, const char *key, cmph_uint32 keylen)
 {
 
-	register cmph_uint32 vertex;
-	register CMPH_HASH hl_type  = (CMPH_HASH)(*(cmph_uint32 *)packed_mphf);
+	register cmph_uint32 fastrange = *(cmph_uint32 *)packed_mphf & CMPH_PACKED_FASTRANGE;
+	register CMPH_HASH hl_type  = (CMPH_HASH)(*(cmph_uint32 *)packed_mphf & ~(CMPH_PACKED_FASTRANGE | CMPH_PACKED_BDZ_LINES));
 	register cmph_uint8 *hl_ptr = (cmph_uint8 *)(packed_mphf) + 4;
 
-	register cmph_uint32 *ranktable = (cmph_uint32*)(hl_ptr + hash_state_packed_size(hl_type));
-
-	register cmph_uint32 r = *ranktable++;
-	register cmph_uint32 ranktablesize = *ranktable++;
-	register cmph_uint8 * g = (cmph_uint8 *)(ranktable + ranktablesize);
-	register cmph_uint8 b = *g++;
+	register cmph_uint32 r = *(cmph_uint32 *)(hl_ptr + hash_state_packed_size(hl_type));
+	register const cmph_uint64 *lines = (const cmph_uint64 *)((cmph_uint8 *)packed_mphf + bdz_packed_lines_offset(hl_type));
 
 	cmph_uint32 hl[3];
 	hash_vector_packed(hl_ptr, hl_type, key, keylen, hl);
-	hl[0] = hl[0] % r;
-	hl[1] = hl[1] % r + r;
-	hl[2] = hl[2] % r + (r << 1);
-	vertex = hl[(GETVALUE(g, hl[0]) + GETVALUE(g, hl[1]) + GETVALUE(g, hl[2])) % 3];
-	return rank(b, ranktable, g, vertex);
+	if (!(*(cmph_uint32 *)packed_mphf & CMPH_PACKED_BDZ_LINES)) return bdz_search_packed_legacy(packed_mphf, hl);
+	return bdz_search_hashed(r, fastrange, lines, hl);
+}
+
+cmph_uint32 bdz_search_packed_integer(void *packed_mphf, cmph_uint64 key, cmph_uint32 keylen)
+{
+	register cmph_uint32 fastrange = *(cmph_uint32 *)packed_mphf & CMPH_PACKED_FASTRANGE;
+	register CMPH_HASH hl_type  = (CMPH_HASH)(*(cmph_uint32 *)packed_mphf & ~(CMPH_PACKED_FASTRANGE | CMPH_PACKED_BDZ_LINES));
+	register cmph_uint8 *hl_ptr = (cmph_uint8 *)(packed_mphf) + 4;
+
+	register cmph_uint32 r = *(cmph_uint32 *)(hl_ptr + hash_state_packed_size(hl_type));
+	register const cmph_uint64 *lines = (const cmph_uint64 *)((cmph_uint8 *)packed_mphf + bdz_packed_lines_offset(hl_type));
+
+	cmph_uint32 hl[3];
+	hash_vector_packed_integer(hl_ptr, hl_type, key, keylen, hl);
+	if (!(*(cmph_uint32 *)packed_mphf & CMPH_PACKED_BDZ_LINES)) return bdz_search_packed_legacy(packed_mphf, hl);
+	return bdz_search_hashed(r, fastrange, lines, hl);
+}
+
+void bdz_search_packed_batch(void *packed_mphf, const char **keys, const cmph_uint32 *keylens, cmph_uint32 n, cmph_uint32 *out)
+{
+	register cmph_uint32 fastrange = *(cmph_uint32 *)packed_mphf & CMPH_PACKED_FASTRANGE;
+	register CMPH_HASH hl_type  = (CMPH_HASH)(*(cmph_uint32 *)packed_mphf & ~(CMPH_PACKED_FASTRANGE | CMPH_PACKED_BDZ_LINES));
+	register cmph_uint8 *hl_ptr = (cmph_uint8 *)(packed_mphf) + 4;
+
+	register cmph_uint32 r = *(cmph_uint32 *)(hl_ptr + hash_state_packed_size(hl_type));
+	register const cmph_uint64 *lines = (const cmph_uint64 *)((cmph_uint8 *)packed_mphf + bdz_packed_lines_offset(hl_type));
+
+	cmph_uint32 hl[CMPH_SEARCH_BATCH_SIZE][3];
+	cmph_uint32 i, j, count;
+	for(i = 0; i < n; i += count)
+	{
+		count = n - i < CMPH_SEARCH_BATCH_SIZE ? n - i : CMPH_SEARCH_BATCH_SIZE;
+		hash_vector_packed_batch(hl_ptr, hl_type, keys + i, keylens + i, count, hl);
+		if (!(*(cmph_uint32 *)packed_mphf & CMPH_PACKED_BDZ_LINES))
+		{
+			for(j = 0; j < count; j++) out[i + j] = bdz_search_packed_legacy(packed_mphf, hl[j]);
+			continue;
+		}
+		bdz_search_group(r, fastrange, lines, hl, count, out + i);
+	}
 }
@@ -16,6 +16,16 @@ void bdz_load(FILE *f, cmph_t *mphf);
 int bdz_dump(cmph_t *mphf, FILE *f);
 void bdz_destroy(cmph_t *mphf);
 cmph_uint32 bdz_search(cmph_t *mphf, const char *key, cmph_uint32 keylen);
+void bdz_search_batch(cmph_t *mphf, const char **keys, const cmph_uint32 *keylens, cmph_uint32 n, cmph_uint32 *out);
+
+/** \fn cmph_uint32 bdz_search_integer(cmph_t *mphf, cmph_uint64 key, cmph_uint32 keylen);
+ *  \brief Same as bdz_search for a key that is an integer of keylen bytes, 4 or 8.
+ *  \param mphf pointer to the resulting mphf
+ *  \param key the integer
+ *  \param keylen size of the integer in bytes
+ *  \return The mphf value
+ */
+cmph_uint32 bdz_search_integer(cmph_t *mphf, cmph_uint64 key, cmph_uint32 keylen);
 
 /** \fn void bdz_pack(cmph_t *mphf, void *packed_mphf);
  *  \brief Support the ability to pack a perfect hash function into a preallocated contiguous memory space pointed by packed_mphf.
@@ -40,4 +50,23 @@ cmph_uint32 bdz_packed_size(cmph_t *mphf);
  */
 cmph_uint32 bdz_search_packed(void *packed_mphf, const char *key, cmph_uint32 keylen);
 
+/** \fn void bdz_search_packed_batch(void *packed_mphf, const char **keys, const cmph_uint32 *keylens, cmph_uint32 n, cmph_uint32 *out);
+ *  \brief Batched version of @see bdz_search_packed.
+ *  \param packed_mphf pointer to the packed mphf
+ *  \param keys array of n keys to be hashed
+ *  \param keylens array with the length in bytes of each key
+ *  \param n number of keys
+ *  \param out array of n entries that receives the mphf values
+ */
+void bdz_search_packed_batch(void *packed_mphf, const char **keys, const cmph_uint32 *keylens, cmph_uint32 n, cmph_uint32 *out);
+
+/** \fn cmph_uint32 bdz_search_packed_integer(void *packed_mphf, cmph_uint64 key, cmph_uint32 keylen);
+ *  \brief Same as bdz_search_packed for a key that is an integer of keylen bytes, 4 or 8.
+ *  \param packed_mphf pointer to the packed mphf
+ *  \param key the integer
+ *  \param keylen size of the integer in bytes
+ *  \return The mphf value
+ */
+cmph_uint32 bdz_search_packed_integer(void *packed_mphf, cmph_uint64 key, cmph_uint32 keylen);
+
 #endif
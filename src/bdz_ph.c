@@ -3,6 +3,8 @@
 #include "bdz_structs_ph.h"
 #include "hash.h"
 #include "bitbool.h"
+#include "fastrange.h"
+#include "prefetch.h"
 
 #include <math.h>
 #include <stdlib.h>
@@ -211,6 +213,7 @@ bdz_ph_config_data_t *bdz_ph_config_new(void)
 	bdz_ph->hashfunc = CMPH_HASH_JENKINS;
 	bdz_ph->g = NULL;
 	bdz_ph->hl = NULL;
+	bdz_ph->fingerprints = NULL;
 	return bdz_ph;
 }
 
@@ -274,10 +277,14 @@ cmph_t *bdz_ph_new(cmph_config_t *mph, double c)
 	{
 		fprintf(stderr, "Entering mapping step for mph creation of %u keys with graph sized %u\n", bdz_ph->m, bdz_ph->n);
 	}
+	__config_phase(mph, CMPH_PHASE_HASHING);
+	if (bdz_ph->hashfunc == CMPH_HASH_FINGERPRINT) bdz_ph->fingerprints = __config_fingerprints(mph);
 	while(1)
 	{
 		int ok;
 		DEBUGP("linear hash function \n");
+		mph->stats.iterations++;
+		__config_phase(mph, CMPH_PHASE_HASHING);
 		bdz_ph->hl = hash_state_new(bdz_ph->hashfunc, 15);
 
 		ok = bdz_ph_mapping(mph, &graph3, edges);
@@ -295,6 +302,8 @@ cmph_t *bdz_ph_new(cmph_config_t *mph, double c)
 		}
 		else break;
 	}
+	free(bdz_ph->fingerprints);
+	bdz_ph->fingerprints = NULL;
 
 	if (iterations == 0)
 	{
@@ -309,6 +318,7 @@ cmph_t *bdz_ph_new(cmph_config_t *mph, double c)
 	{
 		fprintf(stderr, "Entering assigning step for mph creation of %u keys with graph sized %u\n", bdz_ph->m, bdz_ph->n);
 	}
+	__config_phase(mph, CMPH_PHASE_ASSIGNING);
 	assigning(bdz_ph, &graph3, edges);
 
 	bdz_ph_free_queue(&edges);
@@ -319,6 +329,7 @@ cmph_t *bdz_ph_new(cmph_config_t *mph, double c)
 		fprintf(stderr, "Starting optimization step\n");
 	}
 
+	__config_phase(mph, CMPH_PHASE_COMPRESSING);
 	bdz_ph_optimization(bdz_ph);
 
 	#ifdef CMPH_TIMING
@@ -326,6 +337,7 @@ cmph_t *bdz_ph_new(cmph_config_t *mph, double c)
 	#endif
 	mphf = (cmph_t *)malloc(sizeof(cmph_t));
 	mphf->algo = mph->algo;
+	mphf->version = CMPH_VERSION_FASTRANGE;
 	bdz_phf = (bdz_ph_data_t *)malloc(sizeof(bdz_ph_data_t));
 	bdz_phf->g = bdz_ph->g;
 	bdz_ph->g = NULL; //transfer memory ownership
@@ -362,20 +374,25 @@ static int bdz_ph_mapping(cmph_config_t *mph, bdz_ph_graph3_t* graph3, bdz_ph_qu
 
 	bdz_ph_config_data_t *bdz_ph = (bdz_ph_config_data_t *)mph->data;
 	bdz_ph_init_graph3(graph3, bdz_ph->m, bdz_ph->n);
-	mph->key_source->rewind(mph->key_source->data);
+	if (bdz_ph->fingerprints == NULL) mph->key_source->rewind(mph->key_source->data);
 	for (e = 0; e < mph->key_source->nkeys; ++e)
 	{
 		cmph_uint32 h0, h1, h2;
 		cmph_uint32 keylen;
 		char *key = NULL;
-		mph->key_source->read(mph->key_source->data, &key, &keylen);
-		hash_vector(bdz_ph->hl, key, keylen, hl);
-		h0 = hl[0] % bdz_ph->r;
-		h1 = hl[1] % bdz_ph->r + bdz_ph->r;
-		h2 = hl[2] % bdz_ph->r + (bdz_ph->r << 1);
-		mph->key_source->dispose(mph->key_source->data, key, keylen);
+		if (bdz_ph->fingerprints) hash_vector_fingerprint(bdz_ph->hl, bdz_ph->fingerprints + 2*e, hl);
+		else
+		{
+			mph->key_source->read(mph->key_source->data, &key, &keylen);
+			hash_vector(bdz_ph->hl, key, keylen, hl);
+			__key_dispose(mph->key_source, key, keylen);
+		}
+		h0 = fastrange32(hl[0], bdz_ph->r);
+		h1 = fastrange32(hl[1], bdz_ph->r) + bdz_ph->r;
+		h2 = fastrange32(hl[2], bdz_ph->r) + (bdz_ph->r << 1);
 		bdz_ph_add_edge(graph3,h0,h1,h2);
 	}
+	__config_phase(mph, CMPH_PHASE_SEARCHING);
 	cycles = bdz_ph_generate_queue(bdz_ph->m, bdz_ph->n, queue, graph3);
 	return (cycles == 0);
 }
@@ -518,9 +535,9 @@ cmph_uint32 bdz_ph_search(cmph_t *mphf, const char *key, cmph_uint32 keylen)
 	register cmph_uint32 vertex;
 
 	hash_vector(bdz_ph->hl, key, keylen,hl);
-	hl[0] = hl[0] % bdz_ph->r;
-	hl[1] = hl[1] % bdz_ph->r + bdz_ph->r;
-	hl[2] = hl[2] % bdz_ph->r + (bdz_ph->r << 1);
+	hl[0] = RANGE(hl[0], bdz_ph->r, mphf->version);
+	hl[1] = RANGE(hl[1], bdz_ph->r, mphf->version) + bdz_ph->r;
+	hl[2] = RANGE(hl[2], bdz_ph->r, mphf->version) + (bdz_ph->r << 1);
 
 	byte0 = bdz_ph->g[hl[0]/5];
 	byte1 = bdz_ph->g[hl[1]/5];
@@ -534,6 +551,44 @@ cmph_uint32 bdz_ph_search(cmph_t *mphf, const char *key, cmph_uint32 keylen)
 	return vertex;
 }
 
+// Maps a group of already hashed keys to their vertices, prefetching the
+// bytes of g of the whole group before any of them is read.
+static inline void bdz_ph_search_group(cmph_uint32 r, cmph_uint32 fastrange, const cmph_uint8 * g,
+                                       cmph_uint32 hl[][3], cmph_uint32 count, cmph_uint32 *out)
+{
+	register cmph_uint32 i;
+	register cmph_uint8 byte0, byte1, byte2;
+	for(i = 0; i < count; i++)
+	{
+		hl[i][0] = RANGE(hl[i][0], r, fastrange);
+		hl[i][1] = RANGE(hl[i][1], r, fastrange) + r;
+		hl[i][2] = RANGE(hl[i][2], r, fastrange) + (r << 1);
+		PREFETCH(g + hl[i][0]/5);
+		PREFETCH(g + hl[i][1]/5);
+		PREFETCH(g + hl[i][2]/5);
+	}
+	for(i = 0; i < count; i++)
+	{
+		byte0 = lookup_table[hl[i][0]%5U][g[hl[i][0]/5]];
+		byte1 = lookup_table[hl[i][1]%5U][g[hl[i][1]/5]];
+		byte2 = lookup_table[hl[i][2]%5U][g[hl[i][2]/5]];
+		out[i] = hl[i][(byte0 + byte1 + byte2)%3];
+	}
+}
+
+void bdz_ph_search_batch(cmph_t *mphf, const char **keys, const cmph_uint32 *keylens, cmph_uint32 n, cmph_uint32 *out)
+{
+	register bdz_ph_data_t *bdz_ph = (bdz_ph_data_t *)mphf->data;
+	cmph_uint32 hl[CMPH_SEARCH_BATCH_SIZE][3];
+	cmph_uint32 i, count;
+	for(i = 0; i < n; i += count)
+	{
+		count = n - i < CMPH_SEARCH_BATCH_SIZE ? n - i : CMPH_SEARCH_BATCH_SIZE;
+		hash_vector_batch(bdz_ph->hl, keys + i, keylens + i, count, hl);
+		bdz_ph_search_group(bdz_ph->r, mphf->version, bdz_ph->g, hl, count, out + i);
+	}
+}
+
 
 void bdz_ph_destroy(cmph_t *mphf)
 {
@@ -556,7 +611,7 @@ void bdz_ph_pack(cmph_t *mphf, void *packed_mphf)
 
 	// packing hl type
 	CMPH_HASH hl_type = hash_get_type(data->hl);
-	*((cmph_uint32 *) ptr) = hl_type;
+	*((cmph_uint32 *) ptr) = hl_type | (mphf->version ? CMPH_PACKED_FASTRANGE : 0);
 	ptr += sizeof(cmph_uint32);
 
 	// packing hl
@@ -595,7 +650,8 @@ cmph_uint32 bdz_ph_packed_size(cmph_t *mphf)
 cmph_uint32 bdz_ph_search_packed(void *packed_mphf, const char *key, cmph_uint32 keylen)
 {
 
-	register CMPH_HASH hl_type  = (CMPH_HASH)*(cmph_uint32 *)packed_mphf;
+	register cmph_uint32 fastrange = *(cmph_uint32 *)packed_mphf & CMPH_PACKED_FASTRANGE;
+	register CMPH_HASH hl_type  = (CMPH_HASH)(*(cmph_uint32 *)packed_mphf & ~CMPH_PACKED_FASTRANGE);
 	register cmph_uint8 *hl_ptr = (cmph_uint8 *)(packed_mphf) + 4;
 
 	register cmph_uint8 * ptr = hl_ptr + hash_state_packed_size(hl_type);
@@ -609,9 +665,9 @@ cmph_uint32 bdz_ph_search_packed(void *packed_mphf, const char *key, cmph_uint32
 
 	hash_vector_packed(hl_ptr, hl_type, key, keylen, hl);
 
-	hl[0] = hl[0] % r;
-	hl[1] = hl[1] % r + r;
-	hl[2] = hl[2] % r + (r << 1);
+	hl[0] = RANGE(hl[0], r, fastrange);
+	hl[1] = RANGE(hl[1], r, fastrange) + r;
+	hl[2] = RANGE(hl[2], r, fastrange) + (r << 1);
 
 	byte0 = g[hl[0]/5];
 	byte1 = g[hl[1]/5];
@@ -624,3 +680,24 @@ cmph_uint32 bdz_ph_search_packed(void *packed_mphf, const char *key, cmph_uint32
 
 	return vertex;
 }
+
+void bdz_ph_search_packed_batch(void *packed_mphf, const char **keys, const cmph_uint32 *keylens, cmph_uint32 n, cmph_uint32 *out)
+{
+	register cmph_uint32 fastrange = *(cmph_uint32 *)packed_mphf & CMPH_PACKED_FASTRANGE;
+	register CMPH_HASH hl_type  = (CMPH_HASH)(*(cmph_uint32 *)packed_mphf & ~CMPH_PACKED_FASTRANGE);
+	register cmph_uint8 *hl_ptr = (cmph_uint8 *)(packed_mphf) + 4;
+
+	register cmph_uint8 * ptr = hl_ptr + hash_state_packed_size(hl_type);
+
+	register cmph_uint32 r = *((cmph_uint32*) ptr);
+	register cmph_uint8 * g = ptr + 4;
+
+	cmph_uint32 hl[CMPH_SEARCH_BATCH_SIZE][3];
+	cmph_uint32 i, count;
+	for(i = 0; i < n; i += count)
+	{
+		count = n - i < CMPH_SEARCH_BATCH_SIZE ? n - i : CMPH_SEARCH_BATCH_SIZE;
+		hash_vector_packed_batch(hl_ptr, hl_type, keys + i, keylens + i, count, hl);
+		bdz_ph_search_group(r, fastrange, g, hl, count, out + i);
+	}
+}
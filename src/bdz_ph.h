@@ -15,6 +15,7 @@ void bdz_ph_load(FILE *f, cmph_t *mphf);
 int bdz_ph_dump(cmph_t *mphf, FILE *f);
 void bdz_ph_destroy(cmph_t *mphf);
 cmph_uint32 bdz_ph_search(cmph_t *mphf, const char *key, cmph_uint32 keylen);
+void bdz_ph_search_batch(cmph_t *mphf, const char **keys, const cmph_uint32 *keylens, cmph_uint32 n, cmph_uint32 *out);
 
 /** \fn void bdz_ph_pack(cmph_t *mphf, void *packed_mphf);
  *  \brief Support the ability to pack a perfect hash function into a preallocated contiguous memory space pointed by packed_mphf.
@@ -38,5 +39,6 @@ cmph_uint32 bdz_ph_packed_size(cmph_t *mphf);
  *  \return The mphf value
  */
 cmph_uint32 bdz_ph_search_packed(void *packed_mphf, const char *key, cmph_uint32 keylen);
+void bdz_ph_search_packed_batch(void *packed_mphf, const char **keys, const cmph_uint32 *keylens, cmph_uint32 n, cmph_uint32 *out);
 
 #endif
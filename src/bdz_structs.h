@@ -3,18 +3,29 @@
 
 #include "hash_state.h"
 
+/** In memory and once packed, g and its rank counters are interleaved in
+ *  64-byte lines of BDZ_LINE_WORDS words: a header word followed by seven
+ *  words of 32 2-bit values each. The header keeps the number of assigned
+ *  vertices in the lines before it in its low 32 bits and, in byte 4 + j,
+ *  the number of assigned vertices in the first 2j words of the line, so
+ *  that rank() touches a single cache line. The dump keeps g and the
+ *  ranktable of k-vertex blocks, k, b and ranktablesize only describe it.
+ */
+#define BDZ_LINE_WORDS 8U
+#define BDZ_LINE_VERTICES 224U
+
 struct __bdz_data_t
 {
 	cmph_uint32 m; //edges (words) count
 	cmph_uint32 n; //vertex count
 	cmph_uint32 r; //partition vertex count
-	cmph_uint8 *g;
+	cmph_uint64 *lines; // g interleaved with its rank counters, 64-byte aligned
+	void *lines_mem; // allocation backing lines
 	hash_state_t *hl; // linear hashing
 
 	cmph_uint32 k; //kth index in ranktable, $k = log_2(n=3r)/\varepsilon$
 	cmph_uint8 b; // number of bits of k
 	cmph_uint32 ranktablesize; //number of entries in ranktable, $n/k +1$
-	cmph_uint32 *ranktable; // rank table
 };
 
 
@@ -29,8 +40,10 @@ struct __bdz_config_data_t
 	cmph_uint32 k; //kth index in ranktable, $k = log_2(n=3r)/\varepsilon$
 	cmph_uint8 b; // number of bits of k
 	cmph_uint32 ranktablesize; //number of entries in ranktable, $n/k +1$
-	cmph_uint32 *ranktable; // rank table
+	cmph_uint64 *lines; // g interleaved with its rank counters
+	void *lines_mem; // allocation backing lines
 	CMPH_HASH hashfunc;
+	cmph_uint64 *fingerprints; // of the keys during construction with CMPH_HASH_FINGERPRINT
 };
 
 #endif
@@ -21,6 +21,7 @@ struct __bdz_ph_config_data_t
 	cmph_uint32 r; //partition vertex count
 	cmph_uint8 *g;
 	hash_state_t *hl; // linear hashing
+	cmph_uint64 *fingerprints; // of the keys during construction with CMPH_HASH_FINGERPRINT
 };
 
 #endif
@@ -70,6 +70,63 @@ static const cmph_uint8 valuemask[] = { 0xfc, 0xf3, 0xcf, 0x3f};
  */
 #define GETVALUE(array, i) ((cmph_uint8)((array[i >> 2] >> ((i & 0x00000003U) << 1U)) & 0x00000003U))
 
+/** \fn cmph_uint32 popcount64(cmph_uint64 x);
+ *  \brief count the bits set in a 64-bit word.
+ *  \param x is the word to count bits from
+ *  \return the number of bits set in x
+ *
+ * The popcnt instruction is used when the compiler targets it (e.g. -mpopcnt or
+ * -march=native on x86), a branch free bit count otherwise. See popcount64_hw
+ * for the x86 builds that do not target it.
+ */
+static inline cmph_uint32 popcount64(cmph_uint64 x)
+{
+#if defined(__GNUC__) && (defined(__POPCNT__) || defined(__aarch64__))
+	return (cmph_uint32)__builtin_popcountll(x);
+#else
+	x = x - ((x >> 1) & 0x5555555555555555ULL);
+	x = (x & 0x3333333333333333ULL) + ((x >> 2) & 0x3333333333333333ULL);
+	x = (x + (x >> 4)) & 0x0f0f0f0f0f0f0f0fULL;
+	return (cmph_uint32)((x * 0x0101010101010101ULL) >> 56);
+#endif
+}
+
+/** \def CMPH_POPCNT_DISPATCH
+ *  \brief Defined on x86 builds whose popcount64 does not use the popcnt
+ *  instruction. Hot paths are then also compiled with
+ *  __attribute__((target("popcnt"))) and the copy is chosen at run time with
+ *  __builtin_cpu_supports("popcnt").
+ */
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__)) && !defined(__POPCNT__)
+#define CMPH_POPCNT_DISPATCH
+#endif
+
+/** \def CMPH_POPCNT_INLINE
+ *  \brief Declares the functions shared by both copies of a hot path, they
+ *  must be inlined for the popcnt instruction to be used.
+ */
+#ifdef CMPH_POPCNT_DISPATCH
+#define CMPH_POPCNT_INLINE static inline __attribute__((always_inline))
+#else
+#define CMPH_POPCNT_INLINE static inline
+#endif
+
+/** \fn cmph_uint32 popcount64_hw(cmph_uint64 x, int popcnt);
+ *  \brief popcount64 that uses the popcnt instruction when popcnt is a non zero
+ *  constant, for functions compiled with __attribute__((target("popcnt"))).
+ *  \param x is the word to count bits from
+ *  \param popcnt whether the caller is compiled for the popcnt instruction
+ *  \return the number of bits set in x
+ */
+CMPH_POPCNT_INLINE cmph_uint32 popcount64_hw(cmph_uint64 x, int popcnt)
+{
+#ifdef CMPH_POPCNT_DISPATCH
+	if (popcnt) return (cmph_uint32)__builtin_popcountll(x);
+#endif
+	(void)popcnt;
+	return popcount64(x);
+}
+
 
 
 /** \def SETBIT32(array, i)
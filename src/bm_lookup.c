@@ -0,0 +1,397 @@
+// Lookup benchmark over every algorithm, key shape and size.
+//
+// For each key shape (4-byte integers, 16-byte ids, 50-200 byte urls), each
+// number of keys and each algorithm it reports the construction time, the
+// space of the packed function in bits per key, the ns per lookup of hot
+// (a few keys looked up over and over) and cold (random keys over the whole
+// set) lookups, both unpacked and packed, and the packed lookup throughput
+// with 1, 2, 4, ... threads. A share of the cold lookups can be made of keys
+// outside the set. Results are printed as CSV or JSON to track regressions.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "cmph.h"
+#include "cmph_time.h"
+#include "thread_pool.h"
+
+#define BM_HOT_KEYS 256
+#define BM_RUNS 3
+
+typedef enum { BM_INT, BM_ID, BM_URL, BM_SHAPE_COUNT } bm_shape_t;
+static const char *bm_shape_names[] = { "int", "id", "url", NULL };
+
+// Keys are stored as for cmph_io_byte_vector_adapter: a cmph_uint32 length
+// followed by the key bytes.
+typedef struct {
+  cmph_uint8 **keys;
+  cmph_uint8 *arena;
+  cmph_uint32 nkeys;
+} bm_keys_t;
+
+typedef struct {
+  void *packed_mphf;
+  cmph_uint8 **stream;
+  cmph_uint32 nlookups;
+  cmph_uint32 ntasks;
+  cmph_uint64 sums[64];  // one per task, apart to limit false sharing
+} bm_threads_job_t;
+
+static volatile cmph_uint64 g_sink = 0;
+
+// splitmix64 finalizer, a bijection: distinct indexes give distinct keys.
+static cmph_uint64 bm_mix64(cmph_uint64 x) {
+  x += 0x9e3779b97f4a7c15ULL;
+  x = (x ^ (x >> 30)) * 0xbf58476d1ce4e5b9ULL;
+  x = (x ^ (x >> 27)) * 0x94d049bb133111ebULL;
+  return x ^ (x >> 31);
+}
+
+// murmur3 fmix32, also a bijection.
+static cmph_uint32 bm_mix32(cmph_uint32 x) {
+  x ^= x >> 16; x *= 0x85ebca6bU;
+  x ^= x >> 13; x *= 0xc2b2ae35U;
+  return x ^ (x >> 16);
+}
+
+// Writes key number i of the given shape to buf, returns its length.
+static cmph_uint32 bm_make_key(bm_shape_t shape, cmph_uint32 i, char *buf) {
+  static const char alphabet[] = "abcdefghijklmnopqrstuvwxyz0123456789-_";
+  cmph_uint64 h = bm_mix64(i);
+  cmph_uint32 len, target, j;
+  switch (shape) {
+    case BM_INT: {
+      cmph_uint32 v = bm_mix32(i);
+      memcpy(buf, &v, sizeof(v));
+      return sizeof(v);
+    }
+    case BM_ID: {
+      cmph_uint64 lo = bm_mix64(h);
+      memcpy(buf, &h, sizeof(h));
+      memcpy(buf + sizeof(h), &lo, sizeof(lo));
+      return 2 * sizeof(h);
+    }
+    default: break;
+  }
+  // https://www.siteNNN.com/ + path + /%016llx, 50 to 200 bytes
+  target = 50 + (cmph_uint32)(h % 151);
+  len = (cmph_uint32)sprintf(buf, "https://www.site%u.com/", (cmph_uint32)(h >> 40) % 1000);
+  for (j = 0; len < target - 17; ++j, ++len) {
+    cmph_uint64 r = bm_mix64(h + j);
+    buf[len] = (j % 12 == 11) ? '/' : alphabet[r % (sizeof(alphabet) - 1)];
+  }
+  len += (cmph_uint32)sprintf(buf + len, "/%016llx", (unsigned long long)h);
+  return len;
+}
+
+// Keys number first to first + nkeys - 1.
+static void bm_keys_new(bm_keys_t *set, bm_shape_t shape, cmph_uint32 first, cmph_uint32 nkeys) {
+  char buf[256];
+  cmph_uint64 size = 0, capacity = (cmph_uint64)nkeys * 24 + 256;
+  cmph_uint64 *offsets = (cmph_uint64 *)malloc(sizeof(cmph_uint64) * nkeys);
+  cmph_uint32 i;
+  set->arena = (cmph_uint8 *)malloc((size_t)capacity);
+  for (i = 0; i < nkeys; ++i) {
+    cmph_uint32 len = bm_make_key(shape, first + i, buf);
+    if (size + sizeof(len) + len > capacity) {
+      capacity *= 2;
+      set->arena = (cmph_uint8 *)realloc(set->arena, (size_t)capacity);
+    }
+    offsets[i] = size;
+    memcpy(set->arena + size, &len, sizeof(len));
+    memcpy(set->arena + size + sizeof(len), buf, len);
+    size += sizeof(len) + len;
+  }
+  set->keys = (cmph_uint8 **)malloc(sizeof(cmph_uint8 *) * nkeys);
+  for (i = 0; i < nkeys; ++i) set->keys[i] = set->arena + offsets[i];
+  set->nkeys = nkeys;
+  free(offsets);
+}
+
+static void bm_keys_destroy(bm_keys_t *set) {
+  free(set->keys);
+  free(set->arena);
+}
+
+static double bm_now(void) {
+  double t = 0;
+  elapsed_time_in_seconds(&t);
+  return t;
+}
+
+static double bm_search_stream(cmph_t *mphf, cmph_uint8 **stream, cmph_uint32 nlookups) {
+  double best = 0;
+  cmph_uint32 run, i;
+  for (run = 0; run < BM_RUNS; ++run) {
+    cmph_uint64 sum = 0;
+    double t = bm_now();
+    for (i = 0; i < nlookups; ++i) {
+      cmph_uint32 keylen;
+      memcpy(&keylen, stream[i], sizeof(keylen));
+      sum += cmph_search(mphf, (const char *)stream[i] + sizeof(keylen), keylen);
+    }
+    t = bm_now() - t;
+    g_sink += sum;
+    if (run == 0 || t < best) best = t;
+  }
+  return best * 1e9 / nlookups;
+}
+
+static double bm_search_packed_stream(void *packed_mphf, cmph_uint8 **stream, cmph_uint32 nlookups) {
+  double best = 0;
+  cmph_uint32 run, i;
+  for (run = 0; run < BM_RUNS; ++run) {
+    cmph_uint64 sum = 0;
+    double t = bm_now();
+    for (i = 0; i < nlookups; ++i) {
+      cmph_uint32 keylen;
+      memcpy(&keylen, stream[i], sizeof(keylen));
+      sum += cmph_search_packed(packed_mphf, (const char *)stream[i] + sizeof(keylen), keylen);
+    }
+    t = bm_now() - t;
+    g_sink += sum;
+    if (run == 0 || t < best) best = t;
+  }
+  return best * 1e9 / nlookups;
+}
+
+static void bm_threads_task(void *arg, cmph_uint32 task) {
+  bm_threads_job_t *job = (bm_threads_job_t *)arg;
+  cmph_uint32 begin = (cmph_uint32)(((cmph_uint64)job->nlookups * task) / job->ntasks);
+  cmph_uint32 end = (cmph_uint32)(((cmph_uint64)job->nlookups * (task + 1)) / job->ntasks);
+  cmph_uint64 sum = 0;
+  cmph_uint32 i;
+  for (i = begin; i < end; ++i) {
+    cmph_uint32 keylen;
+    memcpy(&keylen, job->stream[i], sizeof(keylen));
+    sum += cmph_search_packed(job->packed_mphf, (const char *)job->stream[i] + sizeof(keylen), keylen);
+  }
+  job->sums[task] = sum;
+}
+
+// Millions of packed lookups per second with nthreads threads.
+static double bm_threads_stream(void *packed_mphf, cmph_uint8 **stream, cmph_uint32 nlookups, cmph_uint32 nthreads) {
+  bm_threads_job_t job;
+  double best = 0;
+  cmph_uint32 run, i;
+  job.packed_mphf = packed_mphf;
+  job.stream = stream;
+  job.nlookups = nlookups;
+  job.ntasks = nthreads;
+  for (run = 0; run < BM_RUNS; ++run) {
+    double t = bm_now();
+    thread_pool_run(nthreads, nthreads, bm_threads_task, &job);
+    t = bm_now() - t;
+    for (i = 0; i < nthreads; ++i) g_sink += job.sums[i];
+    if (run == 0 || t < best) best = t;
+  }
+  return nlookups / best / 1e6;
+}
+
+static cmph_t *bm_build(CMPH_ALGO algo, double c, bm_keys_t *set, const char *tmp_dir, double *build_s) {
+  cmph_io_adapter_t *source = cmph_io_byte_vector_adapter(set->keys, set->nkeys);
+  cmph_config_t *config = cmph_config_new(source);
+  FILE *mphf_fd = tmpfile();
+  cmph_t *mphf;
+  double t;
+
+  cmph_config_set_algo(config, algo);
+  if (c > 0) cmph_config_set_graphsize(config, c);
+  cmph_config_set_tmp_dir(config, (cmph_uint8 *)tmp_dir);
+  cmph_config_set_mphf_fd(config, mphf_fd);
+  t = bm_now();
+  mphf = cmph_new(config);
+  *build_s = bm_now() - t;
+  cmph_config_destroy(config);
+  cmph_io_byte_vector_adapter_destroy(source);
+  if (mphf) {
+    // BRZ writes the function to mphf_fd as it goes, load all of them back
+    cmph_dump(mphf, mphf_fd);
+    cmph_destroy(mphf);
+    rewind(mphf_fd);
+    mphf = cmph_load(mphf_fd);
+  }
+  fclose(mphf_fd);
+  return mphf;
+}
+
+static void usage(const char *prg) {
+  fprintf(stderr, "usage: %s [-h] [-a algo[,algo...]] [-k int|id|url[,...]] [-n nkeys[,nkeys...]] "
+          "[-l lookups] [-x miss_ratio] [-t max_threads] [-c value] [-f csv|json] [-d tmp_dir]\n", prg);
+}
+
+static void usage_long(const char *prg) {
+  usage(prg);
+  fprintf(stderr, "Lookup benchmark of the minimal perfect hash functions\n\n");
+  fprintf(stderr, "  -h\t print this help message\n");
+  fprintf(stderr, "  -a\t algorithms, all of them by default\n");
+  fprintf(stderr, "  -k\t key shapes, all of them by default\n");
+  fprintf(stderr, "    \t int: 4-byte integers\n");
+  fprintf(stderr, "    \t id: 16-byte binary ids\n");
+  fprintf(stderr, "    \t url: 50 to 200 byte urls\n");
+  fprintf(stderr, "  -n\t numbers of keys, 10000,1000000 by default (100000000 needs tens of GB for urls)\n");
+  fprintf(stderr, "  -l\t lookups per measure, 1000000 by default\n");
+  fprintf(stderr, "  -x\t share of cold lookups made of keys outside the set, 0 by default\n");
+  fprintf(stderr, "  -t\t up to how many threads the throughput is measured, 4 by default\n");
+  fprintf(stderr, "  -c\t value given to cmph_config_set_graphsize, 3 for fch and the default of the other algorithms by default\n");
+  fprintf(stderr, "  -f\t output format, csv by default\n");
+  fprintf(stderr, "  -d\t temporary directory used by brz algorithm\n");
+}
+
+// Sets selected[i] for every name of the comma separated list found in names.
+static int bm_parse_names(char *list, const char **names, cmph_uint32 count, cmph_uint32 *selected) {
+  char *name;
+  memset(selected, 0, sizeof(cmph_uint32) * count);
+  for (name = strtok(list, ","); name; name = strtok(NULL, ",")) {
+    cmph_uint32 i;
+    for (i = 0; i < count; ++i) if (strcmp(name, names[i]) == 0) break;
+    if (i == count) {
+      fprintf(stderr, "Unknown name %s\n", name);
+      return 0;
+    }
+    selected[i] = 1;
+  }
+  return 1;
+}
+
+int main(int argc, char **argv) {
+  cmph_uint32 algos[CMPH_COUNT], shapes[BM_SHAPE_COUNT];
+  cmph_uint32 sizes[16] = { 10000, 1000000 }, nsizes = 2;
+  cmph_uint32 nlookups = 1000000, max_threads = 4, json = 0, nrows = 0;
+  const char *tmp_dir = P_tmpdir "/";
+  double miss_ratio = 0;
+  // fch default c of 2.6 takes minutes to build a function over 10000 keys
+  double graphsize[CMPH_COUNT] = { 0 };
+  cmph_uint32 a, s, z, i, t;
+  int ch;
+
+  graphsize[CMPH_FCH] = 3;
+  for (i = 0; i < CMPH_COUNT; ++i) algos[i] = 1;
+  for (i = 0; i < BM_SHAPE_COUNT; ++i) shapes[i] = 1;
+  while ((ch = getopt(argc, argv, "ha:k:n:l:x:t:c:f:d:")) != -1) {
+    switch (ch) {
+      case 'a':
+        if (!bm_parse_names(optarg, cmph_names, CMPH_COUNT, algos)) return -1;
+        break;
+      case 'k':
+        if (!bm_parse_names(optarg, bm_shape_names, BM_SHAPE_COUNT, shapes)) return -1;
+        break;
+      case 'n': {
+        char *size;
+        nsizes = 0;
+        for (size = strtok(optarg, ","); size && nsizes < 16; size = strtok(NULL, ",")) {
+          sizes[nsizes++] = (cmph_uint32)strtoul(size, NULL, 10);
+        }
+        break;
+      }
+      case 'l':
+        nlookups = (cmph_uint32)strtoul(optarg, NULL, 10);
+        break;
+      case 'x':
+        miss_ratio = atof(optarg);
+        break;
+      case 't':
+        max_threads = (cmph_uint32)strtoul(optarg, NULL, 10);
+        break;
+      case 'c':
+        for (i = 0; i < CMPH_COUNT; ++i) graphsize[i] = atof(optarg);
+        break;
+      case 'f':
+        json = strcmp(optarg, "json") == 0;
+        break;
+      case 'd':
+        tmp_dir = optarg;
+        break;
+      case 'h':
+        usage_long(argv[0]);
+        return 0;
+      default:
+        usage(argv[0]);
+        return 1;
+    }
+  }
+  if (nlookups == 0 || miss_ratio < 0 || miss_ratio > 1) {
+    usage(argv[0]);
+    return 1;
+  }
+  if (max_threads < 1) max_threads = 1;
+  if (max_threads > 64) max_threads = 64;
+  if (!thread_pool_available()) max_threads = 1;
+
+  if (json) {
+    printf("[");
+  } else {
+    printf("algo,keys,nkeys,miss_ratio,build_s,bits_per_key,hot_ns,cold_ns,hot_packed_ns,cold_packed_ns");
+    for (t = 1; t < max_threads; t *= 2) printf(",mlookups_s_%u", t);
+    printf(",mlookups_s_%u\n", max_threads);
+  }
+  srand(1);
+  for (s = 0; s < BM_SHAPE_COUNT; ++s) {
+    if (!shapes[s]) continue;
+    for (z = 0; z < nsizes; ++z) {
+      bm_keys_t set, misses;
+      cmph_uint32 nkeys = sizes[z];
+      cmph_uint32 nmisses = nkeys < nlookups ? nkeys : nlookups;
+      cmph_uint8 **hot, **cold;
+      if (nkeys == 0) continue;
+      hot = (cmph_uint8 **)malloc(sizeof(cmph_uint8 *) * nlookups);
+      cold = (cmph_uint8 **)malloc(sizeof(cmph_uint8 *) * nlookups);
+      bm_keys_new(&set, (bm_shape_t)s, 0, nkeys);
+      bm_keys_new(&misses, (bm_shape_t)s, nkeys, nmisses);
+      for (i = 0; i < nlookups; ++i) {
+        cmph_uint32 r = (cmph_uint32)(((cmph_uint64)rand() << 31) ^ (cmph_uint64)rand());
+        hot[i] = set.keys[r % (nkeys < BM_HOT_KEYS ? nkeys : BM_HOT_KEYS)];
+        if ((double)rand() / RAND_MAX < miss_ratio) cold[i] = misses.keys[r % nmisses];
+        else cold[i] = set.keys[r % nkeys];
+      }
+      for (a = 0; a < CMPH_COUNT; ++a) {
+        double build_s, bits_per_key, hot_ns, cold_ns, hot_packed_ns, cold_packed_ns;
+        void *packed_mphf;
+        cmph_t *mphf;
+        if (!algos[a]) continue;
+        mphf = bm_build((CMPH_ALGO)a, graphsize[a], &set, tmp_dir, &build_s);
+        if (!mphf) {
+          fprintf(stderr, "Unable to create %s function over %u %s keys, skipped\n",
+                  cmph_names[a], nkeys, bm_shape_names[s]);
+          continue;
+        }
+        packed_mphf = malloc(cmph_packed_size(mphf));
+        cmph_pack(mphf, packed_mphf);
+        bits_per_key = cmph_packed_size(mphf) * 8.0 / nkeys;
+        hot_ns = bm_search_stream(mphf, hot, nlookups);
+        cold_ns = bm_search_stream(mphf, cold, nlookups);
+        hot_packed_ns = bm_search_packed_stream(packed_mphf, hot, nlookups);
+        cold_packed_ns = bm_search_packed_stream(packed_mphf, cold, nlookups);
+        if (json) {
+          printf("%s\n {\"algo\": \"%s\", \"keys\": \"%s\", \"nkeys\": %u, \"miss_ratio\": %.3f, "
+                 "\"build_s\": %.6f, \"bits_per_key\": %.3f, \"hot_ns\": %.2f, \"cold_ns\": %.2f, "
+                 "\"hot_packed_ns\": %.2f, \"cold_packed_ns\": %.2f, \"mlookups_s\": {",
+                 nrows ? "," : "", cmph_names[a], bm_shape_names[s], nkeys, miss_ratio,
+                 build_s, bits_per_key, hot_ns, cold_ns, hot_packed_ns, cold_packed_ns);
+        } else {
+          printf("%s,%s,%u,%.3f,%.6f,%.3f,%.2f,%.2f,%.2f,%.2f", cmph_names[a], bm_shape_names[s], nkeys,
+                 miss_ratio, build_s, bits_per_key, hot_ns, cold_ns, hot_packed_ns, cold_packed_ns);
+        }
+        for (t = 1; ; t = t * 2 < max_threads ? t * 2 : max_threads) {
+          double mlookups_s = bm_threads_stream(packed_mphf, cold, nlookups, t);
+          if (json) printf("%s\"%u\": %.3f", t > 1 ? ", " : "", t, mlookups_s);
+          else printf(",%.3f", mlookups_s);
+          if (t == max_threads) break;
+        }
+        printf(json ? "}}" : "\n");
+        fflush(stdout);
+        ++nrows;
+        free(packed_mphf);
+        cmph_destroy(mphf);
+      }
+      free(hot);
+      free(cold);
+      bm_keys_destroy(&misses);
+      bm_keys_destroy(&set);
+    }
+  }
+  if (json) printf("\n]\n");
+  return 0;
+}
@@ -31,6 +31,7 @@ bmz_config_data_t *bmz_config_new(void)
 	bmz->g = NULL;
 	bmz->graph = NULL;
 	bmz->hashes = NULL;
+	bmz->fingerprints = NULL;
 	return bmz;
 }
 
@@ -82,6 +83,11 @@ cmph_t *bmz_new(cmph_config_t *mph, double c)
 
 	bmz->hashes = (hash_state_t **)malloc(sizeof(hash_state_t *)*3);
 	for(i = 0; i < 3; ++i) bmz->hashes[i] = NULL;
+	if (bmz->hashfuncs[0] == CMPH_HASH_FINGERPRINT && bmz->hashfuncs[1] == CMPH_HASH_FINGERPRINT)
+	{
+		__config_phase(mph, CMPH_PHASE_HASHING);
+		bmz->fingerprints = __config_fingerprints(mph);
+	}
 
 	do
 	{
@@ -96,10 +102,9 @@ cmph_t *bmz_new(cmph_config_t *mph, double c)
 	  while(1)
 	  {
 		int ok;
-		DEBUGP("hash function 1\n");
-		bmz->hashes[0] = hash_state_new(bmz->hashfuncs[0], bmz->n);
-		DEBUGP("hash function 2\n");
-		bmz->hashes[1] = hash_state_new(bmz->hashfuncs[1], bmz->n);
+		DEBUGP("hash functions\n");
+		mph->stats.iterations++;
+		hash_pair_new(bmz->hashfuncs[0], bmz->hashfuncs[1], bmz->n, &bmz->hashes[0], &bmz->hashes[1]);
 		DEBUGP("Generating edges\n");
 		ok = bmz_gen_edges(mph);
 		if (!ok)
@@ -121,6 +126,8 @@ cmph_t *bmz_new(cmph_config_t *mph, double c)
 	  if (iterations == 0)
 	  {
 		graph_destroy(bmz->graph);
+		free(bmz->fingerprints);
+		bmz->fingerprints = NULL;
 		return NULL;
 	  }
 	  // Ordering step
@@ -128,6 +135,7 @@ cmph_t *bmz_new(cmph_config_t *mph, double c)
 	  {
 		fprintf(stderr, "Starting ordering step\n");
 	  }
+	  __config_phase(mph, CMPH_PHASE_SEARCHING);
 	  graph_obtain_critical_nodes(bmz->graph);
 
 	  // Searching step
@@ -137,6 +145,7 @@ cmph_t *bmz_new(cmph_config_t *mph, double c)
 		fprintf(stderr, "\tTraversing critical vertices.\n");
 	  }
 	  DEBUGP("Searching step\n");
+	  __config_phase(mph, CMPH_PHASE_ASSIGNING);
 	  visited = (cmph_uint8 *)malloc((size_t)bmz->n/8 + 1);
 	  memset(visited, 0, (size_t)bmz->n/8 + 1);
 	  used_edges = (cmph_uint8 *)malloc((size_t)bmz->m/8 + 1);
@@ -169,6 +178,8 @@ cmph_t *bmz_new(cmph_config_t *mph, double c)
 	  free(used_edges);
 	  free(visited);
         } while(restart_mapping && iterations_map > 0);
+	free(bmz->fingerprints);
+	bmz->fingerprints = NULL;
 	graph_destroy(bmz->graph);
 	bmz->graph = NULL;
 	if (iterations_map == 0)
@@ -183,6 +194,7 @@ cmph_t *bmz_new(cmph_config_t *mph, double c)
 
 	mphf = (cmph_t *)malloc(sizeof(cmph_t));
 	mphf->algo = mph->algo;
+	mphf->version = 0;
 	bmzf = (bmz_data_t *)malloc(sizeof(bmz_data_t));
 	bmzf->g = bmz->g;
 	bmz->g = NULL; //transfer memory ownership
@@ -424,27 +436,31 @@ static int bmz_gen_edges(cmph_config_t *mph)
 	bmz_config_data_t *bmz = (bmz_config_data_t *)mph->data;
 	cmph_uint8 multiple_edges = 0;
 	DEBUGP("Generating edges for %u vertices\n", bmz->n);
+	__config_phase(mph, CMPH_PHASE_HASHING);
 	graph_clear_edges(bmz->graph);
-	mph->key_source->rewind(mph->key_source->data);
+	if (bmz->fingerprints == NULL) mph->key_source->rewind(mph->key_source->data);
 	for (e = 0; e < mph->key_source->nkeys; ++e)
 	{
 		cmph_uint32 h1, h2;
-		cmph_uint32 keylen;
+		cmph_uint32 keylen, hp[2];
 		char *key = NULL;
-		mph->key_source->read(mph->key_source->data, &key, &keylen);
-
-		h1 = hash(bmz->hashes[0], key, keylen) % bmz->n;
-		h2 = hash(bmz->hashes[1], key, keylen) % bmz->n;
+		if (bmz->fingerprints) hash_pair_fingerprint(bmz->hashes[0], bmz->hashes[1], bmz->fingerprints + 2*e, hp);
+		else
+		{
+			mph->key_source->read(mph->key_source->data, &key, &keylen);
+			hash_pair(bmz->hashes[0], bmz->hashes[1], key, keylen, hp);
+			__key_dispose(mph->key_source, key, keylen);
+		}
+		h1 = hp[0] % bmz->n;
+		h2 = hp[1] % bmz->n;
 		if (h1 == h2) if (++h2 >= bmz->n) h2 = 0;
-		DEBUGP("key: %.*s h1: %u h2: %u\n", keylen, key, h1, h2);
+		DEBUGP("key %u: h1: %u h2: %u\n", e, h1, h2);
 		if (h1 == h2)
 		{
 			if (mph->verbosity) fprintf(stderr, "Self loop for key %u\n", e);
-			mph->key_source->dispose(mph->key_source->data, key, keylen);
 			return 0;
 		}
-		DEBUGP("Adding edge: %u -> %u for key %.*s\n", h1, h2, keylen, key);
-		mph->key_source->dispose(mph->key_source->data, key, keylen);
+		DEBUGP("Adding edge: %u -> %u for key %u\n", h1, h2, e);
 		multiple_edges = graph_contains_edge(bmz->graph, h1, h2);
 		if (mph->verbosity && multiple_edges) fprintf(stderr, "A non simple graph was generated\n");
 		if (multiple_edges) return 0; // checking multiple edge restriction.
@@ -457,12 +473,12 @@ int bmz_dump(cmph_t *mphf, FILE *fd)
 {
 	char *buf = NULL;
 	cmph_uint32 buflen;
-	cmph_uint32 two = 2; //number of hash functions
 	bmz_data_t *data = (bmz_data_t *)mphf->data;
+	cmph_uint32 nhashes = data->hashes[1] ? 2 : 1; //number of hash functions
 	register size_t nbytes;
 	__cmph_dump(mphf, fd);
 
-	nbytes = fwrite(&two, sizeof(cmph_uint32), (size_t)1, fd);
+	nbytes = fwrite(&nhashes, sizeof(cmph_uint32), (size_t)1, fd);
 
 	hash_state_dump(data->hashes[0], &buf, &buflen);
 	DEBUGP("Dumping hash state with %u bytes to disk\n", buflen);
@@ -470,11 +486,14 @@ int bmz_dump(cmph_t *mphf, FILE *fd)
 	nbytes = fwrite(buf, (size_t)buflen, (size_t)1, fd);
 	free(buf);
 
-	hash_state_dump(data->hashes[1], &buf, &buflen);
-	DEBUGP("Dumping hash state with %u bytes to disk\n", buflen);
-	nbytes = fwrite(&buflen, sizeof(cmph_uint32), (size_t)1, fd);
-	nbytes = fwrite(buf, (size_t)buflen, (size_t)1, fd);
-	free(buf);
+	if (nhashes == 2)
+	{
+		hash_state_dump(data->hashes[1], &buf, &buflen);
+		DEBUGP("Dumping hash state with %u bytes to disk\n", buflen);
+		nbytes = fwrite(&buflen, sizeof(cmph_uint32), (size_t)1, fd);
+		nbytes = fwrite(buf, (size_t)buflen, (size_t)1, fd);
+		free(buf);
+	}
 
 	nbytes = fwrite(&(data->n), sizeof(cmph_uint32), (size_t)1, fd);
 	nbytes = fwrite(&(data->m), sizeof(cmph_uint32), (size_t)1, fd);
@@ -533,8 +552,11 @@ void bmz_load(FILE *f, cmph_t *mphf)
 cmph_uint32 bmz_search(cmph_t *mphf, const char *key, cmph_uint32 keylen)
 {
 	bmz_data_t *bmz = (bmz_data_t *)mphf->data;
-	cmph_uint32 h1 = hash(bmz->hashes[0], key, keylen) % bmz->n;
-	cmph_uint32 h2 = hash(bmz->hashes[1], key, keylen) % bmz->n;
+	cmph_uint32 hp[2];
+	cmph_uint32 h1, h2;
+	hash_pair(bmz->hashes[0], bmz->hashes[1], key, keylen, hp);
+	h1 = hp[0] % bmz->n;
+	h2 = hp[1] % bmz->n;
 	DEBUGP("key: %.*s h1: %u h2: %u\n", keylen, key, h1, h2);
 	if (h1 == h2 && ++h2 >= bmz->n) h2 = 0;
 	DEBUGP("key: %.*s g[h1]: %u g[h2]: %u edges: %u\n", keylen, key, bmz->g[h1], bmz->g[h2], bmz->m);
@@ -624,8 +646,10 @@ cmph_uint32 bmz_search_packed(void *packed_mphf, const char *key, cmph_uint32 ke
 
 	register cmph_uint32 n = *g_ptr++;
 
-	register cmph_uint32 h1 = hash_packed(h1_ptr, h1_type, key, keylen) % n;
-	register cmph_uint32 h2 = hash_packed(h2_ptr, h2_type, key, keylen) % n;
+	cmph_uint32 hp[2];
+	hash_pair_packed(h1_ptr, h1_type, h2_ptr, h2_type, key, keylen, hp);
+	register cmph_uint32 h1 = hp[0] % n;
+	register cmph_uint32 h2 = hp[1] % n;
 	if (h1 == h2 && ++h2 >= n) h2 = 0;
 	return (g_ptr[h1] + g_ptr[h2]);
 }
@@ -100,10 +100,15 @@ cmph_t *bmz8_new(cmph_config_t *mph, double c)
 	  while(1)
 	  {
 		int ok;
-		DEBUGP("hash function 1\n");
-		bmz8->hashes[0] = hash_state_new(bmz8->hashfuncs[0], bmz8->n);
-		DEBUGP("hash function 2\n");
-		bmz8->hashes[1] = hash_state_new(bmz8->hashfuncs[1], bmz8->n);
+		DEBUGP("hash functions\n");
+		mph->stats.iterations++;
+		if (mph->seed)
+		{
+			// one seed per function, the second is not needed with a single family
+			bmz8->hashes[0] = __config_hash_state(mph, bmz8->hashfuncs[0], 0);
+			bmz8->hashes[1] = bmz8->hashfuncs[0] == bmz8->hashfuncs[1] ? NULL : __config_hash_state(mph, bmz8->hashfuncs[1], 0);
+		}
+		else hash_pair_new(bmz8->hashfuncs[0], bmz8->hashfuncs[1], bmz8->n, &bmz8->hashes[0], &bmz8->hashes[1]);
 		DEBUGP("Generating edges\n");
 		ok = bmz8_gen_edges(mph);
 		if (!ok)
@@ -134,6 +139,7 @@ cmph_t *bmz8_new(cmph_config_t *mph, double c)
 		fprintf(stderr, "Starting ordering step\n");
 	  }
 
+	  __config_phase(mph, CMPH_PHASE_SEARCHING);
 	  graph_obtain_critical_nodes(bmz8->graph);
 
 	  // Searching step
@@ -143,6 +149,7 @@ cmph_t *bmz8_new(cmph_config_t *mph, double c)
 		fprintf(stderr, "\tTraversing critical vertices.\n");
 	  }
 	  DEBUGP("Searching step\n");
+	  __config_phase(mph, CMPH_PHASE_ASSIGNING);
 	  visited = (cmph_uint8 *)malloc((size_t)bmz8->n/8 + 1);
 	  memset(visited, 0, (size_t)bmz8->n/8 + 1);
 	  used_edges = (cmph_uint8 *)malloc((size_t)bmz8->m/8 + 1);
@@ -185,6 +192,7 @@ cmph_t *bmz8_new(cmph_config_t *mph, double c)
 	}
 	mphf = (cmph_t *)malloc(sizeof(cmph_t));
 	mphf->algo = mph->algo;
+	mphf->version = 0;
 	bmz8f = (bmz8_data_t *)malloc(sizeof(bmz8_data_t));
 	bmz8f->g = bmz8->g;
 	bmz8->g = NULL; //transfer memory ownership
@@ -431,27 +439,29 @@ static int bmz8_gen_edges(cmph_config_t *mph)
 	bmz8_config_data_t *bmz8 = (bmz8_config_data_t *)mph->data;
 	cmph_uint8 multiple_edges = 0;
 	DEBUGP("Generating edges for %u vertices\n", bmz8->n);
+	__config_phase(mph, CMPH_PHASE_HASHING);
 	graph_clear_edges(bmz8->graph);
 	mph->key_source->rewind(mph->key_source->data);
 	for (e = 0; e < mph->key_source->nkeys; ++e)
 	{
 		cmph_uint8 h1, h2;
-		cmph_uint32 keylen;
+		cmph_uint32 keylen, hp[2];
 		char *key = NULL;
 		mph->key_source->read(mph->key_source->data, &key, &keylen);
 
 //		if (key == NULL)fprintf(stderr, "key = %s -- read BMZ\n", key);
-		h1 = (cmph_uint8)(hash(bmz8->hashes[0], key, keylen) % bmz8->n);
-		h2 = (cmph_uint8)(hash(bmz8->hashes[1], key, keylen) % bmz8->n);
+		hash_pair(bmz8->hashes[0], bmz8->hashes[1], key, keylen, hp);
+		h1 = (cmph_uint8)(hp[0] % bmz8->n);
+		h2 = (cmph_uint8)(hp[1] % bmz8->n);
 		if (h1 == h2) if (++h2 >= bmz8->n) h2 = 0;
 		if (h1 == h2)
 		{
 			if (mph->verbosity) fprintf(stderr, "Self loop for key %u\n", e);
-			mph->key_source->dispose(mph->key_source->data, key, keylen);
+			__key_dispose(mph->key_source, key, keylen);
 			return 0;
 		}
 		//DEBUGP("Adding edge: %u -> %u for key %s\n", h1, h2, key);
-		mph->key_source->dispose(mph->key_source->data, key, keylen);
+		__key_dispose(mph->key_source, key, keylen);
 //		fprintf(stderr, "key = %s -- dispose BMZ\n", key);
 		multiple_edges = graph_contains_edge(bmz8->graph, h1, h2);
 		if (mph->verbosity && multiple_edges) fprintf(stderr, "A non simple graph was generated\n");
@@ -465,12 +475,12 @@ int bmz8_dump(cmph_t *mphf, FILE *fd)
 {
 	char *buf = NULL;
 	cmph_uint32 buflen;
-	cmph_uint8 two = 2; //number of hash functions
 	bmz8_data_t *data = (bmz8_data_t *)mphf->data;
+	cmph_uint8 nhashes = data->hashes[1] ? 2 : 1; //number of hash functions
 	register size_t nbytes;
 	__cmph_dump(mphf, fd);
 
-	nbytes = fwrite(&two, sizeof(cmph_uint8), (size_t)1, fd);
+	nbytes = fwrite(&nhashes, sizeof(cmph_uint8), (size_t)1, fd);
 
 	hash_state_dump(data->hashes[0], &buf, &buflen);
 	DEBUGP("Dumping hash state with %u bytes to disk\n", buflen);
@@ -478,11 +488,14 @@ int bmz8_dump(cmph_t *mphf, FILE *fd)
 	nbytes = fwrite(buf, (size_t)buflen, (size_t)1, fd);
 	free(buf);
 
-	hash_state_dump(data->hashes[1], &buf, &buflen);
-	DEBUGP("Dumping hash state with %u bytes to disk\n", buflen);
-	nbytes = fwrite(&buflen, sizeof(cmph_uint32), (size_t)1, fd);
-	nbytes = fwrite(buf, (size_t)buflen, (size_t)1, fd);
-	free(buf);
+	if (nhashes == 2)
+	{
+		hash_state_dump(data->hashes[1], &buf, &buflen);
+		DEBUGP("Dumping hash state with %u bytes to disk\n", buflen);
+		nbytes = fwrite(&buflen, sizeof(cmph_uint32), (size_t)1, fd);
+		nbytes = fwrite(buf, (size_t)buflen, (size_t)1, fd);
+		free(buf);
+	}
 
 	nbytes = fwrite(&(data->n), sizeof(cmph_uint8), (size_t)1, fd);
 	nbytes = fwrite(&(data->m), sizeof(cmph_uint8), (size_t)1, fd);
@@ -541,10 +554,13 @@ void bmz8_load(FILE *f, cmph_t *mphf)
 cmph_uint8 bmz8_search(cmph_t *mphf, const char *key, cmph_uint32 keylen)
 {
 	bmz8_data_t *bmz8 = (bmz8_data_t *)mphf->data;
-	cmph_uint8 h1 = (cmph_uint8)(hash(bmz8->hashes[0], key, keylen) % bmz8->n);
-	cmph_uint8 h2 = (cmph_uint8)(hash(bmz8->hashes[1], key, keylen) % bmz8->n);
+	cmph_uint32 hp[2];
+	cmph_uint8 h1, h2;
+	hash_pair(bmz8->hashes[0], bmz8->hashes[1], key, keylen, hp);
+	h1 = (cmph_uint8)(hp[0] % bmz8->n);
+	h2 = (cmph_uint8)(hp[1] % bmz8->n);
 	DEBUGP("key: %s h1: %u h2: %u\n", key, h1, h2);
-	if (h1 == h2 && ++h2 > bmz8->n) h2 = 0;
+	if (h1 == h2 && ++h2 >= bmz8->n) h2 = 0;
 	DEBUGP("key: %s g[h1]: %u g[h2]: %u edges: %u\n", key, bmz8->g[h1], bmz8->g[h2], bmz8->m);
 	return (cmph_uint8)(bmz8->g[h1] + bmz8->g[h2]);
 }
@@ -630,9 +646,11 @@ cmph_uint8 bmz8_search_packed(void *packed_mphf, const char *key, cmph_uint32 ke
 
 	register cmph_uint8 n = *g_ptr++;
 
-	register cmph_uint8 h1 = (cmph_uint8)(hash_packed(h1_ptr, h1_type, key, keylen) % n);
-	register cmph_uint8 h2 = (cmph_uint8)(hash_packed(h2_ptr, h2_type, key, keylen) % n);
+	cmph_uint32 hp[2];
+	hash_pair_packed(h1_ptr, h1_type, h2_ptr, h2_type, key, keylen, hp);
+	register cmph_uint8 h1 = (cmph_uint8)(hp[0] % n);
+	register cmph_uint8 h2 = (cmph_uint8)(hp[1] % n);
 	DEBUGP("key: %s h1: %u h2: %u\n", key, h1, h2);
-	if (h1 == h2 && ++h2 > n) h2 = 0;
+	if (h1 == h2 && ++h2 >= n) h2 = 0;
 	return (cmph_uint8)(g_ptr[h1] + g_ptr[h2]);
 }
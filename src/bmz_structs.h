@@ -20,6 +20,7 @@ struct __bmz_config_data_t
 	graph_t *graph;
 	cmph_uint32 *g;
 	hash_state_t **hashes;
+	cmph_uint64 *fingerprints; // of the keys during construction with CMPH_HASH_FINGERPRINT
 };
 
 #endif
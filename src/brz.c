@@ -10,27 +10,45 @@
 #include "cmph.h"
 #include "hash.h"
 #include "bitbool.h"
+#include "fastrange.h"
+#include "thread_pool.h"
 #include <math.h>
+#include <limits.h>
 #include <stdlib.h>
 #include <stdio.h>
 #include <assert.h>
 #include <string.h>
+#ifndef WIN32
+#include <sys/resource.h>
+#endif
 #define MAX_BUCKET_SIZE 255
+#define MAX_BUCKET_SIZE16 65535
+// BDZ and CHD buckets are kept as packed functions with 16-bit sizes
+#define BRZ_PACKED_BUCKETS(algo) ((algo) == CMPH_BDZ || (algo) == CMPH_CHD)
 //#define DEBUG
 #include "debug.h"
 
+// Results of brz_gen_mphf. Only a failed bucket is worth another h0.
+#define BRZ_GEN_FAILED 0
+#define BRZ_GEN_OK 1
+#define BRZ_GEN_IO_ERROR 2 // a temporary file or the MPHF could not be read or written
+
 static int brz_gen_mphf(cmph_config_t *mph);
-static cmph_uint32 brz_min_index(cmph_uint32 * vector, cmph_uint32 n);
+static void brz_heap_sift_down(cmph_uint32 * heap, cmph_uint32 n, cmph_uint32 pos, cmph_uint32 * vector);
 static void brz_destroy_keys_vd(cmph_uint8 ** keys_vd, cmph_uint32 nkeys);
 static char * brz_copy_partial_fch_mphf(brz_config_data_t *brz, fch_data_t * fchf, cmph_uint32 index,  cmph_uint32 *buflen);
 static char * brz_copy_partial_bmz8_mphf(brz_config_data_t *brz, bmz8_data_t * bmzf, cmph_uint32 index,  cmph_uint32 *buflen);
+static char * brz_copy_packed_mphf(cmph_t * mphf, cmph_uint32 *buflen);
+static int brz_dump_size(CMPH_ALGO algo, cmph_uint16 * size, cmph_uint32 k, FILE * fd);
+static cmph_uint16 * brz_load_size(CMPH_ALGO algo, cmph_uint32 k, FILE * fd);
 brz_config_data_t *brz_config_new(void)
 {
 	brz_config_data_t *brz = NULL;
     brz = (brz_config_data_t *)malloc(sizeof(brz_config_data_t));
     if (!brz) return NULL;
+    brz->bucket_algo = CMPH_COUNT;
     brz->algo = CMPH_FCH;
-	brz->b = 128;
+	brz->b = 0;
 	brz->hashfuncs[0] = CMPH_HASH_JENKINS;
 	brz->hashfuncs[1] = CMPH_HASH_JENKINS;
 	brz->hashfuncs[2] = CMPH_HASH_JENKINS;
@@ -106,19 +124,15 @@ void brz_config_set_mphf_fd(cmph_config_t *mph, FILE *mphf_fd)
 void brz_config_set_b(cmph_config_t *mph, cmph_uint32 b)
 {
 	brz_config_data_t *brz = (brz_config_data_t *)mph->data;
-	if(b <= 64 || b >= 175)
-	{
-		b =  128;
-	}
-	brz->b = (cmph_uint8)b;
+	brz->b = b; // validated by brz_new, the range depends on the bucket algo
 }
 
 void brz_config_set_algo(cmph_config_t *mph, CMPH_ALGO algo)
 {
-	if (algo == CMPH_BMZ8 || algo == CMPH_FCH) // supported algorithms
+	if (algo == CMPH_BMZ8 || algo == CMPH_FCH || BRZ_PACKED_BUCKETS(algo)) // supported algorithms
 	{
 		brz_config_data_t *brz = (brz_config_data_t *)mph->data;
-		brz->algo = algo;
+		brz->bucket_algo = algo;
 	}
 }
 
@@ -126,8 +140,9 @@ cmph_t *brz_new(cmph_config_t *mph, double c)
 {
 	cmph_t *mphf = NULL;
 	brz_data_t *brzf = NULL;
-	cmph_uint32 i;
+	cmph_uint32 i, b;
 	cmph_uint32 iterations = 20;
+	long start;
 
 	DEBUGP("c: %f\n", c);
 	brz_config_data_t *brz = (brz_config_data_t *)mph->data;
@@ -140,13 +155,23 @@ cmph_t *brz_new(cmph_config_t *mph, double c)
         return NULL;
     }
 
-	switch(brz->algo) // validating restrictions over parameter c.
+	if (brz->bucket_algo != CMPH_COUNT) brz->algo = brz->bucket_algo;
+	else brz->algo = c >= 2.0 ? CMPH_FCH : CMPH_BMZ8;
+	b = brz->b;
+	switch(brz->algo) // validating restrictions over parameters c and b.
 	{
 		case CMPH_BMZ8:
 			if (c == 0 || c >= 2.0) c = 1;
+			if (b <= 64 || b >= 175) b = 128;
 			break;
 		case CMPH_FCH:
 			if (c <= 2.0) c = 2.6;
+			if (b <= 64 || b >= 175) b = 128;
+			break;
+		case CMPH_BDZ:
+		case CMPH_CHD:
+			// c is handed to the bucket algo as is
+			if (b == 0 || b > 32768) b = 2048;
 			break;
 		default:
 			assert(0);
@@ -158,10 +183,10 @@ cmph_t *brz_new(cmph_config_t *mph, double c)
         brz->c = 5;
     }
 
-	DEBUGP("m: %u\n", brz->m);
-        brz->k = (cmph_uint32)ceil(brz->m/((double)brz->b));
+	DEBUGP("m: %llu\n", (unsigned long long)brz->m);
+        brz->k = (cmph_uint32)ceil(brz->m/((double)b));
 	DEBUGP("k: %u\n", brz->k);
-	brz->size   = (cmph_uint8 *) calloc((size_t)brz->k, sizeof(cmph_uint8));
+	brz->size   = (cmph_uint16 *) calloc((size_t)brz->k, sizeof(cmph_uint16));
 
 	// Clustering the keys by graph id.
 	if (mph->verbosity)
@@ -169,26 +194,44 @@ cmph_t *brz_new(cmph_config_t *mph, double c)
 		fprintf(stderr, "Partitioning the set of keys.\n");
 	}
 
+	// an iteration writes the MPHF again from where the first one started
+	start = ftell(brz->mphf_fd);
 	while(1)
 	{
-		int ok;
+		int status;
 		DEBUGP("hash function 3\n");
-		brz->h0 = hash_state_new(brz->hashfuncs[2], brz->k);
+		mph->stats.iterations++;
+		brz->h0 = __config_hash_state(mph, brz->hashfuncs[2], brz->k);
 		DEBUGP("Generating graphs\n");
-		ok = brz_gen_mphf(mph);
-		if (!ok)
+		status = brz_gen_mphf(mph);
+		if (status == BRZ_GEN_OK) break;
+		hash_state_destroy(brz->h0);
+		brz->h0 = NULL;
+		if (status == BRZ_GEN_IO_ERROR)
 		{
-			--iterations;
-			hash_state_destroy(brz->h0);
-			brz->h0 = NULL;
-			DEBUGP("%u iterations remaining to create the graphs in a external file\n", iterations);
 			if (mph->verbosity)
 			{
-				fprintf(stderr, "Failure: A graph with more than 255 keys was created - %u iterations remaining\n", iterations);
+				fprintf(stderr, "Failure: Unable to read or write the temporary files or the MPHF\n");
 			}
-			if (iterations == 0) break;
+			iterations = 0;
+			break;
+		}
+		--iterations;
+		DEBUGP("%u iterations remaining to create the graphs in a external file\n", iterations);
+		if (mph->verbosity)
+		{
+			fprintf(stderr, "Failure: A graph with more than 255 keys was created - %u iterations remaining\n", iterations);
+		}
+		if (iterations == 0) break;
+		if (start < 0 || fseek(brz->mphf_fd, start, SEEK_SET) != 0)
+		{
+			if (mph->verbosity)
+			{
+				fprintf(stderr, "Failure: Unable to rewind the MPHF file for another iteration\n");
+			}
+			iterations = 0;
+			break;
 		}
-		else break;
 	}
 	if (iterations == 0)
 	{
@@ -198,7 +241,7 @@ cmph_t *brz_new(cmph_config_t *mph, double c)
 	}
 	DEBUGP("Graphs generated\n");
 
-	brz->offset = (cmph_uint32 *)calloc((size_t)brz->k, sizeof(cmph_uint32));
+	brz->offset = (cmph_uint64 *)calloc((size_t)brz->k, sizeof(cmph_uint64));
 	for (i = 1; i < brz->k; ++i)
 	{
 		brz->offset[i] = brz->size[i-1] + brz->offset[i-1];
@@ -206,9 +249,11 @@ cmph_t *brz_new(cmph_config_t *mph, double c)
 	// Generating a mphf
 	mphf = (cmph_t *)malloc(sizeof(cmph_t));
 	mphf->algo = mph->algo;
+	mphf->version = CMPH_VERSION_FASTRANGE;
 	brzf = (brz_data_t *)malloc(sizeof(brz_data_t));
 	brzf->g = brz->g;
 	brz->g = NULL; //transfer memory ownership
+	brzf->g_size = NULL;
 	brzf->h1 = brz->h1;
 	brz->h1 = NULL; //transfer memory ownership
 	brzf->h2 = brz->h2;
@@ -233,297 +278,589 @@ cmph_t *brz_new(cmph_config_t *mph, double c)
 	return mphf;
 }
 
-static int brz_gen_mphf(cmph_config_t *mph)
+// Keys read from the source are gathered in a buffer, sorted by bucket and
+// written to a temporary file whenever the buffer is full. Each key is kept
+// as keylen, h0, key, in the buffer and in the temporary files, so that the
+// bucket computed on ingestion is reused by the sort and the merges.
+#define BRZ_RECORD_SIZE(keylen) ((keylen) + 2*(cmph_uint32)sizeof(cmph_uint32))
+#define BRZ_WRITE_BLOCK (1U << 20)
+// Most runs open at once in a merge, lowered to half of the descriptor limit.
+#define BRZ_MAX_MERGED_RUNS 512U
+// Least memory given to the read buffer of each run of a merge.
+#define BRZ_MIN_RUN_BUFFER 4096U
+
+// Name of the temporary file of run i, to be freed.
+static char *brz_run_filename(brz_config_data_t *brz, cmph_uint32 i)
 {
-	cmph_uint32 i, e, error;
-	brz_config_data_t *brz = (brz_config_data_t *)mph->data;
-	cmph_uint32 memory_usage = 0;
-	cmph_uint32 nkeys_in_buffer = 0;
-	cmph_uint8 *buffer = (cmph_uint8 *)malloc((size_t)brz->memory_availability);
-	cmph_uint32 *buckets_size = (cmph_uint32 *)calloc((size_t)brz->k, sizeof(cmph_uint32));
-	cmph_uint32 *keys_index = NULL;
-	cmph_uint8 **buffer_merge = NULL;
-	cmph_uint32 *buffer_h0 = NULL;
-	cmph_uint32 nflushes = 0;
-	cmph_uint32 h0;
-	register size_t nbytes;
-	FILE *  tmp_fd = NULL;
-	buffer_manager_t * buff_manager = NULL;
-	char *filename = NULL;
-	char *key = NULL;
-	cmph_uint32 keylen;
-	cmph_uint32 cur_bucket = 0;
-	cmph_uint8 nkeys_vd = 0;
-	cmph_uint8 ** keys_vd = NULL;
+	char *filename = (char *)calloc(strlen((char *)(brz->tmp_dir)) + 16, sizeof(char));
+	sprintf(filename, "%s%u.cmph", brz->tmp_dir, i);
+	return filename;
+}
 
-	mph->key_source->rewind(mph->key_source->data);
-	DEBUGP("Generating graphs from %u keys\n", brz->m);
-	// Partitioning
-	for (e = 0; e < brz->m; ++e)
+typedef struct
+{
+	cmph_uint8 *buffer;
+	cmph_uint32 capacity;
+	cmph_uint32 memory_usage;
+	cmph_uint32 nkeys;
+} brz_buffer_t;
+
+// With more than one thread a buffer is filled while the other one is
+// sorted and written: fill and flush write to disjoint fields.
+typedef struct
+{
+	cmph_config_t *mph;
+	brz_buffer_t buffers[2];
+	cmph_uint32 flushing; // buffer written while the other one is filled
+	// owned by brz_fill
+	cmph_uint64 nkeys_read;
+	char *key; // read but left for the next buffer
+	cmph_uint32 keylen;
+	int fill_error;
+	// owned by brz_flush
+	cmph_uint32 *buckets_size;
+	cmph_uint8 *block;
+	cmph_uint32 nflushes;
+	cmph_uint64 nbytes_written;
+	int flush_error;
+} brz_partition_t;
+
+static void brz_fill(brz_partition_t *part, brz_buffer_t *buf)
+{
+	cmph_config_t *mph = part->mph;
+	brz_config_data_t *brz = (brz_config_data_t *)mph->data;
+	buf->memory_usage = 0;
+	buf->nkeys = 0;
+	while (part->key || part->nkeys_read < brz->m)
 	{
-		mph->key_source->read(mph->key_source->data, &key, &keylen);
-
-		/* Buffers management */
-		if (memory_usage + keylen + sizeof(keylen) > brz->memory_availability) // flush buffers
+		cmph_uint32 h0, record_size;
+		if (part->key == NULL)
 		{
-			if(mph->verbosity)
-			{
-				fprintf(stderr, "Flushing  %u\n", nkeys_in_buffer);
-			}
-			cmph_uint32 value = buckets_size[0];
-			cmph_uint32 sum = 0;
-			cmph_uint32 keylen1 = 0;
-			buckets_size[0]   = 0;
-			for(i = 1; i < brz->k; i++)
-			{
-				if(buckets_size[i] == 0) continue;
-				sum += value;
-				value = buckets_size[i];
-				buckets_size[i] = sum;
-
-			}
-			memory_usage = 0;
-			keys_index = (cmph_uint32 *)calloc((size_t)nkeys_in_buffer, sizeof(cmph_uint32));
-			for(i = 0; i < nkeys_in_buffer; i++)
-			{
-				memcpy(&keylen1, buffer + memory_usage, sizeof(keylen1));
-				h0 = hash(brz->h0, (char *)(buffer + memory_usage + sizeof(keylen1)), keylen1) % brz->k;
-				keys_index[buckets_size[h0]] = memory_usage;
-				buckets_size[h0]++;
-				memory_usage +=  keylen1 + (cmph_uint32)sizeof(keylen1);
-			}
-			filename = (char *)calloc(strlen((char *)(brz->tmp_dir)) + 11, sizeof(char));
-			sprintf(filename, "%s%u.cmph",brz->tmp_dir, nflushes);
-			tmp_fd = fopen(filename, "wb");
-			free(filename);
-			filename = NULL;
-			for(i = 0; i < nkeys_in_buffer; i++)
-			{
-				memcpy(&keylen1, buffer + keys_index[i], sizeof(keylen1));
-				nbytes = fwrite(buffer + keys_index[i], (size_t)1, keylen1 + sizeof(keylen1), tmp_fd);
-			}
-			nkeys_in_buffer = 0;
-			memory_usage = 0;
-			memset((void *)buckets_size, 0, brz->k*sizeof(cmph_uint32));
-			nflushes++;
-			free(keys_index);
-			fclose(tmp_fd);
+			mph->key_source->read(mph->key_source->data, &part->key, &part->keylen);
+			part->nkeys_read++;
 		}
-		memcpy(buffer + memory_usage, &keylen, sizeof(keylen));
-		memcpy(buffer + memory_usage + sizeof(keylen), key, (size_t)keylen);
-		memory_usage += keylen + (cmph_uint32)sizeof(keylen);
-		h0 = hash(brz->h0, key, keylen) % brz->k;
+		record_size = BRZ_RECORD_SIZE(part->keylen);
+		if (buf->memory_usage + record_size > buf->capacity)
+		{
+			if (buf->nkeys > 0) break; // the key goes to the next buffer
+			buf->capacity = record_size;
+			buf->buffer = (cmph_uint8 *)realloc(buf->buffer, (size_t)buf->capacity);
+		}
+		h0 = fastrange32(hash(brz->h0, part->key, part->keylen), brz->k);
+		if ((brz->size[h0] == (BRZ_PACKED_BUCKETS(brz->algo) ? MAX_BUCKET_SIZE16 : MAX_BUCKET_SIZE)) || (brz->algo == CMPH_BMZ8 && ((brz->c >= 1.0) && (cmph_uint8)(brz->c * brz->size[h0]) < brz->size[h0])))
+		{
+			__key_dispose(mph->key_source, part->key, part->keylen);
+			part->key = NULL;
+			part->fill_error = 1;
+			return;
+		}
+		brz->size[h0] = (cmph_uint16)(brz->size[h0] + 1U);
+		memcpy(buf->buffer + buf->memory_usage, &part->keylen, sizeof(part->keylen));
+		memcpy(buf->buffer + buf->memory_usage + sizeof(part->keylen), &h0, sizeof(h0));
+		memcpy(buf->buffer + buf->memory_usage + 2*sizeof(cmph_uint32), part->key, (size_t)part->keylen);
+		buf->memory_usage += record_size;
+		buf->nkeys++;
+		__key_dispose(mph->key_source, part->key, part->keylen);
+		part->key = NULL;
+	}
+}
+
+static void brz_flush(brz_partition_t *part, brz_buffer_t *buf)
+{
+	brz_config_data_t *brz = (brz_config_data_t *)part->mph->data;
+	cmph_uint32 *keys_index = (cmph_uint32 *)malloc(sizeof(cmph_uint32)*buf->nkeys);
+	cmph_uint32 i, h0, keylen, sum = 0, offset = 0, block_usage = 0;
+	FILE *tmp_fd;
+	char *filename;
 
-		if ((brz->size[h0] == MAX_BUCKET_SIZE) || (brz->algo == CMPH_BMZ8 && ((brz->c >= 1.0) && (cmph_uint8)(brz->c * brz->size[h0]) < brz->size[h0])))
+	if(part->mph->verbosity)
+	{
+		fprintf(stderr, "Flushing  %u\n", buf->nkeys);
+	}
+	// counting sort of the keys by bucket
+	memset((void *)part->buckets_size, 0, brz->k*sizeof(cmph_uint32));
+	for(i = 0; i < buf->nkeys; i++)
+	{
+		memcpy(&keylen, buf->buffer + offset, sizeof(keylen));
+		memcpy(&h0, buf->buffer + offset + sizeof(keylen), sizeof(h0));
+		part->buckets_size[h0]++;
+		offset += BRZ_RECORD_SIZE(keylen);
+	}
+	for(i = 0; i < brz->k; i++)
+	{
+		cmph_uint32 size = part->buckets_size[i];
+		part->buckets_size[i] = sum;
+		sum += size;
+	}
+	offset = 0;
+	for(i = 0; i < buf->nkeys; i++)
+	{
+		memcpy(&keylen, buf->buffer + offset, sizeof(keylen));
+		memcpy(&h0, buf->buffer + offset + sizeof(keylen), sizeof(h0));
+		keys_index[part->buckets_size[h0]++] = offset;
+		offset += BRZ_RECORD_SIZE(keylen);
+	}
+	filename = brz_run_filename(brz, part->nflushes);
+	tmp_fd = fopen(filename, "wb");
+	free(filename);
+	if (tmp_fd == NULL)
+	{
+		free(keys_index);
+		part->flush_error = 1;
+		return;
+	}
+	// records are written in blocks of BRZ_WRITE_BLOCK bytes
+	for(i = 0; i < buf->nkeys && !part->flush_error; i++)
+	{
+		cmph_uint8 *record = buf->buffer + keys_index[i];
+		cmph_uint32 record_size;
+		memcpy(&keylen, record, sizeof(keylen));
+		record_size = BRZ_RECORD_SIZE(keylen);
+		if (block_usage + record_size > BRZ_WRITE_BLOCK)
 		{
-			free(buffer);
-			free(buckets_size);
-			return 0;
+			if (fwrite(part->block, (size_t)1, (size_t)block_usage, tmp_fd) != block_usage) part->flush_error = 1;
+			part->nbytes_written += block_usage;
+			block_usage = 0;
 		}
-		brz->size[h0] = (cmph_uint8)(brz->size[h0] + 1U);
-		buckets_size[h0] ++;
-		nkeys_in_buffer++;
-		mph->key_source->dispose(mph->key_source->data, key, keylen);
+		if (record_size > BRZ_WRITE_BLOCK)
+		{
+			if (fwrite(record, (size_t)1, (size_t)record_size, tmp_fd) != record_size) part->flush_error = 1;
+			part->nbytes_written += record_size;
+			continue;
+		}
+		memcpy(part->block + block_usage, record, (size_t)record_size);
+		block_usage += record_size;
+	}
+	if (fwrite(part->block, (size_t)1, (size_t)block_usage, tmp_fd) != block_usage) part->flush_error = 1;
+	part->nbytes_written += block_usage;
+	if (fclose(tmp_fd) != 0) part->flush_error = 1;
+	part->nflushes++;
+	free(keys_index);
+}
+
+static void brz_partition_task(void *arg, cmph_uint32 task)
+{
+	brz_partition_t *part = (brz_partition_t *)arg;
+	if (task == 0) brz_fill(part, &part->buffers[part->flushing ^ 1U]);
+	else brz_flush(part, &part->buffers[part->flushing]);
+}
+
+// Partitions the keys into sorted temporary files and sets nflushes to their
+// number. Returns BRZ_GEN_FAILED when a bucket gets too many keys and
+// BRZ_GEN_IO_ERROR when a file can not be written.
+static int brz_partition(cmph_config_t *mph, cmph_uint32 *nflushes)
+{
+	brz_config_data_t *brz = (brz_config_data_t *)mph->data;
+	cmph_uint32 pipelined = mph->nthreads > 1 && thread_pool_available();
+	cmph_uint32 i, cur = 0;
+	int status;
+	brz_partition_t part;
+
+	memset(&part, 0, sizeof(part));
+	part.mph = mph;
+	for (i = 0; i < 1U + pipelined; i++)
+	{
+		// two buffers share the memory given to one
+		part.buffers[i].capacity = brz->memory_availability >> pipelined;
+		part.buffers[i].buffer = (cmph_uint8 *)malloc((size_t)part.buffers[i].capacity);
 	}
-	if (memory_usage != 0) // flush buffers
+	part.buckets_size = (cmph_uint32 *)malloc(sizeof(cmph_uint32)*brz->k);
+	part.block = (cmph_uint8 *)malloc((size_t)BRZ_WRITE_BLOCK);
+	memset(brz->size, 0, sizeof(cmph_uint16)*brz->k);
+
+	mph->key_source->rewind(mph->key_source->data);
+	DEBUGP("Partitioning %llu keys\n", (unsigned long long)brz->m);
+	brz_fill(&part, &part.buffers[0]);
+	while (!part.fill_error && !part.flush_error && part.buffers[cur].nkeys > 0)
 	{
-		if(mph->verbosity)
+		if (pipelined)
 		{
-			fprintf(stderr, "Flushing  %u\n", nkeys_in_buffer);
+			part.flushing = cur;
+			thread_pool_run(2, 2, brz_partition_task, &part);
+			cur ^= 1U;
 		}
-		cmph_uint32 value = buckets_size[0];
-		cmph_uint32 sum = 0;
-		cmph_uint32 keylen1 = 0;
-		buckets_size[0]   = 0;
-		for(i = 1; i < brz->k; i++)
+		else
 		{
-			if(buckets_size[i] == 0) continue;
-			sum += value;
-			value = buckets_size[i];
-			buckets_size[i] = sum;
+			brz_flush(&part, &part.buffers[0]);
+			if (!part.flush_error) brz_fill(&part, &part.buffers[0]);
 		}
-		memory_usage = 0;
-		keys_index = (cmph_uint32 *)calloc((size_t)nkeys_in_buffer, sizeof(cmph_uint32));
-		for(i = 0; i < nkeys_in_buffer; i++)
+	}
+	status = part.flush_error ? BRZ_GEN_IO_ERROR : part.fill_error ? BRZ_GEN_FAILED : BRZ_GEN_OK;
+	*nflushes = part.nflushes;
+	mph->stats.tmp_bytes_written += part.nbytes_written;
+	if (part.key) __key_dispose(mph->key_source, part.key, part.keylen);
+	free(part.buffers[0].buffer);
+	free(part.buffers[1].buffer);
+	free(part.buckets_size);
+	free(part.block);
+	return status;
+}
+
+static cmph_uint32 brz_merge_fanin(void)
+{
+	cmph_uint32 fanin = BRZ_MAX_MERGED_RUNS;
+#ifndef WIN32
+	struct rlimit limit;
+	if (getrlimit(RLIMIT_NOFILE, &limit) == 0 && limit.rlim_cur != RLIM_INFINITY && limit.rlim_cur/2 < fanin)
+	{
+		fanin = (cmph_uint32)(limit.rlim_cur/2);
+	}
+#endif
+	return fanin < 2 ? 2 : fanin;
+}
+
+// Memory of the read buffers of a merge of nruns runs.
+static cmph_uint32 brz_merge_memory(brz_config_data_t *brz, cmph_uint32 nruns)
+{
+	cmph_uint64 memory = (cmph_uint64)nruns*BRZ_MIN_RUN_BUFFER;
+	return memory > brz->memory_availability ? (cmph_uint32)memory : brz->memory_availability;
+}
+
+// Merges the runs first to first + n - 1 into run out and removes them. The
+// keys of a bucket keep the order of their runs, as in the final merge, so
+// the merged run builds the same function. Returns 0 on failure.
+static int brz_merge_runs(brz_config_data_t *brz, cmph_uint32 first, cmph_uint32 n, cmph_uint32 out, cmph_uint64 *nbytes_written)
+{
+	buffer_manager_t *buff_manager = buffer_manager_new(brz_merge_memory(brz, n), n);
+	cmph_uint8 **heads = (cmph_uint8 **)calloc((size_t)n, sizeof(cmph_uint8 *));
+	cmph_uint32 *heads_h0 = (cmph_uint32 *)calloc((size_t)n, sizeof(cmph_uint32));
+	cmph_uint32 *runs_heap = (cmph_uint32 *)calloc((size_t)n, sizeof(cmph_uint32));
+	cmph_uint32 i, keylen, nruns = 0;
+	char *filename = brz_run_filename(brz, out);
+	FILE *out_fd = fopen(filename, "wb");
+	int ok = out_fd != NULL;
+
+	free(filename);
+	for (i = 0; ok && i < n; i++)
+	{
+		filename = brz_run_filename(brz, first + i);
+		ok = buffer_manager_open(buff_manager, i, filename);
+		free(filename);
+		if (!ok) break;
+		heads[i] = buffer_manager_read_key(buff_manager, i, &keylen, heads_h0 + i);
+		if (heads[i] == NULL) continue;
+		runs_heap[nruns++] = i;
+	}
+	if (ok) for (i = nruns/2; i-- > 0;) brz_heap_sift_down(runs_heap, nruns, i, heads_h0);
+	while (ok && nruns > 0)
+	{
+		i = runs_heap[0];
+		memcpy(&keylen, heads[i], sizeof(keylen));
+		if (fwrite(&keylen, sizeof(keylen), (size_t)1, out_fd) != 1 ||
+		    fwrite(heads_h0 + i, sizeof(cmph_uint32), (size_t)1, out_fd) != 1 ||
+		    fwrite(heads[i] + sizeof(keylen), (size_t)1, (size_t)keylen, out_fd) != keylen)
 		{
-			memcpy(&keylen1, buffer + memory_usage, sizeof(keylen1));
-			h0 = hash(brz->h0, (char *)(buffer + memory_usage + sizeof(keylen1)), keylen1) % brz->k;
-			keys_index[buckets_size[h0]] = memory_usage;
-			buckets_size[h0]++;
-			memory_usage +=  keylen1 + (cmph_uint32)sizeof(keylen1);
+			ok = 0;
 		}
-		filename = (char *)calloc(strlen((char *)(brz->tmp_dir)) + 11, sizeof(char));
-		sprintf(filename, "%s%u.cmph",brz->tmp_dir, nflushes);
-		tmp_fd = fopen(filename, "wb");
+		*nbytes_written += BRZ_RECORD_SIZE(keylen);
+		free(heads[i]);
+		heads[i] = buffer_manager_read_key(buff_manager, i, &keylen, heads_h0 + i);
+		if (heads[i] == NULL) runs_heap[0] = runs_heap[--nruns]; // run exhausted
+		brz_heap_sift_down(runs_heap, nruns, 0, heads_h0);
+	}
+	for (i = 0; i < n; i++) free(heads[i]);
+	buffer_manager_destroy(buff_manager);
+	if (out_fd && fclose(out_fd) != 0) ok = 0;
+	for (i = 0; i < n; i++)
+	{
+		filename = brz_run_filename(brz, first + i);
+		remove(filename);
 		free(filename);
-		filename = NULL;
-		for(i = 0; i < nkeys_in_buffer; i++)
+	}
+	free(heads);
+	free(heads_h0);
+	free(runs_heap);
+	return ok;
+}
+
+// Merges the runs in passes until the final merge can have all of them open
+// at once. Returns the number of runs left or UINT_MAX on failure.
+static cmph_uint32 brz_reduce_runs(cmph_config_t *mph, cmph_uint32 nruns)
+{
+	brz_config_data_t *brz = (brz_config_data_t *)mph->data;
+	cmph_uint32 fanin = brz_merge_fanin();
+	while (nruns > fanin)
+	{
+		cmph_uint32 first, n, nmerged = 0;
+		if (mph->verbosity)
 		{
-			memcpy(&keylen1, buffer + keys_index[i], sizeof(keylen1));
-			nbytes = fwrite(buffer + keys_index[i], (size_t)1, keylen1 + sizeof(keylen1), tmp_fd);
+			fprintf(stderr, "Merging %u runs in groups of %u\n", nruns, fanin);
 		}
-		nkeys_in_buffer = 0;
-		memory_usage = 0;
-		memset((void *)buckets_size, 0, brz->k*sizeof(cmph_uint32));
-		nflushes++;
-		free(keys_index);
-		fclose(tmp_fd);
+		for (first = 0; first < nruns; first += n, ++nmerged)
+		{
+			char *from, *to;
+			int ok;
+			n = nruns - first < fanin ? nruns - first : fanin;
+			// the merged run is written past the last run, then renamed to
+			// a run that has been merged already
+			if (n > 1 && !brz_merge_runs(brz, first, n, nruns, &mph->stats.tmp_bytes_written)) return UINT_MAX;
+			from = brz_run_filename(brz, n > 1 ? nruns : first);
+			to = brz_run_filename(brz, nmerged);
+			ok = strcmp(from, to) == 0 || rename(from, to) == 0;
+			free(from);
+			free(to);
+			if (!ok) return UINT_MAX;
+		}
+		nruns = nmerged;
+	}
+	return nruns;
+}
+
+// Generation of the functions of complete buckets, one task per bucket.
+#define BRZ_BUCKETS_PER_THREAD 64U
+
+typedef struct
+{
+	cmph_uint8 **keys; // room for the largest bucket
+	cmph_uint32 nkeys;
+	cmph_uint32 index;
+	char *bufmphf; // NULL when generation failed
+	cmph_uint32 buflen;
+} brz_bucket_t;
+
+typedef struct
+{
+	brz_config_data_t *brz;
+	brz_bucket_t *buckets;
+	cmph_uint32 nbuckets;
+	cmph_uint32 seed;	// the seeds of the buckets are derived from it
+} brz_build_job_t;
+
+static void brz_build_task(void *arg, cmph_uint32 task)
+{
+	brz_build_job_t *job = (brz_build_job_t *)arg;
+	brz_config_data_t *brz = job->brz;
+	brz_bucket_t *bucket = job->buckets + task;
+	cmph_io_adapter_t *source = NULL;
+	cmph_config_t *config = NULL;
+	cmph_t *mphf_tmp = NULL;
+	// Source of keys
+	source = cmph_io_byte_vector_adapter(bucket->keys, bucket->nkeys);
+	config = cmph_config_new(source);
+	config->untimed = 1;
+	config->seed = __seed_derive(job->seed, bucket->index); // rand() would depend on the scheduling of the threads
+	cmph_config_set_algo(config, brz->algo);
+	cmph_config_set_hashfuncs(config, brz->hashfuncs);
+	cmph_config_set_graphsize(config, brz->c);
+	mphf_tmp = cmph_new(config);
+	bucket->bufmphf = NULL;
+	if (mphf_tmp)
+	{
+		switch(brz->algo)
+		{
+			case CMPH_FCH:
+				bucket->bufmphf = brz_copy_partial_fch_mphf(brz, (fch_data_t *)mphf_tmp->data, bucket->index, &bucket->buflen);
+				break;
+			case CMPH_BMZ8:
+				bucket->bufmphf = brz_copy_partial_bmz8_mphf(brz, (bmz8_data_t *)mphf_tmp->data, bucket->index, &bucket->buflen);
+				break;
+			case CMPH_BDZ:
+			case CMPH_CHD:
+				bucket->bufmphf = brz_copy_packed_mphf(mphf_tmp, &bucket->buflen);
+				break;
+			default: assert(0);
+		}
+		cmph_destroy(mphf_tmp);
 	}
+	cmph_config_destroy(config);
+	brz_destroy_keys_vd(bucket->keys, bucket->nkeys);
+	cmph_io_byte_vector_adapter_destroy(source);
+}
+
+static int brz_gen_mphf(cmph_config_t *mph)
+{
+	cmph_uint32 i, j;
+	cmph_uint64 e;
+	brz_config_data_t *brz = (brz_config_data_t *)mph->data;
+	cmph_uint8 **buffer_merge = NULL;
+	cmph_uint32 *buffer_h0 = NULL;
+	cmph_uint32 *runs_heap = NULL;
+	cmph_uint32 nruns = 0;
+	cmph_uint32 nflushes = 0;
+	cmph_uint32 h0;
+	buffer_manager_t * buff_manager = NULL;
+	char *filename = NULL;
+	char *key = NULL;
+	cmph_uint32 keylen;
+	cmph_uint32 cur_bucket = 0;
+	cmph_uint32 nkeys_vd = 0, max_size = 0;
+	cmph_uint8 ** keys_vd = NULL;
+	cmph_uint32 nbatch;
+	brz_build_job_t job;
+	cmph_uint64 nbytes_written = mph->stats.tmp_bytes_written;
+	int status;
 
-	free(buffer);
-	free(buckets_size);
-	if(nflushes > 1024) return 0; // Too many files generated.
+	// Partitioning
+	__config_phase(mph, CMPH_PHASE_HASHING);
+	status = brz_partition(mph, &nflushes);
+	if (status != BRZ_GEN_OK) return status;
+	nflushes = brz_reduce_runs(mph, nflushes);
+	if (nflushes == UINT_MAX) return BRZ_GEN_IO_ERROR;
+	// Merging the runs and generating the functions of the buckets
+	__config_phase(mph, CMPH_PHASE_SEARCHING);
 	// mphf generation
 	if(mph->verbosity)
 	{
 		fprintf(stderr, "\nMPHF generation \n");
 	}
 	/* Starting to dump to disk the resulting MPHF: __cmph_dump function */
-	nbytes = fwrite(cmph_names[CMPH_BRZ], (size_t)(strlen(cmph_names[CMPH_BRZ]) + 1), (size_t)1, brz->mphf_fd);
-	nbytes = fwrite(&(brz->m), sizeof(brz->m), (size_t)1, brz->mphf_fd);
-	nbytes = fwrite(&(brz->c), sizeof(double), (size_t)1, brz->mphf_fd);
-	nbytes = fwrite(&(brz->algo), sizeof(brz->algo), (size_t)1, brz->mphf_fd);
-	nbytes = fwrite(&(brz->k), sizeof(cmph_uint32), (size_t)1, brz->mphf_fd); // number of MPHFs
-	nbytes = fwrite(brz->size, sizeof(cmph_uint8)*(brz->k), (size_t)1, brz->mphf_fd);
+	if (!__cmph_dump_header(CMPH_BRZ, CMPH_VERSION_FASTRANGE, brz->m, brz->mphf_fd) ||
+	    fwrite(&(brz->c), sizeof(double), (size_t)1, brz->mphf_fd) != 1 ||
+	    fwrite(&(brz->algo), sizeof(brz->algo), (size_t)1, brz->mphf_fd) != 1 ||
+	    fwrite(&(brz->k), sizeof(cmph_uint32), (size_t)1, brz->mphf_fd) != 1 || // number of MPHFs
+	    !brz_dump_size(brz->algo, brz->size, brz->k, brz->mphf_fd))
+	{
+		if (mph->verbosity) fprintf(stderr, "Unable to write the MPHF\n");
+		return BRZ_GEN_IO_ERROR;
+	}
 
 	//tmp_fds = (FILE **)calloc(nflushes, sizeof(FILE *));
-	buff_manager = buffer_manager_new(brz->memory_availability, nflushes);
+	buff_manager = buffer_manager_new(brz_merge_memory(brz, nflushes), nflushes);
 	buffer_merge = (cmph_uint8 **)calloc((size_t)nflushes, sizeof(cmph_uint8 *));
 	buffer_h0    = (cmph_uint32 *)calloc((size_t)nflushes, sizeof(cmph_uint32));
+	runs_heap    = (cmph_uint32 *)calloc((size_t)nflushes, sizeof(cmph_uint32));
 
-	memory_usage = 0;
 	for(i = 0; i < nflushes; i++)
 	{
-		filename = (char *)calloc(strlen((char *)(brz->tmp_dir)) + 11, sizeof(char));
-		sprintf(filename, "%s%u.cmph",brz->tmp_dir, i);
-		buffer_manager_open(buff_manager, i, filename);
+		filename = brz_run_filename(brz, i);
+		key = NULL;
+		if (buffer_manager_open(buff_manager, i, filename)) key = (char *)buffer_manager_read_key(buff_manager, i, &keylen, buffer_h0 + i);
+		if (key == NULL)
+		{
+			if (mph->verbosity) fprintf(stderr, "Unable to read the temporary file %s\n", filename);
+			free(filename);
+			for (j = 0; j < i; j++) free(buffer_merge[j]);
+			buffer_manager_destroy(buff_manager);
+			free(buffer_merge);
+			free(buffer_h0);
+			free(runs_heap);
+			return BRZ_GEN_IO_ERROR;
+		}
 		free(filename);
 		filename = NULL;
-		key = (char *)buffer_manager_read_key(buff_manager, i, &keylen);
-		h0 = hash(brz->h0, key+sizeof(keylen), keylen) % brz->k;
-		buffer_h0[i] = h0;
                 buffer_merge[i] = (cmph_uint8 *)key;
                 key = NULL; //transfer memory ownership
+		runs_heap[i] = i;
 	}
+	// The runs are merged through a binary heap of run heads keyed by
+	// the bucket of the head, computed once when the key is read.
+	nruns = nflushes;
+	for(i = nruns/2; i-- > 0;) brz_heap_sift_down(runs_heap, nruns, i, buffer_h0);
 	e = 0;
-	keys_vd = (cmph_uint8 **)calloc((size_t)MAX_BUCKET_SIZE, sizeof(cmph_uint8 *));
+	// With more threads complete buckets are gathered and built together,
+	// then written in bucket order.
+	nbatch = mph->nthreads > 1 ? BRZ_BUCKETS_PER_THREAD*mph->nthreads : 1;
+	job.brz = brz;
+	job.seed = mph->seed ? __seed_derive(mph->seed, mph->nseeds++) : (cmph_uint32)rand();
+	job.buckets = (brz_bucket_t *)calloc((size_t)nbatch, sizeof(brz_bucket_t));
+	for(i = 0; i < brz->k; i++) if (brz->size[i] > max_size) max_size = brz->size[i];
+	for(i = 0; i < nbatch; i++) job.buckets[i].keys = (cmph_uint8 **)calloc((size_t)max_size, sizeof(cmph_uint8 *));
+	job.nbuckets = 0;
+	keys_vd = job.buckets[0].keys;
 	nkeys_vd = 0;
-	error = 0;
-	while(e < brz->m)
+	status = BRZ_GEN_OK;
+	while(e < brz->m && nruns > 0)
 	{
-		i = brz_min_index(buffer_h0, nflushes);
+		i = runs_heap[0];
 		cur_bucket = buffer_h0[i];
-		key = (char *)buffer_manager_read_key(buff_manager, i, &keylen);
-		if(key)
-		{
-			while(key)
-			{
-				//keylen = strlen(key);
-				h0 = hash(brz->h0, key+sizeof(keylen), keylen) % brz->k;
-				if (h0 != buffer_h0[i]) break;
-				keys_vd[nkeys_vd++] = (cmph_uint8 *)key;
-				key = NULL; //transfer memory ownership
-				e++;
-				key = (char *)buffer_manager_read_key(buff_manager, i, &keylen);
-			}
-			if (key)
-			{
-				assert(nkeys_vd < brz->size[cur_bucket]);
-				keys_vd[nkeys_vd++] = buffer_merge[i];
-				buffer_merge[i] = NULL; //transfer memory ownership
-				e++;
-				buffer_h0[i] = h0;
-				buffer_merge[i] = (cmph_uint8 *)key;
-			}
-		}
-		if(!key)
+		// the head of the run, then the keys that follow it in the same bucket
+		assert(nkeys_vd < brz->size[cur_bucket]);
+		keys_vd[nkeys_vd++] = buffer_merge[i];
+		buffer_merge[i] = NULL; //transfer memory ownership
+		e++;
+		key = (char *)buffer_manager_read_key(buff_manager, i, &keylen, &h0);
+		while(key && h0 == cur_bucket)
 		{
 			assert(nkeys_vd < brz->size[cur_bucket]);
-			keys_vd[nkeys_vd++] = buffer_merge[i];
-			buffer_merge[i] = NULL; //transfer memory ownership
+			keys_vd[nkeys_vd++] = (cmph_uint8 *)key;
+			key = NULL; //transfer memory ownership
 			e++;
+			key = (char *)buffer_manager_read_key(buff_manager, i, &keylen, &h0);
+		}
+		buffer_merge[i] = (cmph_uint8 *)key;
+		if (key) buffer_h0[i] = h0;
+		else
+		{
 			buffer_h0[i] = UINT_MAX;
+			runs_heap[0] = runs_heap[--nruns]; // run exhausted
 		}
+		brz_heap_sift_down(runs_heap, nruns, 0, buffer_h0);
 
 		if(nkeys_vd == brz->size[cur_bucket]) // Generating mphf for each bucket.
 		{
-			cmph_io_adapter_t *source = NULL;
-			cmph_config_t *config = NULL;
-			cmph_t *mphf_tmp = NULL;
-			char *bufmphf = NULL;
-			cmph_uint32 buflenmphf = 0;
-			// Source of keys
-			source = cmph_io_byte_vector_adapter(keys_vd, (cmph_uint32)nkeys_vd);
-			config = cmph_config_new(source);
-			cmph_config_set_algo(config, brz->algo);
-			cmph_config_set_hashfuncs(config, brz->hashfuncs);
-			cmph_config_set_graphsize(config, brz->c);
-			mphf_tmp = cmph_new(config);
-			if (mphf_tmp == NULL)
-			{
-				if(mph->verbosity) fprintf(stderr, "ERROR: Can't generate MPHF for bucket %u out of %u\n", cur_bucket + 1, brz->k);
-				error = 1;
-				cmph_config_destroy(config);
- 				brz_destroy_keys_vd(keys_vd, nkeys_vd);
-				cmph_io_byte_vector_adapter_destroy(source);
-				break;
-			}
-			if(mph->verbosity)
+			job.buckets[job.nbuckets].nkeys = nkeys_vd;
+			job.buckets[job.nbuckets].index = cur_bucket;
+			job.nbuckets++;
+			if(job.nbuckets == nbatch || e == brz->m)
 			{
-			  if (cur_bucket % 1000 == 0)
-  			  {
-			  	fprintf(stderr, "MPHF for bucket %u out of %u was generated.\n", cur_bucket + 1, brz->k);
-			  }
-			}
-			switch(brz->algo)
-			{
-				case CMPH_FCH:
+				thread_pool_run(mph->nthreads, job.nbuckets, brz_build_task, &job);
+				for(i = 0; i < job.nbuckets; i++)
 				{
-					fch_data_t * fchf = NULL;
-					fchf = (fch_data_t *)mphf_tmp->data;
-					bufmphf = brz_copy_partial_fch_mphf(brz, fchf, cur_bucket, &buflenmphf);
+					brz_bucket_t *bucket = job.buckets + i;
+					if (bucket->bufmphf == NULL)
+					{
+						if(mph->verbosity) fprintf(stderr, "ERROR: Can't generate MPHF for bucket %u out of %u\n", bucket->index + 1, brz->k);
+						status = BRZ_GEN_FAILED;
+						continue;
+					}
+					if(mph->verbosity)
+					{
+					  if (bucket->index % 1000 == 0)
+		  			  {
+					  	fprintf(stderr, "MPHF for bucket %u out of %u was generated.\n", bucket->index + 1, brz->k);
+					  }
+					}
+					if(status == BRZ_GEN_OK && fwrite(bucket->bufmphf, (size_t)bucket->buflen, (size_t)1, brz->mphf_fd) != 1)
+					{
+						if(mph->verbosity) fprintf(stderr, "Unable to write the MPHF\n");
+						status = BRZ_GEN_IO_ERROR;
+					}
+					free(bucket->bufmphf);
+					bucket->bufmphf = NULL;
 				}
-					break;
-				case CMPH_BMZ8:
-				{
-					bmz8_data_t * bmzf = NULL;
-					bmzf = (bmz8_data_t *)mphf_tmp->data;
-					bufmphf = brz_copy_partial_bmz8_mphf(brz, bmzf, cur_bucket,  &buflenmphf);
-				}
-					break;
-				default: assert(0);
+				job.nbuckets = 0;
+				if (status != BRZ_GEN_OK) break;
 			}
-		        nbytes = fwrite(bufmphf, (size_t)buflenmphf, (size_t)1, brz->mphf_fd);
-			free(bufmphf);
-			bufmphf = NULL;
-			cmph_config_destroy(config);
- 			brz_destroy_keys_vd(keys_vd, nkeys_vd);
-			cmph_destroy(mphf_tmp);
-			cmph_io_byte_vector_adapter_destroy(source);
+			keys_vd = job.buckets[job.nbuckets].keys;
 			nkeys_vd = 0;
 		}
 	}
 	buffer_manager_destroy(buff_manager);
-	free(keys_vd);
+	for(i = 0; i < nbatch; i++) free(job.buckets[i].keys);
+	free(job.buckets);
 	free(buffer_merge);
 	free(buffer_h0);
-	if (error) return 0;
-	return 1;
+	free(runs_heap);
+	// runs cut short by a failed read run out before all the keys are read
+	if (status == BRZ_GEN_OK && e < brz->m) status = BRZ_GEN_IO_ERROR;
+	if (status != BRZ_GEN_OK) return status;
+	// a complete merge has read back every run
+	mph->stats.tmp_bytes_read += mph->stats.tmp_bytes_written - nbytes_written;
+	return BRZ_GEN_OK;
 }
 
-static cmph_uint32 brz_min_index(cmph_uint32 * vector, cmph_uint32 n)
+// Orders the runs by the bucket of their head key, the lowest run first
+// among equal buckets, so the merge visits the runs in a fixed order.
+#define BRZ_RUN_LESS(vector, a, b) ((vector)[a] < (vector)[b] || ((vector)[a] == (vector)[b] && (a) < (b)))
+
+// Restores the min-heap of run indices below pos after vector[heap[pos]] grew.
+static void brz_heap_sift_down(cmph_uint32 * heap, cmph_uint32 n, cmph_uint32 pos, cmph_uint32 * vector)
 {
-	cmph_uint32 i, min_index = 0;
-	for(i = 1; i < n; i++)
+	cmph_uint32 run = heap[pos];
+	while(2*pos + 1 < n)
 	{
-		if(vector[i] < vector[min_index]) min_index = i;
+		cmph_uint32 child = 2*pos + 1;
+		if(child + 1 < n && BRZ_RUN_LESS(vector, heap[child + 1], heap[child])) child++;
+		if(!BRZ_RUN_LESS(vector, heap[child], run)) break;
+		heap[pos] = heap[child];
+		pos = child;
 	}
-	return min_index;
+	heap[pos] = run;
 }
 
 static void brz_destroy_keys_vd(cmph_uint8 ** keys_vd, cmph_uint32 nkeys)
 {
-	cmph_uint8 i;
+	cmph_uint32 i;
 	for(i = 0; i < nkeys; i++) { free(keys_vd[i]); keys_vd[i] = NULL;}
 }
 
@@ -558,76 +895,184 @@ static char * brz_copy_partial_bmz8_mphf(brz_config_data_t *brz, bmz8_data_t * b
 	char * buf   = NULL;
 	cmph_uint32 n = (cmph_uint32)ceil(brz->c * brz->size[index]);
 	hash_state_dump(bmzf->hashes[0], &bufh1, &buflenh1);
-	hash_state_dump(bmzf->hashes[1], &bufh2, &buflenh2);
+	// a missing second state (single pass hashing) is dumped with zero bytes
+	if (bmzf->hashes[1]) hash_state_dump(bmzf->hashes[1], &bufh2, &buflenh2);
 	*buflen = buflenh1 + buflenh2 + n + 2U * (cmph_uint32)sizeof(cmph_uint32);
 	buf = (char *)malloc((size_t)(*buflen));
 	memcpy(buf, &buflenh1, sizeof(cmph_uint32));
 	memcpy(buf+sizeof(cmph_uint32), bufh1, (size_t)buflenh1);
 	memcpy(buf+sizeof(cmph_uint32)+buflenh1, &buflenh2, sizeof(cmph_uint32));
-	memcpy(buf+2*sizeof(cmph_uint32)+buflenh1, bufh2, (size_t)buflenh2);
+	if (buflenh2) memcpy(buf+2*sizeof(cmph_uint32)+buflenh1, bufh2, (size_t)buflenh2);
 	memcpy(buf+2*sizeof(cmph_uint32)+buflenh1+buflenh2,bmzf->g, (size_t)n);
 	free(bufh1);
 	free(bufh2);
 	return buf;
 }
 
+// BDZ and CHD buckets are stored as their packed function, after its size.
+static char * brz_copy_packed_mphf(cmph_t * mphf, cmph_uint32 *buflen)
+{
+	cmph_uint32 size = cmph_packed_size(mphf);
+	char * buf = (char *)malloc((size_t)size + sizeof(cmph_uint32));
+	memcpy(buf, &size, sizeof(cmph_uint32));
+	cmph_pack(mphf, buf + sizeof(cmph_uint32));
+	*buflen = size + (cmph_uint32)sizeof(cmph_uint32);
+	return buf;
+}
+
+// Bucket sizes are 8-bit wide on disk unless the buckets are BDZ or CHD functions.
+// Returns 0 on a short write.
+static int brz_dump_size(CMPH_ALGO algo, cmph_uint16 * size, cmph_uint32 k, FILE * fd)
+{
+	int ok;
+	if (BRZ_PACKED_BUCKETS(algo))
+	{
+		ok = fwrite(size, sizeof(cmph_uint16)*k, (size_t)1, fd) == 1;
+	}
+	else
+	{
+		cmph_uint32 i;
+		cmph_uint8 *size8 = (cmph_uint8 *)malloc(sizeof(cmph_uint8)*k);
+		for (i = 0; i < k; i++) size8[i] = (cmph_uint8)size[i];
+		ok = fwrite(size8, sizeof(cmph_uint8)*k, (size_t)1, fd) == 1;
+		free(size8);
+	}
+	return ok;
+}
+
+// Returns NULL on a short read.
+static cmph_uint16 * brz_load_size(CMPH_ALGO algo, cmph_uint32 k, FILE * fd)
+{
+	int ok;
+	cmph_uint16 *size = (cmph_uint16 *)malloc(sizeof(cmph_uint16)*k);
+	if (BRZ_PACKED_BUCKETS(algo))
+	{
+		ok = fread(size, sizeof(cmph_uint16)*k, (size_t)1, fd) == 1;
+	}
+	else
+	{
+		cmph_uint32 i;
+		cmph_uint8 *size8 = (cmph_uint8 *)malloc(sizeof(cmph_uint8)*k);
+		ok = fread(size8, sizeof(cmph_uint8)*k, (size_t)1, fd) == 1;
+		for (i = 0; ok && i < k; i++) size[i] = size8[i];
+		free(size8);
+	}
+	if (!ok)
+	{
+		free(size);
+		return NULL;
+	}
+	return size;
+}
 
 int brz_dump(cmph_t *mphf, FILE *fd)
 {
 	brz_data_t *data = (brz_data_t *)mphf->data;
 	char *buf = NULL;
 	cmph_uint32 buflen;
-	register size_t nbytes;
+	int ok;
 	DEBUGP("Dumping brzf\n");
 	// The initial part of the MPHF has already been dumped to disk during construction
 	// Dumping h0
         hash_state_dump(data->h0, &buf, &buflen);
         DEBUGP("Dumping hash state with %u bytes to disk\n", buflen);
-        nbytes = fwrite(&buflen, sizeof(cmph_uint32), (size_t)1, fd);
-        nbytes = fwrite(buf, (size_t)buflen, (size_t)1, fd);
+        ok = fwrite(&buflen, sizeof(cmph_uint32), (size_t)1, fd) == 1 &&
+             fwrite(buf, (size_t)buflen, (size_t)1, fd) == 1;
         free(buf);
-	// Dumping m and the vector offset.
-	nbytes = fwrite(&(data->m), sizeof(cmph_uint32), (size_t)1, fd);
-	nbytes = fwrite(data->offset, sizeof(cmph_uint32)*(data->k), (size_t)1, fd);
-	return 1;
+	if (!ok) return 0;
+	// Dumping m and the vector offset, with 32-bit entries unless m does not fit in them.
+	if (data->m >= CMPH_SIZE64_FLAG)
+	{
+		ok = fwrite(&(data->m), sizeof(cmph_uint64), (size_t)1, fd) == 1 &&
+		     fwrite(data->offset, sizeof(cmph_uint64)*(data->k), (size_t)1, fd) == 1;
+	}
+	else
+	{
+		cmph_uint32 i, m = (cmph_uint32)data->m;
+		cmph_uint32 *offset = (cmph_uint32 *)malloc(sizeof(cmph_uint32)*data->k);
+		for (i = 0; i < data->k; i++) offset[i] = (cmph_uint32)data->offset[i];
+		ok = fwrite(&m, sizeof(cmph_uint32), (size_t)1, fd) == 1 &&
+		     fwrite(offset, sizeof(cmph_uint32)*(data->k), (size_t)1, fd) == 1;
+		free(offset);
+	}
+	return ok;
 }
 
-void brz_load(FILE *f, cmph_t *mphf)
+// Reads a hash state dumped as its length and bytes, NULL when the length
+// is 0. Returns 0 on a short read.
+static int brz_load_hash_state(FILE *f, hash_state_t **state)
 {
-	char *buf = NULL;
 	cmph_uint32 buflen;
-	register size_t nbytes;
+	char *buf;
+	*state = NULL;
+	if (fread(&buflen, sizeof(cmph_uint32), (size_t)1, f) != 1) return 0;
+	DEBUGP("Hash state has %u bytes\n", buflen);
+	if (buflen == 0) return 1;
+	buf = (char *)malloc((size_t)buflen);
+	if (fread(buf, (size_t)buflen, (size_t)1, f) == 1) *state = hash_state_load(buf, buflen);
+	free(buf);
+	return *state != NULL;
+}
+
+static void brz_data_destroy(brz_data_t *data)
+{
+	cmph_uint32 i;
+	if(data->g)
+	{
+		for(i = 0; i < data->k; i++)
+		{
+			free(data->g[i]);
+			hash_state_destroy(data->h1[i]);
+			hash_state_destroy(data->h2[i]);
+		}
+		free(data->g);
+		free(data->h1);
+		free(data->h2);
+	}
+	hash_state_destroy(data->h0);
+	free(data->g_size);
+	free(data->size);
+	free(data->offset);
+	free(data);
+}
+
+int brz_load(FILE *f, cmph_t *mphf)
+{
 	cmph_uint32 i, n;
-	brz_data_t *brz = (brz_data_t *)malloc(sizeof(brz_data_t));
+	brz_data_t *brz = (brz_data_t *)calloc((size_t)1, sizeof(brz_data_t));
 
 	DEBUGP("Loading brz mphf\n");
 	mphf->data = brz;
-	nbytes = fread(&(brz->c), sizeof(double), (size_t)1, f);
-	nbytes = fread(&(brz->algo), sizeof(brz->algo), (size_t)1, f); // Reading algo.
-	nbytes = fread(&(brz->k), sizeof(cmph_uint32), (size_t)1, f);
-	brz->size   = (cmph_uint8 *) malloc(sizeof(cmph_uint8)*brz->k);
-	nbytes = fread(brz->size, sizeof(cmph_uint8)*(brz->k), (size_t)1, f);
-	brz->h1 = (hash_state_t **)malloc(sizeof(hash_state_t *)*brz->k);
-	brz->h2 = (hash_state_t **)malloc(sizeof(hash_state_t *)*brz->k);
+	if (fread(&(brz->c), sizeof(double), (size_t)1, f) != 1 ||
+	    fread(&(brz->algo), sizeof(brz->algo), (size_t)1, f) != 1 || // Reading algo.
+	    fread(&(brz->k), sizeof(cmph_uint32), (size_t)1, f) != 1)
+	{
+		goto fail;
+	}
+	brz->size   = brz_load_size(brz->algo, brz->k, f);
+	if (brz->size == NULL) goto fail;
+	brz->h1 = (hash_state_t **)calloc((size_t)brz->k, sizeof(hash_state_t *));
+	brz->h2 = (hash_state_t **)calloc((size_t)brz->k, sizeof(hash_state_t *));
 	brz->g  = (cmph_uint8 **)  calloc((size_t)brz->k, sizeof(cmph_uint8 *));
 	DEBUGP("Reading c = %f   k = %u   algo = %u \n", brz->c, brz->k, brz->algo);
+	if (BRZ_PACKED_BUCKETS(brz->algo))
+	{
+		//loading the packed function of each bucket.
+		brz->g_size = (cmph_uint32 *)calloc((size_t)brz->k, sizeof(cmph_uint32));
+		for(i = 0; i < brz->k; i++)
+		{
+			if (fread(&(brz->g_size[i]), sizeof(cmph_uint32), (size_t)1, f) != 1) goto fail;
+			DEBUGP("g_i has %u bytes\n", brz->g_size[i]);
+			brz->g[i] = (cmph_uint8 *)malloc((size_t)brz->g_size[i]);
+			if (fread(brz->g[i], (size_t)brz->g_size[i], (size_t)1, f) != 1) goto fail;
+		}
+	}
 	//loading h_i1, h_i2 and g_i.
-	for(i = 0; i < brz->k; i++)
+	else for(i = 0; i < brz->k; i++)
 	{
-		// h1
-		nbytes = fread(&buflen, sizeof(cmph_uint32), (size_t)1, f);
-		DEBUGP("Hash state 1 has %u bytes\n", buflen);
-		buf = (char *)malloc((size_t)buflen);
-		nbytes = fread(buf, (size_t)buflen, (size_t)1, f);
-		brz->h1[i] = hash_state_load(buf, buflen);
-		free(buf);
-		//h2
-		nbytes = fread(&buflen, sizeof(cmph_uint32), (size_t)1, f);
-		DEBUGP("Hash state 2 has %u bytes\n", buflen);
-		buf = (char *)malloc((size_t)buflen);
-		nbytes = fread(buf, (size_t)buflen, (size_t)1, f);
-		brz->h2[i] = hash_state_load(buf, buflen);
-		free(buf);
+		// h1, and h2 unless a single hash function gives both values
+		if (!brz_load_hash_state(f, brz->h1 + i) || brz->h1[i] == NULL) goto fail;
+		if (!brz_load_hash_state(f, brz->h2 + i)) goto fail;
 		switch(brz->algo)
 		{
 			case CMPH_FCH:
@@ -640,98 +1085,163 @@ void brz_load(FILE *f, cmph_t *mphf)
 		}
 		DEBUGP("g_i has %u bytes\n", n);
 		brz->g[i] = (cmph_uint8 *)calloc((size_t)n, sizeof(cmph_uint8));
-		nbytes = fread(brz->g[i], sizeof(cmph_uint8)*n, (size_t)1, f);
+		if (n > 0 && fread(brz->g[i], sizeof(cmph_uint8)*n, (size_t)1, f) != 1) goto fail;
 	}
 	//loading h0
-	nbytes = fread(&buflen, sizeof(cmph_uint32), (size_t)1, f);
-	DEBUGP("Hash state has %u bytes\n", buflen);
-	buf = (char *)malloc((size_t)buflen);
-	nbytes = fread(buf, (size_t)buflen, (size_t)1, f);
-	brz->h0 = hash_state_load(buf, buflen);
-	free(buf);
+	if (!brz_load_hash_state(f, &brz->h0) || brz->h0 == NULL) goto fail;
 
 	//loading c, m, and the vector offset.
-	nbytes = fread(&(brz->m), sizeof(cmph_uint32), (size_t)1, f);
-	brz->offset = (cmph_uint32 *)malloc(sizeof(cmph_uint32)*brz->k);
-	nbytes = fread(brz->offset, sizeof(cmph_uint32)*(brz->k), (size_t)1, f);
-	return;
+	brz->offset = (cmph_uint64 *)malloc(sizeof(cmph_uint64)*brz->k);
+	if (mphf->size >= CMPH_SIZE64_FLAG)
+	{
+		if (fread(&(brz->m), sizeof(cmph_uint64), (size_t)1, f) != 1 ||
+		    fread(brz->offset, sizeof(cmph_uint64)*(brz->k), (size_t)1, f) != 1)
+		{
+			goto fail;
+		}
+	}
+	else
+	{
+		cmph_uint32 m;
+		cmph_uint32 *offset = (cmph_uint32 *)malloc(sizeof(cmph_uint32)*brz->k);
+		if (fread(&m, sizeof(cmph_uint32), (size_t)1, f) != 1 ||
+		    fread(offset, sizeof(cmph_uint32)*(brz->k), (size_t)1, f) != 1)
+		{
+			free(offset);
+			goto fail;
+		}
+		brz->m = m;
+		for (i = 0; i < brz->k; i++) brz->offset[i] = offset[i];
+		free(offset);
+	}
+	return 1;
+fail:
+	DEBUGP("Short read loading brz mphf\n");
+	brz_data_destroy(brz);
+	mphf->data = NULL;
+	return 0;
 }
 
-static cmph_uint32 brz_bmz8_search(brz_data_t *brz, const char *key, cmph_uint32 keylen, cmph_uint32 * fingerprint)
+static cmph_uint64 brz_bmz8_search(brz_data_t *brz, cmph_uint32 fastrange, const char *key, cmph_uint32 keylen, cmph_uint32 * fingerprint)
 {
 	register cmph_uint32 h0;
 
 	hash_vector(brz->h0, key, keylen, fingerprint);
-	h0 = fingerprint[2] % brz->k;
+	h0 = RANGE(fingerprint[2], brz->k, fastrange);
 
 	register cmph_uint32 m = brz->size[h0];
 	register cmph_uint32 n = (cmph_uint32)ceil(brz->c * m);
-	register cmph_uint32 h1 = hash(brz->h1[h0], key, keylen) % n;
-	register cmph_uint32 h2 = hash(brz->h2[h0], key, keylen) % n;
+	cmph_uint32 hp[2];
+	hash_pair(brz->h1[h0], brz->h2[h0], key, keylen, hp);
+	register cmph_uint32 h1 = hp[0] % n;
+	register cmph_uint32 h2 = hp[1] % n;
 	register cmph_uint8 mphf_bucket;
 
 	if (h1 == h2 && ++h2 >= n) h2 = 0;
 	mphf_bucket = (cmph_uint8)(brz->g[h0][h1] + brz->g[h0][h2]);
 	DEBUGP("key: %s h1: %u h2: %u h0: %u\n", key, h1, h2, h0);
-	DEBUGP("key: %s g[h1]: %u g[h2]: %u offset[h0]: %u edges: %u\n", key, brz->g[h0][h1], brz->g[h0][h2], brz->offset[h0], brz->m);
-	DEBUGP("Address: %u\n", mphf_bucket + brz->offset[h0]);
+	DEBUGP("key: %s g[h1]: %u g[h2]: %u offset[h0]: %llu\n", key, brz->g[h0][h1], brz->g[h0][h2], (unsigned long long)brz->offset[h0]);
 	return (mphf_bucket + brz->offset[h0]);
 }
 
-static cmph_uint32 brz_fch_search(brz_data_t *brz, const char *key, cmph_uint32 keylen, cmph_uint32 * fingerprint)
+static cmph_uint64 brz_fch_search(brz_data_t *brz, cmph_uint32 fastrange, const char *key, cmph_uint32 keylen, cmph_uint32 * fingerprint)
 {
 	register cmph_uint32 h0;
 
 	hash_vector(brz->h0, key, keylen, fingerprint);
-	h0 = fingerprint[2] % brz->k;
+	h0 = RANGE(fingerprint[2], brz->k, fastrange);
 
 	register cmph_uint32 m = brz->size[h0];
 	register cmph_uint32 b = fch_calc_b(brz->c, m);
 	register double p1 = fch_calc_p1(m);
 	register double p2 = fch_calc_p2(b);
-	register cmph_uint32 h1 = hash(brz->h1[h0], key, keylen) % m;
-	register cmph_uint32 h2 = hash(brz->h2[h0], key, keylen) % m;
+	register cmph_uint32 h1 = RANGE(hash(brz->h1[h0], key, keylen), m, fastrange);
+	register cmph_uint32 h2 = RANGE(hash(brz->h2[h0], key, keylen), m, fastrange);
 	register cmph_uint8 mphf_bucket = 0;
 	h1 = mixh10h11h12(b, p1, p2, h1);
-	mphf_bucket = (cmph_uint8)((h2 + brz->g[h0][h1]) % m);
+	mphf_bucket = (cmph_uint8)fch_displace(h2, brz->g[h0][h1], m);
 	return (mphf_bucket + brz->offset[h0]);
 }
 
+static cmph_uint64 brz_cmph_search(brz_data_t *brz, cmph_uint32 fastrange, const char *key, cmph_uint32 keylen, cmph_uint32 * fingerprint)
+{
+	register cmph_uint32 h0;
+
+	hash_vector(brz->h0, key, keylen, fingerprint);
+	h0 = RANGE(fingerprint[2], brz->k, fastrange);
+	return (cmph_search_packed(brz->g[h0], key, keylen) + brz->offset[h0]);
+}
+
 cmph_uint32 brz_search(cmph_t *mphf, const char *key, cmph_uint32 keylen)
+{
+	return (cmph_uint32)brz_search64(mphf, key, keylen);
+}
+
+cmph_uint64 brz_search64(cmph_t *mphf, const char *key, cmph_uint32 keylen)
 {
 	brz_data_t *brz = (brz_data_t *)mphf->data;
 	cmph_uint32 fingerprint[3];
 	switch(brz->algo)
 	{
 		case CMPH_FCH:
-			return brz_fch_search(brz, key, keylen, fingerprint);
+			return brz_fch_search(brz, mphf->version, key, keylen, fingerprint);
 		case CMPH_BMZ8:
-			return brz_bmz8_search(brz, key, keylen, fingerprint);
+			return brz_bmz8_search(brz, mphf->version, key, keylen, fingerprint);
+		case CMPH_BDZ:
+		case CMPH_CHD:
+			return brz_cmph_search(brz, mphf->version, key, keylen, fingerprint);
 		default: assert(0);
 	}
 	return 0;
 }
 void brz_destroy(cmph_t *mphf)
 {
-	cmph_uint32 i;
+	brz_data_destroy((brz_data_t *)mphf->data);
+	free(mphf);
+}
+
+// Packed layout with BDZ or CHD buckets: algo, h0 type, h0, k, the k 32-bit
+// offsets, the k positions of the bucket functions from the start of their
+// positions table, then the packed bucket functions, each padded to 4 bytes.
+#define BRZ_PAD4(n) (((n) + 3U) & ~3U)
+
+static void brz_cmph_pack(cmph_t *mphf, cmph_uint8 *ptr)
+{
 	brz_data_t *data = (brz_data_t *)mphf->data;
-	if(data->g)
+	CMPH_HASH h0_type = hash_get_type(data->h0);
+	cmph_uint32 h0_word = h0_type | (mphf->version ? CMPH_PACKED_FASTRANGE : 0);
+	cmph_uint32 i, *g_is_ptr;
+	cmph_uint8 *g_i;
+
+	memcpy(ptr, &(data->algo), sizeof(data->algo));
+	ptr += sizeof(data->algo);
+	memcpy(ptr, &h0_word, sizeof(h0_word));
+	ptr += sizeof(h0_word);
+	hash_state_pack(data->h0, ptr);
+	ptr += hash_state_packed_size(h0_type);
+	memcpy(ptr, &(data->k), sizeof(data->k));
+	ptr += sizeof(data->k);
+	for(i = 0; i < data->k; i++) ((cmph_uint32 *)ptr)[i] = (cmph_uint32)data->offset[i];
+	ptr += sizeof(cmph_uint32)*data->k;
+
+	g_is_ptr = (cmph_uint32 *)ptr;
+	g_i = (cmph_uint8 *)(g_is_ptr + data->k);
+	for(i = 0; i < data->k; i++)
 	{
-		for(i = 0; i < data->k; i++)
-		{
-			free(data->g[i]);
-			hash_state_destroy(data->h1[i]);
-			hash_state_destroy(data->h2[i]);
-		}
-		free(data->g);
-		free(data->h1);
-		free(data->h2);
+		g_is_ptr[i] = (cmph_uint32)(g_i - ptr);
+		memcpy(g_i, data->g[i], (size_t)data->g_size[i]);
+		memset(g_i + data->g_size[i], 0, (size_t)(BRZ_PAD4(data->g_size[i]) - data->g_size[i]));
+		g_i += BRZ_PAD4(data->g_size[i]);
 	}
-	hash_state_destroy(data->h0);
-	free(data->size);
-	free(data->offset);
-	free(data);
-	free(mphf);
+}
+
+static cmph_uint32 brz_cmph_packed_size(brz_data_t *data)
+{
+	cmph_uint32 i;
+	cmph_uint32 size = (cmph_uint32)(2*sizeof(CMPH_ALGO) + sizeof(CMPH_HASH) + hash_state_packed_size(hash_get_type(data->h0)) +
+			sizeof(cmph_uint32) + 2*sizeof(cmph_uint32)*data->k);
+	for(i = 0; i < data->k; i++) size += BRZ_PAD4(data->g_size[i]);
+	return size;
 }
 
 /** \fn void brz_pack(cmph_t *mphf, void *packed_mphf);
@@ -747,18 +1257,24 @@ void brz_pack(cmph_t *mphf, void *packed_mphf)
  
     // This assumes that if one function pointer is NULL, 
     // all the others will be as well.
-    if (data->h1 == NULL) 
+    if (data->h1 == NULL || data->m >= CMPH_SIZE64_FLAG) 
     {
         return;
     }
+	if (BRZ_PACKED_BUCKETS(data->algo))
+	{
+		brz_cmph_pack(mphf, ptr);
+		return;
+	}
 	// packing internal algo type
 	memcpy(ptr, &(data->algo), sizeof(data->algo));
 	ptr += sizeof(data->algo);
 
 	// packing h0 type
 	CMPH_HASH h0_type = hash_get_type(data->h0);
-	memcpy(ptr, &h0_type, sizeof(h0_type));
-	ptr += sizeof(h0_type);
+	cmph_uint32 h0_word = h0_type | (mphf->version ? CMPH_PACKED_FASTRANGE : 0);
+	memcpy(ptr, &h0_word, sizeof(h0_word));
+	ptr += sizeof(h0_word);
 
 	// packing h0
 	hash_state_pack(data->h0, ptr);
@@ -783,13 +1299,15 @@ void brz_pack(cmph_t *mphf, void *packed_mphf)
 	ptr += sizeof(h2_type);
 
 	// packing size
-	memcpy(ptr, data->size, sizeof(cmph_uint8)*data->k);
+	for(i = 0; i < data->k; i++) ptr[i] = (cmph_uint8)data->size[i];
 	ptr += data->k;
 
 	// packing offset
-	memcpy(ptr, data->offset, sizeof(cmph_uint32)*data->k);
+	for(i = 0; i < data->k; i++) ((cmph_uint32 *)ptr)[i] = (cmph_uint32)data->offset[i];
 	ptr += sizeof(cmph_uint32)*data->k;
 
+	// g_is entries are offsets from the start of the g_is table, so the
+	// packed function can be moved or mapped at any address
 	#if defined (__ia64) || defined (__x86_64__)
 		cmph_uint64 * g_is_ptr = (cmph_uint64 *)ptr;
 	#else
@@ -801,9 +1319,9 @@ void brz_pack(cmph_t *mphf, void *packed_mphf)
 	for(i = 0; i < data->k; i++)
 	{
 		#if defined (__ia64) || defined (__x86_64__)
-			*g_is_ptr++ = (cmph_uint64)g_i;
+			g_is_ptr[i] = (cmph_uint64)(g_i - ptr);
 		#else
-			*g_is_ptr++ = (cmph_uint32)g_i;
+			g_is_ptr[i] = (cmph_uint32)(g_i - ptr);
 		#endif
 		// packing h1[i]
 		hash_state_pack(data->h1[i], g_i);
@@ -847,10 +1365,12 @@ cmph_uint32 brz_packed_size(cmph_t *mphf)
 
     // This assumes that if one function pointer is NULL, 
     // all the others will be as well.
-    if (data->h1 == NULL) 
+    // The packed offsets are 32-bit wide.
+    if (data->h1 == NULL || data->m >= CMPH_SIZE64_FLAG) 
     {
         return 0U;
     }
+	if (BRZ_PACKED_BUCKETS(data->algo)) return brz_cmph_packed_size(data);
 
 	h0_type = hash_get_type(data->h0);
 	h1_type = hash_get_type(data->h1[0]);
@@ -858,7 +1378,7 @@ cmph_uint32 brz_packed_size(cmph_t *mphf)
 
 	size = (cmph_uint32)(2*sizeof(CMPH_ALGO) + 3*sizeof(CMPH_HASH) + hash_state_packed_size(h0_type) + sizeof(cmph_uint32) +
 			sizeof(double) + sizeof(cmph_uint8)*data->k + sizeof(cmph_uint32)*data->k);
-	// pointers to g_is
+	// offsets to g_is
 	#if defined (__ia64) || defined (__x86_64__)
 		size +=  (cmph_uint32) sizeof(cmph_uint64)*data->k;
 	#else
@@ -890,7 +1410,8 @@ cmph_uint32 brz_packed_size(cmph_t *mphf)
 
 static cmph_uint32 brz_bmz8_search_packed(cmph_uint32 *packed_mphf, const char *key, cmph_uint32 keylen, cmph_uint32 * fingerprint)
 {
-	register CMPH_HASH h0_type = (CMPH_HASH)*packed_mphf++;
+	register cmph_uint32 fastrange = *packed_mphf & CMPH_PACKED_FASTRANGE;
+	register CMPH_HASH h0_type = (CMPH_HASH)(*packed_mphf++ & ~CMPH_PACKED_FASTRANGE);
 	register cmph_uint32 *h0_ptr = packed_mphf;
 	packed_mphf = (cmph_uint32 *)(((cmph_uint8 *)packed_mphf) + hash_state_packed_size(h0_type));
 
@@ -912,7 +1433,7 @@ static cmph_uint32 brz_bmz8_search_packed(cmph_uint32 *packed_mphf, const char *
 	register cmph_uint32 h0;
 
 	hash_vector_packed(h0_ptr, h0_type, key, keylen, fingerprint);
-	h0 = fingerprint[2] % k;
+	h0 = RANGE(fingerprint[2], k, fastrange);
 
 	register cmph_uint32 m = size[h0];
 	register cmph_uint32 n = (cmph_uint32)ceil(c * m);
@@ -923,14 +1444,16 @@ static cmph_uint32 brz_bmz8_search_packed(cmph_uint32 *packed_mphf, const char *
 		register cmph_uint32 * g_is_ptr = packed_mphf;
 	#endif
 
-	register cmph_uint8 * h1_ptr = (cmph_uint8 *) g_is_ptr[h0];
+	register cmph_uint8 * h1_ptr = (cmph_uint8 *) g_is_ptr + g_is_ptr[h0];
 
 	register cmph_uint8 * h2_ptr = h1_ptr + hash_state_packed_size(h1_type);
 
 	register cmph_uint8 * g = h2_ptr + hash_state_packed_size(h2_type);
 
-	register cmph_uint32 h1 = hash_packed(h1_ptr, h1_type, key, keylen) % n;
-	register cmph_uint32 h2 = hash_packed(h2_ptr, h2_type, key, keylen) % n;
+	cmph_uint32 hp[2];
+	hash_pair_packed(h1_ptr, h1_type, h2_ptr, h2_type, key, keylen, hp);
+	register cmph_uint32 h1 = hp[0] % n;
+	register cmph_uint32 h2 = hp[1] % n;
 
 	register cmph_uint8 mphf_bucket;
 
@@ -943,7 +1466,8 @@ static cmph_uint32 brz_bmz8_search_packed(cmph_uint32 *packed_mphf, const char *
 
 static cmph_uint32 brz_fch_search_packed(cmph_uint32 *packed_mphf, const char *key, cmph_uint32 keylen, cmph_uint32 * fingerprint)
 {
-	register CMPH_HASH h0_type = (CMPH_HASH)*packed_mphf++;
+	register cmph_uint32 fastrange = *packed_mphf & CMPH_PACKED_FASTRANGE;
+	register CMPH_HASH h0_type = (CMPH_HASH)(*packed_mphf++ & ~CMPH_PACKED_FASTRANGE);
 
 	register cmph_uint32 *h0_ptr = packed_mphf;
 	packed_mphf = (cmph_uint32 *)(((cmph_uint8 *)packed_mphf) + hash_state_packed_size(h0_type));
@@ -966,7 +1490,7 @@ static cmph_uint32 brz_fch_search_packed(cmph_uint32 *packed_mphf, const char *k
 	register cmph_uint32 h0;
 
 	hash_vector_packed(h0_ptr, h0_type, key, keylen, fingerprint);
-	h0 = fingerprint[2] % k;
+	h0 = RANGE(fingerprint[2], k, fastrange);
 
 	register cmph_uint32 m = size[h0];
 	register cmph_uint32 b = fch_calc_b(c, m);
@@ -979,21 +1503,40 @@ static cmph_uint32 brz_fch_search_packed(cmph_uint32 *packed_mphf, const char *k
 		register cmph_uint32 * g_is_ptr = packed_mphf;
 	#endif
 
-	register cmph_uint8 * h1_ptr = (cmph_uint8 *) g_is_ptr[h0];
+	register cmph_uint8 * h1_ptr = (cmph_uint8 *) g_is_ptr + g_is_ptr[h0];
 
 	register cmph_uint8 * h2_ptr = h1_ptr + hash_state_packed_size(h1_type);
 
 	register cmph_uint8 * g = h2_ptr + hash_state_packed_size(h2_type);
 
-	register cmph_uint32 h1 = hash_packed(h1_ptr, h1_type, key, keylen) % m;
-	register cmph_uint32 h2 = hash_packed(h2_ptr, h2_type, key, keylen) % m;
+	register cmph_uint32 h1 = RANGE(hash_packed(h1_ptr, h1_type, key, keylen), m, fastrange);
+	register cmph_uint32 h2 = RANGE(hash_packed(h2_ptr, h2_type, key, keylen), m, fastrange);
 
 	register cmph_uint8 mphf_bucket = 0;
 	h1 = mixh10h11h12(b, p1, p2, h1);
-	mphf_bucket = (cmph_uint8)((h2 + g[h1]) % m);
+	mphf_bucket = (cmph_uint8)fch_displace(h2, g[h1], m);
 	return (mphf_bucket + offset[h0]);
 }
 
+static cmph_uint32 brz_cmph_search_packed(cmph_uint32 *packed_mphf, const char *key, cmph_uint32 keylen, cmph_uint32 * fingerprint)
+{
+	register cmph_uint32 fastrange = *packed_mphf & CMPH_PACKED_FASTRANGE;
+	register CMPH_HASH h0_type = (CMPH_HASH)(*packed_mphf++ & ~CMPH_PACKED_FASTRANGE);
+	register cmph_uint32 *h0_ptr = packed_mphf;
+	packed_mphf = (cmph_uint32 *)(((cmph_uint8 *)packed_mphf) + hash_state_packed_size(h0_type));
+
+	register cmph_uint32 k = *packed_mphf++;
+
+	register cmph_uint32 * offset = packed_mphf;
+	register cmph_uint32 * g_is_ptr = packed_mphf + k;
+
+	register cmph_uint32 h0;
+
+	hash_vector_packed(h0_ptr, h0_type, key, keylen, fingerprint);
+	h0 = RANGE(fingerprint[2], k, fastrange);
+	return (cmph_search_packed((cmph_uint8 *)g_is_ptr + g_is_ptr[h0], key, keylen) + offset[h0]);
+}
+
 /** cmph_uint32 brz_search(void *packed_mphf, const char *key, cmph_uint32 keylen);
  *  \brief Use the packed mphf to do a search.
  *  \param  packed_mphf pointer to the packed mphf
@@ -1012,6 +1555,9 @@ cmph_uint32 brz_search_packed(void *packed_mphf, const char *key, cmph_uint32 ke
 			return brz_fch_search_packed(ptr, key, keylen, fingerprint);
 		case CMPH_BMZ8:
 			return brz_bmz8_search_packed(ptr, key, keylen, fingerprint);
+		case CMPH_BDZ:
+		case CMPH_CHD:
+			return brz_cmph_search_packed(ptr, key, keylen, fingerprint);
 		default: assert(0);
 	}
 }
@@ -31,10 +31,11 @@ void brz_config_set_memory_availability(cmph_config_t *mph, cmph_uint32 memory_a
 void brz_config_destroy(cmph_config_t *mph);
 cmph_t *brz_new(cmph_config_t *mph, double c);
 
-void brz_load(FILE *f, cmph_t *mphf);
+int brz_load(FILE *f, cmph_t *mphf);
 int brz_dump(cmph_t *mphf, FILE *f);
 void brz_destroy(cmph_t *mphf);
 cmph_uint32 brz_search(cmph_t *mphf, const char *key, cmph_uint32 keylen);
+cmph_uint64 brz_search64(cmph_t *mphf, const char *key, cmph_uint32 keylen);
 
 /** \fn void brz_pack(cmph_t *mphf, void *packed_mphf);
  *  \brief Support the ability to pack a perfect hash function into a preallocated contiguous memory space pointed by packed_mphf.
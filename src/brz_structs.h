@@ -5,12 +5,13 @@
 
 struct __brz_data_t
 {
-	CMPH_ALGO algo;      // CMPH algo for generating the MPHFs for the buckets (Just CMPH_FCH and CMPH_BMZ8)
-	cmph_uint32 m;       // edges (words) count
+	CMPH_ALGO algo;      // CMPH algo for generating the MPHFs for the buckets (CMPH_FCH, CMPH_BMZ8, CMPH_BDZ or CMPH_CHD)
+	cmph_uint64 m;       // edges (words) count
 	double c;      // constant c
-	cmph_uint8  *size;   // size[i] stores the number of edges represented by g[i][...]. 
-	cmph_uint32 *offset; // offset[i] stores the sum: size[0] + size[1] + ... size[i-1].
-	cmph_uint8 **g;      // g function. 
+	cmph_uint16 *size;   // size[i] stores the number of edges represented by g[i][...]. 
+	cmph_uint64 *offset; // offset[i] stores the sum: size[0] + size[1] + ... size[i-1].
+	cmph_uint8 **g;      // g function, or the packed function of each bucket for CMPH_BDZ and CMPH_CHD. 
+	cmph_uint32 *g_size; // g_size[i] is the size of the packed function g[i] (CMPH_BDZ and CMPH_CHD)
 	cmph_uint32 k;       // number of components
 	hash_state_t **h1;
 	hash_state_t **h2;
@@ -20,13 +21,14 @@ struct __brz_data_t
 struct __brz_config_data_t
 {
 	CMPH_HASH hashfuncs[3];
-	CMPH_ALGO algo;      // CMPH algo for generating the MPHFs for the buckets (Just CMPH_FCH and CMPH_BMZ8)
+	CMPH_ALGO bucket_algo; // algo asked with brz_config_set_algo, CMPH_COUNT to pick CMPH_FCH or CMPH_BMZ8 from c
+	CMPH_ALGO algo;      // CMPH algo for generating the MPHFs for the buckets (CMPH_FCH, CMPH_BMZ8, CMPH_BDZ or CMPH_CHD)
 	double c;      // constant c
-	cmph_uint32 m;       // edges (words) count
-	cmph_uint8  *size;   // size[i] stores the number of edges represented by g[i][...]. 
-	cmph_uint32 *offset; // offset[i] stores the sum: size[0] + size[1] + ... size[i-1].
+	cmph_uint64 m;       // edges (words) count
+	cmph_uint16 *size;   // size[i] stores the number of edges represented by g[i][...]. 
+	cmph_uint64 *offset; // offset[i] stores the sum: size[0] + size[1] + ... size[i-1].
 	cmph_uint8 **g;      // g function. 
-	cmph_uint8  b;       // parameter b. 
+	cmph_uint32 b;       // parameter b, 0 for the default of the bucket algo. 
 	cmph_uint32 k;       // number of components
 	hash_state_t **h1;
 	hash_state_t **h2;
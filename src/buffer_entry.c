@@ -27,9 +27,11 @@ buffer_entry_t * buffer_entry_new(cmph_uint32 capacity)
 	return buff_entry;
 }
 
-void buffer_entry_open(buffer_entry_t * buffer_entry, char * filename)
+// Returns 0 when the file can not be opened.
+int buffer_entry_open(buffer_entry_t * buffer_entry, char * filename)
 {
 	buffer_entry->fd = fopen(filename, "rb");
+	return buffer_entry->fd != NULL;
 }
 
 void buffer_entry_set_capacity(buffer_entry_t * buffer_entry, cmph_uint32 capacity)
@@ -52,46 +54,56 @@ static void buffer_entry_load(buffer_entry_t * buffer_entry)
 	buffer_entry->pos = 0;
 }
 
-cmph_uint8 * buffer_entry_read_key(buffer_entry_t * buffer_entry, cmph_uint32 * keylen)
+// Copies the next n bytes of the file to dest, returns 0 on a short read.
+static int buffer_entry_read(buffer_entry_t * buffer_entry, void * dest, cmph_uint32 n)
+{
+	cmph_uint8 * ptr = (cmph_uint8 *)dest;
+	while (n > 0)
+	{
+		cmph_uint32 copied_bytes;
+		if (buffer_entry->pos == buffer_entry->nbytes)
+		{
+			if (buffer_entry->eof) return 0;
+			buffer_entry_load(buffer_entry);
+			if (buffer_entry->nbytes == 0) return 0;
+		}
+		copied_bytes = buffer_entry->nbytes - buffer_entry->pos;
+		if (copied_bytes > n) copied_bytes = n;
+		memcpy(ptr, buffer_entry->buff + buffer_entry->pos, (size_t)copied_bytes);
+		buffer_entry->pos += copied_bytes;
+		ptr += copied_bytes;
+		n -= copied_bytes;
+	}
+	return 1;
+}
+
+// Reads a record written as keylen, bucket, key and returns keylen followed
+// by the key, NULL at the end of the file or on a short read.
+cmph_uint8 * buffer_entry_read_key(buffer_entry_t * buffer_entry, cmph_uint32 * keylen, cmph_uint32 * bucket)
 {
 	cmph_uint8 * buf = NULL;
-	cmph_uint32 lacked_bytes = sizeof(*keylen);
-	cmph_uint32 copied_bytes = 0;
 	if(buffer_entry->eof && (buffer_entry->pos == buffer_entry->nbytes)) // end
 	{
-		free(buf);
 		return NULL;
 	}
-	if((buffer_entry->pos + lacked_bytes) > buffer_entry->nbytes)
+	if (!buffer_entry_read(buffer_entry, keylen, (cmph_uint32)sizeof(*keylen)) ||
+	    !buffer_entry_read(buffer_entry, bucket, (cmph_uint32)sizeof(*bucket)))
 	{
-		copied_bytes = buffer_entry->nbytes - buffer_entry->pos;
-		lacked_bytes = (buffer_entry->pos + lacked_bytes) - buffer_entry->nbytes;
-		if (copied_bytes != 0) memcpy(keylen, buffer_entry->buff + buffer_entry->pos, (size_t)copied_bytes);
-		buffer_entry_load(buffer_entry);
+		return NULL;
 	}
-	memcpy(keylen + copied_bytes, buffer_entry->buff + buffer_entry->pos, (size_t)lacked_bytes);
-	buffer_entry->pos += lacked_bytes;
-
-	lacked_bytes = *keylen;
-	copied_bytes = 0;
 	buf = (cmph_uint8 *)malloc(*keylen + sizeof(*keylen));
-        memcpy(buf, keylen, sizeof(*keylen));
-	if((buffer_entry->pos + lacked_bytes) > buffer_entry->nbytes) {
-		copied_bytes = buffer_entry->nbytes - buffer_entry->pos;
-		lacked_bytes = (buffer_entry->pos + lacked_bytes) - buffer_entry->nbytes;
-		if (copied_bytes != 0) {
-			memcpy(buf + sizeof(*keylen), buffer_entry->buff + buffer_entry->pos, (size_t)copied_bytes);
-                }
-		buffer_entry_load(buffer_entry);
+	memcpy(buf, keylen, sizeof(*keylen));
+	if (!buffer_entry_read(buffer_entry, buf + sizeof(*keylen), *keylen)) // short read
+	{
+		free(buf);
+		return NULL;
 	}
-	memcpy(buf+sizeof(*keylen)+copied_bytes, buffer_entry->buff + buffer_entry->pos, (size_t)lacked_bytes);
-	buffer_entry->pos += lacked_bytes;
 	return buf;
 }
 
 void buffer_entry_destroy(buffer_entry_t * buffer_entry)
 {
-  fclose(buffer_entry->fd);
+  if (buffer_entry->fd) fclose(buffer_entry->fd);
   buffer_entry->fd = NULL;
   free(buffer_entry->buff);
   buffer_entry->buff = NULL;
@@ -30,12 +30,12 @@ buffer_manager_t * buffer_manager_new(cmph_uint32 memory_avail, cmph_uint32 nent
 	return buff_manager;
 }
 
-void buffer_manager_open(buffer_manager_t * buffer_manager, cmph_uint32 index, char * filename)
+int buffer_manager_open(buffer_manager_t * buffer_manager, cmph_uint32 index, char * filename)
 {
-	buffer_entry_open(buffer_manager->buffer_entries[index], filename);
+	return buffer_entry_open(buffer_manager->buffer_entries[index], filename);
 }
 
-cmph_uint8 * buffer_manager_read_key(buffer_manager_t * buffer_manager, cmph_uint32 index, cmph_uint32 * keylen)
+cmph_uint8 * buffer_manager_read_key(buffer_manager_t * buffer_manager, cmph_uint32 index, cmph_uint32 * keylen, cmph_uint32 * bucket)
 {
 	cmph_uint8 * key = NULL;
 	if (buffer_manager->pos_avail_list >= 0 ) // recovering memory
@@ -43,7 +43,7 @@ cmph_uint8 * buffer_manager_read_key(buffer_manager_t * buffer_manager, cmph_uin
 		cmph_uint32 new_capacity = buffer_entry_get_capacity(buffer_manager->buffer_entries[index]) + buffer_manager->memory_avail_list[(buffer_manager->pos_avail_list)--];
 		buffer_entry_set_capacity(buffer_manager->buffer_entries[index], new_capacity);
 	}
-	key = buffer_entry_read_key(buffer_manager->buffer_entries[index], keylen);
+	key = buffer_entry_read_key(buffer_manager->buffer_entries[index], keylen, bucket);
 	if (key == NULL) // storing memory to be recovered
 	{
 		buffer_manager->memory_avail_list[++(buffer_manager->pos_avail_list)] = buffer_entry_get_capacity(buffer_manager->buffer_entries[index]);
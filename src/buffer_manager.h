@@ -6,7 +6,7 @@
 typedef struct __buffer_manager_t buffer_manager_t;
 
 buffer_manager_t * buffer_manager_new(cmph_uint32 memory_avail, cmph_uint32 nentries);
-void buffer_manager_open(buffer_manager_t * buffer_manager, cmph_uint32 index, char * filename);
-cmph_uint8 * buffer_manager_read_key(buffer_manager_t * buffer_manager, cmph_uint32 index, cmph_uint32 * keylen);
+int buffer_manager_open(buffer_manager_t * buffer_manager, cmph_uint32 index, char * filename);
+cmph_uint8 * buffer_manager_read_key(buffer_manager_t * buffer_manager, cmph_uint32 index, cmph_uint32 * keylen, cmph_uint32 * bucket);
 void buffer_manager_destroy(buffer_manager_t * buffer_manager);
 #endif
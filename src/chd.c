@@ -10,6 +10,7 @@
 #include "chd_structs.h"
 #include "chd.h"
 #include "bitbool.h"
+#include "prefetch.h"
 //#define DEBUG
 #include "debug.h"
 
@@ -88,13 +89,22 @@ cmph_t *chd_new(cmph_config_t *mph, double c)
 
 	cmph_config_set_verbosity(chd->chd_ph, mph->verbosity);
 	cmph_config_set_graphsize(chd->chd_ph, c);
+	chd->chd_ph->seed = mph->seed;
+	chd->chd_ph->key_source = mph->key_source; // cmph_new may have replaced a source of unknown size
 
 	if (mph->verbosity)
 	{
 		fprintf(stderr, "Generating a CHD_PH perfect hash function with a load factor equal to %.3f\n", c);
 	}
 
+	__config_phase(mph, CMPH_PHASE_COUNT); // the inner build is timed on its own
 	chd_phf = cmph_new(chd->chd_ph);
+	for (i = 0; i < CMPH_PHASE_COUNT; ++i)
+	{
+		mph->stats.wall_time[i] += chd->chd_ph->stats.wall_time[i];
+		mph->stats.cpu_time[i] += chd->chd_ph->stats.cpu_time[i];
+	}
+	mph->stats.iterations += chd->chd_ph->stats.iterations;
 
 	if(chd_phf == NULL)
 	{
@@ -118,6 +128,7 @@ cmph_t *chd_new(cmph_config_t *mph, double c)
 		fprintf(stderr, "Compressing the range of the resulting CHD_PH perfect hash function\n");
 	}
 
+	__config_phase(mph, CMPH_PHASE_COMPRESSING);
 	compressed_rank_init(&cr);
 	nbins = chd_ph->n;
 	nkeys = chd_ph->m;
@@ -144,6 +155,7 @@ cmph_t *chd_new(cmph_config_t *mph, double c)
 
 	mphf = (cmph_t *)malloc(sizeof(cmph_t));
 	mphf->algo = mph->algo;
+	mphf->version = CMPH_VERSION_FASTRANGE; // of the embedded CHD_PH function
 	chdf = (chd_data_t *)malloc(sizeof(chd_data_t));
 
 	chdf->packed_cr = packed_cr;
@@ -233,6 +245,47 @@ cmph_uint32 chd_search(cmph_t *mphf, const char *key, cmph_uint32 keylen)
 	return _chd_search(chd->packed_chd_phf, chd->packed_cr, key, keylen);
 }
 
+// packed_chd_phf starts with the algorithm id written by cmph_pack, the
+// chd_ph function is searched directly.
+static inline cmph_uint32 _chd_search_integer(void * packed_chd_phf, void * packed_cr, cmph_uint64 key, cmph_uint32 keylen)
+{
+	register cmph_uint32 bin_idx = chd_ph_search_packed_integer((cmph_uint32 *)packed_chd_phf + 1, key, keylen);
+	register cmph_uint32 rank = compressed_rank_query_packed(packed_cr, bin_idx);
+	return bin_idx - rank;
+}
+
+cmph_uint32 chd_search_integer(cmph_t *mphf, cmph_uint64 key, cmph_uint32 keylen)
+{
+	register chd_data_t * chd = (chd_data_t *)mphf->data;
+	return _chd_search_integer(chd->packed_chd_phf, chd->packed_cr, key, keylen);
+}
+
+// The bins of a whole group come from the batched chd_ph search, then the rank
+// slots of the group are prefetched before they are queried.
+static inline void _chd_search_batch(void * packed_chd_phf, void * packed_cr, const char **keys, const cmph_uint32 *keylens, cmph_uint32 n, cmph_uint32 *out)
+{
+	cmph_uint32 i, j, count;
+	for(i = 0; i < n; i += count)
+	{
+		count = n - i < CMPH_SEARCH_BATCH_SIZE ? n - i : CMPH_SEARCH_BATCH_SIZE;
+		cmph_search_packed_batch(packed_chd_phf, keys + i, keylens + i, count, out + i);
+		for(j = i; j < i + count; j++)
+		{
+			compressed_rank_prefetch_packed(packed_cr, out[j]);
+		}
+		for(j = i; j < i + count; j++)
+		{
+			out[j] -= compressed_rank_query_packed(packed_cr, out[j]);
+		}
+	}
+}
+
+void chd_search_batch(cmph_t *mphf, const char **keys, const cmph_uint32 *keylens, cmph_uint32 n, cmph_uint32 *out)
+{
+	register chd_data_t * chd = (chd_data_t *)mphf->data;
+	_chd_search_batch(chd->packed_chd_phf, chd->packed_cr, keys, keylens, n, out);
+}
+
 void chd_pack(cmph_t *mphf, void *packed_mphf)
 {
 	chd_data_t *data = (chd_data_t *)mphf->data;
@@ -268,3 +321,19 @@ cmph_uint32 chd_search_packed(void *packed_mphf, const char *key, cmph_uint32 ke
 	register cmph_uint8 * packed_chd_phf = ((cmph_uint8 *) ptr) + packed_cr_size + sizeof(cmph_uint32);
 	return _chd_search(packed_chd_phf, ptr, key, keylen);
 }
+
+cmph_uint32 chd_search_packed_integer(void *packed_mphf, cmph_uint64 key, cmph_uint32 keylen)
+{
+	register cmph_uint32 * ptr = (cmph_uint32 *)packed_mphf;
+	register cmph_uint32 packed_cr_size = *ptr++;
+	register cmph_uint8 * packed_chd_phf = ((cmph_uint8 *) ptr) + packed_cr_size + sizeof(cmph_uint32);
+	return _chd_search_integer(packed_chd_phf, ptr, key, keylen);
+}
+
+void chd_search_packed_batch(void *packed_mphf, const char **keys, const cmph_uint32 *keylens, cmph_uint32 n, cmph_uint32 *out)
+{
+	register cmph_uint32 * ptr = (cmph_uint32 *)packed_mphf;
+	register cmph_uint32 packed_cr_size = *ptr++;
+	register cmph_uint8 * packed_chd_phf = ((cmph_uint8 *) ptr) + packed_cr_size + sizeof(cmph_uint32);
+	_chd_search_batch(packed_chd_phf, ptr, keys, keylens, n, out);
+}
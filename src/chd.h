@@ -32,6 +32,16 @@ void chd_load(FILE *fd, cmph_t *mphf);
 int chd_dump(cmph_t *mphf, FILE *fd);
 void chd_destroy(cmph_t *mphf);
 cmph_uint32 chd_search(cmph_t *mphf, const char *key, cmph_uint32 keylen);
+void chd_search_batch(cmph_t *mphf, const char **keys, const cmph_uint32 *keylens, cmph_uint32 n, cmph_uint32 *out);
+
+/** \fn cmph_uint32 chd_search_integer(cmph_t *mphf, cmph_uint64 key, cmph_uint32 keylen);
+ *  \brief Same as chd_search for a key that is an integer of keylen bytes, 4 or 8.
+ *  \param mphf pointer to the resulting mphf
+ *  \param key the integer
+ *  \param keylen size of the integer in bytes
+ *  \return The mphf value
+ */
+cmph_uint32 chd_search_integer(cmph_t *mphf, cmph_uint64 key, cmph_uint32 keylen);
 
 /** \fn void chd_pack(cmph_t *mphf, void *packed_mphf);
  *  \brief Support the ability to pack a perfect hash function into a preallocated contiguous memory space pointed by packed_mphf.
@@ -56,4 +66,23 @@ cmph_uint32 chd_packed_size(cmph_t *mphf);
  */
 cmph_uint32 chd_search_packed(void *packed_mphf, const char *key, cmph_uint32 keylen);
 
+/** \fn void chd_search_packed_batch(void *packed_mphf, const char **keys, const cmph_uint32 *keylens, cmph_uint32 n, cmph_uint32 *out);
+ *  \brief Batched version of @see chd_search_packed.
+ *  \param packed_mphf pointer to the packed mphf
+ *  \param keys array of n keys to be hashed
+ *  \param keylens array with the length in bytes of each key
+ *  \param n number of keys
+ *  \param out array of n entries that receives the mphf values
+ */
+void chd_search_packed_batch(void *packed_mphf, const char **keys, const cmph_uint32 *keylens, cmph_uint32 n, cmph_uint32 *out);
+
+/** \fn cmph_uint32 chd_search_packed_integer(void *packed_mphf, cmph_uint64 key, cmph_uint32 keylen);
+ *  \brief Same as chd_search_packed for a key that is an integer of keylen bytes, 4 or 8.
+ *  \param packed_mphf pointer to the packed mphf
+ *  \param key the integer
+ *  \param keylen size of the integer in bytes
+ *  \return The mphf value
+ */
+cmph_uint32 chd_search_packed_integer(void *packed_mphf, cmph_uint64 key, cmph_uint32 keylen);
+
 #endif
@@ -10,6 +10,8 @@
 #include "chd_structs_ph.h"
 #include "chd_ph.h"
 #include"miller_rabin.h"
+#include "prefetch.h"
+#include "fastrange.h"
 #include"bitbool.h"
 
 
@@ -159,6 +161,7 @@ chd_ph_config_data_t *chd_ph_config_new(void)
 	chd_ph->keys_per_bin = 1;
 	chd_ph->keys_per_bucket = 4;
 	chd_ph->occup_table = 0;
+	chd_ph->fingerprints = NULL;
 
 	return chd_ph;
 }
@@ -227,25 +230,31 @@ cmph_uint8 chd_ph_mapping(cmph_config_t *mph, chd_ph_bucket_t * buckets, chd_ph_
 	while(1)
 	{
 		mapping_iterations--;
+		mph->stats.iterations++;
 		if (chd_ph->hl) hash_state_destroy(chd_ph->hl);
-		chd_ph->hl = hash_state_new(chd_ph->hashfunc, chd_ph->m);
+		if (mph->seed) chd_ph->hl = hash_state_seeded(chd_ph->hashfunc, __seed_derive(mph->seed, 1000 - mapping_iterations));
+		else chd_ph->hl = hash_state_new(chd_ph->hashfunc, chd_ph->m);
 
 		chd_ph_bucket_clean(buckets, chd_ph->nbuckets);
 
-		mph->key_source->rewind(mph->key_source->data);
+		if (chd_ph->fingerprints == NULL) mph->key_source->rewind(mph->key_source->data);
 
 		for(i = 0; i < chd_ph->m; i++)
 		{
-			mph->key_source->read(mph->key_source->data, &key, &keylen);
-			hash_vector(chd_ph->hl, key, keylen, hl);
+			if (chd_ph->fingerprints) hash_vector_fingerprint(chd_ph->hl, chd_ph->fingerprints + 2*i, hl);
+			else
+			{
+				mph->key_source->read(mph->key_source->data, &key, &keylen);
+				hash_vector(chd_ph->hl, key, keylen, hl);
+				__key_dispose(mph->key_source, key, keylen);
+			}
 
 			map_item = (map_items + i);
 
-			g = hl[0] % chd_ph->nbuckets;
-			map_item->f = hl[1] % chd_ph->n;
-			map_item->h = hl[2] % (chd_ph->n - 1) + 1;
+			g = fastrange32(hl[0], chd_ph->nbuckets);
+			map_item->f = fastrange32(hl[1], chd_ph->n);
+			map_item->h = fastrange32(hl[2], chd_ph->n - 1) + 1;
 			map_item->bucket_num=g;
-			mph->key_source->dispose(mph->key_source->data, key, keylen);
 // 			if(buckets[g].size == (chd_ph->keys_per_bucket << 2))
 // 			{
 // 				DEBUGP("BUCKET = %u -- SIZE = %u -- MAXIMUM SIZE = %u\n", g, buckets[g].size, (chd_ph->keys_per_bucket << 2));
@@ -706,6 +715,11 @@ cmph_t *chd_ph_new(cmph_config_t *mph, double c)
 // 
 // 	init_genrand(time(0));
 
+	if (chd_ph->hashfunc == CMPH_HASH_FINGERPRINT)
+	{
+		__config_phase(mph, CMPH_PHASE_HASHING);
+		chd_ph->fingerprints = __config_fingerprints(mph);
+	}
 	while(1)
 	{
 		iterations --;
@@ -714,6 +728,7 @@ cmph_t *chd_ph_new(cmph_config_t *mph, double c)
 			fprintf(stderr, "Starting mapping step for mph creation of %u keys with %u bins\n", chd_ph->m, chd_ph->n);
 		}
 
+		__config_phase(mph, CMPH_PHASE_HASHING);
 		if(!chd_ph_mapping(mph, buckets, items, &max_bucket_size))
 		{
 			if (mph->verbosity)
@@ -733,6 +748,7 @@ cmph_t *chd_ph_new(cmph_config_t *mph, double c)
 			free(sorted_lists);
 		}
 
+		__config_phase(mph, CMPH_PHASE_MAPPING);
         	sorted_lists = chd_ph_ordering(&buckets, &items, chd_ph->nbuckets, chd_ph->m, max_bucket_size);
 
 		if (mph->verbosity)
@@ -740,6 +756,7 @@ cmph_t *chd_ph_new(cmph_config_t *mph, double c)
 			fprintf(stderr, "Starting searching step\n");
 		}
 
+		__config_phase(mph, CMPH_PHASE_SEARCHING);
 		searching_success = chd_ph_searching(chd_ph, buckets, items, max_bucket_size, sorted_lists, max_probes, disp_table);
 		if(searching_success) break;
 
@@ -781,6 +798,7 @@ cmph_t *chd_ph_new(cmph_config_t *mph, double c)
 	{
 		free(chd_ph->cs);
 	}
+	__config_phase(mph, CMPH_PHASE_COMPRESSING);
 	chd_ph->cs = (compressed_seq_t *) calloc(1, sizeof(compressed_seq_t));
 	compressed_seq_init(chd_ph->cs);
 	compressed_seq_generate(chd_ph->cs, disp_table, chd_ph->nbuckets);
@@ -792,6 +810,8 @@ cmph_t *chd_ph_new(cmph_config_t *mph, double c)
 	#endif
 
 cleanup:
+	free(chd_ph->fingerprints);
+	chd_ph->fingerprints = NULL;
 	chd_ph_bucket_destroy(buckets);
 	free(items);
 	free(sorted_lists);
@@ -808,6 +828,7 @@ cleanup:
 
 	mphf = (cmph_t *)malloc(sizeof(cmph_t));
 	mphf->algo = mph->algo;
+	mphf->version = CMPH_VERSION_FASTRANGE;
 	chd_phf = (chd_ph_data_t *)malloc(sizeof(chd_ph_data_t));
 
 	chd_phf->cs = chd_ph->cs;
@@ -914,9 +935,9 @@ cmph_uint32 chd_ph_search(cmph_t *mphf, const char *key, cmph_uint32 keylen)
 	register cmph_uint32 probe0_num,probe1_num;
 	register cmph_uint32 f,g,h;
 	hash_vector(chd_ph->hl, key, keylen, hl);
-	g = hl[0] % chd_ph->nbuckets;
-	f = hl[1] % chd_ph->n;
-	h = hl[2] % (chd_ph->n-1) + 1;
+	g = RANGE(hl[0], chd_ph->nbuckets, mphf->version);
+	f = RANGE(hl[1], chd_ph->n, mphf->version);
+	h = RANGE(hl[2], chd_ph->n-1, mphf->version) + 1;
 
 	disp = compressed_seq_query(chd_ph->cs, g);
 	probe0_num = disp % chd_ph->n;
@@ -925,6 +946,50 @@ cmph_uint32 chd_ph_search(cmph_t *mphf, const char *key, cmph_uint32 keylen)
 	return position;
 }
 
+static inline cmph_uint32 chd_ph_position(cmph_uint32 n, cmph_uint32 f, cmph_uint32 h, cmph_uint32 disp)
+{
+	register cmph_uint32 probe0_num = disp % n;
+	register cmph_uint32 probe1_num = disp / n;
+	return (cmph_uint32)((f + ((cmph_uint64 )h)*probe0_num + probe1_num) % n);
+}
+
+cmph_uint32 chd_ph_search_integer(cmph_t *mphf, cmph_uint64 key, cmph_uint32 keylen)
+{
+	register chd_ph_data_t * chd_ph = (chd_ph_data_t *)mphf->data;
+	cmph_uint32 hl[3];
+	register cmph_uint32 f,g,h;
+	hash_vector_integer(chd_ph->hl, key, keylen, hl);
+	g = RANGE(hl[0], chd_ph->nbuckets, mphf->version);
+	f = RANGE(hl[1], chd_ph->n, mphf->version);
+	h = RANGE(hl[2], chd_ph->n-1, mphf->version) + 1;
+	return chd_ph_position(chd_ph->n, f, h, compressed_seq_query(chd_ph->cs, g));
+}
+
+// Keys are hashed a group at a time and the displacement slots of the whole
+// group are prefetched before the first compressed_seq query is issued.
+void chd_ph_search_batch(cmph_t *mphf, const char **keys, const cmph_uint32 *keylens, cmph_uint32 n, cmph_uint32 *out)
+{
+	register chd_ph_data_t * chd_ph = (chd_ph_data_t *)mphf->data;
+	cmph_uint32 hl[CMPH_SEARCH_BATCH_SIZE][3];
+	cmph_uint32 i, j, count;
+	for(i = 0; i < n; i += count)
+	{
+		count = n - i < CMPH_SEARCH_BATCH_SIZE ? n - i : CMPH_SEARCH_BATCH_SIZE;
+		hash_vector_batch(chd_ph->hl, keys + i, keylens + i, count, hl);
+		for(j = 0; j < count; j++)
+		{
+			hl[j][0] = RANGE(hl[j][0], chd_ph->nbuckets, mphf->version);
+			compressed_seq_prefetch(chd_ph->cs, hl[j][0]);
+		}
+		for(j = 0; j < count; j++)
+		{
+			out[i + j] = chd_ph_position(chd_ph->n, RANGE(hl[j][1], chd_ph->n, mphf->version),
+			                             RANGE(hl[j][2], chd_ph->n-1, mphf->version) + 1,
+			                             compressed_seq_query(chd_ph->cs, hl[j][0]));
+		}
+	}
+}
+
 void chd_ph_pack(cmph_t *mphf, void *packed_mphf)
 {
 	chd_ph_data_t *data = (chd_ph_data_t *)mphf->data;
@@ -932,7 +997,7 @@ void chd_ph_pack(cmph_t *mphf, void *packed_mphf)
 
 	// packing hl type
 	CMPH_HASH hl_type = hash_get_type(data->hl);
-	*((cmph_uint32 *) ptr) = hl_type;
+	*((cmph_uint32 *) ptr) = hl_type | (mphf->version ? CMPH_PACKED_FASTRANGE : 0);
 	ptr += sizeof(cmph_uint32);
 
 	// packing hl
@@ -966,7 +1031,8 @@ cmph_uint32 chd_ph_packed_size(cmph_t *mphf)
 
 cmph_uint32 chd_ph_search_packed(void *packed_mphf, const char *key, cmph_uint32 keylen)
 {
-	register CMPH_HASH hl_type  = (CMPH_HASH)*(cmph_uint32 *)packed_mphf;
+	register cmph_uint32 fastrange = *(cmph_uint32 *)packed_mphf & CMPH_PACKED_FASTRANGE;
+	register CMPH_HASH hl_type  = (CMPH_HASH)(*(cmph_uint32 *)packed_mphf & ~CMPH_PACKED_FASTRANGE);
 	register cmph_uint8 *hl_ptr = (cmph_uint8 *)(packed_mphf) + 4;
 
 	register cmph_uint32 * ptr = (cmph_uint32 *)(hl_ptr + hash_state_packed_size(hl_type));
@@ -980,9 +1046,9 @@ cmph_uint32 chd_ph_search_packed(void *packed_mphf, const char *key, cmph_uint32
 
 	hash_vector_packed(hl_ptr, hl_type, key, keylen, hl);
 
-	g = hl[0] % nbuckets;
-	f = hl[1] % n;
-	h = hl[2] % (n-1) + 1;
+	g = RANGE(hl[0], nbuckets, fastrange);
+	f = RANGE(hl[1], n, fastrange);
+	h = RANGE(hl[2], n-1, fastrange) + 1;
 
 	disp = compressed_seq_query_packed(ptr, g);
 	probe0_num = disp % n;
@@ -990,3 +1056,52 @@ cmph_uint32 chd_ph_search_packed(void *packed_mphf, const char *key, cmph_uint32
 	position = (cmph_uint32)((f + ((cmph_uint64 )h)*probe0_num + probe1_num) % n);
 	return position;
 }
+
+cmph_uint32 chd_ph_search_packed_integer(void *packed_mphf, cmph_uint64 key, cmph_uint32 keylen)
+{
+	register cmph_uint32 fastrange = *(cmph_uint32 *)packed_mphf & CMPH_PACKED_FASTRANGE;
+	register CMPH_HASH hl_type  = (CMPH_HASH)(*(cmph_uint32 *)packed_mphf & ~CMPH_PACKED_FASTRANGE);
+	register cmph_uint8 *hl_ptr = (cmph_uint8 *)(packed_mphf) + 4;
+
+	register cmph_uint32 * ptr = (cmph_uint32 *)(hl_ptr + hash_state_packed_size(hl_type));
+	register cmph_uint32 n = *ptr++;
+	register cmph_uint32 nbuckets = *ptr++;
+	cmph_uint32 hl[3];
+	register cmph_uint32 f,g,h;
+
+	hash_vector_packed_integer(hl_ptr, hl_type, key, keylen, hl);
+	g = RANGE(hl[0], nbuckets, fastrange);
+	f = RANGE(hl[1], n, fastrange);
+	h = RANGE(hl[2], n-1, fastrange) + 1;
+	return chd_ph_position(n, f, h, compressed_seq_query_packed(ptr, g));
+}
+
+void chd_ph_search_packed_batch(void *packed_mphf, const char **keys, const cmph_uint32 *keylens, cmph_uint32 n, cmph_uint32 *out)
+{
+	register cmph_uint32 fastrange = *(cmph_uint32 *)packed_mphf & CMPH_PACKED_FASTRANGE;
+	register CMPH_HASH hl_type  = (CMPH_HASH)(*(cmph_uint32 *)packed_mphf & ~CMPH_PACKED_FASTRANGE);
+	register cmph_uint8 *hl_ptr = (cmph_uint8 *)(packed_mphf) + 4;
+
+	register cmph_uint32 * ptr = (cmph_uint32 *)(hl_ptr + hash_state_packed_size(hl_type));
+	register cmph_uint32 nbins = *ptr++;
+	register cmph_uint32 nbuckets = *ptr++;
+
+	cmph_uint32 hl[CMPH_SEARCH_BATCH_SIZE][3];
+	cmph_uint32 i, j, count;
+	for(i = 0; i < n; i += count)
+	{
+		count = n - i < CMPH_SEARCH_BATCH_SIZE ? n - i : CMPH_SEARCH_BATCH_SIZE;
+		hash_vector_packed_batch(hl_ptr, hl_type, keys + i, keylens + i, count, hl);
+		for(j = 0; j < count; j++)
+		{
+			hl[j][0] = RANGE(hl[j][0], nbuckets, fastrange);
+			compressed_seq_prefetch_packed(ptr, hl[j][0]);
+		}
+		for(j = 0; j < count; j++)
+		{
+			out[i + j] = chd_ph_position(nbins, RANGE(hl[j][1], nbins, fastrange),
+			                             RANGE(hl[j][2], nbins-1, fastrange) + 1,
+			                             compressed_seq_query_packed(ptr, hl[j][0]));
+		}
+	}
+}
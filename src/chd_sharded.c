@@ -0,0 +1,552 @@
+#include<stdio.h>
+#include<stdlib.h>
+#include<string.h>
+#include<math.h>
+#include<assert.h>
+#include<limits.h>
+
+#include "cmph_structs.h"
+#include "chd_sharded_structs.h"
+#include "chd_sharded.h"
+#include "hash.h"
+#include "fastrange.h"
+#include "thread_pool.h"
+//#define DEBUG
+#include "debug.h"
+
+#define CHD_SHARDED_KEYS_PER_SHARD (1U << 20)
+#define CHD_SHARDED_MEMORY_AVAILABILITY (64U*1024*1024)
+
+// Keys of a shard, stored as in a byte vector: 4 bytes of key length
+// followed by the key itself. The keys in buf follow the chunks of keys
+// spilled to the temporary file of the construction.
+typedef struct
+{
+	cmph_uint8 *buf;
+	size_t buflen;
+	size_t bufsize;
+	cmph_uint32 nkeys;
+	cmph_uint64 *chunks;	// offset and length of each spilled chunk
+	cmph_uint32 nchunks;
+} chd_sharded_keys_t;
+
+typedef struct
+{
+	chd_sharded_keys_t *keys;
+	cmph_uint64 buffered;	// bytes allocated by the buffers of the keys
+	FILE *spill;		// temporary file of the spilled keys, NULL until the first spill
+	cmph_uint64 spill_size;
+	cmph_uint32 first;	// first shard of the wave being built
+	cmph_uint32 seed;	// the seeds of the shards are derived from it
+	cmph_uint8 **packed_shards;
+	cmph_uint32 *packed_shards_size;
+	chd_sharded_config_data_t *config;
+	double c;
+} chd_sharded_job_t;
+
+chd_sharded_config_data_t *chd_sharded_config_new(void)
+{
+	chd_sharded_config_data_t *chd_sharded;
+	chd_sharded = (chd_sharded_config_data_t *)malloc(sizeof(chd_sharded_config_data_t));
+	if (!chd_sharded) return NULL;
+	memset(chd_sharded, 0, sizeof(chd_sharded_config_data_t));
+	chd_sharded->hashfunc = CMPH_HASH_JENKINS;
+	chd_sharded->keys_per_shard = CHD_SHARDED_KEYS_PER_SHARD;
+	chd_sharded->memory_availability = CHD_SHARDED_MEMORY_AVAILABILITY;
+	return chd_sharded;
+}
+
+void chd_sharded_config_destroy(cmph_config_t *mph)
+{
+	chd_sharded_config_data_t *data = (chd_sharded_config_data_t *) mph->data;
+	DEBUGP("Destroying algorithm dependent data\n");
+	free(data);
+}
+
+void chd_sharded_config_set_hashfuncs(cmph_config_t *mph, CMPH_HASH *hashfuncs)
+{
+	chd_sharded_config_data_t *chd_sharded = (chd_sharded_config_data_t *) mph->data;
+	CMPH_HASH *hashptr = hashfuncs;
+	cmph_uint32 i = 0;
+	while(*hashptr != CMPH_HASH_COUNT)
+	{
+		if (i >= 1) break; // only one hash function selects the shards
+		chd_sharded->hashfunc = *hashptr;
+		++i, ++hashptr;
+	}
+}
+
+void chd_sharded_config_set_keys_per_shard(cmph_config_t *mph, cmph_uint32 keys_per_shard)
+{
+	chd_sharded_config_data_t *chd_sharded = (chd_sharded_config_data_t *) mph->data;
+	if (keys_per_shard == 0) keys_per_shard = CHD_SHARDED_KEYS_PER_SHARD;
+	chd_sharded->keys_per_shard = keys_per_shard;
+}
+
+void chd_sharded_config_set_memory_availability(cmph_config_t *mph, cmph_uint32 memory_availability)
+{
+	chd_sharded_config_data_t *chd_sharded = (chd_sharded_config_data_t *) mph->data;
+	if (memory_availability > 0) chd_sharded->memory_availability = (cmph_uint64)memory_availability*1024*1024;
+}
+
+void chd_sharded_config_set_keys_per_bin(cmph_config_t *mph, cmph_uint32 keys_per_bin)
+{
+	chd_sharded_config_data_t *chd_sharded = (chd_sharded_config_data_t *) mph->data;
+	chd_sharded->keys_per_bin = keys_per_bin;
+}
+
+void chd_sharded_config_set_b(cmph_config_t *mph, cmph_uint32 keys_per_bucket)
+{
+	chd_sharded_config_data_t *chd_sharded = (chd_sharded_config_data_t *) mph->data;
+	chd_sharded->keys_per_bucket = keys_per_bucket;
+}
+
+// Returns 0 when out of memory.
+static int chd_sharded_add_key(chd_sharded_job_t *job, chd_sharded_keys_t *keys, const char *key, cmph_uint32 keylen)
+{
+	size_t needed = keys->buflen + sizeof(cmph_uint32) + keylen;
+	if (needed > keys->bufsize)
+	{
+		size_t bufsize = keys->bufsize ? keys->bufsize : 256;
+		cmph_uint8 *buf;
+		while (bufsize < needed) bufsize <<= 1;
+		buf = (cmph_uint8 *)realloc(keys->buf, bufsize);
+		if (buf == NULL) return 0;
+		job->buffered += bufsize - keys->bufsize;
+		keys->buf = buf;
+		keys->bufsize = bufsize;
+	}
+	memcpy(keys->buf + keys->buflen, &keylen, sizeof(cmph_uint32));
+	memcpy(keys->buf + keys->buflen + sizeof(cmph_uint32), key, (size_t)keylen);
+	keys->buflen = needed;
+	keys->nkeys++;
+	return 1;
+}
+
+// Appends the buffered keys of every shard to the spill file, as one chunk
+// per shard, and releases the buffers. Returns 0 on failure.
+static int chd_sharded_spill(cmph_config_t *mph, chd_sharded_job_t *job, cmph_uint32 nshards)
+{
+	cmph_uint32 i;
+	if (job->spill == NULL && (job->spill = __config_tmpfile(mph)) == NULL) return 0;
+	DEBUGP("Spilling %llu bytes of keys\n", (unsigned long long)job->buffered);
+	for (i = 0; i < nshards; ++i)
+	{
+		chd_sharded_keys_t *keys = job->keys + i;
+		cmph_uint64 *chunks;
+		if (keys->buflen == 0) continue;
+		chunks = (cmph_uint64 *)realloc(keys->chunks, sizeof(cmph_uint64)*2*(keys->nchunks + 1));
+		if (chunks == NULL) return 0;
+		keys->chunks = chunks;
+		if (fwrite(keys->buf, keys->buflen, (size_t)1, job->spill) != 1) return 0;
+		chunks[2*keys->nchunks] = job->spill_size;
+		chunks[2*keys->nchunks + 1] = keys->buflen;
+		keys->nchunks++;
+		job->spill_size += keys->buflen;
+		mph->stats.tmp_bytes_written += keys->buflen;
+		free(keys->buf);
+		keys->buf = NULL;
+		keys->buflen = keys->bufsize = 0;
+	}
+	job->buffered = 0;
+	return 1;
+}
+
+// Reads the spilled chunks of a shard back, ahead of its buffered keys.
+// Returns 0 on failure.
+static int chd_sharded_unspill(cmph_config_t *mph, chd_sharded_job_t *job, chd_sharded_keys_t *keys)
+{
+	cmph_uint8 *buf, *ptr;
+	size_t size = keys->buflen;
+	cmph_uint32 i;
+	if (keys->nchunks == 0) return 1;
+	for (i = 0; i < keys->nchunks; ++i) size += (size_t)keys->chunks[2*i + 1];
+	buf = (cmph_uint8 *)malloc(size);
+	if (buf == NULL) return 0;
+	for (i = 0, ptr = buf; i < keys->nchunks; ++i)
+	{
+		size_t len = (size_t)keys->chunks[2*i + 1];
+		if (fseek(job->spill, (long)keys->chunks[2*i], SEEK_SET) != 0 || fread(ptr, len, (size_t)1, job->spill) != 1)
+		{
+			free(buf);
+			return 0;
+		}
+		ptr += len;
+		mph->stats.tmp_bytes_read += len;
+	}
+	if (keys->buflen) memcpy(ptr, keys->buf, keys->buflen);
+	free(keys->buf);
+	free(keys->chunks);
+	keys->buf = buf;
+	keys->buflen = keys->bufsize = size;
+	keys->chunks = NULL;
+	keys->nchunks = 0;
+	return 1;
+}
+
+// Builds the CHD function of one shard and releases its keys. A failure is
+// reported by leaving packed_shards[shard] NULL for a non empty shard.
+static void chd_sharded_build_task(void *arg, cmph_uint32 task)
+{
+	chd_sharded_job_t *job = (chd_sharded_job_t *)arg;
+	cmph_uint32 shard = job->first + task;
+	chd_sharded_keys_t *keys = job->keys + shard;
+	cmph_io_adapter_t *source;
+	cmph_config_t *config;
+	cmph_t *mphf;
+	cmph_uint8 **vector, *ptr;
+	cmph_uint32 i, keylen;
+	CMPH_HASH hashfuncs[2];
+
+	if (keys->nkeys == 0) return;
+	hashfuncs[0] = job->config->hashfunc; // shards use the same hash family
+	hashfuncs[1] = CMPH_HASH_COUNT;
+	vector = (cmph_uint8 **)malloc(sizeof(cmph_uint8 *)*keys->nkeys);
+	if (vector == NULL)
+	{
+		free(keys->buf);
+		keys->buf = NULL;
+		return;
+	}
+	for (i = 0, ptr = keys->buf; i < keys->nkeys; ++i)
+	{
+		vector[i] = ptr;
+		memcpy(&keylen, ptr, sizeof(cmph_uint32));
+		ptr += sizeof(cmph_uint32) + keylen;
+	}
+	source = cmph_io_byte_vector_adapter(vector, keys->nkeys);
+	config = cmph_config_new(source);
+	config->untimed = 1;
+	config->seed = __seed_derive(job->seed, shard); // rand() would depend on the scheduling of the threads
+	cmph_config_set_algo(config, CMPH_CHD);
+	cmph_config_set_hashfuncs(config, hashfuncs);
+	if (job->config->keys_per_bucket) cmph_config_set_b(config, job->config->keys_per_bucket);
+	if (job->config->keys_per_bin) cmph_config_set_keys_per_bin(config, job->config->keys_per_bin);
+	if (job->c != 0) cmph_config_set_graphsize(config, job->c);
+	mphf = cmph_new(config);
+	cmph_config_destroy(config);
+	cmph_io_byte_vector_adapter_destroy(source);
+	free(vector);
+	free(keys->buf);
+	keys->buf = NULL;
+
+	if (mphf == NULL) return;
+	job->packed_shards_size[shard] = cmph_packed_size(mphf);
+	job->packed_shards[shard] = (cmph_uint8 *)calloc((size_t)job->packed_shards_size[shard], (size_t)1);
+	if (job->packed_shards[shard]) cmph_pack(mphf, job->packed_shards[shard]);
+	cmph_destroy(mphf);
+}
+
+cmph_t *chd_sharded_new(cmph_config_t *mph, double c)
+{
+	cmph_t *mphf = NULL;
+	chd_sharded_data_t *chd_shardedf = NULL;
+	chd_sharded_config_data_t *chd_sharded = (chd_sharded_config_data_t *)mph->data;
+	chd_sharded_job_t job;
+	hash_state_t *h0;
+	cmph_uint64 nkeys = mph->key_source->nkeys;
+	cmph_uint64 e;
+	cmph_uint32 nshards, i, first, wave, failed = 0;
+	cmph_uint64 *offsets;
+	#ifdef CMPH_TIMING
+	double construction_time_begin = 0.0;
+	double construction_time = 0.0;
+	ELAPSED_TIME_IN_SECONDS(&construction_time_begin);
+	#endif
+
+	nshards = (cmph_uint32)ceil(nkeys/(double)chd_sharded->keys_per_shard);
+	if (nshards == 0) nshards = 1;
+	h0 = hash_state_new(chd_sharded->hashfunc, nshards);
+
+	// Partitioning step
+	if (mph->verbosity)
+	{
+		fprintf(stderr, "Partitioning %llu keys into %u shards\n", (unsigned long long)nkeys, nshards);
+	}
+	mph->stats.iterations++;
+	memset(&job, 0, sizeof(chd_sharded_job_t));
+	job.keys = (chd_sharded_keys_t *)calloc((size_t)nshards, sizeof(chd_sharded_keys_t));
+	mph->key_source->rewind(mph->key_source->data);
+	for (e = 0; e < nkeys && !failed; ++e)
+	{
+		char *key = NULL;
+		cmph_uint32 keylen;
+		mph->key_source->read(mph->key_source->data, &key, &keylen);
+		if (!chd_sharded_add_key(&job, job.keys + fastrange32(hash(h0, key, keylen), nshards), key, keylen)) failed = 1;
+		__key_dispose(mph->key_source, key, keylen);
+		if (job.buffered > chd_sharded->memory_availability && !chd_sharded_spill(mph, &job, nshards)) failed = 1;
+	}
+
+	// Building step, in waves of one shard per thread so that only the keys
+	// of the shards being built are read back from the spill file.
+	if (mph->verbosity)
+	{
+		fprintf(stderr, "Generating CHD functions for %u shards with %u threads\n", nshards, mph->nthreads);
+		if (job.spill) fprintf(stderr, "Spilled %llu bytes of keys to a temporary file\n", (unsigned long long)job.spill_size);
+	}
+	job.packed_shards = (cmph_uint8 **)calloc((size_t)nshards, sizeof(cmph_uint8 *));
+	job.packed_shards_size = (cmph_uint32 *)calloc((size_t)nshards, sizeof(cmph_uint32));
+	job.config = chd_sharded;
+	job.c = c;
+	job.seed = mph->seed ? mph->seed : (cmph_uint32)rand();
+	__config_phase(mph, CMPH_PHASE_SEARCHING);
+	wave = mph->nthreads > 1 ? mph->nthreads : 1;
+	for (first = 0; first < nshards && !failed; first += wave)
+	{
+		if (wave > nshards - first) wave = nshards - first;
+		for (i = first; i < first + wave && !failed; ++i)
+		{
+			if (!chd_sharded_unspill(mph, &job, job.keys + i)) failed = 1;
+		}
+		job.first = first;
+		if (!failed) thread_pool_run(mph->nthreads, wave, chd_sharded_build_task, &job);
+	}
+	if (job.spill) fclose(job.spill);
+
+	offsets = (cmph_uint64 *)malloc(sizeof(cmph_uint64)*(nshards + 1));
+	offsets[0] = 0;
+	for (i = 0; i < nshards; ++i)
+	{
+		if (job.keys[i].nkeys && job.packed_shards[i] == NULL) failed = 1;
+		offsets[i + 1] = offsets[i] + job.keys[i].nkeys;
+		free(job.keys[i].buf);
+		free(job.keys[i].chunks);
+	}
+	free(job.keys);
+	if (failed)
+	{
+		if (mph->verbosity)
+		{
+			fprintf(stderr, "Failure generating the function of a shard\n");
+		}
+		for (i = 0; i < nshards; ++i) free(job.packed_shards[i]);
+		free(job.packed_shards);
+		free(job.packed_shards_size);
+		free(offsets);
+		hash_state_destroy(h0);
+		return NULL;
+	}
+	#ifdef CMPH_TIMING
+	ELAPSED_TIME_IN_SECONDS(&construction_time);
+	#endif
+
+	mphf = (cmph_t *)malloc(sizeof(cmph_t));
+	mphf->algo = mph->algo;
+	mphf->version = CMPH_VERSION_FASTRANGE;
+	chd_shardedf = (chd_sharded_data_t *)malloc(sizeof(chd_sharded_data_t));
+	chd_shardedf->nshards = nshards;
+	chd_shardedf->h0 = h0;
+	h0 = NULL; //transfer memory ownership
+	chd_shardedf->offsets = offsets;
+	offsets = NULL; //transfer memory ownership
+	chd_shardedf->packed_shards = job.packed_shards;
+	chd_shardedf->packed_shards_size = job.packed_shards_size;
+	mphf->data = chd_shardedf;
+	mphf->size = nkeys;
+
+	DEBUGP("Successfully generated minimal perfect hash\n");
+	if (mph->verbosity)
+	{
+		fprintf(stderr, "Successfully generated minimal perfect hash function\n");
+	}
+	#ifdef CMPH_TIMING
+	register cmph_uint32 space_usage = chd_sharded_packed_size(mphf)*8;
+	construction_time = construction_time - construction_time_begin;
+	fprintf(stdout, "%llu\t%.2f\t%u\t%.4f\t%.4f\n", (unsigned long long)nkeys, c, nshards, construction_time, space_usage/(double)nkeys);
+	#endif
+	return mphf;
+}
+
+int chd_sharded_load(FILE *fd, cmph_t *mphf)
+{
+	char *buf = NULL;
+	cmph_uint32 buflen, i;
+	chd_sharded_data_t *chd_sharded = (chd_sharded_data_t *)calloc((size_t)1, sizeof(chd_sharded_data_t));
+
+	DEBUGP("Loading chd_sharded mphf\n");
+	mphf->data = chd_sharded;
+
+	if (fread(&buflen, sizeof(cmph_uint32), (size_t)1, fd) != 1) goto fail;
+	DEBUGP("Hash state has %u bytes\n", buflen);
+	buf = (char *)malloc((size_t)buflen);
+	if (fread(buf, (size_t)buflen, (size_t)1, fd) != 1)
+	{
+		free(buf);
+		goto fail;
+	}
+	chd_sharded->h0 = hash_state_load(buf, buflen);
+	free(buf);
+
+	if (fread(&chd_sharded->nshards, sizeof(cmph_uint32), (size_t)1, fd) != 1) goto fail;
+	chd_sharded->offsets = (cmph_uint64 *)malloc(sizeof(cmph_uint64)*(chd_sharded->nshards + 1));
+	chd_sharded->packed_shards = (cmph_uint8 **)calloc((size_t)chd_sharded->nshards, sizeof(cmph_uint8 *));
+	chd_sharded->packed_shards_size = (cmph_uint32 *)calloc((size_t)chd_sharded->nshards, sizeof(cmph_uint32));
+	if (fread(chd_sharded->offsets, sizeof(cmph_uint64)*(chd_sharded->nshards + 1), (size_t)1, fd) != 1) goto fail;
+	for (i = 0; i < chd_sharded->nshards; ++i)
+	{
+		if (fread(chd_sharded->packed_shards_size + i, sizeof(cmph_uint32), (size_t)1, fd) != 1) goto fail;
+		if (chd_sharded->packed_shards_size[i] == 0) continue;
+		chd_sharded->packed_shards[i] = (cmph_uint8 *)calloc((size_t)chd_sharded->packed_shards_size[i], (size_t)1);
+		if (fread(chd_sharded->packed_shards[i], chd_sharded->packed_shards_size[i], (size_t)1, fd) != 1) goto fail;
+	}
+	return 1;
+fail:
+	DEBUGP("Truncated chd_sharded mphf\n");
+	if (chd_sharded->packed_shards)
+	{
+		for (i = 0; i < chd_sharded->nshards; ++i) free(chd_sharded->packed_shards[i]);
+	}
+	free(chd_sharded->packed_shards);
+	free(chd_sharded->packed_shards_size);
+	free(chd_sharded->offsets);
+	if (chd_sharded->h0) hash_state_destroy(chd_sharded->h0);
+	free(chd_sharded);
+	mphf->data = NULL;
+	return 0;
+}
+
+int chd_sharded_dump(cmph_t *mphf, FILE *fd)
+{
+	char *buf = NULL;
+	cmph_uint32 buflen, i;
+	size_t nbytes;
+	chd_sharded_data_t *data = (chd_sharded_data_t *)mphf->data;
+
+	__cmph_dump(mphf, fd);
+
+	hash_state_dump(data->h0, &buf, &buflen);
+	DEBUGP("Dumping hash state with %u bytes to disk\n", buflen);
+	nbytes = fwrite(&buflen, sizeof(cmph_uint32), (size_t)1, fd);
+	nbytes += fwrite(buf, (size_t)buflen, (size_t)1, fd);
+	free(buf);
+	if (nbytes != 2) return 0;
+
+	if (fwrite(&data->nshards, sizeof(cmph_uint32), (size_t)1, fd) != 1) return 0;
+	if (fwrite(data->offsets, sizeof(cmph_uint64)*(data->nshards + 1), (size_t)1, fd) != 1) return 0;
+	for (i = 0; i < data->nshards; ++i)
+	{
+		DEBUGP("Dumping shard %u with %u bytes to disk\n", i, data->packed_shards_size[i]);
+		if (fwrite(data->packed_shards_size + i, sizeof(cmph_uint32), (size_t)1, fd) != 1) return 0;
+		if (data->packed_shards_size[i] == 0) continue;
+		if (fwrite(data->packed_shards[i], data->packed_shards_size[i], (size_t)1, fd) != 1) return 0;
+	}
+	return 1;
+}
+
+void chd_sharded_destroy(cmph_t *mphf)
+{
+	chd_sharded_data_t *data = (chd_sharded_data_t *)mphf->data;
+	cmph_uint32 i;
+	for (i = 0; i < data->nshards; ++i) free(data->packed_shards[i]);
+	free(data->packed_shards);
+	free(data->packed_shards_size);
+	free(data->offsets);
+	hash_state_destroy(data->h0);
+	free(data);
+	free(mphf);
+}
+
+cmph_uint32 chd_sharded_search(cmph_t *mphf, const char *key, cmph_uint32 keylen)
+{
+	return (cmph_uint32)chd_sharded_search64(mphf, key, keylen);
+}
+
+cmph_uint64 chd_sharded_search64(cmph_t *mphf, const char *key, cmph_uint32 keylen)
+{
+	register chd_sharded_data_t *chd_sharded = (chd_sharded_data_t *)mphf->data;
+	register cmph_uint32 shard = RANGE(hash(chd_sharded->h0, key, keylen), chd_sharded->nshards, mphf->version);
+	if (chd_sharded->packed_shards[shard] == NULL) return chd_sharded->offsets[shard];
+	return chd_sharded->offsets[shard] + cmph_search_packed(chd_sharded->packed_shards[shard], key, keylen);
+}
+
+// Shards are stored 4-byte aligned in the packed function, at 32-bit
+// positions, so packed functions are limited to 4GB.
+#define CHD_SHARDED_ALIGN(size) (((size) + 3U) & ~3U)
+
+/** \fn void chd_sharded_pack(cmph_t *mphf, void *packed_mphf);
+ *  \brief Support the ability to pack a perfect hash function into a preallocated contiguous memory space pointed by packed_mphf.
+ *  \param mphf pointer to the resulting mphf
+ *  \param packed_mphf pointer to the contiguous memory area used to store the resulting mphf. The size of packed_mphf must be at least cmph_packed_size()
+ */
+void chd_sharded_pack(cmph_t *mphf, void *packed_mphf)
+{
+	chd_sharded_data_t *data = (chd_sharded_data_t *)mphf->data;
+	cmph_uint8 * ptr = (cmph_uint8 *)packed_mphf;
+	cmph_uint32 *positions;
+	cmph_uint32 i;
+
+	if (chd_sharded_packed_size(mphf) == 0) return; // the positions of the shards do not fit in 32 bits
+	// packing h0 type
+	CMPH_HASH h0_type = hash_get_type(data->h0);
+	*((cmph_uint32 *) ptr) = h0_type | (mphf->version ? CMPH_PACKED_FASTRANGE : 0);
+	ptr += sizeof(cmph_uint32);
+
+	// packing h0
+	hash_state_pack(data->h0, ptr);
+	ptr += hash_state_packed_size(h0_type);
+
+	// packing nshards
+	*((cmph_uint32 *) ptr) = data->nshards;
+	ptr += sizeof(cmph_uint32);
+
+	// packing offsets
+	memcpy(ptr, data->offsets, sizeof(cmph_uint64)*(data->nshards + 1));
+	ptr += sizeof(cmph_uint64)*(data->nshards + 1);
+
+	// packing positions of the shards, relative to the end of this table
+	positions = (cmph_uint32 *)ptr;
+	ptr += sizeof(cmph_uint32)*(data->nshards + 1);
+	positions[0] = 0;
+	for (i = 0; i < data->nshards; ++i)
+	{
+		positions[i + 1] = positions[i] + CHD_SHARDED_ALIGN(data->packed_shards_size[i]);
+		if (data->packed_shards_size[i]) memcpy(ptr + positions[i], data->packed_shards[i], data->packed_shards_size[i]);
+	}
+}
+
+/** \fn cmph_uint32 chd_sharded_packed_size(cmph_t *mphf);
+ *  \brief Return the amount of space needed to pack mphf.
+ *  \param mphf pointer to a mphf
+ *  \return the size of the packed function or zero for failures
+ */
+cmph_uint32 chd_sharded_packed_size(cmph_t *mphf)
+{
+	chd_sharded_data_t *data = (chd_sharded_data_t *)mphf->data;
+	CMPH_HASH h0_type = hash_get_type(data->h0);
+	cmph_uint32 i;
+	cmph_uint64 size;
+
+	size = sizeof(CMPH_ALGO) + 2*sizeof(cmph_uint32) + hash_state_packed_size(h0_type) +
+	       (sizeof(cmph_uint64) + sizeof(cmph_uint32))*(cmph_uint64)(data->nshards + 1);
+	for (i = 0; i < data->nshards; ++i) size += CHD_SHARDED_ALIGN((cmph_uint64)data->packed_shards_size[i]);
+	if (size > UINT_MAX) return 0;
+	return (cmph_uint32)size;
+}
+
+/** cmph_uint32 chd_sharded_search_packed(void *packed_mphf, const char *key, cmph_uint32 keylen);
+ *  \brief Use the packed mphf to do a search.
+ *  \param  packed_mphf pointer to the packed mphf
+ *  \param key key to be hashed
+ *  \param keylen key legth in bytes
+ *  \return The mphf value
+ */
+cmph_uint32 chd_sharded_search_packed(void *packed_mphf, const char *key, cmph_uint32 keylen)
+{
+	return (cmph_uint32)chd_sharded_search_packed64(packed_mphf, key, keylen);
+}
+
+cmph_uint64 chd_sharded_search_packed64(void *packed_mphf, const char *key, cmph_uint32 keylen)
+{
+	register cmph_uint32 fastrange = *(cmph_uint32 *)packed_mphf & CMPH_PACKED_FASTRANGE;
+	register CMPH_HASH h0_type = (CMPH_HASH)(*(cmph_uint32 *)packed_mphf & ~CMPH_PACKED_FASTRANGE);
+	register cmph_uint8 *h0_ptr = (cmph_uint8 *)(packed_mphf) + 4;
+	register cmph_uint32 *ptr = (cmph_uint32 *)(h0_ptr + hash_state_packed_size(h0_type));
+	register cmph_uint32 nshards = *ptr++;
+	register cmph_uint64 *offsets = (cmph_uint64 *)ptr;
+	register cmph_uint32 *positions = (cmph_uint32 *)(offsets + nshards + 1);
+	register cmph_uint8 *shards = (cmph_uint8 *)(positions + nshards + 1);
+	register cmph_uint32 shard = RANGE(hash_packed(h0_ptr, h0_type, key, keylen), nshards, fastrange);
+
+	if (positions[shard] == positions[shard + 1]) return offsets[shard];
+	return offsets[shard] + cmph_search_packed(shards + positions[shard], key, keylen);
+}
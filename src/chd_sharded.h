@@ -0,0 +1,67 @@
+#ifndef __CMPH_CHD_SHARDED_H__
+#define __CMPH_CHD_SHARDED_H__
+
+#include "cmph.h"
+
+typedef struct __chd_sharded_data_t chd_sharded_data_t;
+typedef struct __chd_sharded_config_data_t chd_sharded_config_data_t;
+
+/* Config API */
+chd_sharded_config_data_t *chd_sharded_config_new(void);
+void chd_sharded_config_set_hashfuncs(cmph_config_t *mph, CMPH_HASH *hashfuncs);
+
+/** \fn void chd_sharded_config_set_keys_per_shard(cmph_config_t *mph, cmph_uint32 keys_per_shard);
+ *  \brief Allows to set the average number of keys of each independently built shard.
+ *  \param mph pointer to the configuration structure
+ *  \param keys_per_shard average number of keys per shard
+ */
+void chd_sharded_config_set_keys_per_shard(cmph_config_t *mph, cmph_uint32 keys_per_shard);
+
+/** \fn void chd_sharded_config_set_memory_availability(cmph_config_t *mph, cmph_uint32 memory_availability);
+ *  \brief Allows to set the memory used to buffer the keys of the shards, the keys that do not fit are spilled to a temporary file.
+ *  \param mph pointer to the configuration structure
+ *  \param memory_availability memory in MB
+ */
+void chd_sharded_config_set_memory_availability(cmph_config_t *mph, cmph_uint32 memory_availability);
+void chd_sharded_config_set_keys_per_bin(cmph_config_t *mph, cmph_uint32 keys_per_bin);
+void chd_sharded_config_set_b(cmph_config_t *mph, cmph_uint32 keys_per_bucket);
+void chd_sharded_config_destroy(cmph_config_t *mph);
+
+
+/* Sharded chd algorithm API */
+cmph_t *chd_sharded_new(cmph_config_t *mph, double c);
+/** \fn int chd_sharded_load(FILE *fd, cmph_t *mphf);
+ *  \brief Loads the algorithm dependent parts of mphf.
+ *  \return 0 when fd is truncated, mphf->data is then left NULL
+ */
+int chd_sharded_load(FILE *fd, cmph_t *mphf);
+int chd_sharded_dump(cmph_t *mphf, FILE *fd);
+void chd_sharded_destroy(cmph_t *mphf);
+cmph_uint32 chd_sharded_search(cmph_t *mphf, const char *key, cmph_uint32 keylen);
+cmph_uint64 chd_sharded_search64(cmph_t *mphf, const char *key, cmph_uint32 keylen);
+
+/** \fn void chd_sharded_pack(cmph_t *mphf, void *packed_mphf);
+ *  \brief Support the ability to pack a perfect hash function into a preallocated contiguous memory space pointed by packed_mphf.
+ *  \param mphf pointer to the resulting mphf
+ *  \param packed_mphf pointer to the contiguous memory area used to store the resulting mphf. The size of packed_mphf must be at least cmph_packed_size() 
+ */
+void chd_sharded_pack(cmph_t *mphf, void *packed_mphf);
+
+/** \fn cmph_uint32 chd_sharded_packed_size(cmph_t *mphf);
+ *  \brief Return the amount of space needed to pack mphf.
+ *  \param mphf pointer to a mphf
+ *  \return the size of the packed function or zero for failures
+ */ 
+cmph_uint32 chd_sharded_packed_size(cmph_t *mphf);
+
+/** cmph_uint32 chd_sharded_search_packed(void *packed_mphf, const char *key, cmph_uint32 keylen);
+ *  \brief Use the packed mphf to do a search. 
+ *  \param  packed_mphf pointer to the packed mphf
+ *  \param key key to be hashed
+ *  \param keylen key legth in bytes
+ *  \return The mphf value
+ */
+cmph_uint32 chd_sharded_search_packed(void *packed_mphf, const char *key, cmph_uint32 keylen);
+cmph_uint64 chd_sharded_search_packed64(void *packed_mphf, const char *key, cmph_uint32 keylen);
+
+#endif
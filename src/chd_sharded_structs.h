@@ -0,0 +1,24 @@
+#ifndef __CMPH_CHD_SHARDED_STRUCTS_H__
+#define __CMPH_CHD_SHARDED_STRUCTS_H__
+
+#include "hash_state.h"
+
+struct __chd_sharded_data_t
+{
+	cmph_uint32 nshards;
+	hash_state_t *h0;		// shard selection hash function
+	cmph_uint64 *offsets;		// nshards + 1 prefix sums of the shard sizes
+	cmph_uint32 *packed_shards_size;
+	cmph_uint8 **packed_shards;	// packed CHD function of each shard, NULL for empty shards
+};
+
+struct __chd_sharded_config_data_t
+{
+	CMPH_HASH hashfunc;		// hash function of the shard selection and of the shards
+	cmph_uint32 keys_per_shard;	// average number of keys per shard
+	cmph_uint32 keys_per_bucket;	// forwarded to the CHD of each shard
+	cmph_uint32 keys_per_bin;	// forwarded to the CHD of each shard
+	cmph_uint64 memory_availability;	// bytes of keys buffered before they are spilled to a temporary file
+};
+
+#endif
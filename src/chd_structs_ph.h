@@ -25,5 +25,6 @@ struct __chd_ph_config_data_t
 	cmph_uint32 keys_per_bin;//maximum number of keys per bin 
 	cmph_uint32 keys_per_bucket; // average number of keys per bucket
 	cmph_uint8 *occup_table;     // table that indicates occupied positions	
+	cmph_uint64 *fingerprints;   // of the keys during construction with CMPH_HASH_FINGERPRINT
 };
 #endif
@@ -28,6 +28,7 @@ chm_config_data_t *chm_config_new(void)
 	chm->g = NULL;
 	chm->graph = NULL;
 	chm->hashes = NULL;
+	chm->fingerprints = NULL;
 	return chm;
 }
 void chm_config_destroy(cmph_config_t *mph)
@@ -73,11 +74,16 @@ cmph_t *chm_new(cmph_config_t *mph, double c)
 	{
 		fprintf(stderr, "Entering mapping step for mph creation of %u keys with graph sized %u\n", chm->m, chm->n);
 	}
+	if (chm->hashfuncs[0] == CMPH_HASH_FINGERPRINT && chm->hashfuncs[1] == CMPH_HASH_FINGERPRINT)
+	{
+		__config_phase(mph, CMPH_PHASE_HASHING);
+		chm->fingerprints = __config_fingerprints(mph);
+	}
 	while(1)
 	{
 		int ok;
-		chm->hashes[0] = hash_state_new(chm->hashfuncs[0], chm->n);
-		chm->hashes[1] = hash_state_new(chm->hashfuncs[1], chm->n);
+		mph->stats.iterations++;
+		hash_pair_new(chm->hashfuncs[0], chm->hashfuncs[1], chm->n, &chm->hashes[0], &chm->hashes[1]);
 		ok = chm_gen_edges(mph);
 		if (!ok)
 		{
@@ -95,6 +101,8 @@ cmph_t *chm_new(cmph_config_t *mph, double c)
 		}
 		else break;
 	}
+	free(chm->fingerprints);
+	chm->fingerprints = NULL;
 	if (iterations == 0)
 	{
 		graph_destroy(chm->graph);
@@ -107,6 +115,7 @@ cmph_t *chm_new(cmph_config_t *mph, double c)
 		fprintf(stderr, "Starting assignment step\n");
 	}
 	DEBUGP("Assignment step\n");
+	__config_phase(mph, CMPH_PHASE_ASSIGNING);
  	visited = (cmph_uint8 *)malloc((size_t)(chm->n/8 + 1));
 	memset(visited, 0, (size_t)(chm->n/8 + 1));
 	free(chm->g);
@@ -126,6 +135,7 @@ cmph_t *chm_new(cmph_config_t *mph, double c)
 
 	mphf = (cmph_t *)malloc(sizeof(cmph_t));
 	mphf->algo = mph->algo;
+	mphf->version = 0;
 	chmf = (chm_data_t *)malloc(sizeof(chm_data_t));
 	chmf->g = chm->g;
 	chm->g = NULL; //transfer memory ownership
@@ -170,27 +180,33 @@ static int chm_gen_edges(cmph_config_t *mph)
 	int cycles = 0;
 
 	DEBUGP("Generating edges for %u vertices with hash functions %s and %s\n", chm->n, cmph_hash_names[chm->hashfuncs[0]], cmph_hash_names[chm->hashfuncs[1]]);
+	__config_phase(mph, CMPH_PHASE_HASHING);
 	graph_clear_edges(chm->graph);
-	mph->key_source->rewind(mph->key_source->data);
+	if (chm->fingerprints == NULL) mph->key_source->rewind(mph->key_source->data);
 	for (e = 0; e < mph->key_source->nkeys; ++e)
 	{
-		cmph_uint32 h1, h2;
+		cmph_uint32 h1, h2, hp[2];
 		cmph_uint32 keylen;
 		char *key;
-		mph->key_source->read(mph->key_source->data, &key, &keylen);
-		h1 = hash(chm->hashes[0], key, keylen) % chm->n;
-		h2 = hash(chm->hashes[1], key, keylen) % chm->n;
+		if (chm->fingerprints) hash_pair_fingerprint(chm->hashes[0], chm->hashes[1], chm->fingerprints + 2*e, hp);
+		else
+		{
+			mph->key_source->read(mph->key_source->data, &key, &keylen);
+			hash_pair(chm->hashes[0], chm->hashes[1], key, keylen, hp);
+			__key_dispose(mph->key_source, key, keylen);
+		}
+		h1 = hp[0] % chm->n;
+		h2 = hp[1] % chm->n;
 		if (h1 == h2) if (++h2 >= chm->n) h2 = 0;
 		if (h1 == h2)
 		{
 			if (mph->verbosity) fprintf(stderr, "Self loop for key %u\n", e);
-			mph->key_source->dispose(mph->key_source->data, key, keylen);
 			return 0;
 		}
-		DEBUGP("Adding edge: %u -> %u for key %s\n", h1, h2, key);
-		mph->key_source->dispose(mph->key_source->data, key, keylen);
+		DEBUGP("Adding edge: %u -> %u for key %u\n", h1, h2, e);
 		graph_add_edge(chm->graph, h1, h2);
 	}
+	__config_phase(mph, CMPH_PHASE_SEARCHING);
 	cycles = graph_is_cyclic(chm->graph);
 	if (mph->verbosity && cycles) fprintf(stderr, "Cyclic graph generated\n");
 	DEBUGP("Looking for cycles: %u\n", cycles);
@@ -202,24 +218,27 @@ int chm_dump(cmph_t *mphf, FILE *fd)
 {
 	char *buf = NULL;
 	cmph_uint32 buflen;
-	cmph_uint32 two = 2; //number of hash functions
 	chm_data_t *data = (chm_data_t *)mphf->data;
+	cmph_uint32 nhashes = data->hashes[1] ? 2 : 1; //number of hash functions
 	register size_t nbytes;
 
 	__cmph_dump(mphf, fd);
 
-	nbytes = fwrite(&two, sizeof(cmph_uint32), (size_t)1, fd);
+	nbytes = fwrite(&nhashes, sizeof(cmph_uint32), (size_t)1, fd);
 	hash_state_dump(data->hashes[0], &buf, &buflen);
 	DEBUGP("Dumping hash state with %u bytes to disk\n", buflen);
 	nbytes = fwrite(&buflen, sizeof(cmph_uint32), (size_t)1, fd);
 	nbytes = fwrite(buf, (size_t)buflen, (size_t)1, fd);
 	free(buf);
 
-	hash_state_dump(data->hashes[1], &buf, &buflen);
-	DEBUGP("Dumping hash state with %u bytes to disk\n", buflen);
-	nbytes = fwrite(&buflen, sizeof(cmph_uint32), (size_t)1, fd);
-	nbytes = fwrite(buf, (size_t)buflen, (size_t)1, fd);
-	free(buf);
+	if (nhashes == 2)
+	{
+		hash_state_dump(data->hashes[1], &buf, &buflen);
+		DEBUGP("Dumping hash state with %u bytes to disk\n", buflen);
+		nbytes = fwrite(&buflen, sizeof(cmph_uint32), (size_t)1, fd);
+		nbytes = fwrite(buf, (size_t)buflen, (size_t)1, fd);
+		free(buf);
+	}
 
 	nbytes = fwrite(&(data->n), sizeof(cmph_uint32), (size_t)1, fd);
 	nbytes = fwrite(&(data->m), sizeof(cmph_uint32), (size_t)1, fd);
@@ -277,8 +296,10 @@ void chm_load(FILE *f, cmph_t *mphf)
 cmph_uint32 chm_search(cmph_t *mphf, const char *key, cmph_uint32 keylen)
 {
 	chm_data_t *chm = (chm_data_t *)mphf->data;
-	cmph_uint32 h1 = hash(chm->hashes[0], key, keylen) % chm->n;
-	cmph_uint32 h2 = hash(chm->hashes[1], key, keylen) % chm->n;
+	cmph_uint32 hp[2], h1, h2;
+	hash_pair(chm->hashes[0], chm->hashes[1], key, keylen, hp);
+	h1 = hp[0] % chm->n;
+	h2 = hp[1] % chm->n;
 	DEBUGP("key: %s h1: %u h2: %u\n", key, h1, h2);
 	if (h1 == h2 && ++h2 >= chm->n) h2 = 0;
 	DEBUGP("key: %s g[h1]: %u g[h2]: %u edges: %u\n", key, chm->g[h1], chm->g[h2], chm->m);
@@ -372,8 +393,10 @@ cmph_uint32 chm_search_packed(void *packed_mphf, const char *key, cmph_uint32 ke
 	register cmph_uint32 n = *g_ptr++;
 	register cmph_uint32 m = *g_ptr++;
 
-	register cmph_uint32 h1 = hash_packed(h1_ptr, h1_type, key, keylen) % n;
-	register cmph_uint32 h2 = hash_packed(h2_ptr, h2_type, key, keylen) % n;
+	cmph_uint32 hp[2];
+	hash_pair_packed(h1_ptr, h1_type, h2_ptr, h2_type, key, keylen, hp);
+	register cmph_uint32 h1 = hp[0] % n;
+	register cmph_uint32 h2 = hp[1] % n;
 	DEBUGP("key: %s h1: %u h2: %u\n", key, h1, h2);
 	if (h1 == h2 && ++h2 >= n) h2 = 0;
 	DEBUGP("key: %s g[h1]: %u g[h2]: %u edges: %u\n", key, g_ptr[h1], g_ptr[h2], m);
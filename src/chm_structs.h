@@ -19,6 +19,7 @@ struct __chm_config_data_t
 	graph_t *graph;
 	cmph_uint32 *g;
 	hash_state_t **hashes;
+	cmph_uint64 *fingerprints; // of the keys during construction with CMPH_HASH_FINGERPRINT
 };
 
 #endif
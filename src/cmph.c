@@ -9,14 +9,24 @@
 #include "bdz_ph.h"
 #include "chd_ph.h"
 #include "chd.h"
+#include "chd_sharded.h"
+#include "duplicates.h"
 
 #include <stdlib.h>
 #include <assert.h>
 #include <string.h>
+#ifndef WIN32
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/resource.h>
+#endif
 // #define DEBUG
 #include "debug.h"
 
-const char *cmph_names[] = {"bmz", "bmz8", "chm", "brz", "fch", "bdz", "bdz_ph", "chd_ph", "chd", NULL };
+const char *cmph_names[] = {"bmz", "bmz8", "chm", "brz", "fch", "bdz", "bdz_ph", "chd_ph", "chd", "chd_sharded", NULL };
+const char *cmph_phase_names[] = {"hashing", "mapping", "searching", "assigning", "ranking", "compressing", NULL };
 
 typedef struct
 {
@@ -47,6 +57,54 @@ typedef struct
 } cmph_struct_vector_t;
 
 
+/**
+ * Support a memory mapped file of keys as the source of keys, either newline
+ * separated or in the binary key file format. Keys are returned as pointers
+ * into the mapping, so reading them allocates nothing and rewinding only
+ * resets the current offset.
+ */
+typedef struct
+{
+	char *base;           /* The mapped file */
+	cmph_uint64 size;     /* The size of the file in bytes */
+	cmph_uint64 start;    /* Offset of the first key */
+	cmph_uint64 position; /* Offset of the next key */
+} cmph_mapped_file_t;
+
+/**
+ * Binary key file: a header of CMPH_KEYFILE_HEADER_SIZE bytes holding the
+ * magic, the format version, the number of keys and the sum of their lengths,
+ * all little endian, followed by each key as its length in LEB128 and its bytes.
+ */
+#define CMPH_KEYFILE_MAGIC "CMPHKEYS"
+#define CMPH_KEYFILE_VERSION 1U
+#define CMPH_KEYFILE_HEADER_SIZE 32U
+
+/**
+ * Newline separated files are mapped and cut into chunks of about
+ * CMPH_CHUNK_SIZE bytes that end on a newline. Every chunk keeps its own
+ * cursor, so that threads can read disjoint chunks through read_batch, while
+ * read walks the chunks in order.
+ */
+#define CMPH_CHUNK_SIZE (1U << 20)
+
+typedef struct
+{
+	char *begin;    /* First key */
+	char *end;      /* One past the newline of the last key */
+	char *position; /* Next key */
+} cmph_nl_chunk_t;
+
+typedef struct
+{
+	cmph_mapped_file_t **files;
+	cmph_uint32 nfiles;
+	cmph_nl_chunk_t *chunks;
+	cmph_uint64 *chunk_first; /* Index of the first key of each chunk, and nkeys */
+	cmph_uint32 nchunks;
+	cmph_uint32 current;      /* Chunk of the next key returned by read */
+} cmph_mapped_nlfiles_t;
+
 static cmph_io_adapter_t *cmph_io_vector_new(void * vector, cmph_uint32 nkeys);
 static void cmph_io_vector_destroy(cmph_io_adapter_t * key_source);
 
@@ -78,15 +136,67 @@ static int key_nlfile_read(void *data, char **key, cmph_uint32 *keylen)
 	return (int)(*keylen);
 }
 
+static int key_mmap_nlfiles_read(void *data, char **key, cmph_uint32 *keylen)
+{
+	cmph_mapped_nlfiles_t *files = (cmph_mapped_nlfiles_t *)data;
+	*key = NULL;
+	*keylen = 0;
+	for (; files->current < files->nchunks; files->current++)
+	{
+		cmph_nl_chunk_t *chunk = files->chunks + files->current;
+		if (chunk->position < chunk->end)
+		{
+			char *newline = (char *)memchr(chunk->position, '\n', (size_t)(chunk->end - chunk->position));
+			*key = chunk->position;
+			*keylen = (cmph_uint32)(newline - chunk->position);
+			chunk->position = newline + 1;
+			return (int)(*keylen);
+		}
+	}
+	return -1;
+}
+
+static cmph_uint32 key_mmap_nlfiles_read_batch(void *data, cmph_uint32 chunk_id, char **keys, cmph_uint32 *keylens, cmph_uint32 max)
+{
+	cmph_nl_chunk_t *chunk = ((cmph_mapped_nlfiles_t *)data)->chunks + chunk_id;
+	cmph_uint32 n = 0;
+	for (; n < max && chunk->position < chunk->end; ++n)
+	{
+		char *newline = (char *)memchr(chunk->position, '\n', (size_t)(chunk->end - chunk->position));
+		keys[n] = chunk->position;
+		keylens[n] = (cmph_uint32)(newline - chunk->position);
+		chunk->position = newline + 1;
+	}
+	return n;
+}
+
+static int key_binfile_read(void *data, char **key, cmph_uint32 *keylen)
+{
+	cmph_mapped_file_t *file = (cmph_mapped_file_t *)data;
+	cmph_uint8 *ptr = (cmph_uint8 *)file->base + file->position;
+	cmph_uint8 *end = (cmph_uint8 *)file->base + file->size;
+	cmph_uint32 len = 0, shift = 0;
+	*key = NULL;
+	*keylen = 0;
+	while (ptr < end && shift < 35)
+	{
+		len |= (cmph_uint32)(*ptr & 0x7f) << shift;
+		shift += 7;
+		if (!(*ptr++ & 0x80)) break;
+	}
+	if (shift == 0 || (cmph_uint64)(end - ptr) < len) return -1;
+	*key = (char *)ptr;
+	*keylen = len;
+	file->position = (cmph_uint64)(ptr + len - (cmph_uint8 *)file->base);
+	return (int)(*keylen);
+}
+
 static int key_byte_vector_read(void *data, char **key, cmph_uint32 *keylen)
 {
 	cmph_vector_t *cmph_vector = (cmph_vector_t *)data;
 	cmph_uint8 **keys_vd = (cmph_uint8 **)cmph_vector->vector;
-	size_t size;
 	memcpy(keylen, keys_vd[cmph_vector->position], sizeof(*keylen));
-	size = *keylen;
-	*key = (char *)malloc(size);
-	memcpy(*key, keys_vd[cmph_vector->position] + sizeof(*keylen), size);
+	*key = (char *)keys_vd[cmph_vector->position] + sizeof(*keylen);
 	cmph_vector->position = cmph_vector->position + 1;
 	return (int)(*keylen);
 
@@ -97,14 +207,11 @@ static int key_struct_vector_read(void *data, char **key, cmph_uint32 *keylen)
     cmph_struct_vector_t *cmph_struct_vector = (cmph_struct_vector_t *)data;
     char *keys_vd = (char *)cmph_struct_vector->vector;
     cmph_uint64 keys_vd_offset;
-    size_t size;
     *keylen = cmph_struct_vector->key_len;
-    size = *keylen;
-    *key = (char *)malloc(size);
     keys_vd_offset = ((cmph_uint64)cmph_struct_vector->position * 
                       (cmph_uint64)cmph_struct_vector->struct_size) + 
                      (cmph_uint64)cmph_struct_vector->key_offset;
-    memcpy(*key, keys_vd + keys_vd_offset, size);
+    *key = keys_vd + keys_vd_offset;
     cmph_struct_vector->position = cmph_struct_vector->position + 1;
     return (int)(*keylen);
 }
@@ -113,11 +220,8 @@ static int key_vector_read(void *data, char **key, cmph_uint32 *keylen)
 {
         cmph_vector_t *cmph_vector = (cmph_vector_t *)data;
         char **keys_vd = (char **)cmph_vector->vector;
-	size_t size;
         *keylen = (cmph_uint32)strlen(keys_vd[cmph_vector->position]);
-	size = *keylen;
-        *key = (char *)malloc(size + 1);
-        strcpy(*key, keys_vd[cmph_vector->position]);
+        *key = keys_vd[cmph_vector->position];
         cmph_vector->position = cmph_vector->position + 1;
 	return (int)(*keylen);
 
@@ -129,9 +233,12 @@ static void key_nlfile_dispose(void *data, char *key, cmph_uint32 keylen)
 	free(key);
 }
 
-static void key_vector_dispose(void *data, char *key, cmph_uint32 keylen)
+static void key_borrowed_dispose(void *data, char *key, cmph_uint32 keylen)
 {
-	free(key);
+	// keys point into the vector of the caller or the mapping
+	(void)data;
+	(void)key;
+	(void)keylen;
 }
 
 static void key_nlfile_rewind(void *data)
@@ -140,6 +247,20 @@ static void key_nlfile_rewind(void *data)
 	rewind(fd);
 }
 
+static void key_mapped_file_rewind(void *data)
+{
+	cmph_mapped_file_t *file = (cmph_mapped_file_t *)data;
+	file->position = file->start;
+}
+
+static void key_mmap_nlfiles_rewind(void *data)
+{
+	cmph_mapped_nlfiles_t *files = (cmph_mapped_nlfiles_t *)data;
+	cmph_uint32 i;
+	for (i = 0; i < files->nchunks; ++i) files->chunks[i].position = files->chunks[i].begin;
+	files->current = 0;
+}
+
 static void key_struct_vector_rewind(void *data)
 {
 	cmph_struct_vector_t *cmph_struct_vector = (cmph_struct_vector_t *)data;
@@ -152,9 +273,9 @@ static void key_vector_rewind(void *data)
 	cmph_vector->position = 0;
 }
 
-static cmph_uint32 count_nlfile_keys(FILE *fd)
+static cmph_uint64 count_nlfile_keys(FILE *fd)
 {
-	cmph_uint32 count = 0;
+	cmph_uint64 count = 0;
 	register char * ptr;
 	rewind(fd);
 	while(1)
@@ -175,7 +296,7 @@ static cmph_uint32 count_nlfile_keys(FILE *fd)
 
 cmph_io_adapter_t *cmph_io_nlfile_adapter(FILE * keys_fd)
 {
-  cmph_io_adapter_t * key_source = (cmph_io_adapter_t *)malloc(sizeof(cmph_io_adapter_t));
+  cmph_io_adapter_t * key_source = (cmph_io_adapter_t *)calloc((size_t)1, sizeof(cmph_io_adapter_t));
   assert(key_source);
   key_source->data = (void *)keys_fd;
   key_source->nkeys = count_nlfile_keys(keys_fd);
@@ -190,9 +311,9 @@ void cmph_io_nlfile_adapter_destroy(cmph_io_adapter_t * key_source)
 	free(key_source);
 }
 
-cmph_io_adapter_t *cmph_io_nlnkfile_adapter(FILE * keys_fd, cmph_uint32 nkeys)
+cmph_io_adapter_t *cmph_io_nlnkfile_adapter(FILE * keys_fd, cmph_uint64 nkeys)
 {
-  cmph_io_adapter_t * key_source = (cmph_io_adapter_t *)malloc(sizeof(cmph_io_adapter_t));
+  cmph_io_adapter_t * key_source = (cmph_io_adapter_t *)calloc((size_t)1, sizeof(cmph_io_adapter_t));
   assert(key_source);
   key_source->data = (void *)keys_fd;
   key_source->nkeys = nkeys;
@@ -207,10 +328,267 @@ void cmph_io_nlnkfile_adapter_destroy(cmph_io_adapter_t * key_source)
 	free(key_source);
 }
 
+cmph_io_adapter_t *cmph_io_nlstream_adapter(FILE * keys_fd)
+{
+	return cmph_io_nlnkfile_adapter(keys_fd, CMPH_UNKNOWN_NKEYS);
+}
+
+void cmph_io_nlstream_adapter_destroy(cmph_io_adapter_t * key_source)
+{
+	free(key_source);
+}
+
+static cmph_mapped_file_t *cmph_map_stream(FILE *f)
+{
+	cmph_mapped_file_t * file = (cmph_mapped_file_t *)calloc((size_t)1, sizeof(cmph_mapped_file_t));
+#ifndef WIN32
+	struct stat st;
+	if (fstat(fileno(f), &st) != 0)
+	{
+		free(file);
+		return NULL;
+	}
+	file->size = (cmph_uint64)st.st_size;
+	if (file->size > 0)
+	{
+		file->base = (char *)mmap(NULL, (size_t)file->size, PROT_READ, MAP_SHARED, fileno(f), 0);
+		if (file->base == (char *)MAP_FAILED)
+		{
+			free(file);
+			return NULL;
+		}
+		madvise(file->base, (size_t)file->size, MADV_SEQUENTIAL);
+	}
+#else
+	// no mmap available, fall back to a private copy of the file
+	fseek(f, 0, SEEK_END);
+	file->size = (cmph_uint64)ftell(f);
+	fseek(f, 0, SEEK_SET);
+	if (file->size > 0)
+	{
+		file->base = (char *)malloc((size_t)file->size);
+		if (file->base == NULL || fread(file->base, (size_t)file->size, (size_t)1, f) != 1)
+		{
+			free(file->base);
+			free(file);
+			return NULL;
+		}
+	}
+#endif
+	return file;
+}
+
+static cmph_mapped_file_t *cmph_map_file(const char *filename)
+{
+	cmph_mapped_file_t * file;
+	FILE *f = fopen(filename, "rb");
+	if (f == NULL) return NULL;
+	file = cmph_map_stream(f);
+	fclose(f);
+	return file;
+}
+
+static void cmph_unmap_file(cmph_mapped_file_t *file)
+{
+#ifndef WIN32
+	if (file->size > 0) munmap(file->base, (size_t)file->size);
+#else
+	free(file->base);
+#endif
+	free(file);
+}
+
+static cmph_io_adapter_t *cmph_io_mapped_file_new(cmph_mapped_file_t *file, cmph_uint64 nkeys)
+{
+	cmph_io_adapter_t * key_source = (cmph_io_adapter_t *)calloc((size_t)1, sizeof(cmph_io_adapter_t));
+	assert(key_source);
+	file->position = file->start;
+	key_source->data = (void *)file;
+	key_source->nkeys = nkeys;
+	key_source->dispose = key_borrowed_dispose;
+	key_source->rewind = key_mapped_file_rewind;
+	key_source->flags = CMPH_IO_BORROWED_KEYS;
+	return key_source;
+}
+
+// Cuts the keys of file, up to its last newline, into chunks.
+static void cmph_cut_nlfile(cmph_mapped_nlfiles_t *files, cmph_mapped_file_t *file)
+{
+	char *begin = file->base;
+	char *end = file->base + file->size;
+	while (end > begin && end[-1] != '\n') --end; // a last line without newline is not a key, as in key_nlfile_read
+	while (begin < end)
+	{
+		cmph_nl_chunk_t *chunk;
+		cmph_uint64 nkeys = 0;
+		char *ptr;
+		files->chunks = (cmph_nl_chunk_t *)realloc(files->chunks, sizeof(cmph_nl_chunk_t)*(files->nchunks + 1));
+		files->chunk_first = (cmph_uint64 *)realloc(files->chunk_first, sizeof(cmph_uint64)*(files->nchunks + 2));
+		chunk = files->chunks + files->nchunks;
+		chunk->begin = chunk->position = begin;
+		chunk->end = end - begin > CMPH_CHUNK_SIZE ? (char *)memchr(begin + CMPH_CHUNK_SIZE - 1, '\n', (size_t)(end - begin) - CMPH_CHUNK_SIZE + 1) + 1 : end;
+		for (ptr = begin; ptr < chunk->end; ++nkeys) ptr = (char *)memchr(ptr, '\n', (size_t)(chunk->end - ptr)) + 1;
+		files->chunk_first[files->nchunks + 1] = files->chunk_first[files->nchunks] + nkeys;
+		files->nchunks++;
+		begin = chunk->end;
+	}
+}
+
+static void cmph_mapped_nlfiles_destroy(cmph_mapped_nlfiles_t *files)
+{
+	cmph_uint32 i;
+	for (i = 0; i < files->nfiles; ++i) cmph_unmap_file(files->files[i]);
+	free(files->files);
+	free(files->chunks);
+	free(files->chunk_first);
+	free(files);
+}
+
+cmph_io_adapter_t *cmph_io_mmap_nlfiles_adapter(const char **filenames, cmph_uint32 nfiles)
+{
+	cmph_io_adapter_t * key_source;
+	cmph_mapped_nlfiles_t * files = (cmph_mapped_nlfiles_t *)calloc((size_t)1, sizeof(cmph_mapped_nlfiles_t));
+	assert(files);
+	files->files = (cmph_mapped_file_t **)calloc((size_t)nfiles + 1, sizeof(cmph_mapped_file_t *));
+	// chunk_first keeps one more entry than there are chunks
+	files->chunk_first = (cmph_uint64 *)calloc((size_t)1, sizeof(cmph_uint64));
+	for (files->nfiles = 0; files->nfiles < nfiles; files->nfiles++)
+	{
+		cmph_mapped_file_t *file = cmph_map_file(filenames[files->nfiles]);
+		if (file == NULL)
+		{
+			DEBUGP("Unable to map %s\n", filenames[files->nfiles]);
+			cmph_mapped_nlfiles_destroy(files);
+			return NULL;
+		}
+		files->files[files->nfiles] = file;
+		cmph_cut_nlfile(files, file);
+	}
+	key_source = (cmph_io_adapter_t *)calloc((size_t)1, sizeof(cmph_io_adapter_t));
+	assert(key_source);
+	key_source->data = (void *)files;
+	key_source->nkeys = files->chunk_first[files->nchunks];
+	key_source->read = key_mmap_nlfiles_read;
+	key_source->dispose = key_borrowed_dispose;
+	key_source->rewind = key_mmap_nlfiles_rewind;
+	key_source->flags = CMPH_IO_BORROWED_KEYS;
+	key_source->nchunks = files->nchunks;
+	key_source->chunk_first = files->chunk_first;
+	key_source->read_batch = key_mmap_nlfiles_read_batch;
+	return key_source;
+}
+
+void cmph_io_mmap_nlfiles_adapter_destroy(cmph_io_adapter_t * key_source)
+{
+	cmph_mapped_nlfiles_destroy((cmph_mapped_nlfiles_t *)key_source->data);
+	free(key_source);
+}
+
+cmph_io_adapter_t *cmph_io_mmap_nlfile_adapter(const char *filename)
+{
+	return cmph_io_mmap_nlfiles_adapter(&filename, 1);
+}
+
+void cmph_io_mmap_nlfile_adapter_destroy(cmph_io_adapter_t * key_source)
+{
+	cmph_io_mmap_nlfiles_adapter_destroy(key_source);
+}
+
+static cmph_uint64 cmph_keyfile_get64(const cmph_uint8 *ptr)
+{
+	cmph_uint64 value = 0;
+	cmph_uint32 i;
+	for (i = 8; i-- > 0;) value = (value << 8) | ptr[i];
+	return value;
+}
+
+static void cmph_keyfile_set64(cmph_uint8 *ptr, cmph_uint64 value)
+{
+	cmph_uint32 i;
+	for (i = 0; i < 8; i++, value >>= 8) ptr[i] = (cmph_uint8)value;
+}
+
+static cmph_io_adapter_t *cmph_io_binfile_new(cmph_mapped_file_t *file)
+{
+	cmph_io_adapter_t * key_source;
+	cmph_uint8 *header;
+	cmph_uint64 nkeys, nbytes;
+	if (file == NULL) return NULL;
+	header = (cmph_uint8 *)file->base;
+	if (file->size < CMPH_KEYFILE_HEADER_SIZE || memcmp(header, CMPH_KEYFILE_MAGIC, (size_t)8) != 0 ||
+	    cmph_keyfile_get64(header + 8) != CMPH_KEYFILE_VERSION)
+	{
+		DEBUGP("Not a binary key file\n");
+		cmph_unmap_file(file);
+		return NULL;
+	}
+	nkeys = cmph_keyfile_get64(header + 16);
+	nbytes = cmph_keyfile_get64(header + 24);
+	// every key takes its bytes and one to five bytes of length
+	if (file->size - CMPH_KEYFILE_HEADER_SIZE < nbytes + nkeys || file->size - CMPH_KEYFILE_HEADER_SIZE > nbytes + 5*nkeys)
+	{
+		DEBUGP("Truncated or corrupted binary key file\n");
+		cmph_unmap_file(file);
+		return NULL;
+	}
+	file->start = CMPH_KEYFILE_HEADER_SIZE;
+	key_source = cmph_io_mapped_file_new(file, nkeys);
+	key_source->read = key_binfile_read;
+	return key_source;
+}
+
+cmph_io_adapter_t *cmph_io_binfile_adapter(const char *filename)
+{
+	return cmph_io_binfile_new(cmph_map_file(filename));
+}
+
+void cmph_io_binfile_adapter_destroy(cmph_io_adapter_t * key_source)
+{
+	cmph_unmap_file((cmph_mapped_file_t *)key_source->data);
+	free(key_source);
+}
+
+int cmph_io_binfile_write(cmph_io_adapter_t * key_source, FILE * f)
+{
+	cmph_uint8 header[CMPH_KEYFILE_HEADER_SIZE];
+	cmph_uint64 i, nbytes = 0;
+	long start = ftell(f);
+	int ok = 1;
+
+	memset(header, 0, sizeof(header));
+	memcpy(header, CMPH_KEYFILE_MAGIC, (size_t)8);
+	cmph_keyfile_set64(header + 8, CMPH_KEYFILE_VERSION);
+	// the number of keys and the sum of their lengths are filled in once the keys are written
+	if (start < 0 || fwrite(header, sizeof(header), (size_t)1, f) != 1) return 0;
+	key_source->rewind(key_source->data);
+	for (i = 0; ok && i < key_source->nkeys; ++i)
+	{
+		char *key = NULL;
+		cmph_uint32 keylen, len;
+		cmph_uint8 varint[5];
+		size_t n = 0;
+		if (key_source->read(key_source->data, &key, &keylen) < 0)
+		{
+			// the keys of a source of unknown size end with a failed read
+			if (key) key_source->dispose(key_source->data, key, keylen);
+			break;
+		}
+		for (len = keylen; len >= 0x80; len >>= 7) varint[n++] = (cmph_uint8)(len | 0x80);
+		varint[n++] = (cmph_uint8)len;
+		ok = fwrite(varint, n, (size_t)1, f) == 1 && (keylen == 0 || fwrite(key, (size_t)keylen, (size_t)1, f) == 1);
+		nbytes += keylen;
+		key_source->dispose(key_source->data, key, keylen);
+	}
+	cmph_keyfile_set64(header + 16, i);
+	cmph_keyfile_set64(header + 24, nbytes);
+	if (!ok || fseek(f, start, SEEK_SET) != 0 || fwrite(header, sizeof(header), (size_t)1, f) != 1) return 0;
+	return fseek(f, 0, SEEK_END) == 0;
+}
+
 
 static cmph_io_adapter_t *cmph_io_struct_vector_new(void * vector, cmph_uint32 struct_size, cmph_uint32 key_offset, cmph_uint32 key_len, cmph_uint32 nkeys)
 {
-	cmph_io_adapter_t * key_source = (cmph_io_adapter_t *)malloc(sizeof(cmph_io_adapter_t));
+	cmph_io_adapter_t * key_source = (cmph_io_adapter_t *)calloc((size_t)1, sizeof(cmph_io_adapter_t));
 	cmph_struct_vector_t * cmph_struct_vector = (cmph_struct_vector_t *)malloc(sizeof(cmph_struct_vector_t));
 	assert(key_source);
 	assert(cmph_struct_vector);
@@ -221,6 +599,7 @@ static cmph_io_adapter_t *cmph_io_struct_vector_new(void * vector, cmph_uint32 s
 	cmph_struct_vector->key_len = key_len;
 	key_source->data = (void *)cmph_struct_vector;
 	key_source->nkeys = nkeys;
+	key_source->flags = CMPH_IO_BORROWED_KEYS;
 	return key_source;
 }
 
@@ -234,7 +613,7 @@ static void cmph_io_struct_vector_destroy(cmph_io_adapter_t * key_source)
 
 static cmph_io_adapter_t *cmph_io_vector_new(void * vector, cmph_uint32 nkeys)
 {
-	cmph_io_adapter_t * key_source = (cmph_io_adapter_t *)malloc(sizeof(cmph_io_adapter_t));
+	cmph_io_adapter_t * key_source = (cmph_io_adapter_t *)calloc((size_t)1, sizeof(cmph_io_adapter_t));
 	cmph_vector_t * cmph_vector = (cmph_vector_t *)malloc(sizeof(cmph_vector_t));
 	assert(key_source);
 	assert(cmph_vector);
@@ -242,6 +621,7 @@ static cmph_io_adapter_t *cmph_io_vector_new(void * vector, cmph_uint32 nkeys)
 	cmph_vector->position = 0;
 	key_source->data = (void *)cmph_vector;
 	key_source->nkeys = nkeys;
+	key_source->flags = CMPH_IO_BORROWED_KEYS;
 	return key_source;
 }
 
@@ -257,7 +637,7 @@ cmph_io_adapter_t *cmph_io_byte_vector_adapter(cmph_uint8 ** vector, cmph_uint32
 {
 	cmph_io_adapter_t * key_source = cmph_io_vector_new(vector, nkeys);
 	key_source->read = key_byte_vector_read;
-	key_source->dispose = key_vector_dispose;
+	key_source->dispose = key_borrowed_dispose;
 	key_source->rewind = key_vector_rewind;
 	return key_source;
 }
@@ -270,7 +650,7 @@ cmph_io_adapter_t *cmph_io_struct_vector_adapter(void * vector, cmph_uint32 stru
 {
 	cmph_io_adapter_t * key_source = cmph_io_struct_vector_new(vector, struct_size, key_offset, key_len, nkeys);
 	key_source->read = key_struct_vector_read;
-	key_source->dispose = key_vector_dispose;
+	key_source->dispose = key_borrowed_dispose;
 	key_source->rewind = key_struct_vector_rewind;
 	return key_source;
 }
@@ -280,11 +660,31 @@ void cmph_io_struct_vector_adapter_destroy(cmph_io_adapter_t * key_source)
 	cmph_io_struct_vector_destroy(key_source);
 }
 
+cmph_io_adapter_t *cmph_io_u32_vector_adapter(cmph_uint32 * vector, cmph_uint32 nkeys)
+{
+	return cmph_io_struct_vector_adapter(vector, (cmph_uint32)sizeof(cmph_uint32), 0, (cmph_uint32)sizeof(cmph_uint32), nkeys);
+}
+
+void cmph_io_u32_vector_adapter_destroy(cmph_io_adapter_t * key_source)
+{
+	cmph_io_struct_vector_destroy(key_source);
+}
+
+cmph_io_adapter_t *cmph_io_u64_vector_adapter(cmph_uint64 * vector, cmph_uint32 nkeys)
+{
+	return cmph_io_struct_vector_adapter(vector, (cmph_uint32)sizeof(cmph_uint64), 0, (cmph_uint32)sizeof(cmph_uint64), nkeys);
+}
+
+void cmph_io_u64_vector_adapter_destroy(cmph_io_adapter_t * key_source)
+{
+	cmph_io_struct_vector_destroy(key_source);
+}
+
 cmph_io_adapter_t *cmph_io_vector_adapter(char ** vector, cmph_uint32 nkeys)
 {
 	cmph_io_adapter_t * key_source = cmph_io_vector_new(vector, nkeys);
 	key_source->read = key_vector_read;
-	key_source->dispose = key_vector_dispose;
+	key_source->dispose = key_borrowed_dispose;
 	key_source->rewind = key_vector_rewind;
 	return key_source;
 }
@@ -337,6 +737,9 @@ void cmph_config_set_algo(cmph_config_t *mph, CMPH_ALGO algo)
 			case CMPH_CHD:
 				chd_config_destroy(mph);
 				break;
+			case CMPH_CHD_SHARDED:
+				chd_sharded_config_destroy(mph);
+				break;
 			default:
 				assert(0);
 		}
@@ -369,6 +772,9 @@ void cmph_config_set_algo(cmph_config_t *mph, CMPH_ALGO algo)
 			case CMPH_CHD:
 				mph->data = chd_config_new(mph);
 				break;
+			case CMPH_CHD_SHARDED:
+				mph->data = chd_sharded_config_new();
+				break;
 			default:
 				assert(0);
 		}
@@ -378,6 +784,11 @@ void cmph_config_set_algo(cmph_config_t *mph, CMPH_ALGO algo)
 
 void cmph_config_set_tmp_dir(cmph_config_t *mph, cmph_uint8 *tmp_dir)
 {
+	if (tmp_dir)
+	{
+		free(mph->tmp_dir);
+		mph->tmp_dir = (cmph_uint8 *)strdup((char *)tmp_dir);
+	}
 	if (mph->algo == CMPH_BRZ)
 	{
 		brz_config_set_tmp_dir(mph, tmp_dir);
@@ -411,6 +822,10 @@ void cmph_config_set_b(cmph_config_t *mph, cmph_uint32 b)
 	{
 		chd_config_set_b(mph, b);
 	}
+	else if (mph->algo == CMPH_CHD_SHARDED)
+	{
+		chd_sharded_config_set_b(mph, b);
+	}
 }
 
 void cmph_config_set_keys_per_bin(cmph_config_t *mph, cmph_uint32 keys_per_bin)
@@ -423,6 +838,26 @@ void cmph_config_set_keys_per_bin(cmph_config_t *mph, cmph_uint32 keys_per_bin)
 	{
 		chd_config_set_keys_per_bin(mph, keys_per_bin);
 	}
+	else if (mph->algo == CMPH_CHD_SHARDED)
+	{
+		chd_sharded_config_set_keys_per_bin(mph, keys_per_bin);
+	}
+}
+
+void cmph_config_set_keys_per_shard(cmph_config_t *mph, cmph_uint32 keys_per_shard)
+{
+	if (mph->algo == CMPH_CHD_SHARDED)
+	{
+		chd_sharded_config_set_keys_per_shard(mph, keys_per_shard);
+	}
+}
+
+void cmph_config_set_bucket_algo(cmph_config_t *mph, CMPH_ALGO algo)
+{
+	if (mph->algo == CMPH_BRZ)
+	{
+		brz_config_set_algo(mph, algo);
+	}
 }
 
 void cmph_config_set_memory_availability(cmph_config_t *mph, cmph_uint32 memory_availability)
@@ -431,6 +866,10 @@ void cmph_config_set_memory_availability(cmph_config_t *mph, cmph_uint32 memory_
 	{
 		brz_config_set_memory_availability(mph, memory_availability);
 	}
+	else if (mph->algo == CMPH_CHD_SHARDED)
+	{
+		chd_sharded_config_set_memory_availability(mph, memory_availability);
+	}
 }
 
 void cmph_config_destroy(cmph_config_t *mph)
@@ -467,6 +906,9 @@ void cmph_config_destroy(cmph_config_t *mph)
 			case CMPH_CHD: /* included -- Fabiano */
 				chd_config_destroy(mph);
 				break;
+			case CMPH_CHD_SHARDED:
+				chd_sharded_config_destroy(mph);
+				break;
 			default:
 				assert(0);
 		}
@@ -479,6 +921,21 @@ void cmph_config_set_verbosity(cmph_config_t *mph, cmph_uint32 verbosity)
 	mph->verbosity = verbosity;
 }
 
+void cmph_config_set_threads(cmph_config_t *mph, cmph_uint32 nthreads)
+{
+	mph->nthreads = nthreads ? nthreads : 1;
+}
+
+void cmph_config_set_duplicates(cmph_config_t *mph, CMPH_DUPLICATES duplicates)
+{
+	mph->duplicates = duplicates;
+}
+
+void cmph_config_get_build_stats(cmph_config_t *mph, cmph_build_stats_t *stats)
+{
+	*stats = mph->stats;
+}
+
 void cmph_config_set_hashfuncs(cmph_config_t *mph, CMPH_HASH *hashfuncs)
 {
 	switch (mph->algo)
@@ -510,6 +967,9 @@ void cmph_config_set_hashfuncs(cmph_config_t *mph, CMPH_HASH *hashfuncs)
 		case CMPH_CHD: /* included -- Fabiano */
 			chd_config_set_hashfuncs(mph, hashfuncs);
 			break;
+		case CMPH_CHD_SHARDED:
+			chd_sharded_config_set_hashfuncs(mph, hashfuncs);
+			break;
 		default:
 			break;
 	}
@@ -521,13 +981,112 @@ void cmph_config_set_graphsize(cmph_config_t *mph, double c)
 	return;
 }
 
+static void cmph_build_stats_finish(cmph_build_stats_t *stats, cmph_t *mphf)
+{
+	cmph_uint32 i;
+#ifndef WIN32
+	struct rusage usage;
+	if (getrusage(RUSAGE_SELF, &usage) == 0)
+	{
+#ifdef __APPLE__
+		stats->peak_memory = (cmph_uint64)usage.ru_maxrss;
+#else
+		stats->peak_memory = (cmph_uint64)usage.ru_maxrss*1024;
+#endif
+	}
+#endif
+	stats->total_wall_time = stats->total_cpu_time = 0;
+	for (i = 0; i < CMPH_PHASE_COUNT; ++i)
+	{
+		stats->total_wall_time += stats->wall_time[i];
+		stats->total_cpu_time += stats->cpu_time[i];
+	}
+	if (mphf && mphf->size) stats->bits_per_key = cmph_packed_size(mphf)*8.0/(double)mphf->size;
+}
+
+// Reads the keys of a source of unknown size once, into a temporary binary
+// key file in the temporary directory of mph that is then read through its
+// mapping as often as needed.
+static cmph_io_adapter_t *cmph_io_spill(cmph_config_t *mph, cmph_io_adapter_t *key_source, cmph_uint64 *nbytes)
+{
+	cmph_io_adapter_t *spill = NULL;
+	FILE *f = __config_tmpfile(mph);
+	if (f == NULL) return NULL;
+	if (cmph_io_binfile_write(key_source, f) && fflush(f) == 0)
+	{
+		*nbytes = (cmph_uint64)ftell(f);
+		spill = cmph_io_binfile_new(cmph_map_stream(f));
+	}
+	fclose(f);
+	return spill;
+}
+
+// Finds the duplicated keys of mph and, when they are to be dropped, has them
+// read through an adapter that skips them. Returns 0 when the construction
+// must not go on.
+static int cmph_check_duplicates(cmph_config_t *mph, cmph_io_adapter_t **unique)
+{
+	cmph_build_stats_t *stats = &mph->stats;
+	cmph_uint8 *duplicates = duplicates_find(mph, &stats->duplicates, &stats->first_duplicate);
+	if (duplicates == NULL)
+	{
+		if (mph->verbosity) fprintf(stderr, "Unable to check the keys for duplicates\n");
+		return 0;
+	}
+	if (stats->duplicates == 0)
+	{
+		free(duplicates);
+		return 1;
+	}
+	if (mph->verbosity)
+	{
+		fprintf(stderr, "%llu duplicated keys in the input, the first one is key number %llu\n",
+		        (unsigned long long)stats->duplicates, (unsigned long long)stats->first_duplicate + 1);
+	}
+	if (mph->duplicates == CMPH_DUPLICATES_DROP) *unique = duplicates_adapter(mph->key_source, duplicates, stats->duplicates);
+	if (*unique == NULL)
+	{
+		free(duplicates);
+		return 0;
+	}
+	mph->key_source = *unique;
+	return 1;
+}
+
 cmph_t *cmph_new(cmph_config_t *mph)
 {
 	cmph_t *mphf = NULL;
 	double c = mph->c;
+	cmph_io_adapter_t *key_source = mph->key_source;
+	cmph_io_adapter_t *spill = NULL, *unique = NULL;
 
 	DEBUGP("Creating mph with algorithm %s\n", cmph_names[mph->algo]);
-	switch (mph->algo)
+	memset(&mph->stats, 0, sizeof(cmph_build_stats_t));
+	__config_phase(mph, CMPH_PHASE_HASHING);
+	if (key_source->nkeys == CMPH_UNKNOWN_NKEYS)
+	{
+		spill = cmph_io_spill(mph, key_source, &mph->stats.tmp_bytes_written);
+		if (spill == NULL)
+		{
+			if (mph->verbosity) fprintf(stderr, "Unable to spill the keys to a temporary file\n");
+			__config_phase(mph, CMPH_PHASE_COUNT);
+			return NULL;
+		}
+		mph->key_source = spill;
+		if (mph->verbosity) fprintf(stderr, "Spilled %llu keys to a temporary file\n", (unsigned long long)mph->key_source->nkeys);
+	}
+	if (mph->duplicates != CMPH_DUPLICATES_IGNORE && !cmph_check_duplicates(mph, &unique))
+	{
+		DEBUGP("Stopping the construction after checking for duplicated keys\n");
+	}
+	else if (mph->key_source->nkeys >= CMPH_SIZE64_FLAG && mph->algo != CMPH_BRZ && mph->algo != CMPH_CHD_SHARDED)
+	{
+		if (mph->verbosity)
+		{
+			fprintf(stderr, "Algorithm %s supports less than %u keys, use brz or chd_sharded\n", cmph_names[mph->algo], CMPH_SIZE64_FLAG);
+		}
+	}
+	else switch (mph->algo)
 	{
 		case CMPH_CHM:
 			DEBUGP("Creating chm hash\n");
@@ -543,8 +1102,6 @@ cmph_t *cmph_new(cmph_config_t *mph)
 			break;
 		case CMPH_BRZ: /* included -- Fabiano */
 			DEBUGP("Creating brz hash\n");
-			if (c >= 2.0) brz_config_set_algo(mph, CMPH_FCH);
-			else brz_config_set_algo(mph, CMPH_BMZ8);
 			mphf = brz_new(mph, c);
 			break;
 		case CMPH_FCH: /* included -- Fabiano */
@@ -567,9 +1124,18 @@ cmph_t *cmph_new(cmph_config_t *mph)
 			DEBUGP("Creating chd hash\n");
 			mphf = chd_new(mph, c);
 			break;
+		case CMPH_CHD_SHARDED:
+			DEBUGP("Creating chd_sharded hash\n");
+			mphf = chd_sharded_new(mph, c);
+			break;
 		default:
 			assert(0);
 	}
+	if (unique) duplicates_adapter_destroy(unique);
+	if (spill) cmph_io_binfile_adapter_destroy(spill);
+	mph->key_source = key_source;
+	__config_phase(mph, CMPH_PHASE_COUNT);
+	if (!mph->untimed) cmph_build_stats_finish(&mph->stats, mphf);
 	return mphf;
 }
 
@@ -595,6 +1161,8 @@ int cmph_dump(cmph_t *mphf, FILE *f)
 			return chd_ph_dump(mphf, f);
 		case CMPH_CHD: /* included -- Fabiano */
 			return chd_dump(mphf, f);
+		case CMPH_CHD_SHARDED:
+			return chd_sharded_dump(mphf, f);
 		default:
 			assert(0);
 	}
@@ -624,7 +1192,11 @@ cmph_t *cmph_load(FILE *f)
 			break;
 		case CMPH_BRZ: /* included -- Fabiano */
 			DEBUGP("Loading brz algorithm dependent parts\n");
-			brz_load(f, mphf);
+			if (!brz_load(f, mphf))
+			{
+				free(mphf);
+				return NULL;
+			}
 			break;
 		case CMPH_FCH: /* included -- Fabiano */
 			DEBUGP("Loading fch algorithm dependent parts\n");
@@ -646,6 +1218,14 @@ cmph_t *cmph_load(FILE *f)
 			DEBUGP("Loading chd algorithm dependent parts\n");
 			chd_load(f, mphf);
 			break;
+		case CMPH_CHD_SHARDED:
+			DEBUGP("Loading chd_sharded algorithm dependent parts\n");
+			if (!chd_sharded_load(f, mphf))
+			{
+				free(mphf);
+				return NULL;
+			}
+			break;
 		default:
 			assert(0);
 	}
@@ -685,6 +1265,9 @@ cmph_uint32 cmph_search(cmph_t *mphf, const char *key, cmph_uint32 keylen)
 		case CMPH_CHD: /* included -- Fabiano */
 		        DEBUGP("chd algorithm search\n");
 		        return chd_search(mphf, key, keylen);
+		case CMPH_CHD_SHARDED:
+		        DEBUGP("chd_sharded algorithm search\n");
+		        return chd_sharded_search(mphf, key, keylen);
 		default:
 			assert(0);
 	}
@@ -692,7 +1275,80 @@ cmph_uint32 cmph_search(cmph_t *mphf, const char *key, cmph_uint32 keylen)
 	return 0;
 }
 
+void cmph_search_batch(cmph_t *mphf, const char **keys, const cmph_uint32 *keylens, cmph_uint32 n, cmph_uint32 *out)
+{
+	cmph_uint32 i;
+	DEBUGP("mphf algorithm: %u \n", mphf->algo);
+	switch(mphf->algo)
+	{
+		case CMPH_BDZ:
+			bdz_search_batch(mphf, keys, keylens, n, out);
+			return;
+		case CMPH_BDZ_PH:
+			bdz_ph_search_batch(mphf, keys, keylens, n, out);
+			return;
+		case CMPH_CHD_PH:
+			chd_ph_search_batch(mphf, keys, keylens, n, out);
+			return;
+		case CMPH_CHD:
+			chd_search_batch(mphf, keys, keylens, n, out);
+			return;
+		default:
+			for(i = 0; i < n; i++)
+			{
+				out[i] = cmph_search(mphf, keys[i], keylens[i]);
+			}
+	}
+}
+
 cmph_uint32 cmph_size(cmph_t *mphf)
+{
+	return (cmph_uint32)mphf->size;
+}
+
+cmph_uint64 cmph_search64(cmph_t *mphf, const char *key, cmph_uint32 keylen)
+{
+	switch(mphf->algo)
+	{
+		case CMPH_BRZ:
+			return brz_search64(mphf, key, keylen);
+		case CMPH_CHD_SHARDED:
+			return chd_sharded_search64(mphf, key, keylen);
+		default:
+			return cmph_search(mphf, key, keylen);
+	}
+}
+
+// Algorithms with an integer search hash the integer in registers, the others
+// search its bytes.
+static inline cmph_uint32 cmph_search_integer(cmph_t *mphf, cmph_uint64 key, cmph_uint32 keylen)
+{
+	cmph_uint32 key32 = (cmph_uint32)key;
+	switch(mphf->algo)
+	{
+		case CMPH_BDZ:
+			return bdz_search_integer(mphf, key, keylen);
+		case CMPH_CHD_PH:
+			return chd_ph_search_integer(mphf, key, keylen);
+		case CMPH_CHD:
+			return chd_search_integer(mphf, key, keylen);
+		default:
+			if (keylen == sizeof(cmph_uint32)) return cmph_search(mphf, (const char *)&key32, keylen);
+			return cmph_search(mphf, (const char *)&key, keylen);
+	}
+}
+
+cmph_uint32 cmph_search_u32(cmph_t *mphf, cmph_uint32 key)
+{
+	return cmph_search_integer(mphf, key, (cmph_uint32)sizeof(cmph_uint32));
+}
+
+cmph_uint32 cmph_search_u64(cmph_t *mphf, cmph_uint64 key)
+{
+	return cmph_search_integer(mphf, key, (cmph_uint32)sizeof(cmph_uint64));
+}
+
+cmph_uint64 cmph_size64(cmph_t *mphf)
 {
 	return mphf->size;
 }
@@ -728,6 +1384,9 @@ void cmph_destroy(cmph_t *mphf)
 		case CMPH_CHD: /* included -- Fabiano */
 			chd_destroy(mphf);
 			return;
+		case CMPH_CHD_SHARDED:
+			chd_sharded_destroy(mphf);
+			return;
 		default:
 			assert(0);
 	}
@@ -776,6 +1435,9 @@ void cmph_pack(cmph_t *mphf, void *packed_mphf)
 		case CMPH_CHD: /* included -- Fabiano */
 			chd_pack(mphf, ptr);
 			break;
+		case CMPH_CHD_SHARDED:
+			chd_sharded_pack(mphf, ptr);
+			break;
 		default:
 			assert(0);
 	}
@@ -809,12 +1471,123 @@ cmph_uint32 cmph_packed_size(cmph_t *mphf)
 			return chd_ph_packed_size(mphf);
 		case CMPH_CHD: /* included -- Fabiano */
 			return chd_packed_size(mphf);
+		case CMPH_CHD_SHARDED:
+			return chd_sharded_packed_size(mphf);
 		default:
 			assert(0);
 	}
 	return 0; // FAILURE
 }
 
+int cmph_mmap_dump(cmph_t *mphf, FILE *f)
+{
+	cmph_mmap_header_t header;
+	void *packed_mphf;
+	size_t nbytes;
+	cmph_uint32 packed_size = cmph_packed_size(mphf);
+
+	if (packed_size == 0) return 0;
+	packed_mphf = malloc(packed_size);
+	if (packed_mphf == NULL) return 0;
+	cmph_pack(mphf, packed_mphf);
+
+	memset(&header, 0, sizeof(header));
+	memcpy(header.magic, CMPH_MMAP_MAGIC, sizeof(header.magic));
+	header.version = CMPH_MMAP_VERSION;
+	header.byte_order = CMPH_MMAP_BYTE_ORDER;
+	header.header_size = CMPH_MMAP_HEADER_SIZE;
+	header.algo = mphf->algo;
+	header.size = (cmph_uint32)mphf->size;
+	header.size64 = mphf->size;
+	header.packed_size = packed_size;
+	header.file_size = (cmph_uint64)CMPH_MMAP_HEADER_SIZE + packed_size;
+
+	nbytes = fwrite(&header, sizeof(header), (size_t)1, f);
+	if (nbytes == 1) nbytes = fwrite(packed_mphf, (size_t)packed_size, (size_t)1, f);
+	free(packed_mphf);
+	return nbytes == 1;
+}
+
+static int cmph_mmap_check_header(cmph_mmap_header_t *header, cmph_uint64 file_size)
+{
+	if (file_size < CMPH_MMAP_HEADER_SIZE) return 0;
+	if (memcmp(header->magic, CMPH_MMAP_MAGIC, sizeof(header->magic)) != 0) return 0;
+	if (header->byte_order != CMPH_MMAP_BYTE_ORDER)
+	{
+		DEBUGP("mmap file has a different byte order\n");
+		return 0;
+	}
+	if (header->version != CMPH_MMAP_VERSION || header->header_size != CMPH_MMAP_HEADER_SIZE) return 0;
+	if (header->algo >= CMPH_COUNT || header->file_size != file_size) return 0;
+	return header->file_size == (cmph_uint64)header->header_size + header->packed_size;
+}
+
+void *cmph_mmap_open(const char *filename)
+{
+	cmph_uint8 *base = NULL;
+	cmph_uint64 file_size;
+#ifndef WIN32
+	struct stat st;
+	int fd = open(filename, O_RDONLY);
+	if (fd < 0) return NULL;
+	if (fstat(fd, &st) != 0 || (cmph_uint64)st.st_size < CMPH_MMAP_HEADER_SIZE)
+	{
+		close(fd);
+		return NULL;
+	}
+	file_size = (cmph_uint64)st.st_size;
+	base = (cmph_uint8 *)mmap(NULL, (size_t)file_size, PROT_READ, MAP_SHARED, fd, 0);
+	close(fd);
+	if (base == (cmph_uint8 *)MAP_FAILED) return NULL;
+	if (!cmph_mmap_check_header((cmph_mmap_header_t *)base, file_size))
+	{
+		munmap(base, (size_t)file_size);
+		return NULL;
+	}
+#else
+	// no mmap available, fall back to a private copy of the file
+	FILE *f = fopen(filename, "rb");
+	if (f == NULL) return NULL;
+	fseek(f, 0, SEEK_END);
+	file_size = (cmph_uint64)ftell(f);
+	fseek(f, 0, SEEK_SET);
+	if (file_size >= CMPH_MMAP_HEADER_SIZE) base = (cmph_uint8 *)malloc((size_t)file_size);
+	if (base == NULL || fread(base, (size_t)file_size, (size_t)1, f) != 1 ||
+	    !cmph_mmap_check_header((cmph_mmap_header_t *)base, file_size))
+	{
+		free(base);
+		fclose(f);
+		return NULL;
+	}
+	fclose(f);
+#endif
+	return base + CMPH_MMAP_HEADER_SIZE;
+}
+
+void cmph_mmap_close(void *packed_mphf)
+{
+	cmph_mmap_header_t *header;
+	if (packed_mphf == NULL) return;
+	header = (cmph_mmap_header_t *)((cmph_uint8 *)packed_mphf - CMPH_MMAP_HEADER_SIZE);
+#ifndef WIN32
+	munmap(header, (size_t)header->file_size);
+#else
+	free(header);
+#endif
+}
+
+cmph_uint32 cmph_mmap_size(void *packed_mphf)
+{
+	cmph_mmap_header_t *header = (cmph_mmap_header_t *)((cmph_uint8 *)packed_mphf - CMPH_MMAP_HEADER_SIZE);
+	return header->size;
+}
+
+cmph_uint64 cmph_mmap_size64(void *packed_mphf)
+{
+	cmph_mmap_header_t *header = (cmph_mmap_header_t *)((cmph_uint8 *)packed_mphf - CMPH_MMAP_HEADER_SIZE);
+	return header->size64 ? header->size64 : header->size;
+}
+
 /** cmph_uint32 cmph_search(void *packed_mphf, const char *key, cmph_uint32 keylen);
  *  \brief Use the packed mphf to do a search.
  *  \param  packed_mphf pointer to the packed mphf
@@ -846,8 +1619,76 @@ cmph_uint32 cmph_search_packed(void *packed_mphf, const char *key, cmph_uint32 k
 			return chd_ph_search_packed(++ptr, key, keylen);
 		case CMPH_CHD: /* included -- Fabiano */
 			return chd_search_packed(++ptr, key, keylen);
+		case CMPH_CHD_SHARDED:
+			return chd_sharded_search_packed(++ptr, key, keylen);
 		default:
 			assert(0);
 	}
 	return 0; // FAILURE
 }
+
+cmph_uint64 cmph_search_packed64(void *packed_mphf, const char *key, cmph_uint32 keylen)
+{
+	cmph_uint32 *ptr = (cmph_uint32 *)packed_mphf;
+	switch(*ptr)
+	{
+		case CMPH_CHD_SHARDED:
+			return chd_sharded_search_packed64(++ptr, key, keylen);
+		default:
+			return cmph_search_packed(packed_mphf, key, keylen);
+	}
+}
+
+static inline cmph_uint32 cmph_search_packed_integer(void *packed_mphf, cmph_uint64 key, cmph_uint32 keylen)
+{
+	cmph_uint32 *ptr = (cmph_uint32 *)packed_mphf;
+	cmph_uint32 key32 = (cmph_uint32)key;
+	switch(*ptr)
+	{
+		case CMPH_BDZ:
+			return bdz_search_packed_integer(++ptr, key, keylen);
+		case CMPH_CHD_PH:
+			return chd_ph_search_packed_integer(++ptr, key, keylen);
+		case CMPH_CHD:
+			return chd_search_packed_integer(++ptr, key, keylen);
+		default:
+			if (keylen == sizeof(cmph_uint32)) return cmph_search_packed(packed_mphf, (const char *)&key32, keylen);
+			return cmph_search_packed(packed_mphf, (const char *)&key, keylen);
+	}
+}
+
+cmph_uint32 cmph_search_packed_u32(void *packed_mphf, cmph_uint32 key)
+{
+	return cmph_search_packed_integer(packed_mphf, key, (cmph_uint32)sizeof(cmph_uint32));
+}
+
+cmph_uint32 cmph_search_packed_u64(void *packed_mphf, cmph_uint64 key)
+{
+	return cmph_search_packed_integer(packed_mphf, key, (cmph_uint32)sizeof(cmph_uint64));
+}
+
+void cmph_search_packed_batch(void *packed_mphf, const char **keys, const cmph_uint32 *keylens, cmph_uint32 n, cmph_uint32 *out)
+{
+	cmph_uint32 *ptr = (cmph_uint32 *)packed_mphf;
+	cmph_uint32 i;
+	switch(*ptr)
+	{
+		case CMPH_BDZ:
+			bdz_search_packed_batch(++ptr, keys, keylens, n, out);
+			return;
+		case CMPH_BDZ_PH:
+			bdz_ph_search_packed_batch(++ptr, keys, keylens, n, out);
+			return;
+		case CMPH_CHD_PH:
+			chd_ph_search_packed_batch(++ptr, keys, keylens, n, out);
+			return;
+		case CMPH_CHD:
+			chd_search_packed_batch(++ptr, keys, keylens, n, out);
+			return;
+		default:
+			for(i = 0; i < n; i++)
+			{
+				out[i] = cmph_search_packed(packed_mphf, keys[i], keylens[i]);
+			}
+	}
+}
@@ -17,20 +17,94 @@ typedef struct __cmph_t cmph_t;
 typedef struct 
 {
         void *data;
-        cmph_uint32 nkeys;
+        cmph_uint64 nkeys;
         int (*read)(void *, char **, cmph_uint32 *);
         void (*dispose)(void *, char *, cmph_uint32);
         void (*rewind)(void *);
+        /* Optional, zero for adapters that are read in sequence only. The keys
+         * are split into nchunks chunks, chunk i holding the keys chunk_first[i]
+         * to chunk_first[i + 1] - 1 in the order of read. read_batch(data, i,
+         * keys, keylens, max) reads up to max keys of chunk i and returns how
+         * many it read, 0 at the end of the chunk. Distinct chunks may be read
+         * concurrently, and rewind restarts all of them. */
+        cmph_uint32 nchunks;
+        cmph_uint64 *chunk_first;
+        cmph_uint32 (*read_batch)(void *, cmph_uint32, char **, cmph_uint32 *, cmph_uint32);
+        cmph_uint32 flags; // CMPH_IO_* capabilities, zero for none
 } cmph_io_adapter_t;
 
+/* The keys read point into memory that stays valid and unchanged until the
+ * adapter is destroyed, the vector of the caller or a mapped file. They need
+ * not be disposed of and may be kept without a copy. The vector and mapped
+ * file adapters of the library all set it. */
+#define CMPH_IO_BORROWED_KEYS 1U
+
 /** Adapter pattern API **/
 /* please call free() in the created adapters */
 cmph_io_adapter_t *cmph_io_nlfile_adapter(FILE * keys_fd);
 void cmph_io_nlfile_adapter_destroy(cmph_io_adapter_t * key_source);
 
-cmph_io_adapter_t *cmph_io_nlnkfile_adapter(FILE * keys_fd, cmph_uint32 nkeys);
+cmph_io_adapter_t *cmph_io_nlnkfile_adapter(FILE * keys_fd, cmph_uint64 nkeys);
 void cmph_io_nlnkfile_adapter_destroy(cmph_io_adapter_t * key_source);
 
+/** \def CMPH_UNKNOWN_NKEYS
+ *  \brief nkeys of an adapter whose number of keys is not known in advance.
+ *  Its keys end at the first read that fails. cmph_new reads such a source
+ *  once, without rewinding it, spilling the keys to a temporary file.
+ */
+#define CMPH_UNKNOWN_NKEYS ((cmph_uint64)-1)
+
+/** \fn cmph_io_adapter_t *cmph_io_nlstream_adapter(FILE * keys_fd);
+ *  \brief Same keys as cmph_io_nlfile_adapter, without counting them first,
+ *  so that keys_fd may be a pipe. Its nkeys is CMPH_UNKNOWN_NKEYS.
+ *  \param keys_fd stream of newline separated keys
+ *  \return the adapter
+ */
+cmph_io_adapter_t *cmph_io_nlstream_adapter(FILE * keys_fd);
+void cmph_io_nlstream_adapter_destroy(cmph_io_adapter_t * key_source);
+
+/** \fn cmph_io_adapter_t *cmph_io_mmap_nlfile_adapter(const char *filename);
+ *  \brief Same keys as cmph_io_nlfile_adapter, read from a memory mapped file.
+ *  Keys point into the mapping and are not null terminated; they stay valid
+ *  until the adapter is destroyed.
+ *  \param filename file of newline separated keys
+ *  \return the adapter, or NULL if the file can not be opened or mapped
+ */
+cmph_io_adapter_t *cmph_io_mmap_nlfile_adapter(const char *filename);
+void cmph_io_mmap_nlfile_adapter_destroy(cmph_io_adapter_t * key_source);
+
+/** \fn cmph_io_adapter_t *cmph_io_mmap_nlfiles_adapter(const char **filenames, cmph_uint32 nfiles);
+ *  \brief Same as cmph_io_mmap_nlfile_adapter, over the keys of several files in
+ *  turn. The files are cut into chunks of about a megabyte, which builders
+ *  running on several threads read concurrently through read_batch.
+ *  \param filenames files of newline separated keys
+ *  \param nfiles number of files
+ *  \return the adapter, or NULL if a file can not be opened or mapped
+ */
+cmph_io_adapter_t *cmph_io_mmap_nlfiles_adapter(const char **filenames, cmph_uint32 nfiles);
+void cmph_io_mmap_nlfiles_adapter_destroy(cmph_io_adapter_t * key_source);
+
+/** \fn cmph_io_adapter_t *cmph_io_binfile_adapter(const char *filename);
+ *  \brief Reads the keys of a binary key file written by cmph_io_binfile_write.
+ *  Keys may hold any byte. Like those of cmph_io_mmap_nlfile_adapter they point
+ *  into a read-only mapping of the file, valid until the adapter is destroyed.
+ *  \param filename binary key file
+ *  \return the adapter, or NULL if the file can not be mapped or is not a binary key file
+ */
+cmph_io_adapter_t *cmph_io_binfile_adapter(const char *filename);
+void cmph_io_binfile_adapter_destroy(cmph_io_adapter_t * key_source);
+
+/** \fn int cmph_io_binfile_write(cmph_io_adapter_t *key_source, FILE *f);
+ *  \brief Writes every key of key_source to f as a binary key file: a header
+ *  with the number of keys and the sum of their lengths, then each key behind
+ *  its length. f must be seekable, the header is completed after the keys.
+ *  Sources of CMPH_UNKNOWN_NKEYS keys are read until a read fails.
+ *  \param key_source source of the keys
+ *  \param f file opened for writing in binary mode
+ *  \return 1 on success, 0 on write errors
+ */
+int cmph_io_binfile_write(cmph_io_adapter_t *key_source, FILE *f);
+
 cmph_io_adapter_t *cmph_io_vector_adapter(char ** vector, cmph_uint32 nkeys);
 void cmph_io_vector_adapter_destroy(cmph_io_adapter_t * key_source);
 
@@ -45,6 +119,19 @@ cmph_io_adapter_t *cmph_io_struct_vector_adapter(void * vector,
 
 void cmph_io_struct_vector_adapter_destroy(cmph_io_adapter_t * key_source);
 
+/** \fn cmph_io_adapter_t *cmph_io_u64_vector_adapter(cmph_uint64 * vector, cmph_uint32 nkeys);
+ *  \brief Reads integers as keys of 8 bytes in the byte order of the host, the
+ *  keys of cmph_search_u64. cmph_io_u32_vector_adapter reads 4-byte integers,
+ *  the keys of cmph_search_u32. Use them with the CMPH_HASH_INTEGER function.
+ *  \param vector the integers, borrowed until the adapter is destroyed
+ *  \param nkeys number of integers
+ *  \return the adapter
+ */
+cmph_io_adapter_t *cmph_io_u64_vector_adapter(cmph_uint64 * vector, cmph_uint32 nkeys);
+void cmph_io_u64_vector_adapter_destroy(cmph_io_adapter_t * key_source);
+cmph_io_adapter_t *cmph_io_u32_vector_adapter(cmph_uint32 * vector, cmph_uint32 nkeys);
+void cmph_io_u32_vector_adapter_destroy(cmph_io_adapter_t * key_source);
+
 /** Hash configuration API **/
 cmph_config_t *cmph_config_new(cmph_io_adapter_t *key_source);
 void cmph_config_set_hashfuncs(cmph_config_t *mph, CMPH_HASH *hashfuncs);
@@ -56,8 +143,77 @@ void cmph_config_set_mphf_fd(cmph_config_t *mph, FILE *mphf_fd);
 void cmph_config_set_b(cmph_config_t *mph, cmph_uint32 b);
 void cmph_config_set_keys_per_bin(cmph_config_t *mph, cmph_uint32 keys_per_bin);
 void cmph_config_set_memory_availability(cmph_config_t *mph, cmph_uint32 memory_availability);
+
+/** \fn void cmph_config_set_keys_per_shard(cmph_config_t *mph, cmph_uint32 keys_per_shard);
+ *  \brief Average number of keys of each shard built by CHD_SHARDED. Default is 2^20.
+ *  \param mph pointer to the configuration
+ *  \param keys_per_shard average number of keys per shard
+ */
+void cmph_config_set_keys_per_shard(cmph_config_t *mph, cmph_uint32 keys_per_shard);
+
+/** \fn void cmph_config_set_bucket_algo(cmph_config_t *mph, CMPH_ALGO algo);
+ *  \brief Algorithm building the function of each bucket of BRZ: CMPH_FCH,
+ *  CMPH_BMZ8, CMPH_BDZ or CMPH_CHD. BDZ and CHD buckets hold up to 65535 keys
+ *  and give smaller and faster functions. By default FCH is used when the
+ *  graph size is at least 2 and BMZ8 otherwise.
+ *  \param mph pointer to the configuration
+ *  \param algo algorithm of the buckets
+ */
+void cmph_config_set_bucket_algo(cmph_config_t *mph, CMPH_ALGO algo);
+
+/** \fn void cmph_config_set_threads(cmph_config_t *mph, cmph_uint32 nthreads);
+ *  \brief Number of threads the construction may use. Currently honoured by BDZ,
+ *  whose result does not depend on it, by CHD_SHARDED, which builds its
+ *  shards concurrently, and by BRZ, which writes its temporary files while
+ *  reading keys and builds its buckets concurrently. Default is 1.
+ *  \param mph pointer to the configuration
+ *  \param nthreads number of threads, 0 is the same as 1
+ */
+void cmph_config_set_threads(cmph_config_t *mph, cmph_uint32 nthreads);
+
+/** \fn void cmph_config_set_duplicates(cmph_config_t *mph, CMPH_DUPLICATES duplicates);
+ *  \brief Checks the keys for duplicates before the construction, which would
+ *  otherwise fail only after trying every hash function it may try. The keys
+ *  are read once more and their 128-bit fingerprints sorted. With
+ *  CMPH_DUPLICATES_FAIL cmph_new fails when some key is duplicated, with
+ *  CMPH_DUPLICATES_DROP the function is built on the first occurrence of
+ *  each key only. Default is CMPH_DUPLICATES_IGNORE, no checking.
+ *  \param mph pointer to the configuration
+ *  \param duplicates what to do with duplicated keys
+ */
+void cmph_config_set_duplicates(cmph_config_t *mph, CMPH_DUPLICATES duplicates);
 void cmph_config_destroy(cmph_config_t *mph);
 
+/** Statistics of the last construction of a configuration. The phases are:
+ *  hashing, reading and hashing the keys; mapping, building the graph or the
+ *  buckets from the hash values; searching, peeling, ordering or searching
+ *  displacements; assigning, computing the values of g; ranking; compressing,
+ *  encoding the result. BRZ and CHD_SHARDED count their partitioning as
+ *  hashing and the construction of their buckets or shards as searching.
+ */
+typedef struct
+{
+        double wall_time[CMPH_PHASE_COUNT]; // seconds spent in each phase
+        double cpu_time[CMPH_PHASE_COUNT];  // CPU seconds of the process, every thread included
+        double total_wall_time;
+        double total_cpu_time;
+        cmph_uint32 iterations;             // hash functions tried, partitionings for BRZ
+        cmph_uint64 peak_memory;            // peak resident memory of the process in bytes, 0 if unknown
+        cmph_uint64 tmp_bytes_written;      // bytes written to temporary files
+        cmph_uint64 tmp_bytes_read;         // bytes read back from temporary files
+        double bits_per_key;                // size of the packed function, 0 if the construction failed
+                                            // or the function is not held in memory, as with BRZ
+        cmph_uint64 duplicates;             // keys equal to a key read before them, when checked
+        cmph_uint64 first_duplicate;        // position of the first of them in the order of read
+} cmph_build_stats_t;
+
+/** \fn void cmph_config_get_build_stats(cmph_config_t *mph, cmph_build_stats_t *stats);
+ *  \brief Copies the statistics that the last cmph_new filled in mph.
+ *  \param mph pointer to the configuration
+ *  \param stats receives the statistics
+ */
+void cmph_config_get_build_stats(cmph_config_t *mph, cmph_build_stats_t *stats);
+
 /** Hash API **/
 cmph_t *cmph_new(cmph_config_t *mph);
 
@@ -70,7 +226,49 @@ cmph_t *cmph_new(cmph_config_t *mph);
  */
 cmph_uint32 cmph_search(cmph_t *mphf, const char *key, cmph_uint32 keylen);
 
+/** \fn void cmph_search_batch(cmph_t *mphf, const char **keys, const cmph_uint32 *keylens, cmph_uint32 n, cmph_uint32 *out);
+ *  \brief Computes the mphf value of n keys at once. BDZ, CHD_PH and CHD hash a
+ *  group of keys and prefetch their table slots before resolving them, which
+ *  hides memory latency on functions larger than the cache.
+ *  \param mphf pointer to the resulting function
+ *  \param keys array of n keys to be hashed
+ *  \param keylens array with the length in bytes of each key
+ *  \param n number of keys
+ *  \param out array of n entries that receives the mphf values, out[i] = cmph_search(mphf, keys[i], keylens[i])
+ */
+void cmph_search_batch(cmph_t *mphf, const char **keys, const cmph_uint32 *keylens, cmph_uint32 n, cmph_uint32 *out);
+
 cmph_uint32 cmph_size(cmph_t *mphf);
+
+/** \fn cmph_uint64 cmph_search64(cmph_t *mphf, const char *key, cmph_uint32 keylen);
+ *  \brief 64-bit counterpart of @see cmph_search. BRZ and CHD_SHARDED accept
+ *  key sources with 2^32 keys or more; the values of such functions only fit
+ *  in the result of this function.
+ *  \param mphf pointer to the resulting function
+ *  \param key is the key to be hashed
+ *  \param keylen is the key legth in bytes
+ *  \return The mphf value
+ */
+cmph_uint64 cmph_search64(cmph_t *mphf, const char *key, cmph_uint32 keylen);
+
+/** \fn cmph_uint32 cmph_search_u64(cmph_t *mphf, cmph_uint64 key);
+ *  \brief Same as cmph_search(mphf, (const char *)&key, sizeof(key)), for
+ *  functions built from integer keys. BDZ, CHD_PH and CHD hash the integer
+ *  without going through memory, in a few multiplies with CMPH_HASH_INTEGER.
+ *  cmph_search_u32 is the same for 4-byte integers.
+ *  \param mphf pointer to the resulting function
+ *  \param key the integer
+ *  \return The mphf value
+ */
+cmph_uint32 cmph_search_u64(cmph_t *mphf, cmph_uint64 key);
+cmph_uint32 cmph_search_u32(cmph_t *mphf, cmph_uint32 key);
+
+/** \fn cmph_uint64 cmph_size64(cmph_t *mphf);
+ *  \brief 64-bit counterpart of @see cmph_size.
+ *  \param mphf pointer to the resulting function
+ *  \return the size of the function
+ */
+cmph_uint64 cmph_size64(cmph_t *mphf);
 void cmph_destroy(cmph_t *mphf);
 
 /** Hash serialization/deserialization */
@@ -92,6 +290,43 @@ void cmph_pack(cmph_t *mphf, void *packed_mphf);
  */
 cmph_uint32 cmph_packed_size(cmph_t *mphf);
 
+/** \fn int cmph_mmap_dump(cmph_t *mphf, FILE *f);
+ *  \brief Writes the packed form of mphf preceded by a self-describing header.
+ *  The resulting file can be opened with cmph_mmap_open.
+ *  \param mphf pointer to the mphf
+ *  \param f file to write to
+ *  \return 1 on success, 0 otherwise
+ */
+int cmph_mmap_dump(cmph_t *mphf, FILE *f);
+
+/** \fn void *cmph_mmap_open(const char *filename);
+ *  \brief Maps a file written by cmph_mmap_dump read-only into memory. No data is
+ *  copied: the pages are shared with every process that maps the same file.
+ *  \param filename path of the file
+ *  \return a packed mphf to be used with cmph_search_packed, or NULL on failure
+ */
+void *cmph_mmap_open(const char *filename);
+
+/** \fn void cmph_mmap_close(void *packed_mphf);
+ *  \brief Unmaps a function returned by cmph_mmap_open.
+ *  \param packed_mphf pointer returned by cmph_mmap_open
+ */
+void cmph_mmap_close(void *packed_mphf);
+
+/** \fn cmph_uint32 cmph_mmap_size(void *packed_mphf);
+ *  \brief Same as cmph_size for a function returned by cmph_mmap_open.
+ *  \param packed_mphf pointer returned by cmph_mmap_open
+ *  \return the size of the function
+ */
+cmph_uint32 cmph_mmap_size(void *packed_mphf);
+
+/** \fn cmph_uint64 cmph_mmap_size64(void *packed_mphf);
+ *  \brief Same as cmph_size64 for a function returned by cmph_mmap_open.
+ *  \param packed_mphf pointer returned by cmph_mmap_open
+ *  \return the size of the function
+ */
+cmph_uint64 cmph_mmap_size64(void *packed_mphf);
+
 /** cmph_uint32 cmph_search(void *packed_mphf, const char *key, cmph_uint32 keylen);
  *  \brief Use the packed mphf to do a search. 
  *  \param  packed_mphf pointer to the packed mphf
@@ -101,6 +336,35 @@ cmph_uint32 cmph_packed_size(cmph_t *mphf);
  */
 cmph_uint32 cmph_search_packed(void *packed_mphf, const char *key, cmph_uint32 keylen);
 
+/** \fn cmph_uint64 cmph_search_packed64(void *packed_mphf, const char *key, cmph_uint32 keylen);
+ *  \brief 64-bit counterpart of @see cmph_search_packed.
+ *  \param packed_mphf pointer to the packed mphf
+ *  \param key key to be hashed
+ *  \param keylen key legth in bytes
+ *  \return The mphf value
+ */
+cmph_uint64 cmph_search_packed64(void *packed_mphf, const char *key, cmph_uint32 keylen);
+
+/** \fn cmph_uint32 cmph_search_packed_u64(void *packed_mphf, cmph_uint64 key);
+ *  \brief Packed counterpart of @see cmph_search_u64, cmph_search_packed_u32
+ *  is the one of cmph_search_u32.
+ *  \param packed_mphf pointer to the packed mphf
+ *  \param key the integer
+ *  \return The mphf value
+ */
+cmph_uint32 cmph_search_packed_u64(void *packed_mphf, cmph_uint64 key);
+cmph_uint32 cmph_search_packed_u32(void *packed_mphf, cmph_uint32 key);
+
+/** \fn void cmph_search_packed_batch(void *packed_mphf, const char **keys, const cmph_uint32 *keylens, cmph_uint32 n, cmph_uint32 *out);
+ *  \brief Packed counterpart of @see cmph_search_batch.
+ *  \param packed_mphf pointer to the packed mphf
+ *  \param keys array of n keys to be hashed
+ *  \param keylens array with the length in bytes of each key
+ *  \param n number of keys
+ *  \param out array of n entries that receives the mphf values
+ */
+void cmph_search_packed_batch(void *packed_mphf, const char **keys, const cmph_uint32 *keylens, cmph_uint32 n, cmph_uint32 *out);
+
 // TIMING functions. To use the macro CMPH_TIMING must be defined
 #include "cmph_time.h"
 
@@ -1,6 +1,14 @@
 #include "cmph_structs.h"
+#include "cmph_time.h"
+#include "hash.h"
+#include "thread_pool.h"
 
+#include <stdlib.h>
 #include <string.h>
+#include <time.h>
+#ifndef WIN32
+#include <unistd.h>
+#endif
 
 //#define DEBUG
 #include "debug.h"
@@ -12,21 +20,151 @@ cmph_config_t *__config_new(cmph_io_adapter_t *key_source)
 	memset(mph, 0, sizeof(cmph_config_t));
 	mph->key_source = key_source;
 	mph->verbosity = 0;
+	mph->nthreads = 1;
 	mph->data = NULL;
 	mph->c = 0;
+	mph->phase = CMPH_PHASE_COUNT;
 	return mph;
 }
 
 void __config_destroy(cmph_config_t *mph)
 {
+	free(mph->tmp_dir);
 	free(mph);
 }
 
+FILE *__config_tmpfile(cmph_config_t *mph)
+{
+#ifndef WIN32
+	char *filename;
+	FILE *f;
+	int fd;
+	if (mph->tmp_dir == NULL) return tmpfile();
+	filename = (char *)malloc(strlen((char *)mph->tmp_dir) + 13);
+	if (filename == NULL) return NULL;
+	sprintf(filename, "%s/cmph.XXXXXX", (char *)mph->tmp_dir);
+	fd = mkstemp(filename);
+	if (fd < 0)
+	{
+		free(filename);
+		return NULL;
+	}
+	unlink(filename); // the file goes away with its last descriptor
+	free(filename);
+	f = fdopen(fd, "w+b");
+	if (f == NULL) close(fd);
+	return f;
+#else
+	return tmpfile();
+#endif
+}
+
+cmph_uint32 __seed_derive(cmph_uint32 seed, cmph_uint32 i)
+{
+	cmph_uint32 h = seed + (i + 1)*0x9e3779b9U;
+	h ^= h >> 16;
+	h *= 0x85ebca6bU;
+	h ^= h >> 13;
+	h *= 0xc2b2ae35U;
+	h ^= h >> 16;
+	return h ? h : 1;
+}
+
+hash_state_t *__config_hash_state(cmph_config_t *mph, CMPH_HASH hashfunc, cmph_uint32 hashsize)
+{
+	if (mph->seed) return hash_state_seeded(hashfunc, __seed_derive(mph->seed, mph->nseeds++));
+	return hash_state_new(hashfunc, hashsize);
+}
+
+void __config_phase(cmph_config_t *mph, CMPH_PHASE phase)
+{
+	double wall, cpu;
+	if (mph->untimed) return;
+	wall = (double)time(NULL);
+	cpu = (double)clock()/CLOCKS_PER_SEC;
+#ifdef __GNUC__
+	elapsed_time_in_seconds(&wall);
+#endif
+	if (mph->phase < CMPH_PHASE_COUNT)
+	{
+		mph->stats.wall_time[mph->phase] += wall - mph->phase_wall_time;
+		mph->stats.cpu_time[mph->phase] += cpu - mph->phase_cpu_time;
+	}
+	mph->phase = phase;
+	mph->phase_wall_time = wall;
+	mph->phase_cpu_time = cpu;
+}
+
+#define FINGERPRINT_KEYS_PER_BATCH 256U
+
+typedef struct
+{
+	cmph_io_adapter_t *key_source;
+	cmph_uint64 *fingerprints;
+} fingerprint_job_t;
+
+static void fingerprint_chunk_task(void *arg, cmph_uint32 chunk)
+{
+	fingerprint_job_t *job = (fingerprint_job_t *)arg;
+	cmph_io_adapter_t *key_source = job->key_source;
+	cmph_uint64 *fingerprint = job->fingerprints + 2*key_source->chunk_first[chunk];
+	char *keys[FINGERPRINT_KEYS_PER_BATCH];
+	cmph_uint32 keylens[FINGERPRINT_KEYS_PER_BATCH];
+	cmph_uint32 i, n;
+	while ((n = key_source->read_batch(key_source->data, chunk, keys, keylens, FINGERPRINT_KEYS_PER_BATCH)) > 0)
+	{
+		for (i = 0; i < n; ++i, fingerprint += 2)
+		{
+			hash_fingerprint(keys[i], keylens[i], fingerprint);
+			__key_dispose(key_source, keys[i], keylens[i]);
+		}
+	}
+}
+
+cmph_uint64 *__config_fingerprints(cmph_config_t *mph)
+{
+	cmph_io_adapter_t *key_source = mph->key_source;
+	cmph_uint64 *fingerprints = (cmph_uint64 *)malloc(sizeof(cmph_uint64)*2*(size_t)key_source->nkeys);
+	cmph_uint64 e;
+	if (fingerprints == NULL) return NULL;
+	key_source->rewind(key_source->data);
+	if (mph->nthreads > 1 && key_source->read_batch != NULL)
+	{
+		fingerprint_job_t job;
+		job.key_source = key_source;
+		job.fingerprints = fingerprints;
+		thread_pool_run(mph->nthreads, key_source->nchunks, fingerprint_chunk_task, &job);
+		return fingerprints;
+	}
+	for (e = 0; e < key_source->nkeys; ++e)
+	{
+		char *key = NULL;
+		cmph_uint32 keylen;
+		key_source->read(key_source->data, &key, &keylen);
+		hash_fingerprint(key, keylen, fingerprints + 2*e);
+		__key_dispose(key_source, key, keylen);
+	}
+	return fingerprints;
+}
+
 void __cmph_dump(cmph_t *mphf, FILE *fd)
 {
-	register size_t nbytes;
-	nbytes = fwrite(cmph_names[mphf->algo], (size_t)(strlen(cmph_names[mphf->algo]) + 1), (size_t)1, fd);
-	nbytes = fwrite(&(mphf->size), sizeof(mphf->size), (size_t)1, fd);
+	__cmph_dump_header(mphf->algo, mphf->version, mphf->size, fd);
+}
+
+int __cmph_dump_header(CMPH_ALGO algo, cmph_uint32 version, cmph_uint64 size, FILE *fd)
+{
+	cmph_uint32 size32 = size < CMPH_VERSION_FLAG ? (cmph_uint32)size : CMPH_SIZE64_FLAG;
+	cmph_uint32 version_flag = CMPH_VERSION_FLAG;
+	if (fwrite(cmph_names[algo], (size_t)(strlen(cmph_names[algo]) + 1), (size_t)1, fd) != 1) return 0;
+	if (version)
+	{
+		if (fwrite(&version_flag, sizeof(cmph_uint32), (size_t)1, fd) != 1) return 0;
+		if (fwrite(&version, sizeof(cmph_uint32), (size_t)1, fd) != 1) return 0;
+	}
+	if (fwrite(&size32, sizeof(cmph_uint32), (size_t)1, fd) != 1) return 0;
+	if (size32 == CMPH_SIZE64_FLAG && fwrite(&size, sizeof(cmph_uint64), (size_t)1, fd) != 1) return 0;
+	return 1;
 }
 cmph_t *__cmph_load(FILE *f)
 {
@@ -35,6 +173,7 @@ cmph_t *__cmph_load(FILE *f)
 	char algo_name[BUFSIZ];
 	char *ptr = algo_name;
 	CMPH_ALGO algo = CMPH_COUNT;
+	cmph_uint32 size32;
 	register size_t nbytes;
 
 	DEBUGP("Loading mphf\n");
@@ -64,9 +203,17 @@ cmph_t *__cmph_load(FILE *f)
 	}
 	mphf = (cmph_t *)malloc(sizeof(cmph_t));
 	mphf->algo = algo;
-	nbytes = fread(&(mphf->size), sizeof(mphf->size), (size_t)1, f);
+	mphf->version = 0;
+	nbytes = fread(&size32, sizeof(cmph_uint32), (size_t)1, f);
+	if (size32 == CMPH_VERSION_FLAG)
+	{
+		nbytes = fread(&(mphf->version), sizeof(cmph_uint32), (size_t)1, f);
+		nbytes = fread(&size32, sizeof(cmph_uint32), (size_t)1, f);
+	}
+	mphf->size = size32;
+	if (size32 == CMPH_SIZE64_FLAG) nbytes = fread(&(mphf->size), sizeof(cmph_uint64), (size_t)1, f);
 	mphf->data = NULL;
-	DEBUGP("Algorithm is %s and mphf is sized %u\n", cmph_names[algo],  mphf->size);
+	DEBUGP("Algorithm is %s version %u and mphf is sized %llu\n", cmph_names[algo], mphf->version, (unsigned long long)mphf->size);
 
 	return mphf;
 }
@@ -2,6 +2,7 @@
 #define __CMPH_STRUCTS_H__
 
 #include "cmph.h"
+#include "hash.h"
 
 /** Hash generation algorithm data
   */
@@ -10,8 +11,18 @@ struct __config_t
         CMPH_ALGO algo;
         cmph_io_adapter_t *key_source;
         cmph_uint32 verbosity;
+        cmph_uint32 nthreads; // threads available to the construction
+        CMPH_DUPLICATES duplicates; // checking of the keys before the construction
         double c;
         void *data; // algorithm dependent data
+        cmph_build_stats_t stats;
+        cmph_uint32 untimed; // set on internal configurations whose statistics are dropped
+        cmph_uint32 seed; // when not 0, the seeds of the hash functions are derived from it instead of rand()
+        cmph_uint32 nseeds; // seeds derived from seed so far
+        cmph_uint8 *tmp_dir; // directory of the temporary files, NULL for the system default
+        CMPH_PHASE phase; // phase being timed, CMPH_PHASE_COUNT for none
+        double phase_wall_time; // start of the phase
+        double phase_cpu_time;
 };
 
 /** Hash querying algorithm data
@@ -19,14 +30,86 @@ struct __config_t
 struct __cmph_t
 {
         CMPH_ALGO algo;
-        cmph_uint32 size;
+        cmph_uint32 version; // format version, see CMPH_VERSION_FASTRANGE
+        cmph_uint64 size;
         cmph_io_adapter_t *key_source;
         void *data; // algorithm dependent data
 };
 
+/** Largest size written as a plain 32-bit value by __cmph_dump. Larger
+  * functions are written as this flag followed by the 64-bit size, so files
+  * of 32-bit functions keep their original format.
+  */
+#define CMPH_SIZE64_FLAG 0xFFFFFFFFU
+
+/** Written by __cmph_dump in place of the size of functions whose format
+  * version is not 0, followed by the version and then by the size. Sizes
+  * from this value on are written after CMPH_SIZE64_FLAG.
+  */
+#define CMPH_VERSION_FLAG 0xFFFFFFFEU
+
+/** Format version of the functions that reduce hash values to a range with
+  * fastrange32 instead of the modulo operator: BDZ, BDZ_PH, CHD_PH, CHD,
+  * CHD_SHARDED, FCH and BRZ (bucket selection and FCH buckets; BMZ8 buckets
+  * keep the modulo operator). Version 0 functions of these
+  * algorithms are still loaded and searched with the modulo operator.
+  * Packed functions carry the version as CMPH_PACKED_FASTRANGE, set in the
+  * packed type of the hash function whose values are reduced.
+  */
+#define CMPH_VERSION_FASTRANGE 1U
+#define CMPH_PACKED_FASTRANGE 0x80000000U
+
+/** Set in the packed type of the hash function of BDZ functions packed as
+  * 64-byte lines of values and rank counters. Packed BDZ functions without
+  * it have the layout of the releases before the lines: a rank table, the
+  * shift b of its blocks and a separate array of 2-bit values.
+  */
+#define CMPH_PACKED_BDZ_LINES 0x40000000U
+
+/** Header of the files written by cmph_mmap_dump. The packed function
+  * starts right after it, so it is 64-byte aligned once the file is mapped.
+  */
+#define CMPH_MMAP_MAGIC "CMPHPACK"
+#define CMPH_MMAP_VERSION 2U // 2: BDZ packs g interleaved with its rank counters
+#define CMPH_MMAP_BYTE_ORDER 0x01020304U
+#define CMPH_MMAP_HEADER_SIZE 64U
+
+typedef struct
+{
+        char magic[8];
+        cmph_uint32 version;
+        cmph_uint32 byte_order; // CMPH_MMAP_BYTE_ORDER as written by the producer
+        cmph_uint32 header_size; // offset of the packed function in the file
+        cmph_uint32 algo;
+        cmph_uint32 size; // cmph_size of the packed function
+        cmph_uint32 packed_size;
+        cmph_uint64 file_size;
+        cmph_uint64 size64; // cmph_size64 of the packed function, size is truncated
+        cmph_uint8 reserved[CMPH_MMAP_HEADER_SIZE - 48];
+} cmph_mmap_header_t;
+
 cmph_config_t *__config_new(cmph_io_adapter_t *key_source);
 void __config_destroy(cmph_config_t*);
+/** Ends the phase being timed in mph, if any, and starts timing phase. */
+void __config_phase(cmph_config_t *mph, CMPH_PHASE phase);
+/** Creates an anonymous temporary file in the tmp_dir of mph, in the
+  * directory of tmpfile() when it is not set. Returns NULL on failure. */
+FILE *__config_tmpfile(cmph_config_t *mph);
+/** Derives the i-th seed from seed, never 0. */
+cmph_uint32 __seed_derive(cmph_uint32 seed, cmph_uint32 i);
+/** New hash state seeded with the next seed derived from mph->seed, or a
+  * random one of the given size when mph->seed is 0. */
+hash_state_t *__config_hash_state(cmph_config_t *mph, CMPH_HASH hashfunc, cmph_uint32 hashsize);
+/** Reads every key of mph once and returns their hash_fingerprint values,
+  * two words per key in the order of read, or NULL when out of memory. */
+cmph_uint64 *__config_fingerprints(cmph_config_t *mph);
+/** Disposes of a key read from key_source, borrowed keys need nothing. */
+static inline void __key_dispose(cmph_io_adapter_t *key_source, char *key, cmph_uint32 keylen)
+{
+        if (!(key_source->flags & CMPH_IO_BORROWED_KEYS)) key_source->dispose(key_source->data, key, keylen);
+}
 void __cmph_dump(cmph_t *mphf, FILE *);
+int __cmph_dump_header(CMPH_ALGO algo, cmph_uint32 version, cmph_uint64 size, FILE *fd);
 cmph_t *__cmph_load(FILE *f);
 
 
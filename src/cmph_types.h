@@ -32,11 +32,16 @@ typedef unsigned int cmph_uint32;
   typedef unsigned long long cmph_uint64;
 #endif
 
-typedef enum { CMPH_HASH_JENKINS, CMPH_HASH_COUNT } CMPH_HASH;
+typedef enum { CMPH_HASH_JENKINS, CMPH_HASH_MURMUR, CMPH_HASH_WYHASH, CMPH_HASH_FINGERPRINT, CMPH_HASH_INTEGER, CMPH_HASH_COUNT } CMPH_HASH;
 extern const char *cmph_hash_names[];
 typedef enum { CMPH_BMZ, CMPH_BMZ8, CMPH_CHM, CMPH_BRZ, CMPH_FCH,
                CMPH_BDZ, CMPH_BDZ_PH,
-               CMPH_CHD_PH, CMPH_CHD, CMPH_COUNT } CMPH_ALGO;
+               CMPH_CHD_PH, CMPH_CHD, CMPH_CHD_SHARDED, CMPH_COUNT } CMPH_ALGO;
 extern const char *cmph_names[];
+typedef enum { CMPH_PHASE_HASHING, CMPH_PHASE_MAPPING, CMPH_PHASE_SEARCHING,
+               CMPH_PHASE_ASSIGNING, CMPH_PHASE_RANKING, CMPH_PHASE_COMPRESSING,
+               CMPH_PHASE_COUNT } CMPH_PHASE;
+extern const char *cmph_phase_names[];
+typedef enum { CMPH_DUPLICATES_IGNORE, CMPH_DUPLICATES_FAIL, CMPH_DUPLICATES_DROP } CMPH_DUPLICATES;
 
 #endif
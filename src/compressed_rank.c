@@ -317,5 +317,16 @@ cmph_uint32 compressed_rank_query_packed(void * cr_packed, cmph_uint32 idx)
 	return rank;
 }
 
+void compressed_rank_prefetch_packed(void * cr_packed, cmph_uint32 idx)
+{
+	register cmph_uint32 *ptr = (cmph_uint32 *)cr_packed;
+	register cmph_uint32 max_val = ptr[0];
+	register cmph_uint32 rem_r = ptr[2];
+	register cmph_uint32 val_quot = idx >> rem_r;
 
-
+	if(idx > max_val || val_quot == 0)
+	{
+		return;
+	}
+	select_prefetch_packed(ptr + 4, val_quot - 1);
+}
@@ -52,4 +52,11 @@ cmph_uint32 compressed_rank_packed_size(compressed_rank_t *cr);
  */
 cmph_uint32 compressed_rank_query_packed(void * cr_packed, cmph_uint32 idx);
 
+/** \fn void compressed_rank_prefetch_packed(void * cr_packed, cmph_uint32 idx);
+ *  \brief Prefetches the select slot a later @see compressed_rank_query_packed for idx will read.
+ *  \param cr_packed is a pointer to a contiguous memory area
+ *  \param idx is the index that will be queried
+ */
+void compressed_rank_prefetch_packed(void * cr_packed, cmph_uint32 idx);
+
 #endif
@@ -6,6 +6,7 @@
 #include <string.h>
 
 #include "bitbool.h"
+#include "prefetch.h"
 
 // #define DEBUG
 #include "debug.h"
@@ -159,6 +160,13 @@ cmph_uint32 compressed_seq_query(compressed_seq_t * cs, cmph_uint32 idx)
 	return stored_value + ((1U << enc_length) - 1U);
 };
 
+void compressed_seq_prefetch(compressed_seq_t * cs, cmph_uint32 idx)
+{
+	register cmph_uint32 prev = idx ? idx - 1 : 0;
+	select_prefetch(&cs->sel, prev);
+	PREFETCH(cs->length_rems + ((prev * cs->rem_r) >> 5));
+};
+
 void compressed_seq_dump(compressed_seq_t * cs, char ** buf, cmph_uint32 * buflen)
 {
 	register cmph_uint32 sel_size = select_packed_size(&(cs->sel));
@@ -376,3 +384,16 @@ cmph_uint32 compressed_seq_query_packed(void * cs_packed, cmph_uint32 idx)
 	stored_value = get_bits_at_pos(store_table, enc_idx, enc_length);
 	return stored_value + ((1U << enc_length) - 1U);
 }
+
+void compressed_seq_prefetch_packed(void * cs_packed, cmph_uint32 idx)
+{
+	register cmph_uint32 *ptr = (cmph_uint32 *)cs_packed;
+	register cmph_uint32 rem_r = ptr[1];
+	register cmph_uint32 buflen_sel = ptr[3];
+	register cmph_uint32 * sel_packed = ptr + 4;
+	register cmph_uint32 * length_rems = sel_packed + (buflen_sel >> 2);
+	register cmph_uint32 prev = idx ? idx - 1 : 0;
+
+	select_prefetch_packed(sel_packed, prev);
+	PREFETCH(length_rems + ((prev * rem_r) >> 5));
+}
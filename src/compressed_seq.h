@@ -46,6 +46,13 @@ void compressed_seq_generate(compressed_seq_t * cs, cmph_uint32 * vals_table, cm
  */
 cmph_uint32 compressed_seq_query(compressed_seq_t * cs, cmph_uint32 idx);
 
+/** \fn void compressed_seq_prefetch(compressed_seq_t * cs, cmph_uint32 idx);
+ *  \brief Prefetches the select and length slots a later @see compressed_seq_query for idx will read.
+ *  \param cs points to the compressed sequence structure
+ *  \param idx index that will be queried
+ */
+void compressed_seq_prefetch(compressed_seq_t * cs, cmph_uint32 idx);
+
 
 /** \fn cmph_uint32 compressed_seq_get_space_usage(compressed_seq_t * cs);
  *  \brief Returns amount of space (in bits) to store the compressed sequence.
@@ -81,4 +88,11 @@ cmph_uint32 compressed_seq_packed_size(compressed_seq_t *cs);
  */
 cmph_uint32 compressed_seq_query_packed(void * cs_packed, cmph_uint32 idx);
 
+/** \fn void compressed_seq_prefetch_packed(void * cs_packed, cmph_uint32 idx);
+ *  \brief Packed counterpart of @see compressed_seq_prefetch.
+ *  \param cs_packed is a pointer to a contiguous memory area
+ *  \param idx index that will be queried
+ */
+void compressed_seq_prefetch_packed(void * cs_packed, cmph_uint32 idx);
+
 #endif
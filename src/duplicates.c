@@ -0,0 +1,267 @@
+#include "duplicates.h"
+#include "hash.h"
+#include "bitbool.h"
+#include "thread_pool.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+//#define DEBUG
+#include "debug.h"
+
+#define DUPLICATES_RADIX_BITS 8
+#define DUPLICATES_RADIX (1U << DUPLICATES_RADIX_BITS)
+
+typedef struct
+{
+	cmph_uint64 fingerprint[2];
+	cmph_uint64 position; // in the order of read
+} duplicates_item_t;
+
+// One pass of the radix sort, moving the items of from to to by the digit of
+// their first fingerprint word at shift. The items are split into nslices
+// slices, counted and then moved by one task each.
+typedef struct
+{
+	duplicates_item_t *from;
+	duplicates_item_t *to;
+	cmph_uint64 nitems;
+	cmph_uint32 nslices;
+	cmph_uint32 shift;
+	cmph_uint64 *offsets; // DUPLICATES_RADIX counters per slice
+} duplicates_pass_t;
+
+static inline cmph_uint32 duplicates_digit(const duplicates_pass_t *pass, cmph_uint64 i)
+{
+	return (cmph_uint32)(pass->from[i].fingerprint[0] >> pass->shift) & (DUPLICATES_RADIX - 1);
+}
+
+static void duplicates_count_task(void *arg, cmph_uint32 slice)
+{
+	duplicates_pass_t *pass = (duplicates_pass_t *)arg;
+	cmph_uint64 *count = pass->offsets + (size_t)slice*DUPLICATES_RADIX;
+	cmph_uint64 i = pass->nitems*slice/pass->nslices;
+	cmph_uint64 end = pass->nitems*(slice + 1)/pass->nslices;
+	memset(count, 0, sizeof(cmph_uint64)*DUPLICATES_RADIX);
+	for (; i < end; ++i) ++count[duplicates_digit(pass, i)];
+}
+
+static void duplicates_move_task(void *arg, cmph_uint32 slice)
+{
+	duplicates_pass_t *pass = (duplicates_pass_t *)arg;
+	cmph_uint64 *offset = pass->offsets + (size_t)slice*DUPLICATES_RADIX;
+	cmph_uint64 i = pass->nitems*slice/pass->nslices;
+	cmph_uint64 end = pass->nitems*(slice + 1)/pass->nslices;
+	for (; i < end; ++i) pass->to[offset[duplicates_digit(pass, i)]++] = pass->from[i];
+}
+
+static int duplicates_compare(const void *a, const void *b)
+{
+	const duplicates_item_t *x = (const duplicates_item_t *)a;
+	const duplicates_item_t *y = (const duplicates_item_t *)b;
+	if (x->fingerprint[1] != y->fingerprint[1]) return x->fingerprint[1] < y->fingerprint[1] ? -1 : 1;
+	if (x->position != y->position) return x->position < y->position ? -1 : 1;
+	return 0;
+}
+
+cmph_uint8 *duplicates_find(cmph_config_t *mph, cmph_uint64 *nduplicates, cmph_uint64 *first)
+{
+	cmph_uint64 nkeys = mph->key_source->nkeys;
+	cmph_uint64 *fingerprints = __config_fingerprints(mph);
+	duplicates_item_t *items = NULL, *tmp = NULL;
+	cmph_uint64 *offsets = NULL;
+	cmph_uint8 *duplicates = NULL;
+	duplicates_pass_t pass;
+	cmph_uint64 i, j, k;
+	cmph_uint32 d, s;
+
+	*nduplicates = 0;
+	*first = nkeys;
+	if (fingerprints == NULL) return NULL;
+	items = (duplicates_item_t *)malloc(sizeof(duplicates_item_t)*(size_t)nkeys);
+	if (items)
+	{
+		for (i = 0; i < nkeys; ++i)
+		{
+			items[i].fingerprint[0] = fingerprints[2*i];
+			items[i].fingerprint[1] = fingerprints[2*i + 1];
+			items[i].position = i;
+		}
+	}
+	free(fingerprints);
+	pass.nslices = mph->nthreads;
+	tmp = (duplicates_item_t *)malloc(sizeof(duplicates_item_t)*(size_t)nkeys);
+	offsets = (cmph_uint64 *)malloc(sizeof(cmph_uint64)*DUPLICATES_RADIX*pass.nslices);
+	duplicates = (cmph_uint8 *)calloc((size_t)((nkeys + 7) >> 3), sizeof(cmph_uint8));
+	if (items == NULL || tmp == NULL || offsets == NULL || duplicates == NULL)
+	{
+		free(items);
+		free(tmp);
+		free(offsets);
+		free(duplicates);
+		return NULL;
+	}
+
+	// Sort by the first fingerprint word, least significant digit first. The
+	// number of passes is even, so the items end up back in items.
+	pass.from = items;
+	pass.to = tmp;
+	pass.nitems = nkeys;
+	pass.offsets = offsets;
+	for (pass.shift = 0; pass.shift < 64; pass.shift += DUPLICATES_RADIX_BITS)
+	{
+		duplicates_item_t *swap;
+		cmph_uint64 offset = 0;
+		thread_pool_run(mph->nthreads, pass.nslices, duplicates_count_task, &pass);
+		for (d = 0; d < DUPLICATES_RADIX; ++d)
+		{
+			for (s = 0; s < pass.nslices; ++s)
+			{
+				cmph_uint64 count = offsets[(size_t)s*DUPLICATES_RADIX + d];
+				offsets[(size_t)s*DUPLICATES_RADIX + d] = offset;
+				offset += count;
+			}
+		}
+		thread_pool_run(mph->nthreads, pass.nslices, duplicates_move_task, &pass);
+		swap = pass.from;
+		pass.from = pass.to;
+		pass.to = swap;
+	}
+	free(tmp);
+	free(offsets);
+
+	// Items of equal first words are almost always equal keys, their runs are
+	// sorted by second word and position so the first key read leads.
+	for (i = 0; i < nkeys; i = j)
+	{
+		for (j = i + 1; j < nkeys && items[j].fingerprint[0] == items[i].fingerprint[0]; ++j);
+		if (j - i < 2) continue;
+		qsort(items + i, (size_t)(j - i), sizeof(duplicates_item_t), duplicates_compare);
+		for (k = i + 1; k < j; ++k)
+		{
+			if (items[k].fingerprint[1] != items[k - 1].fingerprint[1]) continue;
+			SETBIT(duplicates, items[k].position);
+			++*nduplicates;
+			if (items[k].position < *first) *first = items[k].position;
+		}
+	}
+	free(items);
+	DEBUGP("Found %llu duplicated keys\n", (unsigned long long)*nduplicates);
+	return duplicates;
+}
+
+typedef struct
+{
+	cmph_io_adapter_t *key_source;
+	cmph_uint8 *duplicates;
+	cmph_uint64 position; // of the next key read from key_source
+	cmph_uint64 *chunk_position; // of the next key of each chunk
+} duplicates_source_t;
+
+static int duplicates_read(void *data, char **key, cmph_uint32 *keylen)
+{
+	duplicates_source_t *source = (duplicates_source_t *)data;
+	cmph_io_adapter_t *key_source = source->key_source;
+	while (1)
+	{
+		int ret = key_source->read(key_source->data, key, keylen);
+		cmph_uint64 position = source->position++;
+		if (ret < 0 || !GETBIT(source->duplicates, position)) return ret;
+		__key_dispose(key_source, *key, *keylen);
+	}
+}
+
+static cmph_uint32 duplicates_read_batch(void *data, cmph_uint32 chunk, char **keys, cmph_uint32 *keylens, cmph_uint32 max)
+{
+	duplicates_source_t *source = (duplicates_source_t *)data;
+	cmph_io_adapter_t *key_source = source->key_source;
+	cmph_uint32 i, n, m;
+	do
+	{
+		n = key_source->read_batch(key_source->data, chunk, keys, keylens, max);
+		for (i = m = 0; i < n; ++i)
+		{
+			cmph_uint64 position = source->chunk_position[chunk]++;
+			if (GETBIT(source->duplicates, position))
+			{
+				__key_dispose(key_source, keys[i], keylens[i]);
+				continue;
+			}
+			keys[m] = keys[i];
+			keylens[m++] = keylens[i];
+		}
+	} while (n > 0 && m == 0);
+	return m;
+}
+
+static void duplicates_dispose(void *data, char *key, cmph_uint32 keylen)
+{
+	duplicates_source_t *source = (duplicates_source_t *)data;
+	source->key_source->dispose(source->key_source->data, key, keylen);
+}
+
+static void duplicates_rewind(void *data)
+{
+	duplicates_source_t *source = (duplicates_source_t *)data;
+	cmph_io_adapter_t *key_source = source->key_source;
+	cmph_uint32 i;
+	key_source->rewind(key_source->data);
+	source->position = 0;
+	if (source->chunk_position == NULL) return;
+	for (i = 0; i < key_source->nchunks; ++i) source->chunk_position[i] = key_source->chunk_first[i];
+}
+
+cmph_io_adapter_t *duplicates_adapter(cmph_io_adapter_t *key_source, cmph_uint8 *duplicates, cmph_uint64 nduplicates)
+{
+	cmph_io_adapter_t *unique = (cmph_io_adapter_t *)calloc((size_t)1, sizeof(cmph_io_adapter_t));
+	duplicates_source_t *source = (duplicates_source_t *)calloc((size_t)1, sizeof(duplicates_source_t));
+	if (unique == NULL || source == NULL)
+	{
+		free(unique);
+		free(source);
+		return NULL;
+	}
+	source->key_source = key_source;
+	source->duplicates = duplicates;
+	if (key_source->read_batch)
+	{
+		// the chunks of key_source without their duplicated keys
+		cmph_uint64 position = 0, dropped = 0;
+		cmph_uint32 i;
+		source->chunk_position = (cmph_uint64 *)malloc(sizeof(cmph_uint64)*key_source->nchunks);
+		unique->chunk_first = (cmph_uint64 *)malloc(sizeof(cmph_uint64)*(key_source->nchunks + 1));
+		if (source->chunk_position == NULL || unique->chunk_first == NULL)
+		{
+			free(source->chunk_position);
+			free(unique->chunk_first);
+			free(source);
+			free(unique);
+			return NULL;
+		}
+		for (i = 0; i <= key_source->nchunks; ++i)
+		{
+			for (; position < key_source->chunk_first[i]; ++position) dropped += GETBIT(duplicates, position);
+			unique->chunk_first[i] = key_source->chunk_first[i] - dropped;
+		}
+		unique->nchunks = key_source->nchunks;
+		unique->read_batch = duplicates_read_batch;
+	}
+	unique->data = source;
+	unique->nkeys = key_source->nkeys - nduplicates;
+	unique->read = duplicates_read;
+	unique->dispose = duplicates_dispose;
+	unique->rewind = duplicates_rewind;
+	unique->flags = key_source->flags;
+	duplicates_rewind(source);
+	return unique;
+}
+
+void duplicates_adapter_destroy(cmph_io_adapter_t *key_source)
+{
+	duplicates_source_t *source = (duplicates_source_t *)key_source->data;
+	free(source->chunk_position);
+	free(source->duplicates);
+	free(source);
+	free(key_source->chunk_first);
+	free(key_source);
+}
@@ -0,0 +1,28 @@
+#ifndef __CMPH_DUPLICATES_H__
+#define __CMPH_DUPLICATES_H__
+
+#include "cmph_structs.h"
+
+/** \fn cmph_uint8 *duplicates_find(cmph_config_t *mph, cmph_uint64 *nduplicates, cmph_uint64 *first);
+ *  \brief Finds the keys of mph equal to a key read before them. The keys are
+ *  read once and fingerprinted, on the threads of mph when the key source is
+ *  read in chunks, and the fingerprints are radix sorted. Keys of equal
+ *  128-bit fingerprints are taken as equal.
+ *  \param mph pointer to the configuration
+ *  \param nduplicates receives the number of duplicated keys
+ *  \param first receives the position in the order of read of the first of them
+ *  \return a bit vector with a bit set for each duplicated key, or NULL when out of memory
+ */
+cmph_uint8 *duplicates_find(cmph_config_t *mph, cmph_uint64 *nduplicates, cmph_uint64 *first);
+
+/** \fn cmph_io_adapter_t *duplicates_adapter(cmph_io_adapter_t *key_source, cmph_uint8 *duplicates, cmph_uint64 nduplicates);
+ *  \brief Reads the keys of key_source without the duplicated ones.
+ *  \param key_source source of the keys, not owned by the adapter
+ *  \param duplicates bit vector of duplicates_find, owned by the adapter
+ *  \param nduplicates number of bits set in duplicates
+ *  \return the adapter or NULL when out of memory
+ */
+cmph_io_adapter_t *duplicates_adapter(cmph_io_adapter_t *key_source, cmph_uint8 *duplicates, cmph_uint64 nduplicates);
+void duplicates_adapter_destroy(cmph_io_adapter_t *key_source);
+
+#endif
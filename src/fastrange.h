@@ -0,0 +1,27 @@
+#ifndef __CMPH_FASTRANGE_H__
+#define __CMPH_FASTRANGE_H__
+
+#include "cmph_types.h"
+
+/** \fn cmph_uint32 fastrange32(cmph_uint32 h, cmph_uint32 n);
+ *  \brief Maps a 32-bit hash value to [0, n) with multiplications and a shift
+ *  instead of a division (Lemire, "A fast alternative to the modulo reduction").
+ *  The result depends on the high bits of the product, so h is first multiplied
+ *  by the golden ratio to carry its low bits up: the first and second values of
+ *  jenkins_hash_vector are not mixed well enough in their high bits alone.
+ *  \param h is the hash value
+ *  \param n is the size of the range
+ *  \return a value in [0, n)
+ */
+static inline cmph_uint32 fastrange32(cmph_uint32 h, cmph_uint32 n)
+{
+	return (cmph_uint32)(((cmph_uint64)(h * 0x9e3779b9U) * n) >> 32);
+}
+
+/** \def RANGE(h, n, fastrange)
+ *  \brief reduces h to [0, n) with fastrange32 when fastrange is non zero, as
+ *  functions of version CMPH_VERSION_FASTRANGE do, with the modulo otherwise.
+ */
+#define RANGE(h, n, fastrange) ((fastrange) ? fastrange32((h), (n)) : (h) % (n))
+
+#endif
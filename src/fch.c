@@ -3,6 +3,7 @@
 #include "fch_structs.h"
 #include "hash.h"
 #include "bitbool.h"
+#include "fastrange.h"
 #include "fch_buckets.h"
 #include <math.h>
 #include <stdlib.h>
@@ -16,8 +17,8 @@
 static fch_buckets_t * mapping(cmph_config_t *mph);
 static cmph_uint32 * ordering(fch_buckets_t * buckets);
 static cmph_uint8 check_for_collisions_h2(fch_config_data_t *fch, fch_buckets_t * buckets, cmph_uint32 *sorted_indexes);
-static void permut(cmph_uint32 * vector, cmph_uint32 n);
-static cmph_uint8 searching(fch_config_data_t *fch, fch_buckets_t *buckets, cmph_uint32 *sorted_indexes);
+static void permut(cmph_uint32 * vector, cmph_uint32 n, cmph_uint32 seed);
+static cmph_uint8 searching(cmph_config_t *mph, fch_buckets_t *buckets, cmph_uint32 *sorted_indexes);
 
 fch_config_data_t *fch_config_new()
 {
@@ -88,7 +89,7 @@ static fch_buckets_t * mapping(cmph_config_t *mph)
 	fch_buckets_t *buckets = NULL;
 	fch_config_data_t *fch = (fch_config_data_t *)mph->data;
 	if (fch->h1) hash_state_destroy(fch->h1);
-	fch->h1 = hash_state_new(fch->hashfuncs[0], fch->m);
+	fch->h1 = __config_hash_state(mph, fch->hashfuncs[0], fch->m);
 	fch->b = fch_calc_b(fch->c, fch->m);
 	fch->p1 = fch_calc_p1(fch->m);
 	fch->p2 = fch_calc_p2(fch->b);
@@ -101,7 +102,7 @@ static fch_buckets_t * mapping(cmph_config_t *mph)
 		cmph_uint32 h1, keylen;
 		char *key = NULL;
 		mph->key_source->read(mph->key_source->data, &key, &keylen);
-		h1 = hash(fch->h1, key, keylen) % fch->m;
+		h1 = fastrange32(hash(fch->h1, key, keylen), fch->m);
 		h1 = mixh10h11h12 (fch->b, fch->p1, fch->p2, h1);
 		fch_buckets_insert(buckets, h1, key, keylen);
 		key = NULL; // transger memory ownership
@@ -133,7 +134,7 @@ static cmph_uint8 check_for_collisions_h2(fch_config_data_t *fch, fch_buckets_t
 		{
 			char * key = fch_buckets_get_key(buckets, sorted_indexes[i], j);
 			cmph_uint32 keylen = fch_buckets_get_keylength(buckets, sorted_indexes[i], j);
-			index = hash(fch->h2, key, keylen) % fch->m;
+			index = fastrange32(hash(fch->h2, key, keylen), fch->m);
 			if(hashtable[index]) { // collision detected
 				free(hashtable);
 				return 1;
@@ -145,19 +146,21 @@ static cmph_uint8 check_for_collisions_h2(fch_config_data_t *fch, fch_buckets_t
 	return 0;
 }
 
-static void permut(cmph_uint32 * vector, cmph_uint32 n)
+// Shuffles vector with rand(), or with values derived from seed when it is not 0.
+static void permut(cmph_uint32 * vector, cmph_uint32 n, cmph_uint32 seed)
 {
   cmph_uint32 i, j, b;
   for (i = 0; i < n; i++) {
-    j = (cmph_uint32) rand() % n;
+    j = (seed ? __seed_derive(seed, i) : (cmph_uint32) rand()) % n;
     b = vector[i];
     vector[i] = vector[j];
     vector[j] = b;
   }
 }
 
-static cmph_uint8 searching(fch_config_data_t *fch, fch_buckets_t *buckets, cmph_uint32 *sorted_indexes)
+static cmph_uint8 searching(cmph_config_t *mph, fch_buckets_t *buckets, cmph_uint32 *sorted_indexes)
 {
+	fch_config_data_t *fch = (fch_config_data_t *)mph->data;
 	cmph_uint32 * random_table = (cmph_uint32 *) calloc((size_t)fch->m, sizeof(cmph_uint32));
 	cmph_uint32 * map_table    = (cmph_uint32 *) calloc((size_t)fch->m, sizeof(cmph_uint32));
 	cmph_uint32 iteration_to_generate_h2 = 0;
@@ -174,14 +177,14 @@ static cmph_uint8 searching(fch_config_data_t *fch, fch_buckets_t *buckets, cmph
 	{
 		random_table[i] = i;
 	}
-	permut(random_table, fch->m);
+	permut(random_table, fch->m, mph->seed ? __seed_derive(mph->seed, mph->nseeds++) : 0);
 	for(i = 0; i < fch->m; i++)
 	{
 		map_table[random_table[i]] = i;
 	}
 	do {
 		if (fch->h2) hash_state_destroy(fch->h2);
-		fch->h2 = hash_state_new(fch->hashfuncs[1], fch->m);
+		fch->h2 = __config_hash_state(mph, fch->hashfuncs[1], fch->m);
 		restart = check_for_collisions_h2(fch, buckets, sorted_indexes);
 		filled_count = 0;
 		if (!restart)
@@ -204,7 +207,7 @@ static cmph_uint8 searching(fch_config_data_t *fch, fch_buckets_t *buckets, cmph
 			for(z = 0; (z < (fch->m - filled_count)) && restart; z++) {
 				char * key = fch_buckets_get_key(buckets, sorted_indexes[i], INDEX);
 				cmph_uint32 keylen = fch_buckets_get_keylength(buckets, sorted_indexes[i], INDEX);
-				cmph_uint32 h2 = hash(fch->h2, key, keylen) % fch->m;
+				cmph_uint32 h2 = fastrange32(hash(fch->h2, key, keylen), fch->m);
 				counter = 0;
 				restart = 0; // false
 				fch->g[sorted_indexes[i]] = (fch->m + random_table[filled_count + z] - h2) % fch->m;
@@ -214,8 +217,8 @@ static cmph_uint8 searching(fch_config_data_t *fch, fch_buckets_t *buckets, cmph
 					cmph_uint32 index = 0;
 					key = fch_buckets_get_key(buckets, sorted_indexes[i], j);
 					keylen = fch_buckets_get_keylength(buckets, sorted_indexes[i], j);
-					h2 = hash(fch->h2, key, keylen) % fch->m;
-					index = (h2 + fch->g[sorted_indexes[i]]) % fch->m;
+					h2 = fastrange32(hash(fch->h2, key, keylen), fch->m);
+					index = fch_displace(h2, fch->g[sorted_indexes[i]], fch->m);
 					//DEBUGP("key:%s  keylen:%u  index: %u  h2:%u  bucketsize:%u\n", key, keylen, index, h2, bucketsize);
 					if (map_table[index] >= filled_count) {
 						cmph_uint32 y  = map_table[index];
@@ -269,19 +272,23 @@ cmph_t *fch_new(cmph_config_t *mph, double c)
 		{
 			fprintf(stderr, "Entering mapping step for mph creation of %u keys\n", fch->m);
 		}
+		mph->stats.iterations++;
+		__config_phase(mph, CMPH_PHASE_HASHING);
 		if (buckets) fch_buckets_destroy(buckets, mph);
 		buckets = mapping(mph);
 		if (mph->verbosity)
 		{
 			fprintf(stderr, "Starting ordering step\n");
 		}
+		__config_phase(mph, CMPH_PHASE_MAPPING);
 		if (sorted_indexes) free (sorted_indexes);
 		sorted_indexes = ordering(buckets);
 		if (mph->verbosity)
 		{
 			fprintf(stderr, "Starting searching step.\n");
 		}
-		restart_mapping = searching(fch, buckets, sorted_indexes);
+		__config_phase(mph, CMPH_PHASE_SEARCHING);
+		restart_mapping = searching(mph, buckets, sorted_indexes);
 		iterations--;
 
         } while(restart_mapping && iterations > 0);
@@ -290,6 +297,7 @@ cmph_t *fch_new(cmph_config_t *mph, double c)
 	if (iterations == 0) return NULL;
 	mphf = (cmph_t *)malloc(sizeof(cmph_t));
 	mphf->algo = mph->algo;
+	mphf->version = CMPH_VERSION_FASTRANGE;
 	fchf = (fch_data_t *)malloc(sizeof(fch_data_t));
 	fchf->g = fch->g;
 	fch->g = NULL; //transfer memory ownership
@@ -399,11 +407,11 @@ void fch_load(FILE *f, cmph_t *mphf)
 cmph_uint32 fch_search(cmph_t *mphf, const char *key, cmph_uint32 keylen)
 {
 	fch_data_t *fch = (fch_data_t *)mphf->data;
-	cmph_uint32 h1 = hash(fch->h1, key, keylen) % fch->m;
-	cmph_uint32 h2 = hash(fch->h2, key, keylen) % fch->m;
+	cmph_uint32 h1 = RANGE(hash(fch->h1, key, keylen), fch->m, mphf->version);
+	cmph_uint32 h2 = RANGE(hash(fch->h2, key, keylen), fch->m, mphf->version);
 	h1 = mixh10h11h12 (fch->b, fch->p1, fch->p2, h1);
 	//DEBUGP("key: %s h1: %u h2: %u  g[h1]: %u\n", key, h1, h2, fch->g[h1]);
-	return (h2 + fch->g[h1]) % fch->m;
+	return fch_displace(h2, fch->g[h1], fch->m);
 }
 void fch_destroy(cmph_t *mphf)
 {
@@ -427,7 +435,7 @@ void fch_pack(cmph_t *mphf, void *packed_mphf)
 
 	// packing h1 type
 	CMPH_HASH h1_type = hash_get_type(data->h1);
-	*((cmph_uint32 *) ptr) = h1_type;
+	*((cmph_uint32 *) ptr) = h1_type | (mphf->version ? CMPH_PACKED_FASTRANGE : 0);
 	ptr += sizeof(cmph_uint32);
 
 	// packing h1
@@ -489,7 +497,8 @@ cmph_uint32 fch_packed_size(cmph_t *mphf)
 cmph_uint32 fch_search_packed(void *packed_mphf, const char *key, cmph_uint32 keylen)
 {
 	register cmph_uint8 *h1_ptr = (cmph_uint8 *)packed_mphf;
-	register CMPH_HASH h1_type  = (CMPH_HASH)*((cmph_uint32 *)h1_ptr);
+	register cmph_uint32 fastrange = *((cmph_uint32 *)h1_ptr) & CMPH_PACKED_FASTRANGE;
+	register CMPH_HASH h1_type  = (CMPH_HASH)(*((cmph_uint32 *)h1_ptr) & ~CMPH_PACKED_FASTRANGE);
 	h1_ptr += 4;
 
 	register cmph_uint8 *h2_ptr = h1_ptr + hash_state_packed_size(h1_type);
@@ -508,9 +517,9 @@ cmph_uint32 fch_search_packed(void *packed_mphf, const char *key, cmph_uint32 ke
 	register double p2 = (double)(*((cmph_uint64 *)g_ptr));
 	g_ptr += 2;
 
-	register cmph_uint32 h1 = hash_packed(h1_ptr, h1_type, key, keylen) % m;
-	register cmph_uint32 h2 = hash_packed(h2_ptr, h2_type, key, keylen) % m;
+	register cmph_uint32 h1 = RANGE(hash_packed(h1_ptr, h1_type, key, keylen), m, fastrange);
+	register cmph_uint32 h2 = RANGE(hash_packed(h2_ptr, h2_type, key, keylen), m, fastrange);
 
 	h1 = mixh10h11h12 (b, p1, p2, h1);
-	return (h2 + g_ptr[h1]) % m;
+	return fch_displace(h2, g_ptr[h1], m);
 }
@@ -12,6 +12,12 @@ double fch_calc_p1(cmph_uint32 m);
 double fch_calc_p2(cmph_uint32 b);
 cmph_uint32 mixh10h11h12(cmph_uint32 b, double p1, double p2, cmph_uint32 initial_index);
 
+/* (h2 + g) % m without a division, for h2 and g below m */
+static inline cmph_uint32 fch_displace(cmph_uint32 h2, cmph_uint32 g, cmph_uint32 m)
+{
+	return h2 >= m - g ? h2 - (m - g) : h2 + g;
+}
+
 fch_config_data_t *fch_config_new(void);
 void fch_config_set_hashfuncs(cmph_config_t *mph, CMPH_HASH *hashfuncs);
 void fch_config_destroy(cmph_config_t *mph);
@@ -36,7 +36,7 @@ static void fch_bucket_destroy(fch_bucket_t *bucket, cmph_config_t *mph)
 	for (i = 0; i < bucket->size; i++)
 	{
     fch_bucket_entry_t * entry = bucket->entries + i;
-		mph->key_source->dispose(mph->key_source->data, entry->value, entry->length);
+		__key_dispose(mph->key_source, entry->value, entry->length);
 	}
 	free(bucket->entries);
 }
@@ -0,0 +1,161 @@
+#include "fingerprint_hash.h"
+#include "murmur_hash.h"
+#include <stdlib.h>
+#include <limits.h>
+#include <string.h>
+
+//#define DEBUG
+#include "debug.h"
+
+/*
+   --------------------------------------------------------------------
+   The fingerprint of a key is its MurmurHash3_x64_128 digest with seed 0.
+   The values of a seed come from two rounds of the murmur finalizer over
+   the fingerprint and the seed, so they cost a few multiplies once the
+   fingerprint is known. Two keys only share values for every seed when
+   their 128-bit fingerprints collide.
+   --------------------------------------------------------------------
+ */
+#define FINGERPRINT_SEED_MULTIPLIER 0x9e3779b97f4a7c15ULL
+
+static inline cmph_uint64 fingerprint_mix(cmph_uint64 k)
+{
+	k ^= k >> 33;
+	k *= 0xff51afd7ed558ccdULL;
+	k ^= k >> 33;
+	k *= 0xc4ceb9fe1a85ec53ULL;
+	k ^= k >> 33;
+	return k;
+}
+
+static inline void __fingerprint_hash_vector_from(cmph_uint32 seed, const cmph_uint64 *fingerprint, cmph_uint32 * hashes)
+{
+	cmph_uint64 s = (cmph_uint64)seed * FINGERPRINT_SEED_MULTIPLIER;
+	cmph_uint64 a = fingerprint_mix(fingerprint[0] ^ s);
+	cmph_uint64 b = fingerprint_mix((fingerprint[1] + s) ^ a);
+	hashes[0] = (cmph_uint32)a;
+	hashes[1] = (cmph_uint32)(a >> 32);
+	hashes[2] = (cmph_uint32)b;
+}
+
+static inline void __fingerprint_hash_vector(cmph_uint32 seed, const char *k, cmph_uint32 keylen, cmph_uint32 * hashes)
+{
+	cmph_uint64 fingerprint[2];
+	murmur_hash128(0, k, keylen, fingerprint);
+	__fingerprint_hash_vector_from(seed, fingerprint, hashes);
+}
+
+fingerprint_state_t *fingerprint_state_new(cmph_uint32 size) //size of hash table
+{
+	fingerprint_state_t *state = (fingerprint_state_t *)malloc(sizeof(fingerprint_state_t));
+	if (!state) return NULL;
+	DEBUGP("Initializing fingerprint hash\n");
+	if (size > 0) state->seed = ((cmph_uint32)rand() % size);
+	else state->seed = 0;
+	return state;
+}
+
+void fingerprint_state_destroy(fingerprint_state_t *state)
+{
+	free(state);
+}
+
+void fingerprint_key(const char *k, cmph_uint32 keylen, cmph_uint64 * fingerprint)
+{
+	murmur_hash128(0, k, keylen, fingerprint);
+}
+
+void fingerprint_hash_vector_from(cmph_uint32 seed, const cmph_uint64 * fingerprint, cmph_uint32 * hashes)
+{
+	__fingerprint_hash_vector_from(seed, fingerprint, hashes);
+}
+
+cmph_uint32 fingerprint_hash(fingerprint_state_t *state, const char *k, cmph_uint32 keylen)
+{
+	cmph_uint32 hashes[3];
+	__fingerprint_hash_vector(state->seed, k, keylen, hashes);
+	return hashes[2];
+}
+
+void fingerprint_hash_vector_(fingerprint_state_t *state, const char *k, cmph_uint32 keylen, cmph_uint32 * hashes)
+{
+	__fingerprint_hash_vector(state->seed, k, keylen, hashes);
+}
+
+void fingerprint_state_dump(fingerprint_state_t *state, char **buf, cmph_uint32 *buflen)
+{
+	*buflen = sizeof(cmph_uint32);
+	*buf = (char *)malloc(sizeof(cmph_uint32));
+	if (!*buf)
+	{
+		*buflen = UINT_MAX;
+		return;
+	}
+	memcpy(*buf, &(state->seed), sizeof(cmph_uint32));
+	DEBUGP("Dumped fingerprint state with seed %u\n", state->seed);
+	return;
+}
+
+fingerprint_state_t *fingerprint_state_copy(fingerprint_state_t *src_state)
+{
+	fingerprint_state_t *dest_state = (fingerprint_state_t *)malloc(sizeof(fingerprint_state_t));
+	dest_state->hashfunc = src_state->hashfunc;
+	dest_state->seed = src_state->seed;
+	return dest_state;
+}
+
+fingerprint_state_t *fingerprint_state_load(const char *buf, cmph_uint32 buflen)
+{
+	fingerprint_state_t *state = (fingerprint_state_t *)malloc(sizeof(fingerprint_state_t));
+	(void)buflen;
+	state->seed = *(cmph_uint32 *)buf;
+	state->hashfunc = CMPH_HASH_FINGERPRINT;
+	DEBUGP("Loaded fingerprint state with seed %u\n", state->seed);
+	return state;
+}
+
+/** \fn void fingerprint_state_pack(fingerprint_state_t *state, void *fingerprint_packed);
+ *  \brief Support the ability to pack a fingerprint function into a preallocated contiguous memory space pointed by fingerprint_packed.
+ *  \param state points to the fingerprint function
+ *  \param fingerprint_packed pointer to the contiguous memory area used to store the fingerprint function. The size of fingerprint_packed must be at least fingerprint_state_packed_size()
+ */
+void fingerprint_state_pack(fingerprint_state_t *state, void *fingerprint_packed)
+{
+	if (state && fingerprint_packed)
+	{
+		memcpy(fingerprint_packed, &(state->seed), sizeof(cmph_uint32));
+	}
+}
+
+/** \fn cmph_uint32 fingerprint_state_packed_size(void);
+ *  \brief Return the amount of space needed to pack a fingerprint function.
+ *  \return the size of the packed function or zero for failures
+ */
+cmph_uint32 fingerprint_state_packed_size(void)
+{
+	return sizeof(cmph_uint32);
+}
+
+/** \fn cmph_uint32 fingerprint_hash_packed(void *fingerprint_packed, const char *k, cmph_uint32 keylen);
+ *  \param fingerprint_packed is a pointer to a contiguous memory area
+ *  \param key is a pointer to a key
+ *  \param keylen is the key length
+ *  \return an integer that represents a hash value of 32 bits.
+ */
+cmph_uint32 fingerprint_hash_packed(void *fingerprint_packed, const char *k, cmph_uint32 keylen)
+{
+	cmph_uint32 hashes[3];
+	__fingerprint_hash_vector(*((cmph_uint32 *)fingerprint_packed), k, keylen, hashes);
+	return hashes[2];
+}
+
+/** \fn fingerprint_hash_vector_packed(void *fingerprint_packed, const char *k, cmph_uint32 keylen, cmph_uint32 * hashes);
+ *  \param fingerprint_packed is a pointer to a contiguous memory area
+ *  \param key is a pointer to a key
+ *  \param keylen is the key length
+ *  \param hashes is a pointer to a memory large enough to fit three 32-bit integers.
+ */
+void fingerprint_hash_vector_packed(void *fingerprint_packed, const char *k, cmph_uint32 keylen, cmph_uint32 * hashes)
+{
+	__fingerprint_hash_vector(*((cmph_uint32 *)fingerprint_packed), k, keylen, hashes);
+}
@@ -0,0 +1,84 @@
+#ifndef __FINGERPRINT_HASH_H__
+#define __FINGERPRINT_HASH_H__
+
+#include "hash.h"
+
+/** The fingerprint function hashes a key once, with a fixed seed, into a
+ *  128-bit fingerprint, and derives the values of each seed from the
+ *  fingerprint alone. Builders that find it keep the fingerprints of the keys
+ *  and retry new seeds without reading the keys again.
+ */
+typedef struct __fingerprint_state_t
+{
+	CMPH_HASH hashfunc;
+	cmph_uint32 seed;
+} fingerprint_state_t;
+
+fingerprint_state_t *fingerprint_state_new(cmph_uint32 size); //size of hash table
+
+/** \fn void fingerprint_key(const char *k, cmph_uint32 keylen, cmph_uint64 * fingerprint);
+ *  \param key is a pointer to a key
+ *  \param keylen is the key length
+ *  \param fingerprint is a pointer to a memory large enough to fit two 64-bit integers.
+ */
+void fingerprint_key(const char *k, cmph_uint32 keylen, cmph_uint64 * fingerprint);
+
+/** \fn void fingerprint_hash_vector_from(cmph_uint32 seed, const cmph_uint64 * fingerprint, cmph_uint32 * hashes);
+ *  \brief Gives the values of hash_vector for the key of fingerprint.
+ *  \param seed is the seed of the function
+ *  \param fingerprint is the fingerprint of a key
+ *  \param hashes is a pointer to a memory large enough to fit three 32-bit integers.
+ */
+void fingerprint_hash_vector_from(cmph_uint32 seed, const cmph_uint64 * fingerprint, cmph_uint32 * hashes);
+
+/** \fn cmph_uint32 fingerprint_hash(fingerprint_state_t *state, const char *k, cmph_uint32 keylen);
+ *  \param state is a pointer to a fingerprint_state_t structure
+ *  \param key is a pointer to a key
+ *  \param keylen is the key length
+ *  \return an integer that represents a hash value of 32 bits.
+ */
+cmph_uint32 fingerprint_hash(fingerprint_state_t *state, const char *k, cmph_uint32 keylen);
+
+/** \fn void fingerprint_hash_vector_(fingerprint_state_t *state, const char *k, cmph_uint32 keylen, cmph_uint32 * hashes);
+ *  \param state is a pointer to a fingerprint_state_t structure
+ *  \param key is a pointer to a key
+ *  \param keylen is the key length
+ *  \param hashes is a pointer to a memory large enough to fit three 32-bit integers.
+ */
+void fingerprint_hash_vector_(fingerprint_state_t *state, const char *k, cmph_uint32 keylen, cmph_uint32 * hashes);
+
+void fingerprint_state_dump(fingerprint_state_t *state, char **buf, cmph_uint32 *buflen);
+fingerprint_state_t *fingerprint_state_copy(fingerprint_state_t *src_state);
+fingerprint_state_t *fingerprint_state_load(const char *buf, cmph_uint32 buflen);
+void fingerprint_state_destroy(fingerprint_state_t *state);
+
+/** \fn void fingerprint_state_pack(fingerprint_state_t *state, void *fingerprint_packed);
+ *  \brief Support the ability to pack a fingerprint function into a preallocated contiguous memory space pointed by fingerprint_packed.
+ *  \param state points to the fingerprint function
+ *  \param fingerprint_packed pointer to the contiguous memory area used to store the fingerprint function. The size of fingerprint_packed must be at least fingerprint_state_packed_size()
+ */
+void fingerprint_state_pack(fingerprint_state_t *state, void *fingerprint_packed);
+
+/** \fn cmph_uint32 fingerprint_state_packed_size();
+ *  \brief Return the amount of space needed to pack a fingerprint function.
+ *  \return the size of the packed function or zero for failures
+ */
+cmph_uint32 fingerprint_state_packed_size(void);
+
+/** \fn cmph_uint32 fingerprint_hash_packed(void *fingerprint_packed, const char *k, cmph_uint32 keylen);
+ *  \param fingerprint_packed is a pointer to a contiguous memory area
+ *  \param key is a pointer to a key
+ *  \param keylen is the key length
+ *  \return an integer that represents a hash value of 32 bits.
+ */
+cmph_uint32 fingerprint_hash_packed(void *fingerprint_packed, const char *k, cmph_uint32 keylen);
+
+/** \fn fingerprint_hash_vector_packed(void *fingerprint_packed, const char *k, cmph_uint32 keylen, cmph_uint32 * hashes);
+ *  \param fingerprint_packed is a pointer to a contiguous memory area
+ *  \param key is a pointer to a key
+ *  \param keylen is the key length
+ *  \param hashes is a pointer to a memory large enough to fit three 32-bit integers.
+ */
+void fingerprint_hash_vector_packed(void *fingerprint_packed, const char *k, cmph_uint32 keylen, cmph_uint32 * hashes);
+
+#endif
@@ -7,7 +7,7 @@
 //#define DEBUG
 #include "debug.h"
 
-const char *cmph_hash_names[] = { "jenkins", NULL };
+const char *cmph_hash_names[] = { "jenkins", "murmur", "wyhash", "fingerprint", "integer", NULL };
 
 hash_state_t *hash_state_new(CMPH_HASH hashfunc, cmph_uint32 hashsize)
 {
@@ -19,18 +19,64 @@ hash_state_t *hash_state_new(CMPH_HASH hashfunc, cmph_uint32 hashsize)
 			state = (hash_state_t *)jenkins_state_new(hashsize);
 	  		DEBUGP("Jenkins function created\n");
 			break;
+		case CMPH_HASH_MURMUR:
+			state = (hash_state_t *)murmur_state_new(hashsize);
+			break;
+		case CMPH_HASH_WYHASH:
+			state = (hash_state_t *)wy_state_new(hashsize);
+			break;
+		case CMPH_HASH_FINGERPRINT:
+			state = (hash_state_t *)fingerprint_state_new(hashsize);
+			break;
+		case CMPH_HASH_INTEGER:
+			state = (hash_state_t *)integer_state_new(hashsize);
+			break;
 		default:
 			assert(0);
 	}
 	state->hashfunc = hashfunc;
 	return state;
 }
+
+hash_state_t *hash_state_seeded(CMPH_HASH hashfunc, cmph_uint32 seed)
+{
+	hash_state_t *state = hash_state_new(hashfunc, 0);
+	switch (hashfunc)
+	{
+		case CMPH_HASH_JENKINS:
+			state->jenkins.seed = seed;
+			break;
+		case CMPH_HASH_MURMUR:
+			state->murmur.seed = seed;
+			break;
+		case CMPH_HASH_WYHASH:
+			state->wy.seed = seed;
+			break;
+		case CMPH_HASH_FINGERPRINT:
+			state->fingerprint.seed = seed;
+			break;
+		case CMPH_HASH_INTEGER:
+			state->integer.seed = seed;
+			break;
+		default:
+			assert(0);
+	}
+	return state;
+}
 cmph_uint32 hash(hash_state_t *state, const char *key, cmph_uint32 keylen)
 {
 	switch (state->hashfunc)
 	{
 		case CMPH_HASH_JENKINS:
 			return jenkins_hash((jenkins_state_t *)state, key, keylen);
+		case CMPH_HASH_MURMUR:
+			return murmur_hash((murmur_state_t *)state, key, keylen);
+		case CMPH_HASH_WYHASH:
+			return wy_hash((wy_state_t *)state, key, keylen);
+		case CMPH_HASH_FINGERPRINT:
+			return fingerprint_hash((fingerprint_state_t *)state, key, keylen);
+		case CMPH_HASH_INTEGER:
+			return integer_hash((integer_state_t *)state, key, keylen);
 		default:
 			assert(0);
 	}
@@ -45,6 +91,18 @@ void hash_vector(hash_state_t *state, const char *key, cmph_uint32 keylen, cmph_
 		case CMPH_HASH_JENKINS:
 			jenkins_hash_vector_((jenkins_state_t *)state, key, keylen, hashes);
 			break;
+		case CMPH_HASH_MURMUR:
+			murmur_hash_vector_((murmur_state_t *)state, key, keylen, hashes);
+			break;
+		case CMPH_HASH_WYHASH:
+			wy_hash_vector_((wy_state_t *)state, key, keylen, hashes);
+			break;
+		case CMPH_HASH_FINGERPRINT:
+			fingerprint_hash_vector_((fingerprint_state_t *)state, key, keylen, hashes);
+			break;
+		case CMPH_HASH_INTEGER:
+			integer_hash_vector_((integer_state_t *)state, key, keylen, hashes);
+			break;
 		default:
 			assert(0);
 	}
@@ -63,6 +121,22 @@ void hash_state_dump(hash_state_t *state, char **buf, cmph_uint32 *buflen)
                 goto cmph_cleanup;
             }
 			break;
+		case CMPH_HASH_MURMUR:
+			murmur_state_dump((murmur_state_t *)state, &algobuf, buflen);
+			if (*buflen == UINT_MAX) goto cmph_cleanup;
+			break;
+		case CMPH_HASH_WYHASH:
+			wy_state_dump((wy_state_t *)state, &algobuf, buflen);
+			if (*buflen == UINT_MAX) goto cmph_cleanup;
+			break;
+		case CMPH_HASH_FINGERPRINT:
+			fingerprint_state_dump((fingerprint_state_t *)state, &algobuf, buflen);
+			if (*buflen == UINT_MAX) goto cmph_cleanup;
+			break;
+		case CMPH_HASH_INTEGER:
+			integer_state_dump((integer_state_t *)state, &algobuf, buflen);
+			if (*buflen == UINT_MAX) goto cmph_cleanup;
+			break;
 		default:
 			assert(0);
 	}
@@ -85,6 +159,18 @@ hash_state_t * hash_state_copy(hash_state_t *src_state)
 		case CMPH_HASH_JENKINS:
 			dest_state = (hash_state_t *)jenkins_state_copy((jenkins_state_t *)src_state);
 			break;
+		case CMPH_HASH_MURMUR:
+			dest_state = (hash_state_t *)murmur_state_copy((murmur_state_t *)src_state);
+			break;
+		case CMPH_HASH_WYHASH:
+			dest_state = (hash_state_t *)wy_state_copy((wy_state_t *)src_state);
+			break;
+		case CMPH_HASH_FINGERPRINT:
+			dest_state = (hash_state_t *)fingerprint_state_copy((fingerprint_state_t *)src_state);
+			break;
+		case CMPH_HASH_INTEGER:
+			dest_state = (hash_state_t *)integer_state_copy((integer_state_t *)src_state);
+			break;
 		default:
 			assert(0);
 	}
@@ -111,6 +197,14 @@ hash_state_t *hash_state_load(const char *buf, cmph_uint32 buflen)
 	{
 		case CMPH_HASH_JENKINS:
 			return (hash_state_t *)jenkins_state_load(buf + offset, buflen - offset);
+		case CMPH_HASH_MURMUR:
+			return (hash_state_t *)murmur_state_load(buf + offset, buflen - offset);
+		case CMPH_HASH_WYHASH:
+			return (hash_state_t *)wy_state_load(buf + offset, buflen - offset);
+		case CMPH_HASH_FINGERPRINT:
+			return (hash_state_t *)fingerprint_state_load(buf + offset, buflen - offset);
+		case CMPH_HASH_INTEGER:
+			return (hash_state_t *)integer_state_load(buf + offset, buflen - offset);
 		default:
 			return NULL;
 	}
@@ -118,11 +212,24 @@ hash_state_t *hash_state_load(const char *buf, cmph_uint32 buflen)
 }
 void hash_state_destroy(hash_state_t *state)
 {
+	if (state == NULL) return;
 	switch (state->hashfunc)
 	{
 		case CMPH_HASH_JENKINS:
 			jenkins_state_destroy((jenkins_state_t *)state);
 			break;
+		case CMPH_HASH_MURMUR:
+			murmur_state_destroy((murmur_state_t *)state);
+			break;
+		case CMPH_HASH_WYHASH:
+			wy_state_destroy((wy_state_t *)state);
+			break;
+		case CMPH_HASH_FINGERPRINT:
+			fingerprint_state_destroy((fingerprint_state_t *)state);
+			break;
+		case CMPH_HASH_INTEGER:
+			integer_state_destroy((integer_state_t *)state);
+			break;
 		default:
 			assert(0);
 	}
@@ -139,12 +246,25 @@ void hash_state_destroy(hash_state_t *state)
  */
 void hash_state_pack(hash_state_t *state, void *hash_packed)
 {
+	if (state == NULL) return;
 	switch (state->hashfunc)
 	{
 		case CMPH_HASH_JENKINS:
 			// pack the jenkins hash function
 			jenkins_state_pack((jenkins_state_t *)state, hash_packed);
 			break;
+		case CMPH_HASH_MURMUR:
+			murmur_state_pack((murmur_state_t *)state, hash_packed);
+			break;
+		case CMPH_HASH_WYHASH:
+			wy_state_pack((wy_state_t *)state, hash_packed);
+			break;
+		case CMPH_HASH_FINGERPRINT:
+			fingerprint_state_pack((fingerprint_state_t *)state, hash_packed);
+			break;
+		case CMPH_HASH_INTEGER:
+			integer_state_pack((integer_state_t *)state, hash_packed);
+			break;
 		default:
 			assert(0);
 	}
@@ -164,6 +284,20 @@ cmph_uint32 hash_state_packed_size(CMPH_HASH hashfunc)
 		case CMPH_HASH_JENKINS:
 			size += jenkins_state_packed_size();
 			break;
+		case CMPH_HASH_MURMUR:
+			size += murmur_state_packed_size();
+			break;
+		case CMPH_HASH_WYHASH:
+			size += wy_state_packed_size();
+			break;
+		case CMPH_HASH_FINGERPRINT:
+			size += fingerprint_state_packed_size();
+			break;
+		case CMPH_HASH_INTEGER:
+			size += integer_state_packed_size();
+			break;
+		case CMPH_HASH_COUNT: // missing second state of a pair
+			break;
 		default:
 			assert(0);
 	}
@@ -183,6 +317,14 @@ cmph_uint32 hash_packed(void *hash_packed, CMPH_HASH hashfunc, const char *k, cm
 	{
 		case CMPH_HASH_JENKINS:
 			return jenkins_hash_packed(hash_packed, k, keylen);
+		case CMPH_HASH_MURMUR:
+			return murmur_hash_packed(hash_packed, k, keylen);
+		case CMPH_HASH_WYHASH:
+			return wy_hash_packed(hash_packed, k, keylen);
+		case CMPH_HASH_FINGERPRINT:
+			return fingerprint_hash_packed(hash_packed, k, keylen);
+		case CMPH_HASH_INTEGER:
+			return integer_hash_packed(hash_packed, k, keylen);
 		default:
 			assert(0);
 	}
@@ -203,6 +345,18 @@ void hash_vector_packed(void *hash_packed, CMPH_HASH hashfunc, const char *k, cm
 		case CMPH_HASH_JENKINS:
 			jenkins_hash_vector_packed(hash_packed, k, keylen, hashes);
 			break;
+		case CMPH_HASH_MURMUR:
+			murmur_hash_vector_packed(hash_packed, k, keylen, hashes);
+			break;
+		case CMPH_HASH_WYHASH:
+			wy_hash_vector_packed(hash_packed, k, keylen, hashes);
+			break;
+		case CMPH_HASH_FINGERPRINT:
+			fingerprint_hash_vector_packed(hash_packed, k, keylen, hashes);
+			break;
+		case CMPH_HASH_INTEGER:
+			integer_hash_vector_packed(hash_packed, k, keylen, hashes);
+			break;
 		default:
 			assert(0);
 	}
@@ -215,5 +369,117 @@ void hash_vector_packed(void *hash_packed, CMPH_HASH hashfunc, const char *k, cm
  */
 CMPH_HASH hash_get_type(hash_state_t *state)
 {
+	if (state == NULL) return CMPH_HASH_COUNT;
 	return state->hashfunc;
 }
+
+void hash_pair_new(CMPH_HASH h1func, CMPH_HASH h2func, cmph_uint32 hashsize, hash_state_t **h1, hash_state_t **h2)
+{
+	if (h1func == h2func)
+	{
+		// a single seed replaces two of them: keep as many distinct pairs
+		*h1 = hash_state_new(h1func, hashsize < 0x10000 ? hashsize * hashsize : UINT_MAX);
+		*h2 = NULL;
+		return;
+	}
+	*h1 = hash_state_new(h1func, hashsize);
+	*h2 = hash_state_new(h2func, hashsize);
+}
+
+void hash_pair(hash_state_t *h1, hash_state_t *h2, const char *key, cmph_uint32 keylen, cmph_uint32 * hashes)
+{
+	if (h2 == NULL)
+	{
+		cmph_uint32 hv[3];
+		hash_vector(h1, key, keylen, hv);
+		hashes[0] = hv[0];
+		hashes[1] = hv[1];
+		return;
+	}
+	hashes[0] = hash(h1, key, keylen);
+	hashes[1] = hash(h2, key, keylen);
+}
+
+void hash_pair_packed(void *h1_packed, CMPH_HASH h1func, void *h2_packed, CMPH_HASH h2func, const char *k, cmph_uint32 keylen, cmph_uint32 * hashes)
+{
+	if (h2func == CMPH_HASH_COUNT)
+	{
+		cmph_uint32 hv[3];
+		hash_vector_packed(h1_packed, h1func, k, keylen, hv);
+		hashes[0] = hv[0];
+		hashes[1] = hv[1];
+		return;
+	}
+	hashes[0] = hash_packed(h1_packed, h1func, k, keylen);
+	hashes[1] = hash_packed(h2_packed, h2func, k, keylen);
+}
+
+void hash_fingerprint(const char *key, cmph_uint32 keylen, cmph_uint64 * fingerprint)
+{
+	fingerprint_key(key, keylen, fingerprint);
+}
+
+void hash_vector_fingerprint(hash_state_t *state, const cmph_uint64 * fingerprint, cmph_uint32 * hashes)
+{
+	assert(state->hashfunc == CMPH_HASH_FINGERPRINT);
+	fingerprint_hash_vector_from(state->fingerprint.seed, fingerprint, hashes);
+}
+
+void hash_pair_fingerprint(hash_state_t *h1, hash_state_t *h2, const cmph_uint64 * fingerprint, cmph_uint32 * hashes)
+{
+	cmph_uint32 hv[3];
+	hash_vector_fingerprint(h1, fingerprint, hv);
+	if (h2 == NULL)
+	{
+		hashes[0] = hv[0];
+		hashes[1] = hv[1];
+		return;
+	}
+	hashes[0] = hv[2];
+	hash_vector_fingerprint(h2, fingerprint, hv);
+	hashes[1] = hv[2];
+}
+
+void hash_vector_integer(hash_state_t *state, cmph_uint64 key, cmph_uint32 keylen, cmph_uint32 * hashes)
+{
+	if (state->hashfunc == CMPH_HASH_INTEGER) integer_hash_vector_from(state->integer.seed, key, keylen, hashes);
+	else if (keylen == sizeof(cmph_uint32))
+	{
+		cmph_uint32 key32 = (cmph_uint32)key;
+		hash_vector(state, (const char *)&key32, keylen, hashes);
+	}
+	else hash_vector(state, (const char *)&key, keylen, hashes);
+}
+
+void hash_vector_packed_integer(void *hash_packed, CMPH_HASH hashfunc, cmph_uint64 key, cmph_uint32 keylen, cmph_uint32 * hashes)
+{
+	if (hashfunc == CMPH_HASH_INTEGER) integer_hash_vector_from(*(cmph_uint32 *)hash_packed, key, keylen, hashes);
+	else if (keylen == sizeof(cmph_uint32))
+	{
+		cmph_uint32 key32 = (cmph_uint32)key;
+		hash_vector_packed(hash_packed, hashfunc, (const char *)&key32, keylen, hashes);
+	}
+	else hash_vector_packed(hash_packed, hashfunc, (const char *)&key, keylen, hashes);
+}
+
+void hash_vector_batch(hash_state_t *state, const char **keys, const cmph_uint32 *keylens, cmph_uint32 n, cmph_uint32 (*hashes)[3])
+{
+	cmph_uint32 i;
+	if (state->hashfunc == CMPH_HASH_JENKINS)
+	{
+		jenkins_hash_vector_batch(state->jenkins.seed, keys, keylens, n, hashes);
+		return;
+	}
+	for (i = 0; i < n; ++i) hash_vector(state, keys[i], keylens[i], hashes[i]);
+}
+
+void hash_vector_packed_batch(void *hash_packed, CMPH_HASH hashfunc, const char **keys, const cmph_uint32 *keylens, cmph_uint32 n, cmph_uint32 (*hashes)[3])
+{
+	cmph_uint32 i;
+	if (hashfunc == CMPH_HASH_JENKINS)
+	{
+		jenkins_hash_vector_batch(*(cmph_uint32 *)hash_packed, keys, keylens, n, hashes);
+		return;
+	}
+	for (i = 0; i < n; ++i) hash_vector_packed(hash_packed, hashfunc, keys[i], keylens[i], hashes[i]);
+}
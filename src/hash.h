@@ -7,6 +7,14 @@ typedef union __hash_state_t hash_state_t;
 
 hash_state_t *hash_state_new(CMPH_HASH, cmph_uint32 hashsize);
 
+/** \fn hash_state_t *hash_state_seeded(CMPH_HASH hashfunc, cmph_uint32 seed);
+ *  \brief Creates a hash function with the given seed instead of one from rand().
+ *  \param hashfunc type of the hash function
+ *  \param seed seed of the hash function
+ *  \return the new hash function
+ */
+hash_state_t *hash_state_seeded(CMPH_HASH hashfunc, cmph_uint32 seed);
+
 /** \fn cmph_uint32 hash(hash_state_t *state, const char *key, cmph_uint32 keylen);
  *  \param state is a pointer to a hash_state_t structure
  *  \param key is a pointer to a key
@@ -69,8 +77,106 @@ void hash_vector_packed(void *hash_packed, CMPH_HASH hashfunc, const char *k, cm
 
 /** \fn CMPH_HASH hash_get_type(hash_state_t *state);
  *  \param state is a pointer to a hash_state_t structure
- *  \return the hash function type pointed by state
+ *  \return the hash function type pointed by state, CMPH_HASH_COUNT for the missing second state of a pair
  */
 CMPH_HASH hash_get_type(hash_state_t *state);
 
+/** \fn void hash_pair_new(CMPH_HASH h1func, CMPH_HASH h2func, cmph_uint32 hashsize, hash_state_t **h1, hash_state_t **h2);
+ *  \brief Creates the two hash functions that map a key to an edge of a graph.
+ *  When h1func and h2func are the same only *h1 is created and *h2 is set to NULL:
+ *  hash_pair then takes both values from a single pass over the key. A NULL state
+ *  is accepted by hash_get_type, hash_state_pack, hash_state_destroy and packs to
+ *  zero bytes, so such pairs are dumped and packed with one state only.
+ *  \param h1func type of the first hash function
+ *  \param h2func type of the second hash function
+ *  \param hashsize size of the hash table
+ *  \param h1 receives the first state
+ *  \param h2 receives the second state or NULL
+ */
+void hash_pair_new(CMPH_HASH h1func, CMPH_HASH h2func, cmph_uint32 hashsize, hash_state_t **h1, hash_state_t **h2);
+
+/** \fn void hash_pair(hash_state_t *h1, hash_state_t *h2, const char *key, cmph_uint32 keylen, cmph_uint32 * hashes);
+ *  \param h1 is a pointer to the first hash_state_t structure
+ *  \param h2 is a pointer to the second hash_state_t structure or NULL
+ *  \param key is a pointer to a key
+ *  \param keylen is the key length
+ *  \param hashes is a pointer to a memory large enough to fit two 32-bit integers.
+ */
+void hash_pair(hash_state_t *h1, hash_state_t *h2, const char *key, cmph_uint32 keylen, cmph_uint32 * hashes);
+
+/** \fn void hash_pair_packed(void *h1_packed, CMPH_HASH h1func, void *h2_packed, CMPH_HASH h2func, const char *k, cmph_uint32 keylen, cmph_uint32 * hashes);
+ *  \param h1_packed is a pointer to the first packed hash function
+ *  \param h1func is the type of the first hash function
+ *  \param h2_packed is a pointer to the second packed hash function
+ *  \param h2func is the type of the second hash function, CMPH_HASH_COUNT if there is none
+ *  \param key is a pointer to a key
+ *  \param keylen is the key length
+ *  \param hashes is a pointer to a memory large enough to fit two 32-bit integers.
+ */
+void hash_pair_packed(void *h1_packed, CMPH_HASH h1func, void *h2_packed, CMPH_HASH h2func, const char *k, cmph_uint32 keylen, cmph_uint32 * hashes);
+
+/** \fn void hash_fingerprint(const char *key, cmph_uint32 keylen, cmph_uint64 * fingerprint);
+ *  \brief Computes the 128-bit fingerprint of a key. Functions of type
+ *  CMPH_HASH_FINGERPRINT derive all their values from it, so builders may
+ *  fingerprint the keys once and try many seeds without reading them again.
+ *  \param key is a pointer to a key
+ *  \param keylen is the key length
+ *  \param fingerprint is a pointer to a memory large enough to fit two 64-bit integers.
+ */
+void hash_fingerprint(const char *key, cmph_uint32 keylen, cmph_uint64 * fingerprint);
+
+/** \fn void hash_vector_fingerprint(hash_state_t *state, const cmph_uint64 * fingerprint, cmph_uint32 * hashes);
+ *  \brief Same as hash_vector for the key of fingerprint, state must be of type CMPH_HASH_FINGERPRINT.
+ *  \param state is a pointer to a hash_state_t structure
+ *  \param fingerprint is the fingerprint of a key
+ *  \param hashes is a pointer to a memory large enough to fit three 32-bit integers.
+ */
+void hash_vector_fingerprint(hash_state_t *state, const cmph_uint64 * fingerprint, cmph_uint32 * hashes);
+
+/** \fn void hash_pair_fingerprint(hash_state_t *h1, hash_state_t *h2, const cmph_uint64 * fingerprint, cmph_uint32 * hashes);
+ *  \brief Same as hash_pair for the key of fingerprint, the states must be of type CMPH_HASH_FINGERPRINT.
+ *  \param h1 is a pointer to the first hash_state_t structure
+ *  \param h2 is a pointer to the second hash_state_t structure or NULL
+ *  \param fingerprint is the fingerprint of a key
+ *  \param hashes is a pointer to a memory large enough to fit two 32-bit integers.
+ */
+void hash_pair_fingerprint(hash_state_t *h1, hash_state_t *h2, const cmph_uint64 * fingerprint, cmph_uint32 * hashes);
+
+/** \fn void hash_vector_integer(hash_state_t *state, cmph_uint64 key, cmph_uint32 keylen, cmph_uint32 * hashes);
+ *  \brief Same as hash_vector for a key that is an integer of keylen bytes, 4 or 8,
+ *  in the byte order of the host. Functions of type CMPH_HASH_INTEGER take it
+ *  without going through memory.
+ *  \param state is a pointer to a hash_state_t structure
+ *  \param key is the integer
+ *  \param keylen is the size of the integer, 4 or 8
+ *  \param hashes is a pointer to a memory large enough to fit three 32-bit integers.
+ */
+void hash_vector_integer(hash_state_t *state, cmph_uint64 key, cmph_uint32 keylen, cmph_uint32 * hashes);
+
+/** \fn void hash_vector_packed_integer(void *hash_packed, CMPH_HASH hashfunc, cmph_uint64 key, cmph_uint32 keylen, cmph_uint32 * hashes);
+ *  \brief Same as hash_vector_integer for a packed hash function.
+ *  \param hash_packed is a pointer to a contiguous memory area
+ *  \param hashfunc is the type of the hash function packed in hash_packed
+ *  \param key is the integer
+ *  \param keylen is the size of the integer, 4 or 8
+ *  \param hashes is a pointer to a memory large enough to fit three 32-bit integers.
+ */
+void hash_vector_packed_integer(void *hash_packed, CMPH_HASH hashfunc, cmph_uint64 key, cmph_uint32 keylen, cmph_uint32 * hashes);
+
+/** \fn void hash_vector_batch(hash_state_t *state, const char **keys, const cmph_uint32 *keylens, cmph_uint32 n, cmph_uint32 (*hashes)[3]);
+ *  \brief Same as calling hash_vector on each of the n keys. Hash functions
+ *  with a multi-key kernel, currently jenkins, hash several keys at a time.
+ *  \param state is a pointer to a hash_state_t structure
+ *  \param keys is an array of n keys
+ *  \param keylens is an array of n key lengths
+ *  \param n is the number of keys
+ *  \param hashes receives the three 32-bit values of each key
+ */
+void hash_vector_batch(hash_state_t *state, const char **keys, const cmph_uint32 *keylens, cmph_uint32 n, cmph_uint32 (*hashes)[3]);
+
+/** \fn void hash_vector_packed_batch(void *hash_packed, CMPH_HASH hashfunc, const char **keys, const cmph_uint32 *keylens, cmph_uint32 n, cmph_uint32 (*hashes)[3]);
+ *  \brief Same as hash_vector_batch for a packed hash function.
+ */
+void hash_vector_packed_batch(void *hash_packed, CMPH_HASH hashfunc, const char **keys, const cmph_uint32 *keylens, cmph_uint32 n, cmph_uint32 (*hashes)[3]);
+
 #endif
@@ -3,10 +3,18 @@
 
 #include "hash.h"
 #include "jenkins_hash.h"
+#include "murmur_hash.h"
+#include "wy_hash.h"
+#include "fingerprint_hash.h"
+#include "integer_hash.h"
 union __hash_state_t
 {
 	CMPH_HASH hashfunc;
 	jenkins_state_t jenkins;
+	murmur_state_t murmur;
+	wy_state_t wy;
+	fingerprint_state_t fingerprint;
+	integer_state_t integer;
 };
 
 #endif
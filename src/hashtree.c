@@ -121,6 +121,7 @@ cmph_t *hashtree_new(cmph_config_t *mph, double c)
 
 	mphf = (cmph_t *)malloc(sizeof(cmph_t));
 	mphf->algo = mph->algo;
+	mphf->version = 0;
 	hashtreef = (hashtree_data_t *)malloc(sizeof(hashtree_data_t));
 	hashtreef->g = hashtree->g;
 	hashtree->g = NULL; //transfer memory ownership
@@ -179,11 +180,11 @@ static int hashtree_gen_edges(cmph_config_t *mph)
 		if (h1 == h2)
 		{
 			if (mph->verbosity) fprintf(stderr, "Self loop for key %u\n", e);
-			mph->key_source->dispose(mph->key_source->data, key, keylen);
+			__key_dispose(mph->key_source, key, keylen);
 			return 0;
 		}
 		DEBUGP("Adding edge: %u -> %u for key %s\n", h1, h2, key);
-		mph->key_source->dispose(mph->key_source->data, key, keylen);
+		__key_dispose(mph->key_source, key, keylen);
 		graph_add_edge(hashtree->graph, h1, h2);
 	}
 	cycles = graph_is_cyclic(hashtree->graph);
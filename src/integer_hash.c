@@ -0,0 +1,132 @@
+#include "integer_hash.h"
+#include "murmur_hash.h"
+#include <stdlib.h>
+#include <limits.h>
+#include <string.h>
+
+//#define DEBUG
+#include "debug.h"
+
+static inline void __integer_hash_vector(cmph_uint32 seed, const char *k, cmph_uint32 keylen, cmph_uint32 * hashes)
+{
+	cmph_uint64 key;
+	if (keylen == sizeof(cmph_uint64)) memcpy(&key, k, sizeof(cmph_uint64));
+	else if (keylen == sizeof(cmph_uint32))
+	{
+		cmph_uint32 key32;
+		memcpy(&key32, k, sizeof(cmph_uint32));
+		key = key32;
+	}
+	else
+	{
+		cmph_uint64 digest[2];
+		murmur_hash128(0, k, keylen, digest);
+		key = digest[0];
+	}
+	integer_hash_vector_from(seed, key, keylen, hashes);
+}
+
+integer_state_t *integer_state_new(cmph_uint32 size) //size of hash table
+{
+	integer_state_t *state = (integer_state_t *)malloc(sizeof(integer_state_t));
+	if (!state) return NULL;
+	DEBUGP("Initializing integer hash\n");
+	if (size > 0) state->seed = ((cmph_uint32)rand() % size);
+	else state->seed = 0;
+	return state;
+}
+
+void integer_state_destroy(integer_state_t *state)
+{
+	free(state);
+}
+
+cmph_uint32 integer_hash(integer_state_t *state, const char *k, cmph_uint32 keylen)
+{
+	cmph_uint32 hashes[3];
+	__integer_hash_vector(state->seed, k, keylen, hashes);
+	return hashes[2];
+}
+
+void integer_hash_vector_(integer_state_t *state, const char *k, cmph_uint32 keylen, cmph_uint32 * hashes)
+{
+	__integer_hash_vector(state->seed, k, keylen, hashes);
+}
+
+void integer_state_dump(integer_state_t *state, char **buf, cmph_uint32 *buflen)
+{
+	*buflen = sizeof(cmph_uint32);
+	*buf = (char *)malloc(sizeof(cmph_uint32));
+	if (!*buf)
+	{
+		*buflen = UINT_MAX;
+		return;
+	}
+	memcpy(*buf, &(state->seed), sizeof(cmph_uint32));
+	DEBUGP("Dumped integer state with seed %u\n", state->seed);
+	return;
+}
+
+integer_state_t *integer_state_copy(integer_state_t *src_state)
+{
+	integer_state_t *dest_state = (integer_state_t *)malloc(sizeof(integer_state_t));
+	dest_state->hashfunc = src_state->hashfunc;
+	dest_state->seed = src_state->seed;
+	return dest_state;
+}
+
+integer_state_t *integer_state_load(const char *buf, cmph_uint32 buflen)
+{
+	integer_state_t *state = (integer_state_t *)malloc(sizeof(integer_state_t));
+	(void)buflen;
+	state->seed = *(cmph_uint32 *)buf;
+	state->hashfunc = CMPH_HASH_INTEGER;
+	DEBUGP("Loaded integer state with seed %u\n", state->seed);
+	return state;
+}
+
+/** \fn void integer_state_pack(integer_state_t *state, void *integer_packed);
+ *  \brief Support the ability to pack an integer function into a preallocated contiguous memory space pointed by integer_packed.
+ *  \param state points to the integer function
+ *  \param integer_packed pointer to the contiguous memory area used to store the integer function. The size of integer_packed must be at least integer_state_packed_size()
+ */
+void integer_state_pack(integer_state_t *state, void *integer_packed)
+{
+	if (state && integer_packed)
+	{
+		memcpy(integer_packed, &(state->seed), sizeof(cmph_uint32));
+	}
+}
+
+/** \fn cmph_uint32 integer_state_packed_size(void);
+ *  \brief Return the amount of space needed to pack an integer function.
+ *  \return the size of the packed function or zero for failures
+ */
+cmph_uint32 integer_state_packed_size(void)
+{
+	return sizeof(cmph_uint32);
+}
+
+/** \fn cmph_uint32 integer_hash_packed(void *integer_packed, const char *k, cmph_uint32 keylen);
+ *  \param integer_packed is a pointer to a contiguous memory area
+ *  \param key is a pointer to a key
+ *  \param keylen is the key length
+ *  \return an integer that represents a hash value of 32 bits.
+ */
+cmph_uint32 integer_hash_packed(void *integer_packed, const char *k, cmph_uint32 keylen)
+{
+	cmph_uint32 hashes[3];
+	__integer_hash_vector(*((cmph_uint32 *)integer_packed), k, keylen, hashes);
+	return hashes[2];
+}
+
+/** \fn integer_hash_vector_packed(void *integer_packed, const char *k, cmph_uint32 keylen, cmph_uint32 * hashes);
+ *  \param integer_packed is a pointer to a contiguous memory area
+ *  \param key is a pointer to a key
+ *  \param keylen is the key length
+ *  \param hashes is a pointer to a memory large enough to fit three 32-bit integers.
+ */
+void integer_hash_vector_packed(void *integer_packed, const char *k, cmph_uint32 keylen, cmph_uint32 * hashes)
+{
+	__integer_hash_vector(*((cmph_uint32 *)integer_packed), k, keylen, hashes);
+}
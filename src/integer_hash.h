@@ -0,0 +1,101 @@
+#ifndef __INTEGER_HASH_H__
+#define __INTEGER_HASH_H__
+
+#include "hash.h"
+
+/** The integer function is meant for keys that are 4 or 8-byte integers in
+ *  the byte order of the host, such as those of cmph_search_u32 and
+ *  cmph_search_u64. It loads them as one integer and derives the values of a
+ *  seed with two multiply and xorshift rounds. Keys of other lengths are
+ *  first reduced to 64 bits with MurmurHash3.
+ */
+typedef struct __integer_state_t
+{
+	CMPH_HASH hashfunc;
+	cmph_uint32 seed;
+} integer_state_t;
+
+integer_state_t *integer_state_new(cmph_uint32 size); //size of hash table
+
+#define INTEGER_SEED_MULTIPLIER 0x9e3779b97f4a7c15ULL
+
+static inline cmph_uint64 integer_mix(cmph_uint64 k)
+{
+	k ^= k >> 33;
+	k *= 0xff51afd7ed558ccdULL;
+	k ^= k >> 33;
+	k *= 0xc4ceb9fe1a85ec53ULL;
+	k ^= k >> 33;
+	return k;
+}
+
+/** \fn void integer_hash_vector_from(cmph_uint32 seed, cmph_uint64 key, cmph_uint32 keylen, cmph_uint32 * hashes);
+ *  \brief Gives the values of hash_vector for an integer key. The two rounds
+ *  are independent so that their multiplies overlap, and the length keeps
+ *  4 and 8-byte keys of equal value apart.
+ *  \param seed is the seed of the function
+ *  \param key is the integer
+ *  \param keylen is the length of the key, 4 or 8
+ *  \param hashes is a pointer to a memory large enough to fit three 32-bit integers.
+ */
+static inline void integer_hash_vector_from(cmph_uint32 seed, cmph_uint64 key, cmph_uint32 keylen, cmph_uint32 * hashes)
+{
+	cmph_uint64 s = ((cmph_uint64)keylen << 32 | seed) * INTEGER_SEED_MULTIPLIER;
+	cmph_uint64 a = integer_mix(key ^ s);
+	cmph_uint64 b = integer_mix(key + (s << 32 | s >> 32));
+	hashes[0] = (cmph_uint32)a;
+	hashes[1] = (cmph_uint32)(a >> 32);
+	hashes[2] = (cmph_uint32)b;
+}
+
+/** \fn cmph_uint32 integer_hash(integer_state_t *state, const char *k, cmph_uint32 keylen);
+ *  \param state is a pointer to an integer_state_t structure
+ *  \param key is a pointer to a key
+ *  \param keylen is the key length
+ *  \return an integer that represents a hash value of 32 bits.
+ */
+cmph_uint32 integer_hash(integer_state_t *state, const char *k, cmph_uint32 keylen);
+
+/** \fn void integer_hash_vector_(integer_state_t *state, const char *k, cmph_uint32 keylen, cmph_uint32 * hashes);
+ *  \param state is a pointer to an integer_state_t structure
+ *  \param key is a pointer to a key
+ *  \param keylen is the key length
+ *  \param hashes is a pointer to a memory large enough to fit three 32-bit integers.
+ */
+void integer_hash_vector_(integer_state_t *state, const char *k, cmph_uint32 keylen, cmph_uint32 * hashes);
+
+void integer_state_dump(integer_state_t *state, char **buf, cmph_uint32 *buflen);
+integer_state_t *integer_state_copy(integer_state_t *src_state);
+integer_state_t *integer_state_load(const char *buf, cmph_uint32 buflen);
+void integer_state_destroy(integer_state_t *state);
+
+/** \fn void integer_state_pack(integer_state_t *state, void *integer_packed);
+ *  \brief Support the ability to pack an integer function into a preallocated contiguous memory space pointed by integer_packed.
+ *  \param state points to the integer function
+ *  \param integer_packed pointer to the contiguous memory area used to store the integer function. The size of integer_packed must be at least integer_state_packed_size()
+ */
+void integer_state_pack(integer_state_t *state, void *integer_packed);
+
+/** \fn cmph_uint32 integer_state_packed_size();
+ *  \brief Return the amount of space needed to pack an integer function.
+ *  \return the size of the packed function or zero for failures
+ */
+cmph_uint32 integer_state_packed_size(void);
+
+/** \fn cmph_uint32 integer_hash_packed(void *integer_packed, const char *k, cmph_uint32 keylen);
+ *  \param integer_packed is a pointer to a contiguous memory area
+ *  \param key is a pointer to a key
+ *  \param keylen is the key length
+ *  \return an integer that represents a hash value of 32 bits.
+ */
+cmph_uint32 integer_hash_packed(void *integer_packed, const char *k, cmph_uint32 keylen);
+
+/** \fn integer_hash_vector_packed(void *integer_packed, const char *k, cmph_uint32 keylen, cmph_uint32 * hashes);
+ *  \param integer_packed is a pointer to a contiguous memory area
+ *  \param key is a pointer to a key
+ *  \param keylen is the key length
+ *  \param hashes is a pointer to a memory large enough to fit three 32-bit integers.
+ */
+void integer_hash_vector_packed(void *integer_packed, const char *k, cmph_uint32 keylen, cmph_uint32 * hashes);
+
+#endif
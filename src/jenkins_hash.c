@@ -7,6 +7,13 @@
 #include <limits.h>
 #include <string.h>
 
+// The batched kernels load the key words with memcpy, which matches the
+// little-endian loads of __jenkins_hash_vector on x86 only.
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define JENKINS_SIMD
+#include <immintrin.h>
+#endif
+
 //#define DEBUG
 #include "debug.h"
 
@@ -297,3 +304,159 @@ void jenkins_hash_vector_packed(void *jenkins_packed, const char *k, cmph_uint32
 {
 	__jenkins_hash_vector(*((cmph_uint32 *)jenkins_packed), (const unsigned char*)k, keylen, hashes);
 }
+
+#ifdef JENKINS_SIMD
+#define JENKINS_MAX_LANES 8
+
+// mix() on vectors of 32-bit lanes, sub, xor, srl and sll are the intrinsics
+// of the instruction set.
+#define JENKINS_MIX_LANES(a,b,c,sub,xor,srl,sll) \
+{ \
+	a = sub(a, b); a = sub(a, c); a = xor(a, srl(c, 13)); \
+	b = sub(b, c); b = sub(b, a); b = xor(b, sll(a, 8)); \
+	c = sub(c, a); c = sub(c, b); c = xor(c, srl(b, 13)); \
+	a = sub(a, b); a = sub(a, c); a = xor(a, srl(c, 12)); \
+	b = sub(b, c); b = sub(b, a); b = xor(b, sll(a, 16)); \
+	c = sub(c, a); c = sub(c, b); c = xor(c, srl(b, 5)); \
+	a = sub(a, b); a = sub(a, c); a = xor(a, srl(c, 3)); \
+	b = sub(b, c); b = sub(b, a); b = xor(b, sll(a, 10)); \
+	c = sub(c, a); c = sub(c, b); c = xor(c, srl(b, 15)); \
+}
+
+// Loads the words added to a, b and c by round round of the keys of the
+// lanes, transposed into w. Round rounds is the tail of the keys: it is zero
+// padded to 12 bytes, so keys of different lengths but the same number of
+// full rounds share the kernel, and the third word gets the key length.
+static inline void jenkins_lanes_load(const char **keys, const cmph_uint32 *keylens, cmph_uint32 lanes,
+                                      cmph_uint32 round, cmph_uint32 rounds, cmph_uint32 (*w)[JENKINS_MAX_LANES])
+{
+	cmph_uint32 lane;
+	for (lane = 0; lane < lanes; ++lane)
+	{
+		const char *k = keys[lane] + 12*round;
+		char tail[12];
+		if (round == rounds)
+		{
+			memset(tail, 0, sizeof(tail));
+			memcpy(tail, k, keylens[lane] - 12*rounds);
+			k = tail;
+		}
+		memcpy(&w[0][lane], k, sizeof(cmph_uint32));
+		memcpy(&w[1][lane], k + 4, sizeof(cmph_uint32));
+		memcpy(&w[2][lane], k + 8, sizeof(cmph_uint32));
+		/* the first byte of the third word is reserved for the length */
+		if (round == rounds) w[2][lane] = (w[2][lane] << 8) + keylens[lane];
+	}
+}
+
+__attribute__((target("avx2")))
+static void jenkins_hash_vector_avx2(cmph_uint32 seed, const char **keys, const cmph_uint32 *keylens, cmph_uint32 rounds, cmph_uint32 (*hashes)[3])
+{
+	cmph_uint32 w[3][JENKINS_MAX_LANES];
+	__m256i a = _mm256_set1_epi32((int)0x9e3779b9);
+	__m256i b = a;
+	__m256i c = _mm256_set1_epi32((int)seed);
+	cmph_uint32 round, lane;
+	for (round = 0; round <= rounds; ++round)
+	{
+		jenkins_lanes_load(keys, keylens, 8, round, rounds, w);
+		a = _mm256_add_epi32(a, _mm256_loadu_si256((const __m256i *)w[0]));
+		b = _mm256_add_epi32(b, _mm256_loadu_si256((const __m256i *)w[1]));
+		c = _mm256_add_epi32(c, _mm256_loadu_si256((const __m256i *)w[2]));
+		JENKINS_MIX_LANES(a, b, c, _mm256_sub_epi32, _mm256_xor_si256, _mm256_srli_epi32, _mm256_slli_epi32);
+	}
+	_mm256_storeu_si256((__m256i *)w[0], a);
+	_mm256_storeu_si256((__m256i *)w[1], b);
+	_mm256_storeu_si256((__m256i *)w[2], c);
+	for (lane = 0; lane < 8; ++lane)
+	{
+		hashes[lane][0] = w[0][lane];
+		hashes[lane][1] = w[1][lane];
+		hashes[lane][2] = w[2][lane];
+	}
+}
+
+__attribute__((target("sse2")))
+static void jenkins_hash_vector_sse2(cmph_uint32 seed, const char **keys, const cmph_uint32 *keylens, cmph_uint32 rounds, cmph_uint32 (*hashes)[3])
+{
+	cmph_uint32 w[3][JENKINS_MAX_LANES];
+	__m128i a = _mm_set1_epi32((int)0x9e3779b9);
+	__m128i b = a;
+	__m128i c = _mm_set1_epi32((int)seed);
+	cmph_uint32 round, lane;
+	for (round = 0; round <= rounds; ++round)
+	{
+		jenkins_lanes_load(keys, keylens, 4, round, rounds, w);
+		a = _mm_add_epi32(a, _mm_loadu_si128((const __m128i *)w[0]));
+		b = _mm_add_epi32(b, _mm_loadu_si128((const __m128i *)w[1]));
+		c = _mm_add_epi32(c, _mm_loadu_si128((const __m128i *)w[2]));
+		JENKINS_MIX_LANES(a, b, c, _mm_sub_epi32, _mm_xor_si128, _mm_srli_epi32, _mm_slli_epi32);
+	}
+	_mm_storeu_si128((__m128i *)w[0], a);
+	_mm_storeu_si128((__m128i *)w[1], b);
+	_mm_storeu_si128((__m128i *)w[2], c);
+	for (lane = 0; lane < 4; ++lane)
+	{
+		hashes[lane][0] = w[0][lane];
+		hashes[lane][1] = w[1][lane];
+		hashes[lane][2] = w[2][lane];
+	}
+}
+
+// Number of lanes of the widest kernel the processor runs. Threads racing on
+// the first call all store the same value.
+static cmph_uint32 jenkins_lanes(void)
+{
+	static cmph_uint32 lanes = 0;
+	if (lanes == 0)
+	{
+		__builtin_cpu_init();
+		lanes = __builtin_cpu_supports("avx2") ? 8 : (__builtin_cpu_supports("sse2") ? 4 : 1);
+		DEBUGP("Hashing batches of keys with jenkins on %u lanes\n", lanes);
+	}
+	return lanes;
+}
+#endif
+
+/** \fn void jenkins_hash_vector_batch(cmph_uint32 seed, const char **keys, const cmph_uint32 *keylens, cmph_uint32 n, cmph_uint32 (*hashes)[3]);
+ *  \brief Same as calling jenkins_hash_vector_ on each key. Runs of keys with
+ *  the same number of 12-byte rounds are hashed 8 or 4 at a time with AVX2 or
+ *  SSE2 when the processor has them, the other keys one at a time.
+ *  \param seed is the seed of the function
+ *  \param keys is an array of n keys
+ *  \param keylens is an array of n key lengths
+ *  \param n is the number of keys
+ *  \param hashes receives the three 32-bit values of each key
+ */
+void jenkins_hash_vector_batch(cmph_uint32 seed, const char **keys, const cmph_uint32 *keylens, cmph_uint32 n, cmph_uint32 (*hashes)[3])
+{
+	cmph_uint32 i = 0;
+#ifdef JENKINS_SIMD
+	cmph_uint32 lanes = jenkins_lanes();
+	while (lanes >= 4 && i + 4 <= n)
+	{
+		cmph_uint32 rounds = keylens[i] / 12;
+		cmph_uint32 j = i + 1;
+		while (j < n && j - i < lanes && keylens[j] / 12 == rounds) ++j;
+		if (j - i == 8)
+		{
+			jenkins_hash_vector_avx2(seed, keys + i, keylens + i, rounds, hashes + i);
+			i += 8;
+		}
+		else if (j - i >= 4)
+		{
+			jenkins_hash_vector_sse2(seed, keys + i, keylens + i, rounds, hashes + i);
+			i += 4;
+		}
+		else
+		{
+			__jenkins_hash_vector(seed, (const unsigned char *)keys[i], keylens[i], hashes[i]);
+			++i;
+		}
+	}
+#endif
+	for (; i < n; ++i)
+	{
+		__jenkins_hash_vector(seed, (const unsigned char *)keys[i], keylens[i], hashes[i]);
+	}
+}
@@ -27,6 +27,16 @@ cmph_uint32 jenkins_hash(jenkins_state_t *state, const char *k, cmph_uint32 keyl
  */
 void jenkins_hash_vector_(jenkins_state_t *state, const char *k, cmph_uint32 keylen, cmph_uint32 * hashes);
 
+/** \fn void jenkins_hash_vector_batch(cmph_uint32 seed, const char **keys, const cmph_uint32 *keylens, cmph_uint32 n, cmph_uint32 (*hashes)[3]);
+ *  \brief Same as calling jenkins_hash_vector_ on each key, hashing several keys at a time with SIMD instructions when the processor has them.
+ *  \param seed is the seed of the function
+ *  \param keys is an array of n keys
+ *  \param keylens is an array of n key lengths
+ *  \param n is the number of keys
+ *  \param hashes receives the three 32-bit values of each key
+ */
+void jenkins_hash_vector_batch(cmph_uint32 seed, const char **keys, const cmph_uint32 *keylens, cmph_uint32 n, cmph_uint32 (*hashes)[3]);
+
 void jenkins_state_dump(jenkins_state_t *state, char **buf, cmph_uint32 *buflen);
 jenkins_state_t *jenkins_state_copy(jenkins_state_t *src_state);
 jenkins_state_t *jenkins_state_load(const char *buf, cmph_uint32 buflen);
@@ -12,6 +12,8 @@
 #include <assert.h>
 #include "cmph.h"
 #include "hash.h"
+#include "cmph_time.h"
+#include "thread_pool.h"
 
 #ifdef WIN32
 #define VERSION "0.8"
@@ -20,14 +22,231 @@
 #endif
 
 
+// Parallel verification. Every task checks a chunk of the adapter, or a part
+// of a block of keys read serially, with batched lookups, and marks the bins
+// in a bitset, or in byte counters for t-perfect functions, through atomic
+// operations. Each task keeps its first failed key and the one of lowest
+// index is reported. Which key of a colliding pair fails depends on the order
+// the threads mark their bins in.
+#define VERIFY_BLOCK 65536U
+#define VERIFY_KEYS_PER_TASK 4096U
+#define VERIFY_BATCH 256U
+
+typedef struct
+{
+	cmph_uint64 nfailed;
+	cmph_uint64 first;  // index of the first failed key
+	char *key;          // copy of the first failed key
+	cmph_uint32 keylen;
+} verify_result_t;
+
+typedef struct
+{
+	cmph_t *mphf;
+	cmph_io_adapter_t *source;
+	cmph_uint64 size;
+	cmph_uint32 keys_per_bin;
+	cmph_uint8 *bins;
+	char **keys;          // block of keys read serially
+	cmph_uint32 *keylens;
+	cmph_uint64 first;    // index of keys[0]
+	cmph_uint32 nkeys;
+	verify_result_t *results;
+} verify_job_t;
+
+static double now(void)
+{
+	double t = (double)time(NULL);
+#ifdef __GNUC__
+	elapsed_time_in_seconds(&t);
+#endif
+	return t;
+}
+
+// Marks bin h, returns 1 when it already holds keys_per_bin keys.
+static int verify_mark(verify_job_t *job, cmph_uint64 h)
+{
+	cmph_uint8 *bin;
+	cmph_uint8 count;
+	if (job->keys_per_bin == 1)
+	{
+		cmph_uint8 bit = (cmph_uint8)(1U << (h & 7));
+		bin = job->bins + (h >> 3);
+#ifdef __GNUC__
+		return (__atomic_fetch_or(bin, bit, __ATOMIC_RELAXED) & bit) != 0;
+#else
+		count = *bin;
+		*bin |= bit;
+		return (count & bit) != 0;
+#endif
+	}
+	bin = job->bins + h;
+#ifdef __GNUC__
+	count = __atomic_load_n(bin, __ATOMIC_RELAXED);
+	do
+	{
+		if (count >= job->keys_per_bin) return 1;
+	} while (!__atomic_compare_exchange_n(bin, &count, (cmph_uint8)(count + 1), 1, __ATOMIC_RELAXED, __ATOMIC_RELAXED));
+	return 0;
+#else
+	if (*bin >= job->keys_per_bin) return 1;
+	(*bin)++;
+	return 0;
+#endif
+}
+
+// Checks n keys, the first of which has index first.
+static void verify_keys(verify_job_t *job, verify_result_t *result, cmph_uint64 first, char **keys, cmph_uint32 *keylens, cmph_uint32 n)
+{
+	cmph_uint32 values[VERIFY_BATCH];
+	cmph_uint32 i, j, nbatch;
+	for (i = 0; i < n; i += nbatch)
+	{
+		nbatch = n - i < VERIFY_BATCH ? n - i : VERIFY_BATCH;
+		if (job->size <= UINT_MAX) cmph_search_batch(job->mphf, (const char **)keys + i, keylens + i, nbatch, values);
+		for (j = 0; j < nbatch; ++j)
+		{
+			cmph_uint64 h = job->size <= UINT_MAX ? values[j] : cmph_search64(job->mphf, keys[i + j], keylens[i + j]);
+			if (h < job->size && !verify_mark(job, h)) continue;
+			if (result->nfailed++ == 0)
+			{
+				result->first = first + i + j;
+				result->keylen = keylens[i + j];
+				result->key = (char *)malloc((size_t)result->keylen + 1);
+				memcpy(result->key, keys[i + j], (size_t)result->keylen);
+			}
+		}
+	}
+}
+
+static void verify_chunk_task(void *arg, cmph_uint32 chunk)
+{
+	verify_job_t *job = (verify_job_t *)arg;
+	cmph_io_adapter_t *source = job->source;
+	cmph_uint64 first = source->chunk_first[chunk];
+	char *keys[VERIFY_BATCH];
+	cmph_uint32 keylens[VERIFY_BATCH];
+	cmph_uint32 i, n;
+	while ((n = source->read_batch(source->data, chunk, keys, keylens, VERIFY_BATCH)) > 0)
+	{
+		verify_keys(job, job->results + chunk, first, keys, keylens, n);
+		for (i = 0; i < n; ++i) source->dispose(source->data, keys[i], keylens[i]);
+		first += n;
+	}
+}
+
+static void verify_block_task(void *arg, cmph_uint32 task)
+{
+	verify_job_t *job = (verify_job_t *)arg;
+	cmph_uint32 i = task * VERIFY_KEYS_PER_TASK;
+	cmph_uint32 n = job->nkeys - i < VERIFY_KEYS_PER_TASK ? job->nkeys - i : VERIFY_KEYS_PER_TASK;
+	verify_keys(job, job->results + task, job->first + i, job->keys + i, job->keylens + i, n);
+}
+
+// Folds the results of ntasks tasks into result.
+static void verify_merge(verify_result_t *result, verify_result_t *results, cmph_uint32 ntasks)
+{
+	cmph_uint32 i;
+	for (i = 0; i < ntasks; ++i)
+	{
+		if (results[i].nfailed && (result->nfailed == 0 || results[i].first < result->first))
+		{
+			free(result->key);
+			result->first = results[i].first;
+			result->key = results[i].key;
+			result->keylen = results[i].keylen;
+		}
+		else free(results[i].key);
+		result->nfailed += results[i].nfailed;
+	}
+	memset(results, 0, sizeof(verify_result_t)*ntasks);
+}
+
+// Checks every key of source on nthreads threads, returns the number of keys
+// read and fills result.
+static cmph_uint64 verify_parallel(cmph_t *mphf, cmph_io_adapter_t *source, cmph_uint32 keys_per_bin, cmph_uint32 nthreads, verify_result_t *result)
+{
+	verify_job_t job;
+	cmph_uint64 nkeys = 0;
+	job.mphf = mphf;
+	job.source = source;
+	job.size = cmph_size64(mphf);
+	job.keys_per_bin = keys_per_bin;
+	job.bins = (cmph_uint8 *)calloc(keys_per_bin == 1 ? (size_t)(job.size/8 + 1) : (size_t)job.size, sizeof(cmph_uint8));
+	memset(result, 0, sizeof(verify_result_t));
+	source->rewind(source->data);
+	if (source->read_batch != NULL)
+	{
+		job.results = (verify_result_t *)calloc((size_t)source->nchunks + 1, sizeof(verify_result_t));
+		thread_pool_run(nthreads, source->nchunks, verify_chunk_task, &job);
+		verify_merge(result, job.results, source->nchunks);
+		nkeys = source->chunk_first[source->nchunks];
+	}
+	else
+	{
+		cmph_uint32 i;
+		char end = 0;
+		job.results = (verify_result_t *)calloc((size_t)VERIFY_BLOCK/VERIFY_KEYS_PER_TASK, sizeof(verify_result_t));
+		job.keys = (char **)malloc(sizeof(char *)*VERIFY_BLOCK);
+		job.keylens = (cmph_uint32 *)malloc(sizeof(cmph_uint32)*VERIFY_BLOCK);
+		do
+		{
+			cmph_uint32 ntasks;
+			for (job.nkeys = 0; !end && job.nkeys < VERIFY_BLOCK && nkeys + job.nkeys < source->nkeys; ++job.nkeys)
+			{
+				job.keys[job.nkeys] = NULL;
+				if (source->read(source->data, job.keys + job.nkeys, job.keylens + job.nkeys) < 0)
+				{
+					// the keys of a stream end with a failed read
+					if (job.keys[job.nkeys]) source->dispose(source->data, job.keys[job.nkeys], job.keylens[job.nkeys]);
+					end = 1;
+					break;
+				}
+			}
+			job.first = nkeys;
+			ntasks = (job.nkeys + VERIFY_KEYS_PER_TASK - 1)/VERIFY_KEYS_PER_TASK;
+			thread_pool_run(nthreads, ntasks, verify_block_task, &job);
+			verify_merge(result, job.results, ntasks);
+			for (i = 0; i < job.nkeys; ++i) source->dispose(source->data, job.keys[i], job.keylens[i]);
+			nkeys += job.nkeys;
+		} while (job.nkeys == VERIFY_BLOCK);
+		free(job.keys);
+		free(job.keylens);
+	}
+	free(job.results);
+	free(job.bins);
+	return nkeys;
+}
+
+static void print_build_stats(const cmph_build_stats_t *stats)
+{
+	cmph_uint32 i;
+	fprintf(stderr, "%-12s %10s %10s\n", "phase", "wall (s)", "cpu (s)");
+	for (i = 0; i < CMPH_PHASE_COUNT; ++i)
+	{
+		if (stats->wall_time[i] == 0 && stats->cpu_time[i] == 0) continue;
+		fprintf(stderr, "%-12s %10.3f %10.3f\n", cmph_phase_names[i], stats->wall_time[i], stats->cpu_time[i]);
+	}
+	fprintf(stderr, "%-12s %10.3f %10.3f\n", "total", stats->total_wall_time, stats->total_cpu_time);
+	fprintf(stderr, "iterations: %u\n", stats->iterations);
+	if (stats->peak_memory) fprintf(stderr, "peak memory: %.1f MB\n", stats->peak_memory/1048576.0);
+	if (stats->tmp_bytes_written || stats->tmp_bytes_read)
+	{
+		fprintf(stderr, "temporary files: %llu bytes written, %llu bytes read\n",
+		        (unsigned long long)stats->tmp_bytes_written, (unsigned long long)stats->tmp_bytes_read);
+	}
+	if (stats->bits_per_key > 0) fprintf(stderr, "bits per key: %.3f\n", stats->bits_per_key);
+	if (stats->duplicates) fprintf(stderr, "duplicated keys: %llu\n", (unsigned long long)stats->duplicates);
+}
+
 void usage(const char *prg)
 {
-	fprintf(stderr, "usage: %s [-v] [-h] [-V] [-k nkeys] [-f hash_function] [-g [-c algorithm_dependent_value][-s seed] ] [-a algorithm] [-M memory_in_MB] [-b algorithm_dependent_value] [-t keys_per_bin] [-d tmp_dir] [-m file.mph]  keysfile\n", prg);
+	fprintf(stderr, "usage: %s [-v] [-h] [-V] [-k nkeys] [-f hash_function] [-g [-c algorithm_dependent_value][-s seed] ] [-a algorithm] [-i bucket_algorithm] [-M memory_in_MB] [-b algorithm_dependent_value] [-t keys_per_bin] [-d tmp_dir] [-j threads] [-D] [-m file.mph] [-w file.keys] keysfile...\n", prg);
 }
 void usage_long(const char *prg)
 {
 	cmph_uint32 i;
-	fprintf(stderr, "usage: %s [-v] [-h] [-V] [-k nkeys] [-f hash_function] [-g [-c algorithm_dependent_value][-s seed] ] [-a algorithm] [-M memory_in_MB] [-b algorithm_dependent_value] [-t keys_per_bin] [-d tmp_dir] [-m file.mph] keysfile\n", prg);
+	fprintf(stderr, "usage: %s [-v] [-h] [-V] [-k nkeys] [-f hash_function] [-g [-c algorithm_dependent_value][-s seed] ] [-a algorithm] [-i bucket_algorithm] [-M memory_in_MB] [-b algorithm_dependent_value] [-t keys_per_bin] [-d tmp_dir] [-j threads] [-D] [-m file.mph] [-w file.keys] keysfile...\n", prg);
 	fprintf(stderr, "Minimum perfect hashing tool\n\n");
 	fprintf(stderr, "  -h\t print this help message\n");
 	fprintf(stderr, "  -c\t c value determines:\n");
@@ -36,6 +255,8 @@ void usage_long(const char *prg)
 	fprintf(stderr, "    \t  * the load factor in the CHD_PH algorithm\n");
 	fprintf(stderr, "  -a\t algorithm - valid values are\n");
 	for (i = 0; i < CMPH_COUNT; ++i) fprintf(stderr, "    \t  * %s\n", cmph_names[i]);
+	fprintf(stderr, "  -i\t algorithm of the buckets of BRZ - valid values are fch, bmz8, bdz and chd.\n");
+	fprintf(stderr, "    \t By default fch is used when c is at least 2 and bmz8 otherwise\n");
 	fprintf(stderr, "  -f\t hash function (may be used multiple times) - valid values are\n");
 	for (i = 0; i < CMPH_HASH_COUNT; ++i) fprintf(stderr, "    \t  * %s\n", cmph_hash_names[i]);
 	fprintf(stderr, "  -V\t print version number and exit\n");
@@ -44,24 +265,34 @@ void usage_long(const char *prg)
 	fprintf(stderr, "  -g\t generation mode\n");
 	fprintf(stderr, "  -s\t random seed\n");
 	fprintf(stderr, "  -m\t minimum perfect hash function file \n");
-	fprintf(stderr, "  -M\t main memory availability (in MB) used in BRZ algorithm \n");
-	fprintf(stderr, "  -d\t temporary directory used in BRZ algorithm \n");
+	fprintf(stderr, "  -w\t write the keys of keysfile to a binary key file and exit\n");
+	fprintf(stderr, "  -M\t main memory availability (in MB) used in BRZ and CHD_SHARDED algorithms\n");
+	fprintf(stderr, "  -d\t temporary directory used in BRZ and CHD_SHARDED algorithms\n");
+	fprintf(stderr, "  -j\t number of threads used in the construction (BDZ, BRZ and CHD_SHARDED) and in the\n");
+	fprintf(stderr, "    \t verification of the keys, without -v. Default is 1\n");
+	fprintf(stderr, "  -D\t check the keys for duplicates before the construction and fail if there are\n");
+	fprintf(stderr, "    \t any. Given twice, build the function on the first occurrence of each key\n");
 	fprintf(stderr, "  -b\t the meaning of this parameter depends on the algorithm selected in the -a option:\n");
 	fprintf(stderr, "    \t  * For BRZ it is used to make the maximal number of keys in a bucket lower than 256.\n");
-	fprintf(stderr, "    \t    In this case its value should be an integer in the range [64,175]. Default is 128.\n\n");
-	fprintf(stderr, "    \t  * For BDZ it is used to determine the size of some precomputed rank\n");
-	fprintf(stderr, "    \t    information and its value should be an integer in the range [3,10]. Default\n");
-	fprintf(stderr, "    \t    is 7. The larger is this value, the more compact are the resulting functions\n");
-	fprintf(stderr, "    \t    and the slower are them at evaluation time.\n\n");
-	fprintf(stderr, "    \t  * For CHD and CHD_PH it is used to set the average number of keys per bucket\n");
+	fprintf(stderr, "    \t    In this case its value should be an integer in the range [64,175]. Default is 128.\n");
+	fprintf(stderr, "    \t    With bdz or chd buckets it is the average number of keys in a bucket, at\n");
+	fprintf(stderr, "    \t    most 32768. Default is 2048.\n\n");
+	fprintf(stderr, "    \t  * For BDZ it is used to determine the size of the rank table written to the\n");
+	fprintf(stderr, "    \t    mph file and its value should be an integer in the range [3,10]. Default is 7.\n");
+	fprintf(stderr, "    \t    The larger is this value, the smaller is the file. It does not change the\n");
+	fprintf(stderr, "    \t    evaluation, which ranks with the 64-byte lines built when the function is\n");
+	fprintf(stderr, "    \t    created or loaded.\n\n");
+	fprintf(stderr, "    \t  * For CHD, CHD_PH and CHD_SHARDED it is used to set the average number of keys per bucket\n");
 	fprintf(stderr, "    \t    and its value should be an integer in the range [1,32]. Default is 4. The\n");
 	fprintf(stderr, "    \t    larger is this value, the slower is the construction of the functions.\n");
 	fprintf(stderr, "    \t    This parameter has no effect for other algorithms.\n\n");
 	fprintf(stderr, "  -t\t set the number of keys per bin for a t-perfect hashing function. A t-perfect\n");
 	fprintf(stderr, "    \t hash function allows at most t collisions in a given bin. This parameter applies\n");
-	fprintf(stderr, "    \t only to the CHD and CHD_PH algorithms. Its value should be an integer in the\n");
+	fprintf(stderr, "    \t only to the CHD, CHD_PH and CHD_SHARDED algorithms. Its value should be an integer in the\n");
 	fprintf(stderr, "    \t range [1,128]. Defaul is 1\n");
-	fprintf(stderr, "  keysfile\t line separated file with keys\n");
+	fprintf(stderr, "  keysfile\t line separated file with keys, or a binary key file written by -w.\n");
+	fprintf(stderr, "          \t Several line separated files may be given, their keys are read in turn.\n");
+	fprintf(stderr, "          \t With -, line separated keys are read once from the standard input\n");
 }
 
 int main(int argc, char **argv)
@@ -72,23 +303,28 @@ int main(int argc, char **argv)
 	FILE *mphf_fd = stdout;
 	const char *keys_file = NULL;
 	FILE *keys_fd;
-	cmph_uint32 nkeys = UINT_MAX;
+	cmph_uint64 nkeys = ULLONG_MAX;
 	cmph_uint32 seed = UINT_MAX;
 	CMPH_HASH *hashes = NULL;
 	cmph_uint32 nhashes = 0;
 	cmph_uint32 i;
 	CMPH_ALGO mph_algo = CMPH_CHM;
+	CMPH_ALGO bucket_algo = CMPH_COUNT;
 	double c = 0;
 	cmph_config_t *config = NULL;
 	cmph_t *mphf = NULL;
 	char * tmp_dir = NULL;
-	cmph_io_adapter_t *source;
+	cmph_io_adapter_t *source = NULL;
+	enum { NL_FILE, MMAP_NL_FILE, BINARY_FILE } source_type = NL_FILE;
+	char *binary_file = NULL;
 	cmph_uint32 memory_availability = 0;
 	cmph_uint32 b = 0;
 	cmph_uint32 keys_per_bin = 1;
+	cmph_uint32 nthreads = 1;
+	CMPH_DUPLICATES duplicates = CMPH_DUPLICATES_IGNORE;
 	while (1)
 	{
-		char ch = (char)getopt(argc, argv, "hVvgc:k:a:M:b:t:f:m:d:s:");
+		char ch = (char)getopt(argc, argv, "hVvgDc:k:a:i:M:b:t:f:m:d:s:j:w:");
 		if (ch == -1) break;
 		switch (ch)
 		{
@@ -118,7 +354,7 @@ int main(int argc, char **argv)
 			case 'k':
 			        {
 					char *endptr;
-					nkeys = (cmph_uint32)strtoul(optarg, &endptr, 10);
+					nkeys = (cmph_uint64)strtoull(optarg, &endptr, 10);
 					if(*endptr != 0) {
 						fprintf(stderr, "Invalid number of keys %s\n", optarg);
 						exit(1);
@@ -131,6 +367,9 @@ int main(int argc, char **argv)
 			case 'd':
 				tmp_dir = strdup(optarg);
 				break;
+			case 'w':
+				binary_file = strdup(optarg);
+				break;
 			case 'M':
 				{
 					char *cptr;
@@ -161,9 +400,22 @@ int main(int argc, char **argv)
 					}
 				}
 				break;
+			case 'j':
+				{
+					char *cptr;
+					nthreads = (cmph_uint32)strtoul(optarg, &cptr, 10);
+					if(*cptr != 0 || nthreads == 0) {
+						fprintf(stderr, "Invalid number of threads %s\n", optarg);
+						exit(1);
+					}
+				}
+				break;
 			case 'v':
 				++verbosity;
 				break;
+			case 'D':
+				duplicates = duplicates == CMPH_DUPLICATES_IGNORE ? CMPH_DUPLICATES_FAIL : CMPH_DUPLICATES_DROP;
+				break;
 			case 'V':
 				printf("%s\n", VERSION);
 				return 0;
@@ -189,6 +441,25 @@ int main(int argc, char **argv)
 				}
 				}
 				break;
+			case 'i':
+				{
+				char valid = 0;
+				for (i = 0; i < CMPH_COUNT; ++i)
+				{
+					if (strcmp(cmph_names[i], optarg) == 0)
+					{
+						bucket_algo = (CMPH_ALGO)i;
+						valid = (i == CMPH_FCH || i == CMPH_BMZ8 || i == CMPH_BDZ || i == CMPH_CHD);
+						break;
+					}
+				}
+				if (!valid)
+				{
+					fprintf(stderr, "Invalid bucket algorithm: %s\n", optarg);
+					return -1;
+				}
+				}
+				break;
 			case 'f':
 				{
 				char valid = 0;
@@ -217,7 +488,7 @@ int main(int argc, char **argv)
 		}
 	}
 
-	if (optind != argc - 1)
+	if (optind >= argc)
 	{
 		usage(argv[0]);
 		return 1;
@@ -227,6 +498,11 @@ int main(int argc, char **argv)
 	if (seed == UINT_MAX) seed = (cmph_uint32)time(NULL);
 	srand(seed);
 	int ret = 0;
+	if (mphf_file == NULL && binary_file == NULL && strcmp(keys_file, "-") == 0)
+	{
+		fprintf(stderr, "Keys read from the standard input need -m\n");
+		return 1;
+	}
 	if (mphf_file == NULL)
 	{
 		mphf_file = (char *)malloc(strlen(keys_file) + 5);
@@ -234,7 +510,7 @@ int main(int argc, char **argv)
 		memcpy(mphf_file + strlen(keys_file), ".mph\0", (size_t)5);
 	}
 
-	keys_fd = fopen(keys_file, "r");
+	keys_fd = strcmp(keys_file, "-") == 0 ? stdin : fopen(keys_file, "rb");
 
 	if (keys_fd == NULL)
 	{
@@ -243,9 +519,34 @@ int main(int argc, char **argv)
 	}
 
 	if (seed == UINT_MAX) seed = (cmph_uint32)time(NULL);
-	if(nkeys == UINT_MAX) source = cmph_io_nlfile_adapter(keys_fd);
+	if (argc - optind > 1)
+	{
+		source = cmph_io_mmap_nlfiles_adapter((const char **)argv + optind, (cmph_uint32)(argc - optind));
+		if (source == NULL)
+		{
+			fprintf(stderr, "Unable to map the key files\n");
+			return -1;
+		}
+		source_type = MMAP_NL_FILE;
+	}
+	else if (keys_fd == stdin && nkeys == ULLONG_MAX) source = cmph_io_nlstream_adapter(keys_fd);
+	else if (keys_fd == stdin) source = cmph_io_nlnkfile_adapter(keys_fd, nkeys);
+	else if ((source = cmph_io_binfile_adapter(keys_file)) != NULL) source_type = BINARY_FILE;
+	else if(nkeys == ULLONG_MAX && (source = cmph_io_mmap_nlfile_adapter(keys_file)) != NULL) source_type = MMAP_NL_FILE;
+	else if(nkeys == ULLONG_MAX) source = cmph_io_nlfile_adapter(keys_fd);
 	else source = cmph_io_nlnkfile_adapter(keys_fd, nkeys);
-	if (generate)
+	if (binary_file)
+	{
+		FILE *binary_fd = fopen(binary_file, "wb");
+		if (binary_fd == NULL || !cmph_io_binfile_write(source, binary_fd))
+		{
+			fprintf(stderr, "Unable to write binary key file %s: %s\n", binary_file, strerror(errno));
+			ret = 1;
+		}
+		if (binary_fd) fclose(binary_fd);
+		free(binary_file);
+	}
+	else if (generate)
 	{
 		//Create mphf
 		mphf_fd = fopen(mphf_file, "wb");
@@ -257,12 +558,25 @@ int main(int argc, char **argv)
 		cmph_config_set_mphf_fd(config, mphf_fd);
 		cmph_config_set_memory_availability(config, memory_availability);
 		cmph_config_set_b(config, b);
+		if (bucket_algo != CMPH_COUNT) cmph_config_set_bucket_algo(config, bucket_algo);
 		cmph_config_set_keys_per_bin(config, keys_per_bin);
+		cmph_config_set_threads(config, nthreads);
+		cmph_config_set_duplicates(config, duplicates);
 
 		//if((mph_algo == CMPH_BMZ || mph_algo == CMPH_BRZ) && c >= 2.0) c=1.15;
 		if(mph_algo == CMPH_BMZ  && c >= 2.0) c=1.15;
 		if (c != 0) cmph_config_set_graphsize(config, c);
 		mphf = cmph_new(config);
+		{
+			cmph_build_stats_t stats;
+			cmph_config_get_build_stats(config, &stats);
+			if (verbosity) print_build_stats(&stats);
+			else if (stats.duplicates)
+			{
+				fprintf(stderr, "%llu duplicated keys in the input, the first one is key number %llu\n",
+				        (unsigned long long)stats.duplicates, (unsigned long long)stats.first_duplicate + 1);
+			}
+		}
 
 		cmph_config_destroy(config);
 		if (mphf == NULL)
@@ -286,6 +600,7 @@ int main(int argc, char **argv)
 	else
 	{
 		cmph_uint8 * hashtable = NULL;
+		double start;
 		mphf_fd = fopen(mphf_file, "rb");
 		if (mphf_fd == NULL)
 		{
@@ -301,42 +616,65 @@ int main(int argc, char **argv)
 			free(mphf_file);
 			return -1;
 		}
-		cmph_uint32 siz = cmph_size(mphf);
-		hashtable = (cmph_uint8*)calloc(siz, sizeof(cmph_uint8));
-		memset(hashtable, 0,(size_t) siz);
+		cmph_uint64 siz = cmph_size64(mphf);
+		cmph_uint64 e = 0;
+		start = now();
+		if (nthreads > 1 && !verbosity)
+		{
+			verify_result_t result;
+			e = verify_parallel(mphf, source, keys_per_bin, nthreads, &result);
+			if (result.nfailed)
+			{
+				fprintf(stderr, "%llu duplicated or unknown keys in the input, the first one found is key number %llu: %.*s\n",
+				        (unsigned long long)result.nfailed, (unsigned long long)result.first + 1, (int)result.keylen, result.key);
+				free(result.key);
+				ret = 1;
+			}
+		}
+		else hashtable = (cmph_uint8*)calloc((size_t)siz, sizeof(cmph_uint8));
 		//check all keys
-		for (i = 0; i < source->nkeys; ++i)
+		for (; hashtable && e < source->nkeys; ++e)
 		{
-			cmph_uint32 h;
-			char *buf;
+			cmph_uint64 h;
+			char *buf = NULL;
 			cmph_uint32 buflen = 0;
-			source->read(source->data, &buf, &buflen);
-			h = cmph_search(mphf, buf, buflen);
+			if (source->read(source->data, &buf, &buflen) < 0)
+			{
+				// the keys of a stream end with a failed read
+				if (buf) source->dispose(source->data, buf, buflen);
+				break;
+			}
+			h = cmph_search64(mphf, buf, buflen);
 			if (!(h < siz))
 			{
-				fprintf(stderr, "Unknown key %*s in the input.\n", buflen, buf);
+				fprintf(stderr, "Unknown key %.*s in the input.\n", (int)buflen, buf);
 				ret = 1;
 			} else if(hashtable[h] >= keys_per_bin)
 			{
-				fprintf(stderr, "More than %u keys were mapped to bin %u\n", keys_per_bin, h);
-				fprintf(stderr, "Duplicated or unknown key %*s in the input\n", buflen, buf);
+				fprintf(stderr, "More than %u keys were mapped to bin %llu\n", keys_per_bin, (unsigned long long)h);
+				fprintf(stderr, "Duplicated or unknown key %.*s in the input\n", (int)buflen, buf);
 				ret = 1;
 			} else hashtable[h]++;
 
 			if (verbosity)
 			{
-				printf("%s -> %u\n", buf, h);
+				printf("%.*s -> %llu\n", (int)buflen, buf, (unsigned long long)h);
 			}
 			source->dispose(source->data, buf, buflen);
 		}
 
+		start = now() - start;
+		fprintf(stderr, "Verified %llu keys in %.3f s: %.0f keys/s, %.1f ns/key\n", (unsigned long long)e, start,
+		        start > 0 ? e/start : 0.0, e ? start*1e9/e : 0.0);
 		cmph_destroy(mphf);
 		free(hashtable);
 	}
 	fclose(keys_fd);
 	free(mphf_file);
 	free(tmp_dir);
-        cmph_io_nlfile_adapter_destroy(source);
+	if (source_type == BINARY_FILE) cmph_io_binfile_adapter_destroy(source);
+	else if (source_type == MMAP_NL_FILE) cmph_io_mmap_nlfile_adapter_destroy(source);
+	else cmph_io_nlfile_adapter_destroy(source);
 	return ret;
 
 }
@@ -0,0 +1,208 @@
+#include "murmur_hash.h"
+#include <stdlib.h>
+#include <limits.h>
+#include <string.h>
+
+//#define DEBUG
+#include "debug.h"
+
+/*
+   --------------------------------------------------------------------
+   MurmurHash3_x64_128 by Austin Appleby, placed in the public domain.
+   The same function is vendored in cxxmph/MurmurHash3.cpp. It consumes
+   16 bytes per round and yields a 128-bit digest, from which the three
+   32-bit values of hash_vector are taken.
+   --------------------------------------------------------------------
+ */
+#define ROTL64(x,r) (((x) << (r)) | ((x) >> (64 - (r))))
+
+static inline cmph_uint64 fmix64(cmph_uint64 k)
+{
+	k ^= k >> 33;
+	k *= 0xff51afd7ed558ccdULL;
+	k ^= k >> 33;
+	k *= 0xc4ceb9fe1a85ec53ULL;
+	k ^= k >> 33;
+	return k;
+}
+
+static inline void __murmur_hash128(cmph_uint32 seed, const unsigned char *k, cmph_uint32 keylen, cmph_uint64 * digest)
+{
+	const cmph_uint64 c1 = 0x87c37b91114253d5ULL;
+	const cmph_uint64 c2 = 0x4cf5ad432745937fULL;
+	register cmph_uint64 h1 = seed;
+	register cmph_uint64 h2 = seed;
+	cmph_uint64 k1, k2;
+	register cmph_uint32 len = keylen;
+
+	/*---------------------------------------- handle most of the key */
+	while (len >= 16)
+	{
+		memcpy(&k1, k, sizeof(cmph_uint64));
+		memcpy(&k2, k + 8, sizeof(cmph_uint64));
+
+		k1 *= c1; k1 = ROTL64(k1, 31); k1 *= c2; h1 ^= k1;
+		h1 = ROTL64(h1, 27); h1 += h2; h1 = h1*5 + 0x52dce729;
+		k2 *= c2; k2 = ROTL64(k2, 33); k2 *= c1; h2 ^= k2;
+		h2 = ROTL64(h2, 31); h2 += h1; h2 = h2*5 + 0x38495ab5;
+		k += 16; len -= 16;
+	}
+
+	/*------------------------------------- handle the last 15 bytes */
+	k1 = k2 = 0;
+	switch(len)              /* all the case statements fall through */
+	{
+		case 15: k2 ^= (cmph_uint64)k[14] << 48; /* fall through */
+		case 14: k2 ^= (cmph_uint64)k[13] << 40; /* fall through */
+		case 13: k2 ^= (cmph_uint64)k[12] << 32; /* fall through */
+		case 12: k2 ^= (cmph_uint64)k[11] << 24; /* fall through */
+		case 11: k2 ^= (cmph_uint64)k[10] << 16; /* fall through */
+		case 10: k2 ^= (cmph_uint64)k[9] << 8; /* fall through */
+		case  9: k2 ^= (cmph_uint64)k[8];
+			k2 *= c2; k2 = ROTL64(k2, 33); k2 *= c1; h2 ^= k2; /* fall through */
+		case  8: k1 ^= (cmph_uint64)k[7] << 56; /* fall through */
+		case  7: k1 ^= (cmph_uint64)k[6] << 48; /* fall through */
+		case  6: k1 ^= (cmph_uint64)k[5] << 40; /* fall through */
+		case  5: k1 ^= (cmph_uint64)k[4] << 32; /* fall through */
+		case  4: k1 ^= (cmph_uint64)k[3] << 24; /* fall through */
+		case  3: k1 ^= (cmph_uint64)k[2] << 16; /* fall through */
+		case  2: k1 ^= (cmph_uint64)k[1] << 8; /* fall through */
+		case  1: k1 ^= (cmph_uint64)k[0];
+			k1 *= c1; k1 = ROTL64(k1, 31); k1 *= c2; h1 ^= k1;
+			/* case 0: nothing left to add */
+	}
+
+	h1 ^= keylen; h2 ^= keylen;
+	h1 += h2; h2 += h1;
+	h1 = fmix64(h1);
+	h2 = fmix64(h2);
+	h1 += h2; h2 += h1;
+
+	digest[0] = h1;
+	digest[1] = h2;
+}
+
+static inline void __murmur_hash_vector(cmph_uint32 seed, const unsigned char *k, cmph_uint32 keylen, cmph_uint32 * hashes)
+{
+	cmph_uint64 digest[2];
+	__murmur_hash128(seed, k, keylen, digest);
+	hashes[0] = (cmph_uint32)digest[0];
+	hashes[1] = (cmph_uint32)(digest[0] >> 32);
+	hashes[2] = (cmph_uint32)digest[1];
+}
+
+/** \fn void murmur_hash128(cmph_uint32 seed, const char *k, cmph_uint32 keylen, cmph_uint64 * digest);
+ *  \param seed is the seed of the function
+ *  \param key is a pointer to a key
+ *  \param keylen is the key length
+ *  \param digest is a pointer to a memory large enough to fit two 64-bit integers.
+ */
+void murmur_hash128(cmph_uint32 seed, const char *k, cmph_uint32 keylen, cmph_uint64 * digest)
+{
+	__murmur_hash128(seed, (const unsigned char*)k, keylen, digest);
+}
+
+murmur_state_t *murmur_state_new(cmph_uint32 size) //size of hash table
+{
+	murmur_state_t *state = (murmur_state_t *)malloc(sizeof(murmur_state_t));
+	if (!state) return NULL;
+	DEBUGP("Initializing murmur hash\n");
+	if (size > 0) state->seed = ((cmph_uint32)rand() % size);
+	else state->seed = 0;
+	return state;
+}
+
+void murmur_state_destroy(murmur_state_t *state)
+{
+	free(state);
+}
+
+cmph_uint32 murmur_hash(murmur_state_t *state, const char *k, cmph_uint32 keylen)
+{
+	cmph_uint32 hashes[3];
+	__murmur_hash_vector(state->seed, (const unsigned char*)k, keylen, hashes);
+	return hashes[2];
+}
+
+void murmur_hash_vector_(murmur_state_t *state, const char *k, cmph_uint32 keylen, cmph_uint32 * hashes)
+{
+	__murmur_hash_vector(state->seed, (const unsigned char*)k, keylen, hashes);
+}
+
+void murmur_state_dump(murmur_state_t *state, char **buf, cmph_uint32 *buflen)
+{
+	*buflen = sizeof(cmph_uint32);
+	*buf = (char *)malloc(sizeof(cmph_uint32));
+	if (!*buf)
+	{
+		*buflen = UINT_MAX;
+		return;
+	}
+	memcpy(*buf, &(state->seed), sizeof(cmph_uint32));
+	DEBUGP("Dumped murmur state with seed %u\n", state->seed);
+	return;
+}
+
+murmur_state_t *murmur_state_copy(murmur_state_t *src_state)
+{
+	murmur_state_t *dest_state = (murmur_state_t *)malloc(sizeof(murmur_state_t));
+	dest_state->hashfunc = src_state->hashfunc;
+	dest_state->seed = src_state->seed;
+	return dest_state;
+}
+
+murmur_state_t *murmur_state_load(const char *buf, cmph_uint32 buflen)
+{
+	murmur_state_t *state = (murmur_state_t *)malloc(sizeof(murmur_state_t));
+	(void)buflen;
+	state->seed = *(cmph_uint32 *)buf;
+	state->hashfunc = CMPH_HASH_MURMUR;
+	DEBUGP("Loaded murmur state with seed %u\n", state->seed);
+	return state;
+}
+
+/** \fn void murmur_state_pack(murmur_state_t *state, void *murmur_packed);
+ *  \brief Support the ability to pack a murmur function into a preallocated contiguous memory space pointed by murmur_packed.
+ *  \param state points to the murmur function
+ *  \param murmur_packed pointer to the contiguous memory area used to store the murmur function. The size of murmur_packed must be at least murmur_state_packed_size()
+ */
+void murmur_state_pack(murmur_state_t *state, void *murmur_packed)
+{
+	if (state && murmur_packed)
+	{
+		memcpy(murmur_packed, &(state->seed), sizeof(cmph_uint32));
+	}
+}
+
+/** \fn cmph_uint32 murmur_state_packed_size(void);
+ *  \brief Return the amount of space needed to pack a murmur function.
+ *  \return the size of the packed function or zero for failures
+ */
+cmph_uint32 murmur_state_packed_size(void)
+{
+	return sizeof(cmph_uint32);
+}
+
+/** \fn cmph_uint32 murmur_hash_packed(void *murmur_packed, const char *k, cmph_uint32 keylen);
+ *  \param murmur_packed is a pointer to a contiguous memory area
+ *  \param key is a pointer to a key
+ *  \param keylen is the key length
+ *  \return an integer that represents a hash value of 32 bits.
+ */
+cmph_uint32 murmur_hash_packed(void *murmur_packed, const char *k, cmph_uint32 keylen)
+{
+	cmph_uint32 hashes[3];
+	__murmur_hash_vector(*((cmph_uint32 *)murmur_packed), (const unsigned char*)k, keylen, hashes);
+	return hashes[2];
+}
+
+/** \fn murmur_hash_vector_packed(void *murmur_packed, const char *k, cmph_uint32 keylen, cmph_uint32 * hashes);
+ *  \param murmur_packed is a pointer to a contiguous memory area
+ *  \param key is a pointer to a key
+ *  \param keylen is the key length
+ *  \param hashes is a pointer to a memory large enough to fit three 32-bit integers.
+ */
+void murmur_hash_vector_packed(void *murmur_packed, const char *k, cmph_uint32 keylen, cmph_uint32 * hashes)
+{
+	__murmur_hash_vector(*((cmph_uint32 *)murmur_packed), (const unsigned char*)k, keylen, hashes);
+}
@@ -0,0 +1,73 @@
+#ifndef __MURMUR_HASH_H__
+#define __MURMUR_HASH_H__
+
+#include "hash.h"
+
+typedef struct __murmur_state_t
+{
+	CMPH_HASH hashfunc;
+	cmph_uint32 seed;
+} murmur_state_t;
+
+murmur_state_t *murmur_state_new(cmph_uint32 size); //size of hash table
+
+/** \fn cmph_uint32 murmur_hash(murmur_state_t *state, const char *k, cmph_uint32 keylen);
+ *  \param state is a pointer to a murmur_state_t structure
+ *  \param key is a pointer to a key
+ *  \param keylen is the key length
+ *  \return an integer that represents a hash value of 32 bits.
+ */
+cmph_uint32 murmur_hash(murmur_state_t *state, const char *k, cmph_uint32 keylen);
+
+/** \fn void murmur_hash_vector_(murmur_state_t *state, const char *k, cmph_uint32 keylen, cmph_uint32 * hashes);
+ *  \param state is a pointer to a murmur_state_t structure
+ *  \param key is a pointer to a key
+ *  \param keylen is the key length
+ *  \param hashes is a pointer to a memory large enough to fit three 32-bit integers.
+ */
+void murmur_hash_vector_(murmur_state_t *state, const char *k, cmph_uint32 keylen, cmph_uint32 * hashes);
+
+/** \fn void murmur_hash128(cmph_uint32 seed, const char *k, cmph_uint32 keylen, cmph_uint64 * digest);
+ *  \brief Computes the whole 128-bit digest of a key, from which murmur_hash_vector_ takes its values.
+ *  \param seed is the seed of the function
+ *  \param key is a pointer to a key
+ *  \param keylen is the key length
+ *  \param digest is a pointer to a memory large enough to fit two 64-bit integers.
+ */
+void murmur_hash128(cmph_uint32 seed, const char *k, cmph_uint32 keylen, cmph_uint64 * digest);
+
+void murmur_state_dump(murmur_state_t *state, char **buf, cmph_uint32 *buflen);
+murmur_state_t *murmur_state_copy(murmur_state_t *src_state);
+murmur_state_t *murmur_state_load(const char *buf, cmph_uint32 buflen);
+void murmur_state_destroy(murmur_state_t *state);
+
+/** \fn void murmur_state_pack(murmur_state_t *state, void *murmur_packed);
+ *  \brief Support the ability to pack a murmur function into a preallocated contiguous memory space pointed by murmur_packed.
+ *  \param state points to the murmur function
+ *  \param murmur_packed pointer to the contiguous memory area used to store the murmur function. The size of murmur_packed must be at least murmur_state_packed_size() 
+ */
+void murmur_state_pack(murmur_state_t *state, void *murmur_packed);
+
+/** \fn cmph_uint32 murmur_state_packed_size();
+ *  \brief Return the amount of space needed to pack a murmur function.
+ *  \return the size of the packed function or zero for failures
+ */ 
+cmph_uint32 murmur_state_packed_size(void);
+
+/** \fn cmph_uint32 murmur_hash_packed(void *murmur_packed, const char *k, cmph_uint32 keylen);
+ *  \param murmur_packed is a pointer to a contiguous memory area
+ *  \param key is a pointer to a key
+ *  \param keylen is the key length
+ *  \return an integer that represents a hash value of 32 bits.
+ */
+cmph_uint32 murmur_hash_packed(void *murmur_packed, const char *k, cmph_uint32 keylen);
+
+/** \fn murmur_hash_vector_packed(void *murmur_packed, const char *k, cmph_uint32 keylen, cmph_uint32 * hashes);
+ *  \param murmur_packed is a pointer to a contiguous memory area
+ *  \param key is a pointer to a key
+ *  \param keylen is the key length
+ *  \param hashes is a pointer to a memory large enough to fit three 32-bit integers.
+ */
+void murmur_hash_vector_packed(void *murmur_packed, const char *k, cmph_uint32 keylen, cmph_uint32 * hashes);
+
+#endif
@@ -0,0 +1,18 @@
+#ifndef __CMPH_PREFETCH_H__
+#define __CMPH_PREFETCH_H__
+
+// Number of keys hashed ahead by the batched search routines before their
+// table slots are touched. It must be large enough to cover memory latency
+// and small enough to keep the per-group state in registers/L1.
+#ifndef CMPH_SEARCH_BATCH_SIZE
+#define CMPH_SEARCH_BATCH_SIZE 16
+#endif
+
+// Read-only prefetch hint, a no-op on compilers without __builtin_prefetch.
+#if defined(__GNUC__) || defined(__clang__)
+#define PREFETCH(addr) __builtin_prefetch((const void *)(addr), 0, 3)
+#else
+#define PREFETCH(addr) ((void)(addr))
+#endif
+
+#endif
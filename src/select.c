@@ -5,6 +5,7 @@
 #include <limits.h>
 #include "select_lookup_tables.h"
 #include "select.h"
+#include "prefetch.h"
 
 //#define DEBUG
 #include "debug.h"
@@ -219,6 +220,11 @@ cmph_uint32 select_next_query(select_t * sel, cmph_uint32 vec_bit_idx)
 	return _select_next_query((cmph_uint8 *)sel->bits_vec, vec_bit_idx);
 };
 
+void select_prefetch(select_t * sel, cmph_uint32 one_idx)
+{
+	PREFETCH(sel->select_table + (one_idx >> NBITS_STEP_SELECT_TABLE));
+};
+
 void select_dump(select_t *sel, char **buf, cmph_uint32 *buflen)
 {
         register cmph_uint32 nbits = sel->n + sel->m;
@@ -335,3 +341,12 @@ cmph_uint32 select_next_query_packed(void * sel_packed, cmph_uint32 vec_bit_idx)
 	bits_vec += 8; // skipping n and m
 	return _select_next_query(bits_vec, vec_bit_idx);
 }
+
+void select_prefetch_packed(void * sel_packed, cmph_uint32 one_idx)
+{
+	register cmph_uint32 *ptr = (cmph_uint32 *)sel_packed;
+	register cmph_uint32 n = *ptr++;
+	register cmph_uint32 m = *ptr++;
+	register cmph_uint32 vec_size = (n + m + 31) >> 5;
+	PREFETCH(ptr + vec_size + (one_idx >> NBITS_STEP_SELECT_TABLE));
+}
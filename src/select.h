@@ -22,6 +22,13 @@ cmph_uint32 select_query(select_t * sel, cmph_uint32 one_idx);
 
 cmph_uint32 select_next_query(select_t * sel, cmph_uint32 vec_bit_idx);
 
+/** \fn void select_prefetch(select_t * sel, cmph_uint32 one_idx);
+ *  \brief Hint the cache with the select table slot a later @see select_query for one_idx will read.
+ *  \param sel points to the select structure
+ *  \param one_idx is the rank that will be queried
+ */
+void select_prefetch(select_t * sel, cmph_uint32 one_idx);
+
 cmph_uint32 select_get_space_usage(select_t * sel);
 
 void select_dump(select_t *sel, char **buf, cmph_uint32 *buflen);
@@ -58,4 +65,11 @@ cmph_uint32 select_query_packed(void * sel_packed, cmph_uint32 one_idx);
  */
 cmph_uint32 select_next_query_packed(void * sel_packed, cmph_uint32 vec_bit_idx);
 
+/** \fn void select_prefetch_packed(void * sel_packed, cmph_uint32 one_idx);
+ *  \brief Packed counterpart of @see select_prefetch.
+ *  \param sel_packed is a pointer to a contiguous memory area
+ *  \param one_idx is the rank that will be queried
+ */
+void select_prefetch_packed(void * sel_packed, cmph_uint32 one_idx);
+
 #endif
@@ -0,0 +1,80 @@
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+#include "thread_pool.h"
+
+#include <stdlib.h>
+#ifdef HAVE_PTHREAD_H
+#include <pthread.h>
+#endif
+
+//#define DEBUG
+#include "debug.h"
+
+#ifdef HAVE_PTHREAD_H
+typedef struct
+{
+	pthread_mutex_t lock;
+	cmph_uint32 next_task;
+	cmph_uint32 ntasks;
+	thread_pool_task_t task;
+	void *arg;
+} thread_pool_t;
+
+static void *thread_pool_worker(void *data)
+{
+	thread_pool_t *pool = (thread_pool_t *)data;
+	while(1)
+	{
+		cmph_uint32 task;
+		pthread_mutex_lock(&pool->lock);
+		task = pool->next_task;
+		if (task < pool->ntasks) pool->next_task++;
+		pthread_mutex_unlock(&pool->lock);
+		if (task >= pool->ntasks) break;
+		pool->task(pool->arg, task);
+	}
+	return NULL;
+}
+#endif
+
+void thread_pool_run(cmph_uint32 nthreads, cmph_uint32 ntasks, thread_pool_task_t task, void *arg)
+{
+	cmph_uint32 i;
+#ifdef HAVE_PTHREAD_H
+	if (nthreads > ntasks) nthreads = ntasks;
+	if (nthreads > 1)
+	{
+		thread_pool_t pool;
+		cmph_uint32 nstarted = 0;
+		pthread_t *threads = (pthread_t *)malloc(sizeof(pthread_t)*(nthreads - 1));
+		pthread_mutex_init(&pool.lock, NULL);
+		pool.next_task = 0;
+		pool.ntasks = ntasks;
+		pool.task = task;
+		pool.arg = arg;
+		for (i = 0; threads && i < nthreads - 1; ++i)
+		{
+			if (pthread_create(&threads[i], NULL, thread_pool_worker, &pool) != 0) break;
+			++nstarted;
+		}
+		DEBUGP("Running %u tasks on %u threads\n", ntasks, nstarted + 1);
+		// a thread that could not be started only makes the others busier
+		thread_pool_worker(&pool);
+		for (i = 0; i < nstarted; ++i) pthread_join(threads[i], NULL);
+		pthread_mutex_destroy(&pool.lock);
+		free(threads);
+		return;
+	}
+#endif
+	for (i = 0; i < ntasks; ++i) task(arg, i);
+}
+
+cmph_uint32 thread_pool_available(void)
+{
+#ifdef HAVE_PTHREAD_H
+	return 1;
+#else
+	return 0;
+#endif
+}
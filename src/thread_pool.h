@@ -0,0 +1,29 @@
+#ifndef __CMPH_THREAD_POOL_H__
+#define __CMPH_THREAD_POOL_H__
+
+#include "cmph_types.h"
+
+/** \fn typedef void (*thread_pool_task_t)(void *arg, cmph_uint32 task);
+ *  \brief Body of a parallel loop. It is called once for every task index,
+ *  from any of the worker threads, so distinct tasks must not share writes.
+ */
+typedef void (*thread_pool_task_t)(void *arg, cmph_uint32 task);
+
+/** \fn void thread_pool_run(cmph_uint32 nthreads, cmph_uint32 ntasks, thread_pool_task_t task, void *arg);
+ *  \brief Runs task(arg, i) for every i in [0, ntasks) on up to nthreads threads
+ *  and returns when all of them are done. The calling thread takes part in the
+ *  work. Runs serially when nthreads <= 1 or when threads are not available.
+ *  \param nthreads maximum number of threads
+ *  \param ntasks number of tasks
+ *  \param task function called for each task
+ *  \param arg opaque pointer passed to task
+ */
+void thread_pool_run(cmph_uint32 nthreads, cmph_uint32 ntasks, thread_pool_task_t task, void *arg);
+
+/** \fn cmph_uint32 thread_pool_available(void);
+ *  \brief Tells whether the library was built with thread support.
+ *  \return 1 if thread_pool_run can run tasks concurrently, 0 otherwise
+ */
+cmph_uint32 thread_pool_available(void);
+
+#endif
@@ -0,0 +1,221 @@
+#include "wy_hash.h"
+#include <stdlib.h>
+#include <limits.h>
+#include <string.h>
+
+//#define DEBUG
+#include "debug.h"
+
+/*
+   --------------------------------------------------------------------
+   Based on wyhash by Wang Yi, released in the public domain. Keys are
+   consumed 48 bytes at a time by three independent 64x64->128 bit
+   multiplications; the halves of the last product are folded into the
+   64-bit digest that gives the first two 32-bit values of hash_vector,
+   and a further multiplication of the digest gives the third.
+   --------------------------------------------------------------------
+ */
+static const cmph_uint64 wy_secret[4] = { 0x2d358dccaa6c78a5ULL, 0x8bb84b93962eacc9ULL,
+                                          0x4b33a62ed433d4a3ULL, 0x4d5a2da51de1aa47ULL };
+
+static inline void wy_mum(cmph_uint64 *a, cmph_uint64 *b)
+{
+#if defined(__SIZEOF_INT128__)
+	unsigned __int128 r = *a;
+	r *= *b;
+	*a = (cmph_uint64)r;
+	*b = (cmph_uint64)(r >> 64);
+#else
+	cmph_uint64 ha = *a >> 32, hb = *b >> 32, la = (cmph_uint32)*a, lb = (cmph_uint32)*b;
+	cmph_uint64 rh = ha * hb, rm0 = ha * lb, rm1 = hb * la, rl = la * lb;
+	cmph_uint64 t = rl + (rm0 << 32), c = t < rl, lo;
+	lo = t + (rm1 << 32);
+	c += lo < t;
+	*a = lo;
+	*b = rh + (rm0 >> 32) + (rm1 >> 32) + c;
+#endif
+}
+
+static inline cmph_uint64 wy_mix(cmph_uint64 a, cmph_uint64 b)
+{
+	wy_mum(&a, &b);
+	return a ^ b;
+}
+
+static inline cmph_uint64 wy_r8(const unsigned char *p)
+{
+	cmph_uint64 v;
+	memcpy(&v, p, sizeof(cmph_uint64));
+	return v;
+}
+
+static inline cmph_uint64 wy_r4(const unsigned char *p)
+{
+	cmph_uint32 v;
+	memcpy(&v, p, sizeof(cmph_uint32));
+	return v;
+}
+
+static inline void __wy_hash_vector(cmph_uint32 seed32, const unsigned char *k, cmph_uint32 keylen, cmph_uint32 * hashes)
+{
+	register cmph_uint64 seed = seed32;
+	register cmph_uint32 len = keylen;
+	cmph_uint64 a, b;
+
+	seed ^= wy_mix(seed ^ wy_secret[0], wy_secret[1]);
+	if (len <= 16)
+	{
+		if (len >= 4)
+		{
+			a = (wy_r4(k) << 32) | wy_r4(k + ((len >> 3) << 2));
+			b = (wy_r4(k + len - 4) << 32) | wy_r4(k + len - 4 - ((len >> 3) << 2));
+		}
+		else if (len > 0)
+		{
+			a = ((cmph_uint64)k[0] << 16) | ((cmph_uint64)k[len >> 1] << 8) | k[len - 1];
+			b = 0;
+		}
+		else a = b = 0;
+	}
+	else
+	{
+		if (len >= 48)
+		{
+			cmph_uint64 see1 = seed, see2 = seed;
+			do
+			{
+				seed = wy_mix(wy_r8(k) ^ wy_secret[1], wy_r8(k + 8) ^ seed);
+				see1 = wy_mix(wy_r8(k + 16) ^ wy_secret[2], wy_r8(k + 24) ^ see1);
+				see2 = wy_mix(wy_r8(k + 32) ^ wy_secret[3], wy_r8(k + 40) ^ see2);
+				k += 48; len -= 48;
+			} while (len >= 48);
+			seed ^= see1 ^ see2;
+		}
+		while (len > 16)
+		{
+			seed = wy_mix(wy_r8(k) ^ wy_secret[1], wy_r8(k + 8) ^ seed);
+			k += 16; len -= 16;
+		}
+		a = wy_r8(k + len - 16);
+		b = wy_r8(k + len - 8);
+	}
+	a ^= wy_secret[1];
+	b ^= seed;
+	wy_mum(&a, &b);
+	a ^= wy_secret[0] ^ keylen;
+	b ^= wy_secret[1];
+	wy_mum(&a, &b);
+
+	// The low bits of a product are biased, the values are taken from the
+	// folded product a ^ b and from one more round over it.
+	a ^= b;
+	b = wy_mix(a ^ wy_secret[2], seed ^ wy_secret[3]);
+	hashes[0] = (cmph_uint32)a;
+	hashes[1] = (cmph_uint32)(a >> 32);
+	hashes[2] = (cmph_uint32)b;
+}
+
+wy_state_t *wy_state_new(cmph_uint32 size) //size of hash table
+{
+	wy_state_t *state = (wy_state_t *)malloc(sizeof(wy_state_t));
+	if (!state) return NULL;
+	DEBUGP("Initializing wy hash\n");
+	if (size > 0) state->seed = ((cmph_uint32)rand() % size);
+	else state->seed = 0;
+	return state;
+}
+
+void wy_state_destroy(wy_state_t *state)
+{
+	free(state);
+}
+
+cmph_uint32 wy_hash(wy_state_t *state, const char *k, cmph_uint32 keylen)
+{
+	cmph_uint32 hashes[3];
+	__wy_hash_vector(state->seed, (const unsigned char*)k, keylen, hashes);
+	return hashes[2];
+}
+
+void wy_hash_vector_(wy_state_t *state, const char *k, cmph_uint32 keylen, cmph_uint32 * hashes)
+{
+	__wy_hash_vector(state->seed, (const unsigned char*)k, keylen, hashes);
+}
+
+void wy_state_dump(wy_state_t *state, char **buf, cmph_uint32 *buflen)
+{
+	*buflen = sizeof(cmph_uint32);
+	*buf = (char *)malloc(sizeof(cmph_uint32));
+	if (!*buf)
+	{
+		*buflen = UINT_MAX;
+		return;
+	}
+	memcpy(*buf, &(state->seed), sizeof(cmph_uint32));
+	DEBUGP("Dumped wy state with seed %u\n", state->seed);
+	return;
+}
+
+wy_state_t *wy_state_copy(wy_state_t *src_state)
+{
+	wy_state_t *dest_state = (wy_state_t *)malloc(sizeof(wy_state_t));
+	dest_state->hashfunc = src_state->hashfunc;
+	dest_state->seed = src_state->seed;
+	return dest_state;
+}
+
+wy_state_t *wy_state_load(const char *buf, cmph_uint32 buflen)
+{
+	wy_state_t *state = (wy_state_t *)malloc(sizeof(wy_state_t));
+	(void)buflen;
+	state->seed = *(cmph_uint32 *)buf;
+	state->hashfunc = CMPH_HASH_WYHASH;
+	DEBUGP("Loaded wy state with seed %u\n", state->seed);
+	return state;
+}
+
+/** \fn void wy_state_pack(wy_state_t *state, void *wy_packed);
+ *  \brief Support the ability to pack a wy function into a preallocated contiguous memory space pointed by wy_packed.
+ *  \param state points to the wy function
+ *  \param wy_packed pointer to the contiguous memory area used to store the wy function. The size of wy_packed must be at least wy_state_packed_size()
+ */
+void wy_state_pack(wy_state_t *state, void *wy_packed)
+{
+	if (state && wy_packed)
+	{
+		memcpy(wy_packed, &(state->seed), sizeof(cmph_uint32));
+	}
+}
+
+/** \fn cmph_uint32 wy_state_packed_size(void);
+ *  \brief Return the amount of space needed to pack a wy function.
+ *  \return the size of the packed function or zero for failures
+ */
+cmph_uint32 wy_state_packed_size(void)
+{
+	return sizeof(cmph_uint32);
+}
+
+/** \fn cmph_uint32 wy_hash_packed(void *wy_packed, const char *k, cmph_uint32 keylen);
+ *  \param wy_packed is a pointer to a contiguous memory area
+ *  \param key is a pointer to a key
+ *  \param keylen is the key length
+ *  \return an integer that represents a hash value of 32 bits.
+ */
+cmph_uint32 wy_hash_packed(void *wy_packed, const char *k, cmph_uint32 keylen)
+{
+	cmph_uint32 hashes[3];
+	__wy_hash_vector(*((cmph_uint32 *)wy_packed), (const unsigned char*)k, keylen, hashes);
+	return hashes[2];
+}
+
+/** \fn wy_hash_vector_packed(void *wy_packed, const char *k, cmph_uint32 keylen, cmph_uint32 * hashes);
+ *  \param wy_packed is a pointer to a contiguous memory area
+ *  \param key is a pointer to a key
+ *  \param keylen is the key length
+ *  \param hashes is a pointer to a memory large enough to fit three 32-bit integers.
+ */
+void wy_hash_vector_packed(void *wy_packed, const char *k, cmph_uint32 keylen, cmph_uint32 * hashes)
+{
+	__wy_hash_vector(*((cmph_uint32 *)wy_packed), (const unsigned char*)k, keylen, hashes);
+}
@@ -0,0 +1,64 @@
+#ifndef __WY_HASH_H__
+#define __WY_HASH_H__
+
+#include "hash.h"
+
+typedef struct __wy_state_t
+{
+	CMPH_HASH hashfunc;
+	cmph_uint32 seed;
+} wy_state_t;
+
+wy_state_t *wy_state_new(cmph_uint32 size); //size of hash table
+
+/** \fn cmph_uint32 wy_hash(wy_state_t *state, const char *k, cmph_uint32 keylen);
+ *  \param state is a pointer to a wy_state_t structure
+ *  \param key is a pointer to a key
+ *  \param keylen is the key length
+ *  \return an integer that represents a hash value of 32 bits.
+ */
+cmph_uint32 wy_hash(wy_state_t *state, const char *k, cmph_uint32 keylen);
+
+/** \fn void wy_hash_vector_(wy_state_t *state, const char *k, cmph_uint32 keylen, cmph_uint32 * hashes);
+ *  \param state is a pointer to a wy_state_t structure
+ *  \param key is a pointer to a key
+ *  \param keylen is the key length
+ *  \param hashes is a pointer to a memory large enough to fit three 32-bit integers.
+ */
+void wy_hash_vector_(wy_state_t *state, const char *k, cmph_uint32 keylen, cmph_uint32 * hashes);
+
+void wy_state_dump(wy_state_t *state, char **buf, cmph_uint32 *buflen);
+wy_state_t *wy_state_copy(wy_state_t *src_state);
+wy_state_t *wy_state_load(const char *buf, cmph_uint32 buflen);
+void wy_state_destroy(wy_state_t *state);
+
+/** \fn void wy_state_pack(wy_state_t *state, void *wy_packed);
+ *  \brief Support the ability to pack a wy function into a preallocated contiguous memory space pointed by wy_packed.
+ *  \param state points to the wy function
+ *  \param wy_packed pointer to the contiguous memory area used to store the wy function. The size of wy_packed must be at least wy_state_packed_size() 
+ */
+void wy_state_pack(wy_state_t *state, void *wy_packed);
+
+/** \fn cmph_uint32 wy_state_packed_size();
+ *  \brief Return the amount of space needed to pack a wy function.
+ *  \return the size of the packed function or zero for failures
+ */ 
+cmph_uint32 wy_state_packed_size(void);
+
+/** \fn cmph_uint32 wy_hash_packed(void *wy_packed, const char *k, cmph_uint32 keylen);
+ *  \param wy_packed is a pointer to a contiguous memory area
+ *  \param key is a pointer to a key
+ *  \param keylen is the key length
+ *  \return an integer that represents a hash value of 32 bits.
+ */
+cmph_uint32 wy_hash_packed(void *wy_packed, const char *k, cmph_uint32 keylen);
+
+/** \fn wy_hash_vector_packed(void *wy_packed, const char *k, cmph_uint32 keylen, cmph_uint32 * hashes);
+ *  \param wy_packed is a pointer to a contiguous memory area
+ *  \param key is a pointer to a key
+ *  \param keylen is the key length
+ *  \param hashes is a pointer to a memory large enough to fit three 32-bit integers.
+ */
+void wy_hash_vector_packed(void *wy_packed, const char *k, cmph_uint32 keylen, cmph_uint32 * hashes);
+
+#endif
@@ -0,0 +1,160 @@
+#include "../src/cmph.h"
+#include "../src/cmph_structs.h"
+#include "../src/brz.h"
+#include "../src/brz_structs.h"
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+
+#define NKEYS 200000
+#define KEY_RECORD_SIZE (4 + 20)
+
+// With 4KB of memory the keys are partitioned into about 1400 runs, more
+// than can be open at once, so they are merged in passes before the
+// functions of the buckets are generated.
+static int check_many_runs(char **keys, const char *tmp_dir)
+{
+	cmph_io_adapter_t *source = cmph_io_vector_adapter(keys, NKEYS);
+	cmph_config_t *config;
+	cmph_build_stats_t stats;
+	cmph_t *mphf;
+	FILE *mphf_fd = tmpfile();
+	char *seen;
+	cmph_uint32 i;
+	int ret = 0;
+
+	config = cmph_config_new(source);
+	cmph_config_set_algo(config, CMPH_BRZ);
+	cmph_config_set_tmp_dir(config, (cmph_uint8 *)tmp_dir);
+	cmph_config_set_mphf_fd(config, mphf_fd);
+	((brz_config_data_t *)config->data)->memory_availability = 4096;
+	mphf = cmph_new(config);
+	cmph_config_get_build_stats(config, &stats);
+	cmph_config_destroy(config);
+	cmph_io_vector_adapter_destroy(source);
+	if (mphf == NULL)
+	{
+		fprintf(stderr, "Unable to create BRZ function from many runs\n");
+		fclose(mphf_fd);
+		return 1;
+	}
+	// every key is written once by the partitioning and once more by the merge passes
+	if (stats.tmp_bytes_written < 2ULL*KEY_RECORD_SIZE*NKEYS || stats.tmp_bytes_read != stats.tmp_bytes_written)
+	{
+		fprintf(stderr, "Wrote %llu bytes of runs and read back %llu\n",
+		        (unsigned long long)stats.tmp_bytes_written, (unsigned long long)stats.tmp_bytes_read);
+		ret = 1;
+	}
+	cmph_dump(mphf, mphf_fd);
+	cmph_destroy(mphf);
+	rewind(mphf_fd);
+	mphf = cmph_load(mphf_fd);
+	fclose(mphf_fd);
+	seen = (char *)calloc(NKEYS, 1);
+	for (i = 0; ret == 0 && i < NKEYS; i++)
+	{
+		cmph_uint32 h = cmph_search(mphf, keys[i], (cmph_uint32)strlen(keys[i]));
+		if (h >= NKEYS || seen[h]++)
+		{
+			fprintf(stderr, "Key %s collides or is out of range\n", keys[i]);
+			ret = 1;
+		}
+	}
+	free(seen);
+	cmph_destroy(mphf);
+	return ret;
+}
+
+// Builds a BRZ function of the keys with nthreads threads after srand(seed)
+// and returns the file it was written to, rewound, or NULL on failure.
+static FILE *build_with_threads(char **keys, const char *tmp_dir, CMPH_ALGO algo, cmph_uint32 nthreads, unsigned int seed)
+{
+	cmph_io_adapter_t *source = cmph_io_vector_adapter(keys, NKEYS);
+	cmph_config_t *config;
+	cmph_t *mphf;
+	FILE *mphf_fd = tmpfile();
+
+	srand(seed);
+	config = cmph_config_new(source);
+	cmph_config_set_algo(config, CMPH_BRZ);
+	cmph_config_set_bucket_algo(config, algo);
+	cmph_config_set_tmp_dir(config, (cmph_uint8 *)tmp_dir);
+	cmph_config_set_mphf_fd(config, mphf_fd);
+	cmph_config_set_threads(config, nthreads);
+	mphf = cmph_new(config);
+	cmph_config_destroy(config);
+	cmph_io_vector_adapter_destroy(source);
+	if (mphf == NULL)
+	{
+		fclose(mphf_fd);
+		return NULL;
+	}
+	cmph_dump(mphf, mphf_fd);
+	cmph_destroy(mphf);
+	rewind(mphf_fd);
+	return mphf_fd;
+}
+
+// The buckets built by the worker threads get seeds derived from the seed of
+// the construction, so two builds with the same seed write the same file.
+static int check_parallel_determinism(char **keys, const char *tmp_dir, CMPH_ALGO algo)
+{
+	FILE *a = build_with_threads(keys, tmp_dir, algo, 4, 42);
+	FILE *b = build_with_threads(keys, tmp_dir, algo, 4, 42);
+	int ca, cb, ret = 0;
+	if (a == NULL || b == NULL)
+	{
+		fprintf(stderr, "Unable to create BRZ function with %s buckets on 4 threads\n", cmph_names[algo]);
+		ret = 1;
+	}
+	else do
+	{
+		ca = getc(a);
+		cb = getc(b);
+		if (ca != cb)
+		{
+			fprintf(stderr, "BRZ functions with %s buckets built on 4 threads differ\n", cmph_names[algo]);
+			ret = 1;
+			break;
+		}
+	} while (ca != EOF);
+	if (a) fclose(a);
+	if (b) fclose(b);
+	return ret;
+}
+
+int main(void)
+{
+	char **keys = (char **)malloc(sizeof(char *)*NKEYS);
+	char tmp_dir[] = P_tmpdir "/brz_tests.XXXXXX";
+	cmph_uint32 i;
+	int ret = 0;
+
+	// the runs are named by their number, so they get a directory of their own
+	if (mkdtemp(tmp_dir) == NULL)
+	{
+		perror("mkdtemp");
+		return 1;
+	}
+	for (i = 0; i < NKEYS; i++)
+	{
+		keys[i] = (char *)malloc(KEY_RECORD_SIZE);
+		sprintf(keys[i], "brz-run-key-%08u", i);
+	}
+	ret |= check_many_runs(keys, tmp_dir);
+	ret |= check_parallel_determinism(keys, tmp_dir, CMPH_BMZ8);
+	ret |= check_parallel_determinism(keys, tmp_dir, CMPH_FCH);
+	ret |= check_parallel_determinism(keys, tmp_dir, CMPH_BDZ);
+	for (i = 0; i < NKEYS; i++) free(keys[i]);
+	free(keys);
+	for (i = 0; i < 4096; i++)
+	{
+		char filename[sizeof(tmp_dir) + 16];
+		sprintf(filename, "%s/%u.cmph", tmp_dir, i);
+		unlink(filename);
+	}
+	rmdir(tmp_dir);
+	return ret;
+}
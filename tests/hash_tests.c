@@ -0,0 +1,276 @@
+#include "../src/hash.h"
+#include "../src/cmph.h"
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+
+static const char *keys[] = { "", "a", "abc", "0123456789a", "0123456789abcdef", "0123456789abcdef0",
+                              "http://www.example.com/a/fairly/long/path/to/some/document.html?query=1", NULL };
+
+// Every hash function must give the same values after a dump/load and once packed,
+// and hash() must be the third value of hash_vector().
+static int check_hash(CMPH_HASH hashfunc)
+{
+	hash_state_t *state = hash_state_new(hashfunc, 1000);
+	hash_state_t *loaded, *copy;
+	char *buf = NULL;
+	cmph_uint32 buflen;
+	void *packed = malloc(hash_state_packed_size(hashfunc));
+	int i, ret = 0;
+
+	hash_state_dump(state, &buf, &buflen);
+	loaded = hash_state_load(buf, buflen);
+	free(buf);
+	copy = hash_state_copy(state);
+	hash_state_pack(state, packed);
+	if (loaded == NULL || hash_get_type(loaded) != hashfunc || hash_get_type(copy) != hashfunc)
+	{
+		fprintf(stderr, "Unable to reload %s state\n", cmph_hash_names[hashfunc]);
+		return 1;
+	}
+	for (i = 0; keys[i]; ++i)
+	{
+		cmph_uint32 keylen = (cmph_uint32)strlen(keys[i]);
+		cmph_uint32 h[3], hl[3], hp[3];
+		hash_vector(state, keys[i], keylen, h);
+		hash_vector(loaded, keys[i], keylen, hl);
+		hash_vector_packed(packed, hashfunc, keys[i], keylen, hp);
+		if (memcmp(h, hl, sizeof(h)) != 0 || memcmp(h, hp, sizeof(h)) != 0 ||
+		    hash(state, keys[i], keylen) != h[2] || hash(copy, keys[i], keylen) != h[2] ||
+		    hash_packed(packed, hashfunc, keys[i], keylen) != h[2])
+		{
+			fprintf(stderr, "%s: inconsistent values for key \"%s\"\n", cmph_hash_names[hashfunc], keys[i]);
+			ret = 1;
+		}
+	}
+	for (i = 0; i < 16; ++i)
+	{
+		// the integer entry points agree with the hash of the key bytes
+		cmph_uint64 k64 = (cmph_uint64)i * 0x9e3779b97f4a7c15ULL;
+		cmph_uint32 k32 = (cmph_uint32)k64;
+		cmph_uint32 h[3], hi[3], hp[3];
+		hash_vector(state, (const char *)&k64, sizeof(k64), h);
+		hash_vector_integer(state, k64, sizeof(k64), hi);
+		hash_vector_packed_integer(packed, hashfunc, k64, sizeof(k64), hp);
+		if (memcmp(h, hi, sizeof(h)) != 0 || memcmp(h, hp, sizeof(h)) != 0) ret = 1;
+		hash_vector(state, (const char *)&k32, sizeof(k32), h);
+		hash_vector_integer(state, k32, sizeof(k32), hi);
+		hash_vector_packed_integer(packed, hashfunc, k32, sizeof(k32), hp);
+		if (memcmp(h, hi, sizeof(h)) != 0 || memcmp(h, hp, sizeof(h)) != 0) ret = 1;
+		if (ret) fprintf(stderr, "%s: inconsistent integer values for key %u\n", cmph_hash_names[hashfunc], i);
+	}
+	free(packed);
+	hash_state_destroy(copy);
+	hash_state_destroy(loaded);
+	hash_state_destroy(state);
+	return ret;
+}
+
+// A pair of identical functions is served by a single state, whose packed
+// form must give the same two values as hash_vector().
+static int check_pair(CMPH_HASH hashfunc)
+{
+	hash_state_t *h1, *h2;
+	void *packed;
+	int i, ret = 0;
+
+	hash_pair_new(hashfunc, hashfunc, 1000, &h1, &h2);
+	if (h2 != NULL || hash_get_type(h2) != CMPH_HASH_COUNT || hash_state_packed_size(hash_get_type(h2)) != 0)
+	{
+		fprintf(stderr, "%s: pair of identical functions has two states\n", cmph_hash_names[hashfunc]);
+		return 1;
+	}
+	packed = malloc(hash_state_packed_size(hashfunc));
+	hash_state_pack(h1, packed);
+	for (i = 0; keys[i]; ++i)
+	{
+		cmph_uint32 keylen = (cmph_uint32)strlen(keys[i]);
+		cmph_uint32 h[3], hp[2], hpp[2];
+		hash_vector(h1, keys[i], keylen, h);
+		hash_pair(h1, h2, keys[i], keylen, hp);
+		hash_pair_packed(packed, hashfunc, NULL, CMPH_HASH_COUNT, keys[i], keylen, hpp);
+		if (memcmp(h, hp, sizeof(hp)) != 0 || memcmp(hp, hpp, sizeof(hp)) != 0)
+		{
+			fprintf(stderr, "%s: inconsistent pair for key \"%s\"\n", cmph_hash_names[hashfunc], keys[i]);
+			ret = 1;
+		}
+	}
+	free(packed);
+	hash_state_destroy(h2);
+	hash_state_destroy(h1);
+	return ret;
+}
+
+// Builders hash the fingerprints of the keys instead of the keys when the
+// function is CMPH_HASH_FINGERPRINT, both must give the same values.
+static int check_fingerprint(void)
+{
+	hash_state_t *state = hash_state_new(CMPH_HASH_FINGERPRINT, 1000);
+	hash_state_t *h1 = NULL, *h2 = NULL;
+	int i, ret = 0;
+
+	hash_pair_new(CMPH_HASH_FINGERPRINT, CMPH_HASH_FINGERPRINT, 1000, &h1, &h2);
+	for (i = 0; keys[i]; ++i)
+	{
+		cmph_uint32 keylen = (cmph_uint32)strlen(keys[i]);
+		cmph_uint64 fp[2];
+		cmph_uint32 h[3], hf[3], hp[2], hpf[2];
+		hash_fingerprint(keys[i], keylen, fp);
+		hash_vector(state, keys[i], keylen, h);
+		hash_vector_fingerprint(state, fp, hf);
+		hash_pair(h1, h2, keys[i], keylen, hp);
+		hash_pair_fingerprint(h1, h2, fp, hpf);
+		if (memcmp(h, hf, sizeof(h)) != 0 || memcmp(hp, hpf, sizeof(hp)) != 0)
+		{
+			fprintf(stderr, "fingerprint: inconsistent values for key \"%s\"\n", keys[i]);
+			ret = 1;
+		}
+	}
+	hash_state_destroy(h2);
+	hash_state_destroy(h1);
+	hash_state_destroy(state);
+	return ret;
+}
+
+// The batched hash must give the values of hash_vector, whatever the mix of
+// key lengths. Keys of 0 to 40 bytes are grouped in runs of various lengths
+// so that both the multi-key kernels and the one key fallback are taken.
+static int check_batch(CMPH_HASH hashfunc)
+{
+	hash_state_t *state = hash_state_new(hashfunc, 1000);
+	void *packed = malloc(hash_state_packed_size(hashfunc));
+	char text[41 + 64];
+	const char *batch[64];
+	cmph_uint32 keylens[64], hb[64][3], hp[64][3];
+	cmph_uint32 i, n = 0;
+	int ret = 0;
+
+	for (i = 0; i < sizeof(text); ++i) text[i] = (char)(i*31 + 7);
+	for (i = 0; i < 64; ++i)
+	{
+		batch[i] = text + i;
+		keylens[i] = i < 16 ? 16 : (i < 21 ? i + 4 : (i*7) % 41);
+	}
+	hash_state_pack(state, packed);
+	for (n = 0; n <= 64; n += 13)
+	{
+		hash_vector_batch(state, batch, keylens, n, hb);
+		hash_vector_packed_batch(packed, hashfunc, batch, keylens, n, hp);
+		for (i = 0; i < n; ++i)
+		{
+			cmph_uint32 h[3];
+			hash_vector(state, batch[i], keylens[i], h);
+			if (memcmp(h, hb[i], sizeof(h)) != 0 || memcmp(h, hp[i], sizeof(h)) != 0)
+			{
+				fprintf(stderr, "%s: inconsistent batch value for key %u of %u bytes\n", cmph_hash_names[hashfunc], i, keylens[i]);
+				ret = 1;
+			}
+		}
+	}
+	free(packed);
+	hash_state_destroy(state);
+	return ret;
+}
+
+#define NSEQUENTIAL 70000
+
+// Every bit of the three values must be set for about half of the keys
+// "0" to "69999", whose bytes differ little, and so must the values modulo 4.
+// The standard deviation of each fraction is below 0.002.
+// The first value of jenkins, the baseline function whose values are fixed
+// by the dumped functions, is known to be skewed on short keys.
+static int check_distribution(CMPH_HASH hashfunc)
+{
+	hash_state_t *state = hash_state_new(hashfunc, 1000);
+	cmph_uint32 ones[3][32], mod4[3][4];
+	char key[16];
+	cmph_uint32 i, j, b;
+	int ret = 0;
+
+	memset(ones, 0, sizeof(ones));
+	memset(mod4, 0, sizeof(mod4));
+	for (i = 0; i < NSEQUENTIAL; ++i)
+	{
+		cmph_uint32 h[3];
+		hash_vector(state, key, (cmph_uint32)sprintf(key, "%u", i), h);
+		for (j = 0; j < 3; ++j)
+		{
+			for (b = 0; b < 32; ++b) ones[j][b] += (h[j] >> b) & 1;
+			++mod4[j][h[j] & 3];
+		}
+	}
+	for (j = hashfunc == CMPH_HASH_JENKINS ? 1 : 0; j < 3; ++j)
+	{
+		for (b = 0; b < 32; ++b)
+		{
+			double fraction = (double)ones[j][b]/NSEQUENTIAL;
+			if (fraction < 0.48 || fraction > 0.52)
+			{
+				fprintf(stderr, "%s: bit %u of value %u set for %.3f of the keys\n", cmph_hash_names[hashfunc], b, j, fraction);
+				ret = 1;
+			}
+		}
+		for (b = 0; b < 4; ++b)
+		{
+			double fraction = (double)mod4[j][b]/NSEQUENTIAL;
+			if (fraction < 0.23 || fraction > 0.27)
+			{
+				fprintf(stderr, "%s: value %u is %u modulo 4 for %.3f of the keys\n", cmph_hash_names[hashfunc], j, b, fraction);
+				ret = 1;
+			}
+		}
+	}
+	hash_state_destroy(state);
+	return ret;
+}
+
+// CHM takes both of its functions from a single state when they are of the
+// same type, the two values must be independent enough for its graph to be
+// acyclic within the retries.
+static int check_chm(CMPH_HASH hashfunc)
+{
+	char **keys = (char **)malloc(sizeof(char *)*NSEQUENTIAL);
+	CMPH_HASH hashfuncs[3];
+	cmph_io_adapter_t *source;
+	cmph_config_t *config;
+	cmph_t *mphf;
+	cmph_uint32 i;
+
+	for (i = 0; i < NSEQUENTIAL; ++i)
+	{
+		keys[i] = (char *)malloc(8);
+		sprintf(keys[i], "%u", i);
+	}
+	hashfuncs[0] = hashfuncs[1] = hashfunc;
+	hashfuncs[2] = CMPH_HASH_COUNT;
+	source = cmph_io_vector_adapter(keys, NSEQUENTIAL);
+	config = cmph_config_new(source);
+	cmph_config_set_algo(config, CMPH_CHM);
+	cmph_config_set_hashfuncs(config, hashfuncs);
+	mphf = cmph_new(config);
+	cmph_config_destroy(config);
+	cmph_io_vector_adapter_destroy(source);
+	for (i = 0; i < NSEQUENTIAL; ++i) free(keys[i]);
+	free(keys);
+	if (mphf == NULL)
+	{
+		fprintf(stderr, "%s: unable to create a chm function\n", cmph_hash_names[hashfunc]);
+		return 1;
+	}
+	cmph_destroy(mphf);
+	return 0;
+}
+
+int main(void)
+{
+	cmph_uint32 i;
+	int ret = 0;
+	for (i = 0; i < CMPH_HASH_COUNT; ++i) ret |= check_hash((CMPH_HASH)i);
+	for (i = 0; i < CMPH_HASH_COUNT; ++i) ret |= check_pair((CMPH_HASH)i);
+	for (i = 0; i < CMPH_HASH_COUNT; ++i) ret |= check_batch((CMPH_HASH)i);
+	for (i = 0; i < CMPH_HASH_COUNT; ++i) ret |= check_distribution((CMPH_HASH)i);
+	for (i = 0; i < CMPH_HASH_COUNT; ++i) ret |= check_chm((CMPH_HASH)i);
+	ret |= check_fingerprint();
+	return ret;
+}
@@ -0,0 +1,335 @@
+#include "../src/cmph.h"
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+
+// The test file holds an empty key, keys of many lengths, one longer than
+// BUFSIZ, and a last line without newline, which is not a key.
+static const char *lines[] = { "first", "", "second key", NULL };
+
+// Reads every key of both adapters twice, checking that rewind starts over.
+static int check_same_keys(cmph_io_adapter_t *expected, cmph_io_adapter_t *source, const char *name)
+{
+	cmph_uint32 pass;
+	cmph_uint64 i;
+	if (source == NULL || source->nkeys != expected->nkeys)
+	{
+		fprintf(stderr, "%s: wrong number of keys\n", name);
+		return 1;
+	}
+	for (pass = 0; pass < 2; pass++)
+	{
+		expected->rewind(expected->data);
+		source->rewind(source->data);
+		for (i = 0; i < expected->nkeys; i++)
+		{
+			char *k1, *k2;
+			cmph_uint32 l1, l2;
+			int differ;
+			expected->read(expected->data, &k1, &l1);
+			source->read(source->data, &k2, &l2);
+			differ = l1 != l2 || memcmp(k1, k2, l1) != 0;
+			expected->dispose(expected->data, k1, l1);
+			source->dispose(source->data, k2, l2);
+			if (differ)
+			{
+				fprintf(stderr, "%s: key %llu differs\n", name, (unsigned long long)i);
+				return 1;
+			}
+		}
+	}
+	return 0;
+}
+
+// Reads the chunks of source in batches, checking that they hold the keys of
+// expected in the same order.
+static int check_chunks(cmph_io_adapter_t *expected, cmph_io_adapter_t *source, const char *name)
+{
+	char *keys[7];
+	cmph_uint32 keylens[7];
+	cmph_uint32 chunk, i, n;
+	cmph_uint64 nkeys = 0;
+	expected->rewind(expected->data);
+	source->rewind(source->data);
+	for (chunk = 0; chunk < source->nchunks; chunk++)
+	{
+		if (source->chunk_first[chunk] != nkeys)
+		{
+			fprintf(stderr, "%s: chunk %u does not start at key %llu\n", name, chunk, (unsigned long long)nkeys);
+			return 1;
+		}
+		while ((n = source->read_batch(source->data, chunk, keys, keylens, 7)) > 0)
+		{
+			for (i = 0; i < n; i++, nkeys++)
+			{
+				char *key;
+				cmph_uint32 keylen;
+				int differ;
+				expected->read(expected->data, &key, &keylen);
+				differ = keylen != keylens[i] || memcmp(key, keys[i], keylen) != 0;
+				expected->dispose(expected->data, key, keylen);
+				source->dispose(source->data, keys[i], keylens[i]);
+				if (differ)
+				{
+					fprintf(stderr, "%s: key %llu differs\n", name, (unsigned long long)nkeys);
+					return 1;
+				}
+			}
+		}
+	}
+	if (nkeys != expected->nkeys || source->chunk_first[source->nchunks] != nkeys)
+	{
+		fprintf(stderr, "%s: wrong number of keys in chunks\n", name);
+		return 1;
+	}
+	return 0;
+}
+
+// Binary keys may hold newlines and zeros, and need multibyte lengths.
+static const char binary_keys[] = "a\nb\0c";
+
+// Writes source to a binary key file and checks that it reads back the same keys.
+static int check_binfile(cmph_io_adapter_t *source, const char *name)
+{
+	char filename[] = "io_adapter_tests.bin.XXXXXX";
+	cmph_io_adapter_t *binary;
+	FILE *f;
+	int ret;
+
+	if (mkstemp(filename) < 0) return 1;
+	f = fopen(filename, "wb");
+	ret = !cmph_io_binfile_write(source, f);
+	fclose(f);
+	binary = cmph_io_binfile_adapter(filename);
+	ret |= check_same_keys(source, binary, name);
+	if (binary) cmph_io_binfile_adapter_destroy(binary);
+	remove(filename);
+	return ret;
+}
+
+// Builds a function from a stream of unknown size, which cmph_new reads once,
+// and checks that it maps the keys of the file onto [0, nkeys) and that the
+// statistics of the construction account for the spill. The spill goes to
+// tmp_dir, so a missing directory must fail the construction.
+static int check_stream_build(const char *filename, cmph_uint32 nkeys, const char *tmp_dir, int missing)
+{
+	FILE *f = fopen(filename, "r");
+	cmph_io_adapter_t *source = cmph_io_nlstream_adapter(f);
+	cmph_config_t *config = cmph_config_new(source);
+	cmph_t *mphf;
+	cmph_build_stats_t stats;
+	cmph_uint8 *seen = (cmph_uint8 *)calloc((size_t)nkeys, sizeof(cmph_uint8));
+	cmph_uint32 i;
+	int ret = 0;
+
+	cmph_config_set_algo(config, CMPH_BDZ);
+	cmph_config_set_tmp_dir(config, (cmph_uint8 *)tmp_dir);
+	mphf = cmph_new(config);
+	cmph_config_get_build_stats(config, &stats);
+	cmph_config_destroy(config);
+	cmph_io_nlstream_adapter_destroy(source);
+	if (missing)
+	{
+		if (mphf)
+		{
+			fprintf(stderr, "nlstream: spilled the keys outside of %s\n", tmp_dir);
+			ret = 1;
+		}
+	}
+	else if (mphf == NULL || cmph_size(mphf) != nkeys)
+	{
+		fprintf(stderr, "nlstream: unable to build a function of %u keys\n", nkeys);
+		ret = 1;
+	}
+	else if (stats.iterations == 0 || stats.tmp_bytes_written == 0 || stats.bits_per_key <= 0 ||
+	         stats.total_wall_time < 0 || stats.total_cpu_time < stats.cpu_time[CMPH_PHASE_HASHING])
+	{
+		fprintf(stderr, "nlstream: inconsistent build statistics\n");
+		ret = 1;
+	}
+	else
+	{
+		source = cmph_io_nlfile_adapter(f);
+		for (i = 0; i < nkeys; i++)
+		{
+			char *key;
+			cmph_uint32 keylen, h;
+			source->read(source->data, &key, &keylen);
+			h = cmph_search(mphf, key, keylen);
+			source->dispose(source->data, key, keylen);
+			if (h >= nkeys || seen[h]++)
+			{
+				fprintf(stderr, "nlstream: key %u collides\n", i);
+				ret = 1;
+				break;
+			}
+		}
+		cmph_io_nlfile_adapter_destroy(source);
+	}
+	if (mphf) cmph_destroy(mphf);
+	free(seen);
+	fclose(f);
+	return ret;
+}
+
+// Checks that cmph_new finds the duplicated keys of a file holding each of
+// its unique keys twice, and that dropping them, on a chunked source read by
+// two threads, gives a function of the unique keys.
+static int check_duplicates(const char *filename, cmph_uint32 nkeys, cmph_uint32 unique)
+{
+	cmph_io_adapter_t *source = cmph_io_mmap_nlfile_adapter(filename);
+	cmph_config_t *config = cmph_config_new(source);
+	cmph_t *mphf;
+	cmph_build_stats_t stats;
+	cmph_uint8 *seen = (cmph_uint8 *)calloc((size_t)unique, sizeof(cmph_uint8));
+	cmph_uint32 i;
+	int ret = 0;
+
+	cmph_config_set_algo(config, CMPH_BDZ);
+	cmph_config_set_threads(config, 2);
+	cmph_config_set_duplicates(config, CMPH_DUPLICATES_FAIL);
+	mphf = cmph_new(config);
+	cmph_config_get_build_stats(config, &stats);
+	if (mphf != NULL || stats.duplicates != nkeys - unique || stats.first_duplicate != unique)
+	{
+		fprintf(stderr, "duplicates: %llu duplicated keys found, the first one at %llu\n",
+		        (unsigned long long)stats.duplicates, (unsigned long long)stats.first_duplicate);
+		if (mphf) cmph_destroy(mphf);
+		ret = 1;
+	}
+	cmph_config_set_duplicates(config, CMPH_DUPLICATES_DROP);
+	mphf = cmph_new(config);
+	cmph_config_destroy(config);
+	if (mphf == NULL || cmph_size(mphf) != unique)
+	{
+		fprintf(stderr, "duplicates: unable to build a function of %u unique keys\n", unique);
+		ret = 1;
+	}
+	else
+	{
+		source->rewind(source->data);
+		for (i = 0; i < unique; i++)
+		{
+			char *key;
+			cmph_uint32 keylen, h;
+			source->read(source->data, &key, &keylen);
+			h = cmph_search(mphf, key, keylen);
+			source->dispose(source->data, key, keylen);
+			if (h >= unique || seen[h]++)
+			{
+				fprintf(stderr, "duplicates: key %u collides\n", i);
+				ret = 1;
+				break;
+			}
+		}
+	}
+	if (mphf) cmph_destroy(mphf);
+	cmph_io_mmap_nlfile_adapter_destroy(source);
+	free(seen);
+	return ret;
+}
+
+int main(void)
+{
+	char filename[] = "io_adapter_tests.XXXXXX";
+	cmph_io_adapter_t *expected, *source;
+	FILE *f;
+	int i, ret = 0;
+
+	if (mkstemp(filename) < 0) return 1;
+	f = fopen(filename, "w");
+	for (i = 0; lines[i]; i++) fprintf(f, "%s\n", lines[i]);
+	for (i = 0; i < 1000; i++) fprintf(f, "key-%d-%0*d\n", i, i % 300, 0);
+	fprintf(f, "long-%0*d\n", 3 * BUFSIZ, 0);
+	fprintf(f, "unterminated");
+	fclose(f);
+
+	f = fopen(filename, "r");
+	expected = cmph_io_nlfile_adapter(f);
+	source = cmph_io_mmap_nlfile_adapter(filename);
+	ret |= check_same_keys(expected, source, "mmap_nlfile");
+	if (source) ret |= check_chunks(expected, source, "mmap_nlfile");
+	if (source) cmph_io_mmap_nlfile_adapter_destroy(source);
+	ret |= check_binfile(expected, "binfile");
+	cmph_io_nlfile_adapter_destroy(expected);
+	fclose(f);
+
+	// a text file is not taken for a binary key file
+	source = cmph_io_binfile_adapter(filename);
+	if (source)
+	{
+		fprintf(stderr, "binfile: accepted a text file\n");
+		cmph_io_binfile_adapter_destroy(source);
+		ret = 1;
+	}
+
+	// the keys of several files, cut into many chunks, are those of the files in turn
+	{
+		char whole[] = "io_adapter_tests.whole.XXXXXX";
+		char part[] = "io_adapter_tests.part.XXXXXX";
+		char empty[] = "io_adapter_tests.empty.XXXXXX";
+		const char *parts[3];
+		if (mkstemp(whole) < 0 || mkstemp(part) < 0 || mkstemp(empty) < 0) return 1;
+		f = fopen(part, "w");
+		for (i = 0; i < 100000; i++) fprintf(f, "part-%d\n", i);
+		fclose(f);
+		f = fopen(whole, "w");
+		for (i = 0; i < 200000; i++) fprintf(f, "part-%d\n", i % 100000);
+		fclose(f);
+		parts[0] = part;
+		parts[1] = empty;
+		parts[2] = part;
+		f = fopen(whole, "r");
+		expected = cmph_io_nlfile_adapter(f);
+		source = cmph_io_mmap_nlfiles_adapter(parts, 3);
+		ret |= check_same_keys(expected, source, "mmap_nlfiles");
+		if (source && source->nchunks < 2)
+		{
+			fprintf(stderr, "mmap_nlfiles: %u chunks\n", source->nchunks);
+			ret = 1;
+		}
+		if (source) ret |= check_chunks(expected, source, "mmap_nlfiles");
+		if (source) cmph_io_mmap_nlfiles_adapter_destroy(source);
+		cmph_io_nlfile_adapter_destroy(expected);
+		fclose(f);
+		ret |= check_stream_build(part, 100000, ".", 0);
+		ret |= check_stream_build(part, 100000, "io_adapter_tests.missing", 1);
+		ret |= check_duplicates(whole, 200000, 100000);
+		remove(whole);
+		remove(part);
+		remove(empty);
+	}
+
+	{
+		cmph_uint8 *vector[3];
+		cmph_uint32 lengths[3] = { (cmph_uint32)sizeof(binary_keys), 0, 300 };
+		for (i = 0; i < 3; i++)
+		{
+			vector[i] = (cmph_uint8 *)calloc((size_t)1, sizeof(cmph_uint32) + lengths[i]);
+			memcpy(vector[i], &lengths[i], sizeof(cmph_uint32));
+		}
+		memcpy(vector[0] + sizeof(cmph_uint32), binary_keys, sizeof(binary_keys));
+		memset(vector[2] + sizeof(cmph_uint32), '\n', (size_t)300);
+		source = cmph_io_byte_vector_adapter(vector, 3);
+		ret |= check_binfile(source, "binfile of binary keys");
+		// the keys are borrowed from the vector, not copied
+		{
+			char *key;
+			cmph_uint32 keylen;
+			source->rewind(source->data);
+			source->read(source->data, &key, &keylen);
+			if (!(source->flags & CMPH_IO_BORROWED_KEYS) || key != (char *)vector[0] + sizeof(cmph_uint32))
+			{
+				fprintf(stderr, "byte_vector: keys are copied\n");
+				ret = 1;
+			}
+			source->dispose(source->data, key, keylen);
+		}
+		cmph_io_byte_vector_adapter_destroy(source);
+		for (i = 0; i < 3; i++) free(vector[i]);
+	}
+
+	remove(filename);
+	return ret;
+}
@@ -0,0 +1,105 @@
+#include "../src/cmph.h"
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+
+#define NKEYS 3000
+
+static cmph_t *create_mphf(cmph_io_adapter_t *source, CMPH_ALGO algo)
+{
+	cmph_config_t *config;
+	cmph_t *mphf;
+	FILE *mphf_fd = tmpfile();
+
+	source->rewind(source->data);
+	config = cmph_config_new(source);
+	cmph_config_set_algo(config, algo);
+	cmph_config_set_tmp_dir(config, (cmph_uint8 *)P_tmpdir);
+	cmph_config_set_mphf_fd(config, mphf_fd);
+	cmph_config_set_keys_per_shard(config, NKEYS / 7);
+	cmph_config_set_threads(config, 3);
+	mphf = cmph_new(config);
+	cmph_config_destroy(config);
+	if (mphf == NULL)
+	{
+		fclose(mphf_fd);
+		return NULL;
+	}
+	cmph_dump(mphf, mphf_fd);
+	cmph_destroy(mphf);
+	rewind(mphf_fd);
+	mphf = cmph_load(mphf_fd);
+	fclose(mphf_fd);
+	return mphf;
+}
+
+static int check_mmap(cmph_io_adapter_t *source, CMPH_ALGO algo, char **keys, cmph_uint32 nkeys)
+{
+	char filename[] = P_tmpdir "/cmph_mmap_testXXXXXX";
+	cmph_t *mphf;
+	void *packed_mphf;
+	FILE *f;
+	int fd, ret = 0;
+	cmph_uint32 i;
+
+	mphf = create_mphf(source, algo);
+	if (mphf == NULL)
+	{
+		fprintf(stderr, "Unable to create %s function\n", cmph_names[algo]);
+		return 1;
+	}
+	fd = mkstemp(filename);
+	f = fdopen(fd, "wb");
+	if (!cmph_mmap_dump(mphf, f))
+	{
+		fprintf(stderr, "%s: unable to write %s\n", cmph_names[algo], filename);
+		ret = 1;
+	}
+	fclose(f);
+
+	packed_mphf = cmph_mmap_open(filename);
+	if (packed_mphf == NULL || ((size_t)packed_mphf & 63) != 0 || cmph_mmap_size(packed_mphf) != cmph_size(mphf))
+	{
+		fprintf(stderr, "%s: unable to map %s\n", cmph_names[algo], filename);
+		ret = 1;
+	}
+	for (i = 0; ret == 0 && i < nkeys; i++)
+	{
+		cmph_uint32 keylen = (cmph_uint32)strlen(keys[i]);
+		if (cmph_search_packed(packed_mphf, keys[i], keylen) != cmph_search(mphf, keys[i], keylen))
+		{
+			fprintf(stderr, "%s: mapped search mismatch for key %s\n", cmph_names[algo], keys[i]);
+			ret = 1;
+		}
+	}
+	cmph_mmap_close(packed_mphf);
+	unlink(filename);
+	cmph_destroy(mphf);
+	return ret;
+}
+
+int main(void)
+{
+	char *vector[NKEYS];
+	cmph_io_adapter_t *source;
+	cmph_uint32 i;
+	int ret = 0;
+
+	for (i = 0; i < NKEYS; i++)
+	{
+		vector[i] = (char *)malloc(32);
+		sprintf(vector[i], "key-%u", i * 7919);
+	}
+	source = cmph_io_vector_adapter(vector, NKEYS);
+	for (i = 0; i < CMPH_COUNT; i++)
+	{
+		// BMZ8 is limited to 256 keys
+		if (i == CMPH_BMZ8) continue;
+		ret |= check_mmap(source, (CMPH_ALGO)i, vector, NKEYS);
+	}
+	cmph_io_vector_adapter_destroy(source);
+	for (i = 0; i < NKEYS; i++) free(vector[i]);
+	return ret;
+}
@@ -0,0 +1,233 @@
+#include "../src/cmph.h"
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+
+#define NKEYS 5000
+
+static int check_batch(cmph_io_adapter_t *source, CMPH_ALGO algo, const char **keys, cmph_uint32 *keylens, cmph_uint32 nkeys)
+{
+	cmph_config_t *config;
+	cmph_t *mphf;
+	cmph_uint32 *out, i, size;
+	char *packed;
+	int ret = 0;
+
+	source->rewind(source->data);
+	config = cmph_config_new(source);
+	cmph_config_set_algo(config, algo);
+	mphf = cmph_new(config);
+	cmph_config_destroy(config);
+	if (mphf == NULL)
+	{
+		fprintf(stderr, "Unable to create %s function\n", cmph_names[algo]);
+		return 1;
+	}
+
+	out = (cmph_uint32 *)malloc(sizeof(cmph_uint32)*nkeys);
+	cmph_search_batch(mphf, keys, keylens, nkeys, out);
+	for (i = 0; i < nkeys; i++)
+	{
+		if (out[i] != cmph_search(mphf, keys[i], keylens[i]))
+		{
+			fprintf(stderr, "%s: batch search mismatch for key %s\n", cmph_names[algo], keys[i]);
+			ret = 1;
+			break;
+		}
+	}
+
+	size = cmph_packed_size(mphf);
+	packed = (char *)malloc(size);
+	cmph_pack(mphf, packed);
+	cmph_search_packed_batch(packed, keys, keylens, nkeys, out);
+	for (i = 0; i < nkeys; i++)
+	{
+		if (out[i] != cmph_search_packed(packed, keys[i], keylens[i]))
+		{
+			fprintf(stderr, "%s: packed batch search mismatch for key %s\n", cmph_names[algo], keys[i]);
+			ret = 1;
+			break;
+		}
+	}
+
+	free(packed);
+	free(out);
+	cmph_destroy(mphf);
+	return ret;
+}
+
+// Builds a function of integer keys, either 4 or 8 bytes wide, and checks
+// that the integer searches, packed or not, agree with the search of their
+// bytes and map the keys to distinct values.
+static int check_integer(CMPH_ALGO algo, CMPH_HASH hashfunc, cmph_uint32 width)
+{
+	cmph_uint64 *keys64 = (cmph_uint64 *)malloc(sizeof(cmph_uint64)*NKEYS);
+	cmph_uint32 *keys32 = (cmph_uint32 *)malloc(sizeof(cmph_uint32)*NKEYS);
+	// CHD_PH is not minimal, its range has a bit over nkeys/load_factor slots
+	cmph_uint32 range = algo == CMPH_CHD_PH ? 4*NKEYS : NKEYS;
+	cmph_uint8 *seen = (cmph_uint8 *)calloc((size_t)range, sizeof(cmph_uint8));
+	CMPH_HASH hashfuncs[3];
+	cmph_io_adapter_t *source;
+	cmph_config_t *config;
+	cmph_t *mphf;
+	char *packed;
+	cmph_uint32 i;
+	int ret = 0;
+
+	for (i = 0; i < NKEYS; i++)
+	{
+		keys64[i] = (cmph_uint64)i * 0x100000001ULL + 12345;
+		keys32[i] = i * 7919;
+	}
+	hashfuncs[0] = hashfuncs[1] = hashfunc;
+	hashfuncs[2] = CMPH_HASH_COUNT;
+	source = width == sizeof(cmph_uint64) ? cmph_io_u64_vector_adapter(keys64, NKEYS) : cmph_io_u32_vector_adapter(keys32, NKEYS);
+	config = cmph_config_new(source);
+	cmph_config_set_algo(config, algo);
+	cmph_config_set_hashfuncs(config, hashfuncs);
+	mphf = cmph_new(config);
+	cmph_config_destroy(config);
+	if (width == sizeof(cmph_uint64)) cmph_io_u64_vector_adapter_destroy(source);
+	else cmph_io_u32_vector_adapter_destroy(source);
+	if (mphf == NULL)
+	{
+		fprintf(stderr, "Unable to create %s function of integers\n", cmph_names[algo]);
+		free(keys64);
+		free(keys32);
+		free(seen);
+		return 1;
+	}
+	packed = (char *)malloc(cmph_packed_size(mphf));
+	cmph_pack(mphf, packed);
+	for (i = 0; i < NKEYS; i++)
+	{
+		cmph_uint32 h, hb, hp;
+		if (width == sizeof(cmph_uint64))
+		{
+			h = cmph_search_u64(mphf, keys64[i]);
+			hb = cmph_search(mphf, (const char *)&keys64[i], width);
+			hp = cmph_search_packed_u64(packed, keys64[i]);
+		}
+		else
+		{
+			h = cmph_search_u32(mphf, keys32[i]);
+			hb = cmph_search(mphf, (const char *)&keys32[i], width);
+			hp = cmph_search_packed_u32(packed, keys32[i]);
+		}
+		if (h != hb || h != hp || h >= range || seen[h]++)
+		{
+			fprintf(stderr, "%s: integer search of %s mismatch for key %u of %u bytes\n", cmph_names[algo], cmph_hash_names[hashfunc], i, width);
+			ret = 1;
+			break;
+		}
+	}
+	free(packed);
+	cmph_destroy(mphf);
+	free(keys64);
+	free(keys32);
+	free(seen);
+	return ret;
+}
+
+// BDZ function of the keys "key-0" to "key-299" packed by cmph_pack before
+// the 64-byte lines, and its values.
+#define NBASELINE 300
+static const cmph_uint8 baseline_bdz[] = {
+	0x05, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x0d, 0x00, 0x00, 0x00,
+	0x7b, 0x00, 0x00, 0x00, 0x03, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+	0x75, 0x00, 0x00, 0x00, 0xd9, 0x00, 0x00, 0x00, 0x07, 0xa0, 0x28, 0xd9,
+	0x1a, 0x54, 0x46, 0xa6, 0x00, 0x61, 0x88, 0x09, 0xf8, 0x25, 0x8d, 0x49,
+	0xa3, 0xa8, 0x36, 0x12, 0x81, 0x70, 0x28, 0x97, 0x82, 0x01, 0x72, 0x79,
+	0x05, 0x66, 0x08, 0x59, 0xa3, 0xad, 0xbf, 0x26, 0xb9, 0x77, 0x52, 0xdf,
+	0x4f, 0x7d, 0x5a, 0x85, 0x55, 0x82, 0x64, 0x00, 0x44, 0x4d, 0x55, 0x99,
+	0x55, 0x95, 0x1c, 0xbf, 0xc7, 0x55, 0x9b, 0x90, 0x9c, 0x96, 0x67, 0xf5,
+	0x7b, 0x85, 0x6e, 0x22, 0x87, 0x93, 0x3e, 0x89, 0x6d, 0x2a, 0xaf, 0x9c,
+	0xbe, 0x4c, 0xd3, 0x08, 0x79, 0xcb, 0x57, 0x5e, 0x4c, 0x5f, 0x1f, 0xa4,
+	0x97, 0x5d, 0xee, 0x3e, 0x92, 0xfd
+};
+static const cmph_uint32 baseline_bdz_values[NBASELINE] = {
+	56, 24, 146, 176, 35, 17, 131, 254, 291, 106, 82, 156, 299, 221, 174, 152,
+	122, 96, 5, 36, 69, 243, 105, 81, 292, 218, 200, 245, 92, 103, 257, 215,
+	207, 226, 209, 31, 202, 182, 225, 95, 18, 132, 78, 162, 42, 140, 258, 51,
+	190, 262, 139, 3, 115, 65, 272, 55, 33, 282, 285, 267, 187, 205, 188, 97,
+	240, 224, 59, 58, 73, 1, 180, 79, 172, 67, 85, 211, 239, 263, 76, 98,
+	173, 269, 238, 241, 186, 256, 2, 117, 128, 9, 75, 126, 185, 142, 52, 268,
+	138, 227, 151, 91, 28, 168, 166, 184, 259, 23, 88, 251, 170, 102, 249, 255,
+	83, 232, 11, 214, 137, 130, 71, 192, 19, 248, 46, 84, 171, 107, 44, 289,
+	260, 250, 32, 210, 189, 230, 195, 234, 276, 206, 204, 164, 219, 183, 104, 279,
+	294, 40, 223, 203, 296, 53, 129, 39, 66, 144, 108, 280, 15, 175, 134, 220,
+	295, 275, 287, 135, 242, 6, 34, 26, 143, 191, 27, 270, 253, 158, 298, 63,
+	236, 119, 114, 288, 16, 231, 150, 281, 247, 181, 252, 89, 120, 229, 48, 160,
+	12, 0, 154, 155, 99, 45, 109, 145, 123, 167, 201, 244, 110, 208, 141, 274,
+	293, 68, 125, 74, 213, 127, 222, 13, 194, 30, 228, 14, 273, 29, 22, 25,
+	246, 178, 37, 149, 277, 283, 124, 54, 111, 72, 49, 10, 90, 193, 266, 197,
+	237, 64, 153, 148, 284, 136, 4, 297, 290, 57, 43, 113, 121, 62, 235, 7,
+	47, 157, 198, 94, 50, 60, 196, 86, 8, 179, 118, 163, 212, 20, 261, 271,
+	199, 116, 112, 70, 100, 265, 80, 165, 264, 133, 161, 77, 61, 233, 87, 38,
+	278, 101, 93, 147, 21, 177, 159, 41, 286, 216, 217, 169
+};
+
+static int check_baseline_bdz(void)
+{
+	void *packed = malloc(sizeof(baseline_bdz));
+	const char *keys[NBASELINE];
+	cmph_uint32 keylens[NBASELINE], out[NBASELINE];
+	char text[NBASELINE][16];
+	cmph_uint32 i;
+	int ret = 0;
+
+	memcpy(packed, baseline_bdz, sizeof(baseline_bdz));
+	for (i = 0; i < NBASELINE; i++)
+	{
+		keylens[i] = (cmph_uint32)sprintf(text[i], "key-%u", i);
+		keys[i] = text[i];
+	}
+	cmph_search_packed_batch(packed, keys, keylens, NBASELINE, out);
+	for (i = 0; i < NBASELINE; i++)
+	{
+		if (cmph_search_packed(packed, keys[i], keylens[i]) != baseline_bdz_values[i] || out[i] != baseline_bdz_values[i])
+		{
+			fprintf(stderr, "bdz: wrong value for key %s of a function packed by a previous release\n", keys[i]);
+			ret = 1;
+			break;
+		}
+	}
+	free(packed);
+	return ret;
+}
+
+int main(void)
+{
+	char *vector[NKEYS];
+	cmph_uint32 keylens[NKEYS];
+	cmph_io_adapter_t *source;
+	cmph_uint32 i;
+	int ret = 0;
+
+	for (i = 0; i < NKEYS; i++)
+	{
+		vector[i] = (char *)malloc(32);
+		keylens[i] = (cmph_uint32)sprintf(vector[i], "key-%u", i * 7919);
+	}
+	source = cmph_io_vector_adapter(vector, NKEYS);
+
+	ret |= check_batch(source, CMPH_BDZ, (const char **)vector, keylens, NKEYS);
+	ret |= check_batch(source, CMPH_BDZ_PH, (const char **)vector, keylens, NKEYS);
+	ret |= check_batch(source, CMPH_CHD_PH, (const char **)vector, keylens, NKEYS);
+	ret |= check_batch(source, CMPH_CHD, (const char **)vector, keylens, NKEYS);
+	ret |= check_batch(source, CMPH_BMZ, (const char **)vector, keylens, NKEYS);
+
+	ret |= check_baseline_bdz();
+	ret |= check_integer(CMPH_BDZ, CMPH_HASH_INTEGER, 8);
+	ret |= check_integer(CMPH_BDZ, CMPH_HASH_INTEGER, 4);
+	ret |= check_integer(CMPH_BDZ, CMPH_HASH_JENKINS, 8);
+	ret |= check_integer(CMPH_CHD_PH, CMPH_HASH_INTEGER, 8);
+	ret |= check_integer(CMPH_CHD, CMPH_HASH_INTEGER, 8);
+	ret |= check_integer(CMPH_CHD, CMPH_HASH_MURMUR, 4);
+	ret |= check_integer(CMPH_BMZ, CMPH_HASH_INTEGER, 4);
+
+	cmph_io_vector_adapter_destroy(source);
+	for (i = 0; i < NKEYS; i++) free(vector[i]);
+	return ret;
+}
@@ -0,0 +1,187 @@
+#include "../src/cmph.h"
+#include "../src/cmph_structs.h"
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+
+#define NKEYS 3000
+
+// Sizes that do not fit in 32 bits are written after CMPH_SIZE64_FLAG,
+// smaller ones keep the original 32-bit field. A non zero version is
+// written after CMPH_VERSION_FLAG, ahead of the size.
+static int check_header(cmph_uint32 version, cmph_uint64 size, long expected_length)
+{
+	FILE *f = tmpfile();
+	cmph_t *mphf;
+	int ret = 0;
+
+	__cmph_dump_header(CMPH_BRZ, version, size, f);
+	if (ftell(f) != expected_length)
+	{
+		fprintf(stderr, "Header of size %llu has %ld bytes\n", (unsigned long long)size, ftell(f));
+		ret = 1;
+	}
+	rewind(f);
+	mphf = __cmph_load(f);
+	if (mphf == NULL || mphf->algo != CMPH_BRZ || mphf->version != version || mphf->size != size)
+	{
+		fprintf(stderr, "Unable to load header of size %llu\n", (unsigned long long)size);
+		ret = 1;
+	}
+	free(mphf);
+	fclose(f);
+	return ret;
+}
+
+// bucket_algo is the algorithm of the BRZ buckets, CMPH_COUNT for the default.
+static int check_search64(cmph_io_adapter_t *source, CMPH_ALGO algo, CMPH_ALGO bucket_algo, char **keys, cmph_uint32 nkeys)
+{
+	cmph_config_t *config;
+	cmph_t *mphf;
+	FILE *mphf_fd = tmpfile();
+	void *packed_mphf;
+	char *seen;
+	cmph_uint32 i;
+	int ret = 0;
+
+	source->rewind(source->data);
+	config = cmph_config_new(source);
+	cmph_config_set_algo(config, algo);
+	cmph_config_set_tmp_dir(config, (cmph_uint8 *)P_tmpdir);
+	cmph_config_set_mphf_fd(config, mphf_fd);
+	cmph_config_set_keys_per_shard(config, NKEYS / 5);
+	if (bucket_algo != CMPH_COUNT)
+	{
+		cmph_config_set_bucket_algo(config, bucket_algo);
+		cmph_config_set_b(config, NKEYS / 4);
+	}
+	mphf = cmph_new(config);
+	cmph_config_destroy(config);
+	if (mphf == NULL)
+	{
+		fprintf(stderr, "Unable to create %s function\n", cmph_names[algo]);
+		fclose(mphf_fd);
+		return 1;
+	}
+	cmph_dump(mphf, mphf_fd);
+	cmph_destroy(mphf);
+	rewind(mphf_fd);
+	mphf = cmph_load(mphf_fd);
+	fclose(mphf_fd);
+
+	packed_mphf = malloc(cmph_packed_size(mphf));
+	cmph_pack(mphf, packed_mphf);
+	seen = (char *)calloc(nkeys, 1);
+	if (cmph_size64(mphf) != nkeys) ret = 1;
+	for (i = 0; ret == 0 && i < nkeys; i++)
+	{
+		cmph_uint32 keylen = (cmph_uint32)strlen(keys[i]);
+		cmph_uint64 h = cmph_search64(mphf, keys[i], keylen);
+		if (h != cmph_search(mphf, keys[i], keylen) || h != cmph_search_packed64(packed_mphf, keys[i], keylen))
+		{
+			fprintf(stderr, "%s: 64-bit search mismatch for key %s\n", cmph_names[algo], keys[i]);
+			ret = 1;
+		}
+		else if (h >= nkeys || seen[h]++)
+		{
+			fprintf(stderr, "%s: key %s collides or is out of range\n", cmph_names[algo], keys[i]);
+			ret = 1;
+		}
+	}
+	free(seen);
+	free(packed_mphf);
+	cmph_destroy(mphf);
+	return ret;
+}
+
+// CHD_SHARDED spills the keys of its shards to a file in the temporary
+// directory once they exceed the memory availability, here of 1MB.
+#define NSPILLED_KEYS 100000
+static int check_sharded_spill(void)
+{
+	char **keys = (char **)malloc(sizeof(char *)*NSPILLED_KEYS);
+	cmph_io_adapter_t *source;
+	cmph_config_t *config;
+	cmph_build_stats_t stats;
+	cmph_t *mphf;
+	char *seen;
+	cmph_uint32 i;
+	int ret = 0;
+
+	for (i = 0; i < NSPILLED_KEYS; i++)
+	{
+		keys[i] = (char *)malloc(40);
+		sprintf(keys[i], "spilled-key-%020u", i);
+	}
+	source = cmph_io_vector_adapter(keys, NSPILLED_KEYS);
+	config = cmph_config_new(source);
+	cmph_config_set_algo(config, CMPH_CHD_SHARDED);
+	cmph_config_set_tmp_dir(config, (cmph_uint8 *)P_tmpdir);
+	cmph_config_set_memory_availability(config, 1);
+	cmph_config_set_keys_per_shard(config, NSPILLED_KEYS / 8);
+	cmph_config_set_threads(config, 2);
+	mphf = cmph_new(config);
+	cmph_config_get_build_stats(config, &stats);
+	cmph_config_destroy(config);
+	if (mphf == NULL)
+	{
+		fprintf(stderr, "Unable to create spilled %s function\n", cmph_names[CMPH_CHD_SHARDED]);
+		ret = 1;
+	}
+	else if (stats.tmp_bytes_written == 0 || stats.tmp_bytes_read != stats.tmp_bytes_written)
+	{
+		fprintf(stderr, "Spilled %llu bytes and read back %llu\n",
+		        (unsigned long long)stats.tmp_bytes_written, (unsigned long long)stats.tmp_bytes_read);
+		ret = 1;
+	}
+	seen = (char *)calloc(NSPILLED_KEYS, 1);
+	for (i = 0; ret == 0 && i < NSPILLED_KEYS; i++)
+	{
+		cmph_uint32 h = cmph_search(mphf, keys[i], (cmph_uint32)strlen(keys[i]));
+		if (h >= NSPILLED_KEYS || seen[h]++)
+		{
+			fprintf(stderr, "Spilled key %s collides or is out of range\n", keys[i]);
+			ret = 1;
+		}
+	}
+	free(seen);
+	if (mphf) cmph_destroy(mphf);
+	cmph_io_vector_adapter_destroy(source);
+	for (i = 0; i < NSPILLED_KEYS; i++) free(keys[i]);
+	free(keys);
+	return ret;
+}
+
+int main(void)
+{
+	char *vector[NKEYS];
+	cmph_io_adapter_t *source;
+	long name_length = (long)strlen(cmph_names[CMPH_BRZ]) + 1;
+	cmph_uint32 i;
+	int ret = 0;
+
+	ret |= check_header(0, NKEYS, name_length + 4);
+	ret |= check_header(0, CMPH_VERSION_FLAG - 1, name_length + 4);
+	ret |= check_header(0, CMPH_VERSION_FLAG, name_length + 12);
+	ret |= check_header(0, CMPH_SIZE64_FLAG, name_length + 12);
+	ret |= check_header(0, 5000000000ULL, name_length + 12);
+	ret |= check_header(CMPH_VERSION_FASTRANGE, NKEYS, name_length + 12);
+	ret |= check_header(CMPH_VERSION_FASTRANGE, 5000000000ULL, name_length + 20);
+
+	for (i = 0; i < NKEYS; i++)
+	{
+		vector[i] = (char *)malloc(32);
+		sprintf(vector[i], "key-%u", i * 7919);
+	}
+	source = cmph_io_vector_adapter(vector, NKEYS);
+	ret |= check_search64(source, CMPH_BRZ, CMPH_COUNT, vector, NKEYS);
+	ret |= check_search64(source, CMPH_BRZ, CMPH_BDZ, vector, NKEYS);
+	ret |= check_search64(source, CMPH_BRZ, CMPH_CHD, vector, NKEYS);
+	ret |= check_search64(source, CMPH_CHD_SHARDED, CMPH_COUNT, vector, NKEYS);
+	ret |= check_search64(source, CMPH_BDZ, CMPH_COUNT, vector, NKEYS);
+	cmph_io_vector_adapter_destroy(source);
+	for (i = 0; i < NKEYS; i++) free(vector[i]);
+	ret |= check_sharded_spill();
+	return ret;
+}